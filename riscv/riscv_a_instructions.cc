@@ -20,6 +20,7 @@
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_pmp.h"
 #include "riscv/riscv_state.h"
 
 namespace mpact {
@@ -48,7 +49,24 @@ static inline void AInstructionHelper(Instruction *inst, Operation op,
     return;
   }
   // Submit the memory operation.
-  auto address = generic::GetInstructionSource<uint64_t>(inst, 0);
+  uint64_t address = generic::GetInstructionSource<uint64_t>(inst, 0);
+  // Atomic memory operations other than load reserved are translated, and
+  // fault, as stores.
+  bool is_store = op != Operation::kLoadLinked;
+  uint64_t physical_address = address;
+  if (!state->TranslateDataAddress(inst, sizeof(T), is_store,
+                                   &physical_address)) {
+    return;
+  }
+  // Load reserved requires read permission, store conditional write
+  // permission, and the other operations both.
+  int permissions = *PmpCfgBits::kRead | *PmpCfgBits::kWrite;
+  if (op == Operation::kLoadLinked) permissions = *PmpCfgBits::kRead;
+  if (op == Operation::kStoreConditional) permissions = *PmpCfgBits::kWrite;
+  if (!state->CheckMemoryProtection(inst, address, physical_address, sizeof(T),
+                                    permissions)) {
+    return;
+  }
   auto *db = inst->state()->db_factory()->Allocate<T>(1);
   db->set_latency(0);
   // Only access the operand if there is a value to be read.
@@ -57,8 +75,8 @@ static inline void AInstructionHelper(Instruction *inst, Operation op,
   }
   // This transfers ownership of db to context. Don't DecRef.
   auto *context = new LoadContext(db);
-  auto status = state->atomic_memory()->PerformMemoryOp(address, op, db,
-                                                        inst->child(), context);
+  auto status = state->atomic_memory()->PerformMemoryOp(
+      physical_address, op, db, inst->child(), context);
   // If the operation is unimplemented, this is an illegal instruction.
   if (absl::IsUnimplemented(status)) {
     state->Trap(/*is_interrupt*/ false, /*trap_value*/ 0,
@@ -0,0 +1,159 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_basic_block_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "mpact/sim/generic/instruction.h"
+
+namespace mpact::sim::riscv {
+
+RiscVBasicBlockCache::~RiscVBasicBlockCache() {
+  InvalidateAll();
+  FreeStaleBlocks();
+  if (recording_ != nullptr) DeleteBlock(recording_);
+  recording_ = nullptr;
+}
+
+void RiscVBasicBlockCache::StartRecording() {
+  if (recording_ == nullptr) {
+    recording_ = new RiscVBasicBlock();
+  } else {
+    // Release any instructions left over from a previous recording.
+    for (auto *inst : recording_->instructions) inst->DecRef();
+    recording_->instructions.clear();
+  }
+  recording_valid_ = true;
+}
+
+bool RiscVBasicBlockCache::Record(Instruction *inst) {
+  auto &instructions = recording_->instructions;
+  inst->IncRef();
+  if (instructions.empty()) {
+    recording_->start_address = inst->address();
+  }
+  instructions.push_back(inst);
+  // Instructions that signal a fetch fault have size 0, but the block must
+  // still contain their address, so that invalidating it removes the block.
+  recording_->end_address = inst->address() + std::max(inst->size(), 1);
+  return static_cast<int>(instructions.size()) < kMaxBlockSize;
+}
+
+RiscVBasicBlock *RiscVBasicBlockCache::FinishRecording() {
+  if (!recording_valid_ || recording_->instructions.empty()) {
+    for (auto *inst : recording_->instructions) inst->DecRef();
+    recording_->instructions.clear();
+    recording_valid_ = false;
+    return nullptr;
+  }
+  recording_valid_ = false;
+  auto *block = recording_;
+  recording_ = nullptr;
+  auto [it, inserted] = block_map_.insert({block->start_address, block});
+  if (!inserted) {
+    stale_blocks_.push_back(it->second);
+    it->second = block;
+    UnlinkAll(block_map_);
+  }
+  return block;
+}
+
+void RiscVBasicBlockCache::SelectContext(uint64_t context) {
+  if (context == context_) return;
+  recording_valid_ = false;
+  BlockMap block_map;
+  auto it = saved_block_maps_.find(context);
+  if (it != saved_block_maps_.end()) {
+    block_map = std::move(it->second);
+    saved_block_maps_.erase(it);
+  }
+  saved_block_maps_[context_] = std::move(block_map_);
+  block_map_ = std::move(block_map);
+  context_ = context;
+}
+
+void RiscVBasicBlockCache::InvalidateContext(uint64_t context) {
+  if (context == context_) {
+    recording_valid_ = false;
+    RemoveBlocks(block_map_);
+    return;
+  }
+  auto it = saved_block_maps_.find(context);
+  if (it == saved_block_maps_.end()) return;
+  RemoveBlocks(it->second);
+  saved_block_maps_.erase(it);
+}
+
+void RiscVBasicBlockCache::Invalidate(uint64_t address) {
+  // A block that is being recorded may contain a stale decoding.
+  recording_valid_ = false;
+  Invalidate(block_map_, address);
+  for (auto &[unused, block_map] : saved_block_maps_) {
+    Invalidate(block_map, address);
+  }
+}
+
+void RiscVBasicBlockCache::Invalidate(BlockMap &block_map, uint64_t address) {
+  std::vector<uint64_t> to_remove;
+  for (auto const &[start, block] : block_map) {
+    if ((address >= block->start_address) && (address < block->end_address)) {
+      to_remove.push_back(start);
+    }
+  }
+  if (to_remove.empty()) return;
+  for (auto start : to_remove) {
+    auto it = block_map.find(start);
+    stale_blocks_.push_back(it->second);
+    block_map.erase(it);
+  }
+  // Links to the removed blocks may be cached anywhere, so clear them all.
+  UnlinkAll(block_map);
+}
+
+void RiscVBasicBlockCache::InvalidateAll() {
+  recording_valid_ = false;
+  RemoveBlocks(block_map_);
+  for (auto &[unused, block_map] : saved_block_maps_) RemoveBlocks(block_map);
+  saved_block_maps_.clear();
+}
+
+void RiscVBasicBlockCache::FreeStaleBlocks() {
+  for (auto *block : stale_blocks_) DeleteBlock(block);
+  stale_blocks_.clear();
+}
+
+void RiscVBasicBlockCache::RemoveBlocks(BlockMap &block_map) {
+  for (auto &[unused, block] : block_map) {
+    stale_blocks_.push_back(block);
+  }
+  block_map.clear();
+}
+
+void RiscVBasicBlockCache::UnlinkAll(BlockMap &block_map) {
+  for (auto &[unused, block] : block_map) {
+    block->fall_through_exit = {};
+    block->taken_exit = {};
+  }
+}
+
+void RiscVBasicBlockCache::DeleteBlock(RiscVBasicBlock *block) {
+  for (auto *inst : block->instructions) inst->DecRef();
+  delete block;
+}
+
+}  // namespace mpact::sim::riscv
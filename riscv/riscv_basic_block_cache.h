@@ -0,0 +1,168 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_BASIC_BLOCK_CACHE_H_
+#define MPACT_RISCV_RISCV_RISCV_BASIC_BLOCK_CACHE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace mpact::sim::riscv {
+
+using ::mpact::sim::generic::Instruction;
+
+// This file defines the basic block cache used by the RiscVTop run loop. A
+// translated block is a sequence of decoded instructions at consecutive
+// addresses. Blocks are formed by recording the instructions as they are
+// executed, starting at a block entry address, up to and including the first
+// instruction that transfers control away from the sequential path (a taken
+// branch, jump, or trap). Conditional branches that were not taken when the
+// block was recorded may appear anywhere in the block, so the user of a block
+// must check for a change in control flow after each instruction and leave the
+// block early if needed.
+//
+// The block cache holds a reference to each instruction in its blocks, so the
+// instructions stay valid even if they are evicted from the decode cache.
+// Blocks that contain an address must be invalidated whenever the decoding of
+// that address is invalidated (e.g., when a breakpoint is set or cleared).
+//
+// Each block caches pointers to the blocks that most recently followed it, one
+// for the fall-through exit (the address following the last instruction) and
+// one for the taken exit (the target of a taken branch, a jump, or the most
+// recent target of an indirect jump). This allows the run loop to chain from
+// block to block without looking up the successor. The links are cleared
+// whenever a block is removed from the cache.
+//
+// A block may be removed while it is executing, e.g., when an action point
+// action sets a breakpoint in the block. Removed blocks are therefore not
+// deleted right away, but are kept until FreeStaleBlocks is called at the next
+// block boundary, when no block is executing, and no pointer to a removed
+// block is held by the run loop.
+//
+// Like the decode cache, the blocks are kept separately for each fetch context
+// (see riscv_decode_cache.h), and lookups use the blocks of the selected
+// context. Links only connect blocks of the same context.
+
+struct RiscVBasicBlock {
+  // Cached successor block for a given exit address.
+  struct Exit {
+    uint64_t address = 0;
+    RiscVBasicBlock *block = nullptr;
+  };
+
+  // Returns the cached successor block for the given address, or nullptr if
+  // there is none.
+  RiscVBasicBlock *GetSuccessor(uint64_t address) const {
+    if (address == fall_through_exit.address) return fall_through_exit.block;
+    if (address == taken_exit.address) return taken_exit.block;
+    return nullptr;
+  }
+
+  // Address of the first instruction in the block.
+  uint64_t start_address = 0;
+  // Address immediately following the last instruction in the block, or the
+  // address following the first byte of the last instruction if it has size 0.
+  uint64_t end_address = 0;
+  // The instructions in the block, in execution order.
+  std::vector<Instruction *> instructions;
+  // Successor cache.
+  Exit fall_through_exit;
+  Exit taken_exit;
+};
+
+class RiscVBasicBlockCache {
+ public:
+  // Maximum number of instructions in a block.
+  static constexpr int kMaxBlockSize = 64;
+
+  RiscVBasicBlockCache() = default;
+  RiscVBasicBlockCache(const RiscVBasicBlockCache &) = delete;
+  RiscVBasicBlockCache &operator=(const RiscVBasicBlockCache &) = delete;
+  ~RiscVBasicBlockCache();
+
+  // Returns the block that starts at the given address, or nullptr if there
+  // is no such block.
+  RiscVBasicBlock *GetBlock(uint64_t address) const {
+    auto it = block_map_.find(address);
+    if (it == block_map_.end()) return nullptr;
+    return it->second;
+  }
+
+  // Block recording. StartRecording begins a new block, and each instruction
+  // that is executed is then added using Record (which IncRef's the
+  // instruction). Record returns false once the block has reached its maximum
+  // size. FinishRecording adds the recorded block to the cache and returns a
+  // pointer to it. If the decoding of any address was invalidated while the
+  // block was being recorded, the recorded block is discarded, and nullptr is
+  // returned.
+  void StartRecording();
+  bool Record(Instruction *inst);
+  RiscVBasicBlock *FinishRecording();
+
+  // Caches 'to' as the successor of 'from' when execution continues at the
+  // given address.
+  void Link(RiscVBasicBlock *from, uint64_t address, RiscVBasicBlock *to) {
+    if (address == from->end_address) {
+      from->fall_through_exit = {address, to};
+    } else {
+      from->taken_exit = {address, to};
+    }
+  }
+
+  // Selects the fetch context that subsequent lookups and recordings use. The
+  // initial context is 0. Any block that is being recorded is discarded.
+  void SelectContext(uint64_t context);
+  // Removes all blocks of the fetch context.
+  void InvalidateContext(uint64_t context);
+  // Removes any block that contains the given address, in all contexts.
+  void Invalidate(uint64_t address);
+  // Removes all blocks, in all contexts.
+  void InvalidateAll();
+
+  // Deletes the blocks that have been removed from the cache. This must only
+  // be called when no removed block is in use.
+  void FreeStaleBlocks();
+
+  int num_blocks() const { return block_map_.size(); }
+  int num_stale_blocks() const { return stale_blocks_.size(); }
+
+ private:
+  // Blocks indexed by their start address.
+  using BlockMap = absl::flat_hash_map<uint64_t, RiscVBasicBlock *>;
+
+  void DeleteBlock(RiscVBasicBlock *block);
+  // Removes any block in the map that contains the given address.
+  void Invalidate(BlockMap &block_map, uint64_t address);
+  // Removes all blocks in the map.
+  void RemoveBlocks(BlockMap &block_map);
+  // Clears the successor links of all blocks in the map.
+  static void UnlinkAll(BlockMap &block_map);
+
+  // The blocks of the selected context, and of the other contexts.
+  uint64_t context_ = 0;
+  BlockMap block_map_;
+  absl::flat_hash_map<uint64_t, BlockMap> saved_block_maps_;
+  // The block that is being recorded.
+  RiscVBasicBlock *recording_ = nullptr;
+  bool recording_valid_ = false;
+  // Blocks that have been removed, but not yet deleted.
+  std::vector<RiscVBasicBlock *> stale_blocks_;
+};
+
+}  // namespace mpact::sim::riscv
+
+#endif  // MPACT_RISCV_RISCV_RISCV_BASIC_BLOCK_CACHE_H_
@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <limits>
 
 #include "absl/log/log.h"
 #include "mpact/sim/generic/data_buffer.h"
@@ -34,9 +35,9 @@ using ::mpact::sim::generic::ReferenceCount;
 using EC = ::mpact::sim::riscv::ExceptionCode;
 
 RiscVClint::RiscVClint(int period, MipExternalWriteInterface *mip_interface)
-    : mip_interface_(mip_interface), period_(period) {
+    : mip_interface_(mip_interface), period_(period > 0 ? period : 1) {
   // Set the initial values.
-  SetValue(0);
+  Tick(1);
   mip_interface_->set_mtip(mtip_);
   mip_interface->set_msip(msip_ & 0b1);
   int bit = mtime_ >= mtimecmp_;
@@ -53,12 +54,35 @@ void RiscVClint::Reset() {
   WriteMSip(0);
 }
 
-// Called by the counter whenever its value is changed.
+// Called by the counter whenever its value is changed. The counter may be
+// updated in batches, so the clock is advanced by the amount the counter
+// changed since the previous update. The first update, and any update that
+// does not increase the counter value, counts as a single tick.
 void RiscVClint::SetValue(const uint64_t &val) {
-  update_counter_++;
+  uint64_t ticks = 1;
+  if (has_last_value_ && (val > last_value_)) ticks = val - last_value_;
+  has_last_value_ = true;
+  last_value_ = val;
+  Tick(ticks);
+}
+
+uint64_t RiscVClint::TicksToDeadline() const {
+  constexpr uint64_t kNoDeadline = std::numeric_limits<uint64_t>::max();
+  // The first update counts as a single tick, whatever its size.
+  if (!has_last_value_) return 1;
+  if (mtip_ != 0) return kNoDeadline;
+  // mtip is only updated when mtime is incremented.
+  uint64_t periods = (mtimecmp_ > mtime_) ? mtimecmp_ - mtime_ : 1;
+  if (periods > kNoDeadline / period_) return kNoDeadline;
+  return periods * period_ - update_counter_;
+}
+
+// Advance the clock by the given number of ticks of the bound counter.
+void RiscVClint::Tick(uint64_t ticks) {
+  update_counter_ += ticks;
   if (update_counter_ >= period_) {
-    update_counter_ = 0;
-    mtime_++;
+    mtime_ += update_counter_ / period_;
+    update_counter_ %= period_;
     int bit = mtime_ >= mtimecmp_;
     if (bit == mtip_) return;
     mip_interface_->set_mtip(bit);
@@ -43,11 +43,12 @@ namespace riscv {
 //
 // The controller binds to a counter, for instance the instructions executed
 // counter, using the CounterValueSetInterface<> interface. The update_counter_
-// keeps track of how many times this is updated, and then increments the mtime
-// register once for each 'period' updates. That is, the frequency of the mtime
-// clock is 1/'period' of the associated counter. The controller implements the
-// MemoryInterface to allow for memory-mapped loads and stores. Only the
-// non-vector Load/Store methods are implemented.
+// keeps track of how much the counter has advanced, and then increments the
+// mtime register once for each 'period' counts. That is, the frequency of the
+// mtime clock is 1/'period' of the associated counter. The counter may be
+// updated in batches. The controller implements the MemoryInterface to allow
+// for memory-mapped loads and stores. Only the non-vector Load/Store methods
+// are implemented.
 //
 // The controller only uses the low 16 bits of the address. It is assumed that
 // any memory requests routed to the controller are done so correctly.
@@ -73,6 +74,11 @@ class RiscVClint : public CounterValueSetInterface<uint64_t>,
   // CounterValueSetInterface override. This is called when the value of the
   // bound counter is modified.
   void SetValue(const uint64_t &val) override;
+  // Returns the number of increments of the bound counter until mtip is set,
+  // or the maximum uint64_t value if mtip is already set. A counter that is
+  // updated in batches has to be updated no later than this, so that the
+  // timer interrupt is raised on the exact count.
+  uint64_t TicksToDeadline() const;
 
   // MemoryInterface overrides.
   // Non-vector load method.
@@ -90,6 +96,7 @@ class RiscVClint : public CounterValueSetInterface<uint64_t>,
 
  private:
   // Helpers.
+  void Tick(uint64_t ticks);
   uint32_t Read(uint32_t offset);
   void Write(uint32_t offset, uint32_t value);
   // Private methods to access the 32 bit portions of the registers.
@@ -109,8 +116,11 @@ class RiscVClint : public CounterValueSetInterface<uint64_t>,
   // mip write interface.
   MipExternalWriteInterface *mip_interface_;
   // Counter for how many updates there have been in current period.
-  int update_counter_ = 0;
-  int period_ = 0;
+  uint64_t update_counter_ = 0;
+  uint64_t period_ = 0;
+  // Most recent value of the bound counter.
+  uint64_t last_value_ = 0;
+  bool has_last_value_ = false;
 };
 
 }  // namespace riscv
@@ -0,0 +1,186 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_commit_trace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>  // NOLINT: third_party code.
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_state.h"
+
+namespace mpact::sim::riscv {
+
+RiscVCommitTrace::RiscVCommitTrace(RiscVState *state,
+                                   util::MemoryInterface *memory,
+                                   std::ostream *os, int capacity)
+    : state_(state),
+      memory_(memory),
+      os_(os),
+      registers_(new TracedRegister[kMaxRegisters]),
+      records_(new RiscVCommitRecord[capacity]),
+      mask_(capacity - 1) {
+  CHECK(absl::has_single_bit(static_cast<unsigned>(capacity)))
+      << "Commit trace capacity must be a power of two";
+  pending_.num_destinations = 0;
+  pending_.num_memory_accesses = 0;
+  writer_ = std::thread([this]() { WriterLoop(); });
+}
+
+RiscVCommitTrace::~RiscVCommitTrace() {
+  done_.store(true, std::memory_order_release);
+  writer_.join();
+}
+
+void RiscVCommitTrace::AddLoad(uint64_t address) { AddStore(address, 0, 0); }
+
+void RiscVCommitTrace::AddStore(uint64_t address, uint64_t value, int size) {
+  if (pending_.num_memory_accesses == RiscVCommitRecord::kMaxMemoryAccesses) {
+    return;
+  }
+  pending_.memory_accesses[pending_.num_memory_accesses++] = {
+      address, value, static_cast<uint8_t>(size)};
+}
+
+void RiscVCommitTrace::Commit(Instruction *inst, uint32_t inst_word) {
+  pending_.pc = inst->address();
+  pending_.inst_word = inst_word;
+  pending_.privilege = static_cast<uint8_t>(*state_->privilege_mode());
+  AddDestinations(inst);
+  for (auto *child = inst->child(); child != nullptr; child = child->next()) {
+    AddDestinations(child);
+  }
+  // Wait for a free entry.
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  while (head - tail_.load(std::memory_order_acquire) > mask_) {
+    std::this_thread::yield();
+  }
+  records_[head & mask_] = pending_;
+  head_.store(head + 1, std::memory_order_release);
+  pending_.num_destinations = 0;
+  pending_.num_memory_accesses = 0;
+}
+
+void RiscVCommitTrace::AddDestinations(Instruction *inst) {
+  for (int i = 0; i < inst->DestinationsSize(); ++i) {
+    auto *dest = inst->Destination(i);
+    if (dest == nullptr) continue;
+    if (pending_.num_destinations == RiscVCommitRecord::kMaxDestinations) {
+      return;
+    }
+    int index = GetRegisterIndex(dest->AsString());
+    if (index == kNoRegister) continue;
+    pending_.destinations[pending_.num_destinations++] = {
+        static_cast<uint8_t>(index),
+        registers_[index].reg->data_buffer()->Get<uint64_t>(0)};
+  }
+}
+
+int RiscVCommitTrace::GetRegisterIndex(const std::string &name) {
+  auto it = register_index_.find(name);
+  if (it != register_index_.end()) return it->second;
+  int index = kNoRegister;
+  auto *register_map = state_->registers();
+  auto reg_it = register_map->find(name);
+  // Only 64 bit registers other than pc and x0 are traced.
+  if ((name != "pc") && (name != "x0") && (reg_it != register_map->end()) &&
+      (reg_it->second->data_buffer()->size<uint8_t>() == sizeof(uint64_t)) &&
+      (num_registers_ < kMaxRegisters)) {
+    index = num_registers_++;
+    registers_[index] = {reg_it->second, name};
+  }
+  register_index_.insert({name, index});
+  return index;
+}
+
+void RiscVCommitTrace::Flush() {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  while (tail_.load(std::memory_order_acquire) != head) {
+    std::this_thread::yield();
+  }
+}
+
+void RiscVCommitTrace::Format(const RiscVCommitRecord &record,
+                              std::string &line) const {
+  absl::StrAppend(&line, "core   0: ", static_cast<int>(record.privilege),
+                  " 0x", absl::Hex(record.pc, absl::kZeroPad16), " (0x",
+                  absl::Hex(record.inst_word, absl::kZeroPad8), ")");
+  for (int i = 0; i < record.num_destinations; i++) {
+    auto const &dest = record.destinations[i];
+    absl::StrAppend(&line, " ",
+                    absl::StrFormat("%-3s", registers_[dest.reg].name), " 0x",
+                    absl::Hex(dest.value, absl::kZeroPad16));
+  }
+  for (int i = 0; i < record.num_memory_accesses; i++) {
+    auto const &access = record.memory_accesses[i];
+    absl::StrAppend(&line, " mem 0x",
+                    absl::Hex(access.address, absl::kZeroPad16));
+    switch (access.store_size) {
+      case 1:
+        absl::StrAppend(&line, " 0x", absl::Hex(access.value, absl::kZeroPad2));
+        break;
+      case 2:
+        absl::StrAppend(&line, " 0x", absl::Hex(access.value, absl::kZeroPad4));
+        break;
+      case 4:
+        absl::StrAppend(&line, " 0x", absl::Hex(access.value, absl::kZeroPad8));
+        break;
+      case 8:
+        absl::StrAppend(&line, " 0x",
+                        absl::Hex(access.value, absl::kZeroPad16));
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void RiscVCommitTrace::WriterLoop() {
+  std::string text;
+  while (true) {
+    // Read done_ before head_, so that no record committed before the
+    // destructor was called is missed.
+    bool done = done_.load(std::memory_order_acquire);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+      if (done) break;
+      absl::SleepFor(absl::Microseconds(50));
+      continue;
+    }
+    text.clear();
+    for (; tail != head; tail++) {
+      Format(records_[tail & mask_], text);
+      text.push_back('\n');
+    }
+    os_->write(text.data(), text.size());
+    os_->flush();
+    tail_.store(tail, std::memory_order_release);
+  }
+}
+
+}  // namespace mpact::sim::riscv
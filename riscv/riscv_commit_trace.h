@@ -0,0 +1,143 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_COMMIT_TRACE_H_
+#define MPACT_RISCV_RISCV_RISCV_COMMIT_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>  // NOLINT: third_party code.
+
+#include "absl/container/flat_hash_map.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_state.h"
+
+namespace mpact::sim::riscv {
+
+using ::mpact::sim::generic::Instruction;
+
+// This file defines a commit log that is similar to the one produced by Spike
+// (the RiscV reference simulator), for use in co-simulation. The simulation
+// thread stores a fixed size binary record for each retired instruction in a
+// preallocated ring buffer, and a separate writer thread formats the records
+// and writes them to the output stream. The simulation thread only waits if
+// the ring buffer is full.
+
+// Information about a retired instruction.
+struct RiscVCommitRecord {
+  static constexpr int kMaxDestinations = 4;
+  static constexpr int kMaxMemoryAccesses = 4;
+
+  struct Destination {
+    // Index into the commit trace register name table.
+    uint8_t reg;
+    uint64_t value;
+  };
+  struct MemoryAccess {
+    uint64_t address;
+    uint64_t value;
+    // Size of the store value in bytes, or zero for loads.
+    uint8_t store_size;
+  };
+
+  uint64_t pc;
+  uint32_t inst_word;
+  uint8_t privilege;
+  uint8_t num_destinations;
+  uint8_t num_memory_accesses;
+  Destination destinations[kMaxDestinations];
+  MemoryAccess memory_accesses[kMaxMemoryAccesses];
+};
+
+class RiscVCommitTrace {
+ public:
+  // Number of records in the ring buffer. Must be a power of two.
+  static constexpr int kDefaultCapacity = 64 * 1024;
+
+  // The memory interface is the one that the raw instruction words are read
+  // from when instructions are decoded (see RiscVTop::set_commit_trace()),
+  // and should not be one that traces memory accesses. The formatted log is
+  // written to os.
+  RiscVCommitTrace(RiscVState *state, util::MemoryInterface *memory,
+                   std::ostream *os, int capacity);
+  RiscVCommitTrace(RiscVState *state, util::MemoryInterface *memory,
+                   std::ostream *os)
+      : RiscVCommitTrace(state, memory, os, kDefaultCapacity) {}
+  RiscVCommitTrace(const RiscVCommitTrace &) = delete;
+  RiscVCommitTrace &operator=(const RiscVCommitTrace &) = delete;
+  // Writes any remaining records before returning.
+  ~RiscVCommitTrace();
+
+  // Memory accesses made by the instruction that is executing. They are added
+  // to the record of the instruction when it is committed.
+  void AddLoad(uint64_t address);
+  void AddStore(uint64_t address, uint64_t value, int size);
+  // Records the retirement of the given instruction, with its raw instruction
+  // word and the values of its register destinations.
+  void Commit(Instruction *inst, uint32_t inst_word);
+  // Waits until all committed records have been written.
+  void Flush();
+
+  // Formats a record as a line of text (without the newline).
+  void Format(const RiscVCommitRecord &record, std::string &line) const;
+
+  util::MemoryInterface *memory() const { return memory_; }
+
+ private:
+  // Maximum number of distinct registers that can be traced.
+  static constexpr int kMaxRegisters = 256;
+  // Register used in place of those that are not traced.
+  static constexpr int kNoRegister = -1;
+
+  struct TracedRegister {
+    generic::RegisterBase *reg;
+    std::string name;
+  };
+
+  // Adds the register destinations of inst to the pending record.
+  void AddDestinations(Instruction *inst);
+  // Returns the index of the named register in the register table, adding it
+  // if necessary, or kNoRegister if it should not be traced.
+  int GetRegisterIndex(const std::string &name);
+  void WriterLoop();
+
+  RiscVState *state_;
+  util::MemoryInterface *memory_;
+  std::ostream *os_;
+  // The record of the instruction that is executing.
+  RiscVCommitRecord pending_;
+  // Registers indexed by the reg field of the destinations. The table is only
+  // appended to, before a record that refers to the new entry is published.
+  std::unique_ptr<TracedRegister[]> registers_;
+  int num_registers_ = 0;
+  absl::flat_hash_map<std::string, int> register_index_;
+  // Ring buffer. head_ is only written by the simulation thread, and tail_
+  // only by the writer thread.
+  std::unique_ptr<RiscVCommitRecord[]> records_;
+  uint64_t mask_;
+  std::atomic<uint64_t> head_ = 0;
+  std::atomic<uint64_t> tail_ = 0;
+  std::atomic<bool> done_ = false;
+  std::thread writer_;
+};
+
+}  // namespace mpact::sim::riscv
+
+#endif  // MPACT_RISCV_RISCV_RISCV_COMMIT_TRACE_H_
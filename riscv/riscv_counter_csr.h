@@ -4,7 +4,9 @@
 #include <cstdint>
 #include <limits>
 #include <string>
+#include <utility>
 
+#include "absl/functional/any_invocable.h"
 #include "mpact/sim/generic/counters.h"
 #include "riscv/riscv_csr.h"
 
@@ -19,6 +21,10 @@
 // computed from the counter, so that the values read are relative to the most
 // recent write of the CSR.
 
+// The simulator top may defer updating the counter while running. In that
+// case a sync function is bound to the CSR, which is called to bring the
+// counter up to date before its value is used.
+
 namespace mpact::sim::riscv {
 
 using ::mpact::sim::generic::SimpleCounter;
@@ -58,14 +64,20 @@ class RiscVCounterCsr : public RiscVSimpleCsr<T> {
   }
   // This is called to tie a cycle counter to the CSR.
   void set_counter(SimpleCounter<uint64_t>* counter) { counter_ = counter; }
+  // This is called to set the function that brings the counter up to date.
+  void set_sync_fcn(absl::AnyInvocable<void()> sync_fcn) {
+    sync_fcn_ = std::move(sync_fcn);
+  }
 
  private:
-  inline T GetCounterValue() const {
+  inline T GetCounterValue() {
     if (counter_ == nullptr) return 0;
+    if (sync_fcn_ != nullptr) sync_fcn_();
     return static_cast<T>(counter_->GetValue() & kMax);
   };
 
   SimpleCounter<uint64_t>* counter_ = nullptr;
+  absl::AnyInvocable<void()> sync_fcn_;
   T offset_ = 0;
 };
 
@@ -98,15 +110,21 @@ class RiscVCounterCsrHigh : public RiscVSimpleCsr<uint32_t> {
 
   // This is called to tie a cycle counter to the CSR.
   void set_counter(SimpleCounter<uint64_t>* counter) { counter_ = counter; }
+  // This is called to set the function that brings the counter up to date.
+  void set_sync_fcn(absl::AnyInvocable<void()> sync_fcn) {
+    sync_fcn_ = std::move(sync_fcn);
+  }
 
  private:
-  inline uint64_t GetCounterValue() const {
+  inline uint64_t GetCounterValue() {
     if (counter_ == nullptr) return 0;
+    if (sync_fcn_ != nullptr) sync_fcn_();
     return counter_->GetValue();
   };
 
   RiscVCounterCsr<uint32_t, S>* low_csr_;
   SimpleCounter<uint64_t>* counter_ = nullptr;
+  absl::AnyInvocable<void()> sync_fcn_;
   uint64_t offset_ = 0;
 };
 
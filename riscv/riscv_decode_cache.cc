@@ -0,0 +1,191 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_decode_cache.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/decoder_interface.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace mpact::sim::riscv {
+
+RiscVDecodeCache::RiscVDecodeCache(generic::DecoderInterface *decoder)
+    : decoder_(decoder),
+      counter_hits_("decode_cache_hits", 0),
+      counter_misses_("decode_cache_misses", 0),
+      counter_evictions_("decode_cache_evictions", 0) {
+  CHECK_OK(Configure(""));
+}
+
+RiscVDecodeCache::~RiscVDecodeCache() { Clear(); }
+
+absl::Status RiscVDecodeCache::Configure(absl::string_view config) {
+  if (config == "paged") {
+    Clear();
+    table_.entries.clear();
+    table_.next_victim.clear();
+    paged_ = true;
+    return absl::OkStatus();
+  }
+  int num_entries = kDefaultNumEntries;
+  int num_ways = 1;
+  if (!config.empty()) {
+    std::vector<std::string> fields = absl::StrSplit(config, ',');
+    if ((fields.size() != 2) || !absl::SimpleAtoi(fields[0], &num_entries) ||
+        !absl::SimpleAtoi(fields[1], &num_ways)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Invalid decode cache configuration: '", config,
+          "' - expected '<entries>,<ways>' or 'paged'"));
+    }
+  }
+  if ((num_entries <= 0) || (num_ways <= 0) ||
+      !absl::has_single_bit(static_cast<unsigned>(num_entries)) ||
+      !absl::has_single_bit(static_cast<unsigned>(num_ways)) ||
+      (num_ways > num_entries)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid decode cache geometry: ", num_entries, " entries, ", num_ways,
+        " ways - both must be powers of two, with ways <= entries"));
+  }
+  Clear();
+  paged_ = false;
+  num_ways_ = num_ways;
+  set_mask_ = num_entries / num_ways - 1;
+  table_.entries.assign(num_entries, Entry());
+  table_.next_victim.assign(num_entries / num_ways, 0);
+  return absl::OkStatus();
+}
+
+void RiscVDecodeCache::SelectContext(uint64_t context) {
+  if (context == context_) return;
+  Table table;
+  auto it = saved_tables_.find(context);
+  if (it != saved_tables_.end()) {
+    table = std::move(it->second);
+    saved_tables_.erase(it);
+  } else if (!paged_) {
+    table.entries.assign(table_.entries.size(), Entry());
+    table.next_victim.assign(table_.next_victim.size(), 0);
+  }
+  saved_tables_[context_] = std::move(table_);
+  table_ = std::move(table);
+  context_ = context;
+  last_page_number_ = kInvalidAddress;
+  last_page_ = nullptr;
+}
+
+void RiscVDecodeCache::InvalidateContext(uint64_t context) {
+  if (context == context_) {
+    ReleaseInstructions(table_);
+    return;
+  }
+  auto it = saved_tables_.find(context);
+  if (it == saved_tables_.end()) return;
+  ReleaseTable(it->second);
+  saved_tables_.erase(it);
+}
+
+Instruction *RiscVDecodeCache::MissInSet(uint64_t address, int set) {
+  counter_misses_.Increment(1);
+  Entry *entries = &table_.entries[set * num_ways_];
+  // Use an empty way if there is one, otherwise replace round-robin.
+  int way = 0;
+  while ((way < num_ways_) && (entries[way].inst != nullptr)) way++;
+  if (way == num_ways_) {
+    auto &next_victim = table_.next_victim;
+    way = next_victim[set];
+    next_victim[set] = (way + 1) & (num_ways_ - 1);
+    entries[way].inst->DecRef();
+    counter_evictions_.Increment(1);
+  }
+  Instruction *inst = decoder_->DecodeInstruction(address);
+  entries[way] = {address, inst};
+  return inst;
+}
+
+Instruction **RiscVDecodeCache::GetOrAllocatePage(uint64_t page_number) {
+  auto [it, inserted] = table_.pages.insert({page_number, nullptr});
+  if (inserted) it->second = new Instruction *[kEntriesPerPage]();
+  return it->second;
+}
+
+void RiscVDecodeCache::Invalidate(uint64_t address) {
+  Invalidate(table_, address);
+  for (auto &[unused, table] : saved_tables_) Invalidate(table, address);
+}
+
+void RiscVDecodeCache::Invalidate(Table &table, uint64_t address) {
+  if (paged_) {
+    auto it = table.pages.find(address / kPageSize);
+    if (it == table.pages.end()) return;
+    Instruction *&inst = it->second[(address % kPageSize) / kMinPcIncrement];
+    if (inst == nullptr) return;
+    inst->DecRef();
+    inst = nullptr;
+    return;
+  }
+  int set = (address / kMinPcIncrement) & set_mask_;
+  Entry *entries = &table.entries[set * num_ways_];
+  for (int way = 0; way < num_ways_; way++) {
+    if (entries[way].address != address) continue;
+    entries[way].inst->DecRef();
+    entries[way] = Entry();
+  }
+}
+
+void RiscVDecodeCache::InvalidateAll() {
+  ReleaseInstructions(table_);
+  for (auto &[unused, table] : saved_tables_) ReleaseTable(table);
+  saved_tables_.clear();
+}
+
+void RiscVDecodeCache::ReleaseInstructions(Table &table) {
+  for (auto &[unused, page] : table.pages) {
+    for (int i = 0; i < kEntriesPerPage; i++) {
+      if (page[i] == nullptr) continue;
+      page[i]->DecRef();
+      page[i] = nullptr;
+    }
+  }
+  for (auto &entry : table.entries) {
+    if (entry.inst == nullptr) continue;
+    entry.inst->DecRef();
+    entry = Entry();
+  }
+}
+
+void RiscVDecodeCache::ReleaseTable(Table &table) {
+  ReleaseInstructions(table);
+  for (auto &[unused, page] : table.pages) delete[] page;
+  table.pages.clear();
+}
+
+void RiscVDecodeCache::Clear() {
+  InvalidateAll();
+  ReleaseTable(table_);
+  last_page_number_ = kInvalidAddress;
+  last_page_ = nullptr;
+}
+
+}  // namespace mpact::sim::riscv
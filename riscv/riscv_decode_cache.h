@@ -0,0 +1,200 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_DECODE_CACHE_H_
+#define MPACT_RISCV_RISCV_RISCV_DECODE_CACHE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/counters.h"
+#include "mpact/sim/generic/decoder_interface.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace mpact::sim::riscv {
+
+using ::mpact::sim::generic::Instruction;
+
+// This file defines the decode cache used by RiscVTop. It holds a reference to
+// each decoded instruction it contains, and decodes instructions on demand
+// using the decoder that is passed in to the constructor.
+//
+// The cache can be configured with one of two organizations:
+//
+//   Set associative: "<entries>,<ways>", where both are powers of two and
+//     ways <= entries. The set is selected by the instruction address, and a
+//     way is replaced round-robin when the set is full. The default geometry
+//     (empty configuration string) is a direct mapped cache with 16K entries.
+//
+//   Paged: "paged". A two level table, indexed first by the page number, then
+//     by the offset within the page. Pages are allocated on demand, so the
+//     table grows with the footprint of the program, and entries are never
+//     evicted. This avoids repeated decoding for programs with large text
+//     segments.
+//
+// Instructions are cached separately for each fetch context, a value chosen
+// by the user that identifies how instruction fetches are translated and
+// checked, e.g., the privilege mode and address space, since the same address
+// may decode to a different instruction, or a fault, in another context.
+// Lookups use the table of the selected context. The tables of the other
+// contexts are kept, so that switching between contexts, e.g., on traps,
+// doesn't discard their instructions.
+//
+// The number of hits, misses and evictions are counted. Lookups count hits in
+// a plain member, which is added to the hit counter by FlushHits(), and when
+// the hit counter is accessed.
+
+class RiscVDecodeCache {
+ public:
+  // Default number of entries (direct mapped).
+  static constexpr int kDefaultNumEntries = 16 * 1024;
+  // Minimum increment between instruction addresses (compressed instructions).
+  static constexpr int kMinPcIncrement = 2;
+  // Page size of the paged organization.
+  static constexpr uint64_t kPageSize = 4096;
+  static constexpr int kEntriesPerPage = kPageSize / kMinPcIncrement;
+
+  explicit RiscVDecodeCache(generic::DecoderInterface *decoder);
+  RiscVDecodeCache(const RiscVDecodeCache &) = delete;
+  RiscVDecodeCache &operator=(const RiscVDecodeCache &) = delete;
+  ~RiscVDecodeCache();
+
+  // Configures the organization of the cache from the given configuration
+  // string (see above). Any cached instructions are released.
+  absl::Status Configure(absl::string_view config);
+
+  // Returns the decoded instruction at the given address, decoding it if it
+  // isn't in the cache. The cache retains ownership of the instruction, so
+  // the caller must IncRef it if it is to be held past the next call.
+  inline Instruction *GetDecodedInstruction(uint64_t address) {
+    if (paged_) return GetFromPage(address);
+    return GetFromSet(address);
+  }
+
+  // Selects the fetch context that subsequent lookups use. The initial
+  // context is 0.
+  void SelectContext(uint64_t context);
+  // Removes the instructions of the fetch context from the cache.
+  void InvalidateContext(uint64_t context);
+  // Removes the instruction at the given address from the cache, in all
+  // contexts.
+  void Invalidate(uint64_t address);
+  // Removes all instructions from the cache, in all contexts.
+  void InvalidateAll();
+
+  bool paged() const { return paged_; }
+  uint64_t context() const { return context_; }
+  int num_entries() const { return table_.entries.size(); }
+  int num_ways() const { return num_ways_; }
+  int num_pages() const { return table_.pages.size(); }
+
+  generic::SimpleCounter<uint64_t> *counter_hits() {
+    FlushHits();
+    return &counter_hits_;
+  }
+  generic::SimpleCounter<uint64_t> *counter_misses() {
+    return &counter_misses_;
+  }
+  generic::SimpleCounter<uint64_t> *counter_evictions() {
+    return &counter_evictions_;
+  }
+  // Adds the hits counted since the last flush to the hit counter.
+  void FlushHits() {
+    if (pending_hits_ == 0) return;
+    counter_hits_.Increment(pending_hits_);
+    pending_hits_ = 0;
+  }
+
+ private:
+  // Address stored in unused entries. It is odd, so it never matches the
+  // address of an instruction.
+  static constexpr uint64_t kInvalidAddress = ~0ULL;
+
+  struct Entry {
+    uint64_t address = kInvalidAddress;
+    Instruction *inst = nullptr;
+  };
+
+  // The instructions of a fetch context.
+  struct Table {
+    // Set associative organization.
+    std::vector<Entry> entries;
+    std::vector<int> next_victim;
+    // Paged organization.
+    absl::flat_hash_map<uint64_t, Instruction **> pages;
+  };
+
+  // Set associative lookup.
+  inline Instruction *GetFromSet(uint64_t address) {
+    int set = (address / kMinPcIncrement) & set_mask_;
+    Entry *entries = &table_.entries[set * num_ways_];
+    for (int way = 0; way < num_ways_; way++) {
+      if (entries[way].address == address) {
+        pending_hits_++;
+        return entries[way].inst;
+      }
+    }
+    return MissInSet(address, set);
+  }
+  Instruction *MissInSet(uint64_t address, int set);
+
+  // Paged lookup. The most recently used page is cached.
+  inline Instruction *GetFromPage(uint64_t address) {
+    uint64_t page_number = address / kPageSize;
+    if (page_number != last_page_number_) {
+      last_page_ = GetOrAllocatePage(page_number);
+      last_page_number_ = page_number;
+    }
+    Instruction *&inst = last_page_[(address % kPageSize) / kMinPcIncrement];
+    if (inst != nullptr) {
+      pending_hits_++;
+      return inst;
+    }
+    counter_misses_.Increment(1);
+    inst = decoder_->DecodeInstruction(address);
+    return inst;
+  }
+  Instruction **GetOrAllocatePage(uint64_t page_number);
+  // Removes the instruction at the given address from the table.
+  void Invalidate(Table &table, uint64_t address);
+  // Releases the instructions in the table, or the instructions and the pages.
+  static void ReleaseInstructions(Table &table);
+  static void ReleaseTable(Table &table);
+  // Releases all entries and pages, in all contexts.
+  void Clear();
+
+  generic::DecoderInterface *decoder_;
+  bool paged_ = false;
+  int num_ways_ = 1;
+  int set_mask_ = 0;
+  // The table of the selected context, and the tables of the other contexts.
+  uint64_t context_ = 0;
+  Table table_;
+  absl::flat_hash_map<uint64_t, Table> saved_tables_;
+  // The most recently used page of the paged organization.
+  uint64_t last_page_number_ = kInvalidAddress;
+  Instruction **last_page_ = nullptr;
+  // Counters. The hits are counted in pending_hits_ until they are flushed.
+  uint64_t pending_hits_ = 0;
+  generic::SimpleCounter<uint64_t> counter_hits_;
+  generic::SimpleCounter<uint64_t> counter_misses_;
+  generic::SimpleCounter<uint64_t> counter_evictions_;
+};
+
+}  // namespace mpact::sim::riscv
+
+#endif  // MPACT_RISCV_RISCV_RISCV_DECODE_CACHE_H_
@@ -0,0 +1,124 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_host_memory.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+uint8_t *RiscVHostMemory::GetPage(uint64_t address) {
+  auto &page = pages_[address >> kPageShift];
+  // The page storage is value initialized, i.e., zero filled.
+  if (page == nullptr) page = std::make_unique<uint8_t[]>(kPageSize);
+  return page.get();
+}
+
+void RiscVHostMemory::ReadBytes(uint64_t address, uint8_t *data,
+                                uint64_t size) {
+  while (size > 0) {
+    uint64_t offset = address & (kPageSize - 1);
+    uint64_t count = std::min(size, kPageSize - offset);
+    auto iter = pages_.find(address >> kPageShift);
+    // Don't allocate pages on reads of memory that has never been written.
+    if (iter == pages_.end()) {
+      std::memset(data, 0, count);
+    } else {
+      std::memcpy(data, iter->second.get() + offset, count);
+    }
+    address += count;
+    data += count;
+    size -= count;
+  }
+}
+
+void RiscVHostMemory::WriteBytes(uint64_t address, const uint8_t *data,
+                                 uint64_t size) {
+  while (size > 0) {
+    uint64_t offset = address & (kPageSize - 1);
+    uint64_t count = std::min(size, kPageSize - offset);
+    std::memcpy(GetPage(address) + offset, data, count);
+    address += count;
+    data += count;
+    size -= count;
+  }
+}
+
+void RiscVHostMemory::FinishLoad(DataBuffer *db, Instruction *inst,
+                                 ReferenceCount *context) {
+  if (inst == nullptr) return;
+  if (db->latency() > 0) {
+    inst->IncRef();
+    if (context != nullptr) context->IncRef();
+    inst->state()->function_delay_line()->Add(db->latency(),
+                                              [inst, context]() {
+                                                inst->Execute(context);
+                                                if (context != nullptr)
+                                                  context->DecRef();
+                                                inst->DecRef();
+                                              });
+  } else {
+    inst->Execute(context);
+  }
+}
+
+void RiscVHostMemory::Load(uint64_t address, DataBuffer *db, Instruction *inst,
+                           ReferenceCount *context) {
+  ReadBytes(address, static_cast<uint8_t *>(db->raw_ptr()),
+            db->size<uint8_t>());
+  FinishLoad(db, inst, context);
+}
+
+void RiscVHostMemory::Load(DataBuffer *address_db, DataBuffer *mask_db,
+                           int el_size, DataBuffer *db, Instruction *inst,
+                           ReferenceCount *context) {
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  auto *data = static_cast<uint8_t *>(db->raw_ptr());
+  for (size_t i = 0; i < addresses.size(); i++) {
+    if (!mask[i]) continue;
+    ReadBytes(addresses[i], data + i * el_size, el_size);
+  }
+  FinishLoad(db, inst, context);
+}
+
+void RiscVHostMemory::Store(uint64_t address, DataBuffer *db) {
+  WriteBytes(address, static_cast<const uint8_t *>(db->raw_ptr()),
+             db->size<uint8_t>());
+}
+
+void RiscVHostMemory::Store(DataBuffer *address_db, DataBuffer *mask_db,
+                            int el_size, DataBuffer *db) {
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  auto *data = static_cast<const uint8_t *>(db->raw_ptr());
+  for (size_t i = 0; i < addresses.size(); i++) {
+    if (!mask[i]) continue;
+    WriteBytes(addresses[i], data + i * el_size, el_size);
+  }
+}
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
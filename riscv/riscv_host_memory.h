@@ -0,0 +1,84 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_HOST_MEMORY_H_
+#define MPACT_RISCV_RISCV_RISCV_HOST_MEMORY_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/container/flat_hash_map.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+
+// This class implements a flat memory that spans the whole 64 bit address
+// space. Like util::FlatDemandMemory, the storage is allocated in pages on
+// demand, and reads of memory that has not been written return zero. Unlike
+// it, the host address of the storage backing each page is available through
+// GetPage(). RiscVState uses this to perform scalar loads and stores to plain
+// RAM directly, instead of going through the chain of memory interfaces (see
+// RiscVState::set_host_memory()). The pages are never freed or moved, so a
+// host pointer remains valid for the lifetime of the memory.
+class RiscVHostMemory : public util::MemoryInterface {
+ public:
+  static constexpr int kPageShift = 12;
+  static constexpr uint64_t kPageSize = 1ULL << kPageShift;
+
+  RiscVHostMemory() = default;
+  RiscVHostMemory(const RiscVHostMemory &) = delete;
+  RiscVHostMemory &operator=(const RiscVHostMemory &) = delete;
+  ~RiscVHostMemory() override = default;
+
+  // Returns the host address of the page containing 'address', allocating and
+  // zero initializing the page if needed.
+  uint8_t *GetPage(uint64_t address);
+
+  // MemoryInterface overrides.
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Store(uint64_t address, DataBuffer *db) override;
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override;
+
+ private:
+  // Copy 'size' bytes between memory at 'address' and the host buffer 'data'.
+  // The accesses may cross page boundaries.
+  void ReadBytes(uint64_t address, uint8_t *data, uint64_t size);
+  void WriteBytes(uint64_t address, const uint8_t *data, uint64_t size);
+  // Executes the load child instruction, if any, taking the data buffer
+  // latency into account.
+  void FinishLoad(DataBuffer *db, Instruction *inst, ReferenceCount *context);
+
+  // Map from page number to page storage.
+  absl::flat_hash_map<uint64_t, std::unique_ptr<uint8_t[]>> pages_;
+};
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_RISCV_RISCV_RISCV_HOST_MEMORY_H_
@@ -16,7 +16,7 @@
 #define MPACT_RISCV_RISCV_RISCV_INSTRUCTION_HELPERS_H_
 
 #include <cstdint>
-#include <functional>
+#include <cstring>
 #include <limits>
 #include <tuple>
 #include <type_traits>
@@ -40,6 +40,10 @@ namespace riscv {
 using ::mpact::sim::generic::operator*;
 using ::mpact::sim::generic::FPTypeInfo;
 
+// The helpers below take the operation to perform as a template parameter, so
+// that any callable (usually a lambda) can be passed in and inlined into the
+// semantic function, rather than called through a type-erased std::function.
+
 // Templated helper function for convert instruction semantic functions.
 template <typename From, typename To>
 inline std::tuple<To, uint32_t> CvtHelper(From value) {
@@ -293,9 +297,9 @@ inline Argument GetNaNBoxedSource(const Instruction *instruction, int arg) {
 }
 
 // Generic helper function for binary instructions.
-template <typename Register, typename Result, typename Argument>
-inline void RiscVBinaryOp(const Instruction *instruction,
-                          std::function<Result(Argument, Argument)> operation) {
+template <typename Register, typename Result, typename Argument,
+          typename Operation>
+inline void RiscVBinaryOp(const Instruction *instruction, Operation operation) {
   using RegValue = typename Register::ValueType;
   Argument lhs = generic::GetInstructionSource<Argument>(instruction, 0);
   Argument rhs = generic::GetInstructionSource<Argument>(instruction, 1);
@@ -318,9 +322,9 @@ inline void RiscVWriteReg(const Instruction *instruction, int index,
 }
 
 // Generic helper function for unary instructions.
-template <typename Register, typename Result, typename Argument>
-inline void RiscVUnaryOp(const Instruction *instruction,
-                         std::function<Result(Argument)> operation) {
+template <typename Register, typename Result, typename Argument,
+          typename Operation>
+inline void RiscVUnaryOp(const Instruction *instruction, Operation operation) {
   using RegValue = typename Register::ValueType;
   auto lhs = generic::GetInstructionSource<Argument>(instruction, 0);
   Result dest_value = operation(lhs);
@@ -331,10 +335,9 @@ inline void RiscVUnaryOp(const Instruction *instruction,
 }
 
 // Helper function for conditional branches.
-template <typename RegisterType, typename ValueType>
-static inline void BranchConditional(
-    const Instruction *instruction,
-    std::function<bool(ValueType, ValueType)> cond) {
+template <typename RegisterType, typename ValueType, typename Condition>
+static inline void BranchConditional(const Instruction *instruction,
+                                     Condition cond) {
   using UIntType =
       typename std::make_unsigned<typename RegisterType::ValueType>::type;
   ValueType a = generic::GetInstructionSource<ValueType>(instruction, 0);
@@ -357,14 +360,17 @@ inline void RVLoad(const Instruction *instruction) {
   URegVal base = generic::GetInstructionSource<URegVal>(instruction, 0);
   RegVal offset = generic::GetInstructionSource<RegVal>(instruction, 1);
   URegVal address = base + offset;
-  auto *value_db =
-      instruction->state()->db_factory()->Allocate(sizeof(ValueType));
-  value_db->set_latency(0);
-  auto *context = new LoadContext(value_db);
   auto *state = static_cast<RiscVState *>(instruction->state());
-  state->LoadMemory(instruction, address, value_db, instruction->child(),
-                    context);
-  context->DecRef();
+  auto *context = state->GetScalarLoadContext(sizeof(ValueType));
+  // Access plain RAM directly, and write back the value immediately.
+  uint8_t *host = state->GetHostPointer(address, sizeof(ValueType));
+  if ((host != nullptr) && (instruction->child() != nullptr)) {
+    std::memcpy(context->value_db->raw_ptr(), host, sizeof(ValueType));
+    instruction->child()->Execute(context);
+    return;
+  }
+  state->LoadMemory(instruction, address, context->value_db,
+                    instruction->child(), context);
 }
 
 // Generic helper function for load instructions' "child instruction".
@@ -397,19 +403,23 @@ inline void RVStore(const Instruction *instruction) {
   URegVal address = base + offset;
   ValueType value = generic::GetInstructionSource<ValueType>(instruction, 2);
   auto *state = static_cast<RiscVState *>(instruction->state());
-  auto *db = state->db_factory()->Allocate(sizeof(ValueType));
+  uint8_t *host = state->GetHostPointer(address, sizeof(ValueType));
+  if (host != nullptr) {
+    std::memcpy(host, &value, sizeof(ValueType));
+    return;
+  }
+  auto *db = state->GetScalarStoreDataBuffer(sizeof(ValueType));
   db->Set<ValueType>(0, value);
   state->StoreMemory(instruction, address, db);
-  db->DecRef();
 }
 
 // Generic helper function for binary instructions with NaN boxing. This is
 // used for those instructions that produce results in fp registers, but are
 // not really executing an fp operation that requires rounding.
-template <typename RegValue, typename Result, typename Argument>
-inline void RiscVBinaryNaNBoxOp(
-    const Instruction *instruction,
-    std::function<Result(Argument, Argument)> operation) {
+template <typename RegValue, typename Result, typename Argument,
+          typename Operation>
+inline void RiscVBinaryNaNBoxOp(const Instruction *instruction,
+                                Operation operation) {
   Argument lhs = GetNaNBoxedSource<RegValue, Argument>(instruction, 0);
   Argument rhs = GetNaNBoxedSource<RegValue, Argument>(instruction, 1);
   Result dest_value = operation(lhs, rhs);
@@ -434,9 +444,9 @@ inline void RiscVBinaryNaNBoxOp(
 
 // Generic helper function for unary instructions with NaN boxing.
 template <typename DstRegValue, typename SrcRegValue, typename Result,
-          typename Argument>
+          typename Argument, typename Operation>
 inline void RiscVUnaryNaNBoxOp(const Instruction *instruction,
-                               std::function<Result(Argument)> operation) {
+                               Operation operation) {
   Argument lhs = GetNaNBoxedSource<SrcRegValue, Argument>(instruction, 0);
   Result dest_value = operation(lhs);
   auto *reg = static_cast<generic::RegisterDestinationOperand<DstRegValue> *>(
@@ -461,9 +471,9 @@ inline void RiscVUnaryNaNBoxOp(const Instruction *instruction,
 // Generic helper function for unary floating point instructions. The main
 // difference is that it handles rounding mode and performs NaN boxing.
 template <typename DstRegValue, typename SrcRegValue, typename Result,
-          typename Argument>
+          typename Argument, typename Operation>
 inline void RiscVUnaryFloatNaNBoxOp(const Instruction *instruction,
-                                    std::function<Result(Argument)> operation) {
+                                    Operation operation) {
   using ResUint = typename FPTypeInfo<Result>::UIntType;
   Argument lhs = GetNaNBoxedSource<SrcRegValue, Argument>(instruction, 0);
   // Get the rounding mode.
@@ -510,9 +520,9 @@ inline void RiscVUnaryFloatNaNBoxOp(const Instruction *instruction,
 
 // Generic helper function for floating op instructions that do not require
 // NaN boxing since they produce non fp-values.
-template <typename Result, typename Argument>
+template <typename Result, typename Argument, typename Operation>
 inline void RiscVUnaryFloatOp(const Instruction *instruction,
-                              std::function<Result(Argument)> operation) {
+                              Operation operation) {
   Argument lhs = generic::GetInstructionSource<Argument>(instruction, 0);
   // Get the rounding mode.
   int rm_value = generic::GetInstructionSource<int>(instruction, 1);
@@ -541,10 +551,9 @@ inline void RiscVUnaryFloatOp(const Instruction *instruction,
 
 // Generic helper function for floating op instructions that do not require
 // NaN boxing since they produce non fp-values, but set fflags.
-template <typename Result, typename Argument>
-inline void RiscVUnaryFloatWithFflagsOp(
-    const Instruction *instruction,
-    std::function<Result(Argument, uint32_t &)> operation) {
+template <typename Result, typename Argument, typename Operation>
+inline void RiscVUnaryFloatWithFflagsOp(const Instruction *instruction,
+                                        Operation operation) {
   Argument lhs = generic::GetInstructionSource<Argument>(instruction, 0);
   // Get the rounding mode.
   int rm_value = generic::GetInstructionSource<int>(instruction, 1);
@@ -577,10 +586,10 @@ inline void RiscVUnaryFloatWithFflagsOp(
 
 // Generic helper function for binary floating point instructions. The main
 // difference is that it handles rounding mode.
-template <typename Register, typename Result, typename Argument>
-inline void RiscVBinaryFloatNaNBoxOp(
-    const Instruction *instruction,
-    std::function<Result(Argument, Argument)> operation) {
+template <typename Register, typename Result, typename Argument,
+          typename Operation>
+inline void RiscVBinaryFloatNaNBoxOp(const Instruction *instruction,
+                                     Operation operation) {
   Argument lhs = GetNaNBoxedSource<Register, Argument>(instruction, 0);
   Argument rhs = GetNaNBoxedSource<Register, Argument>(instruction, 1);
 
@@ -625,10 +634,10 @@ inline void RiscVBinaryFloatNaNBoxOp(
 }
 
 // Generic helper function for ternary floating point instructions.
-template <typename Register, typename Result, typename Argument>
-inline void RiscVTernaryFloatNaNBoxOp(
-    const Instruction *instruction,
-    std::function<Result(Argument, Argument, Argument)> operation) {
+template <typename Register, typename Result, typename Argument,
+          typename Operation>
+inline void RiscVTernaryFloatNaNBoxOp(const Instruction *instruction,
+                                      Operation operation) {
   Argument rs1 = generic::GetInstructionSource<Argument>(instruction, 0);
   Argument rs2 = generic::GetInstructionSource<Argument>(instruction, 1);
   Argument rs3 = generic::GetInstructionSource<Argument>(instruction, 2);
@@ -0,0 +1,175 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_memory_watcher.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+RiscVMemoryWatcher::RiscVMemoryWatcher(util::MemoryInterface *memory)
+    : memory_(memory), watcher_(memory) {}
+
+void RiscVMemoryWatcher::AddRange(const AddressRange &range,
+                                  WatchedPages *watched) {
+  watched->range_end.emplace(range.start, range.end);
+  UpdatePageIntervals(watched);
+}
+
+void RiscVMemoryWatcher::RemoveRange(uint64_t address, WatchedPages *watched) {
+  // The range is looked up by containment, as in util::MemoryWatcher. There
+  // are few watch ranges, so a linear search is fine.
+  for (auto iter = watched->range_end.begin(); iter != watched->range_end.end();
+       ++iter) {
+    if ((address < iter->first) || (address > iter->second)) continue;
+    watched->range_end.erase(iter);
+    UpdatePageIntervals(watched);
+    return;
+  }
+}
+
+void RiscVMemoryWatcher::UpdatePageIntervals(WatchedPages *watched) {
+  std::vector<std::pair<uint64_t, uint64_t>> pages;
+  pages.reserve(watched->range_end.size());
+  for (auto const &[start, end] : watched->range_end) {
+    pages.emplace_back(start >> kPageShift, end >> kPageShift);
+  }
+  std::sort(pages.begin(), pages.end());
+  // Merge overlapping and adjacent page intervals.
+  watched->page_intervals.clear();
+  auto iter = watched->page_intervals.end();
+  for (auto const &[first, last] : pages) {
+    if ((iter != watched->page_intervals.end()) &&
+        (first <= iter->second + 1)) {
+      iter->second = std::max(iter->second, last);
+      continue;
+    }
+    iter = watched->page_intervals.emplace_hint(
+        watched->page_intervals.end(), first, last);
+  }
+  // Fill the page set if the intervals hold few enough pages.
+  watched->page_set.clear();
+  uint64_t num_pages = 0;
+  for (auto const &[first, last] : watched->page_intervals) {
+    if (last - first >= kMaxPageSetSize - num_pages) {
+      num_pages = kMaxPageSetSize + 1;
+      break;
+    }
+    num_pages += last - first + 1;
+  }
+  watched->use_page_set = num_pages <= kMaxPageSetSize;
+  if (!watched->use_page_set) return;
+  watched->page_set.reserve(num_pages);
+  for (auto const &[first, last] : watched->page_intervals) {
+    for (uint64_t page = first; page <= last; page++) {
+      watched->page_set.insert(page);
+    }
+  }
+}
+
+bool RiscVMemoryWatcher::IsWatched(const WatchedPages &watched,
+                                   uint64_t address, uint64_t size) {
+  if (watched.page_intervals.empty()) return false;
+  uint64_t first = address >> kPageShift;
+  uint64_t last = (address + size - 1) >> kPageShift;
+  // Scalar accesses touch at most two pages, which can be looked up in the
+  // page set.
+  if (watched.use_page_set && (last - first <= 1)) {
+    return watched.page_set.contains(first) || watched.page_set.contains(last);
+  }
+  // The intervals are disjoint, so only the last interval that starts at or
+  // before the last page of the access may overlap it.
+  auto iter = watched.page_intervals.upper_bound(last);
+  if (iter == watched.page_intervals.begin()) return false;
+  --iter;
+  return iter->second >= first;
+}
+
+absl::Status RiscVMemoryWatcher::SetLoadWatchCallback(
+    const AddressRange &range, Callback callback) {
+  auto status = watcher_.SetLoadWatchCallback(range, std::move(callback));
+  if (status.ok()) AddRange(range, &load_pages_);
+  return status;
+}
+
+absl::Status RiscVMemoryWatcher::ClearLoadWatchCallback(uint64_t address) {
+  auto status = watcher_.ClearLoadWatchCallback(address);
+  if (status.ok()) RemoveRange(address, &load_pages_);
+  return status;
+}
+
+absl::Status RiscVMemoryWatcher::SetStoreWatchCallback(
+    const AddressRange &range, Callback callback) {
+  auto status = watcher_.SetStoreWatchCallback(range, std::move(callback));
+  if (status.ok()) AddRange(range, &store_pages_);
+  return status;
+}
+
+absl::Status RiscVMemoryWatcher::ClearStoreWatchCallback(uint64_t address) {
+  auto status = watcher_.ClearStoreWatchCallback(address);
+  if (status.ok()) RemoveRange(address, &store_pages_);
+  return status;
+}
+
+void RiscVMemoryWatcher::Load(uint64_t address, DataBuffer *db,
+                              Instruction *inst, ReferenceCount *context) {
+  if (IsWatched(load_pages_, address, db->size<uint8_t>())) {
+    watcher_.Load(address, db, inst, context);
+    return;
+  }
+  memory_->Load(address, db, inst, context);
+}
+
+// The vector accesses are only checked for whether there are any watch ranges.
+void RiscVMemoryWatcher::Load(DataBuffer *address_db, DataBuffer *mask_db,
+                              int el_size, DataBuffer *db, Instruction *inst,
+                              ReferenceCount *context) {
+  if (!load_pages_.range_end.empty()) {
+    watcher_.Load(address_db, mask_db, el_size, db, inst, context);
+    return;
+  }
+  memory_->Load(address_db, mask_db, el_size, db, inst, context);
+}
+
+void RiscVMemoryWatcher::Store(uint64_t address, DataBuffer *db) {
+  if (IsWatched(store_pages_, address, db->size<uint8_t>())) {
+    watcher_.Store(address, db);
+    return;
+  }
+  memory_->Store(address, db);
+}
+
+void RiscVMemoryWatcher::Store(DataBuffer *address_db, DataBuffer *mask_db,
+                               int el_size, DataBuffer *db) {
+  if (!store_pages_.range_end.empty()) {
+    watcher_.Store(address_db, mask_db, el_size, db);
+    return;
+  }
+  memory_->Store(address_db, mask_db, el_size, db);
+}
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
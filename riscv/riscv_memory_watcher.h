@@ -0,0 +1,118 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_MEMORY_WATCHER_H_
+#define MPACT_RISCV_RISCV_RISCV_MEMORY_WATCHER_H_
+
+#include <cstdint>
+#include <map>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "mpact/sim/util/memory/memory_watcher.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+
+// This class provides the same watch callback interface as util::MemoryWatcher,
+// which it uses to implement the callbacks, but only passes those accesses
+// through the util::MemoryWatcher that may touch a watched range. It keeps
+// the disjoint intervals of 4KB pages that are overlapped by the load and by
+// the store watch ranges, so that the size of a watch range doesn't matter.
+// Scalar accesses to pages without watch ranges of the access type, and all
+// accesses when there are no such watch ranges at all, are forwarded directly
+// to the memory interface, instead of having to look up the address in the
+// util::MemoryWatcher's range map. While the watch ranges of an access type
+// overlap few pages, the pages are also kept in a hash set, so that checking a
+// scalar access takes a hash lookup instead of a search of the page intervals.
+class RiscVMemoryWatcher : public util::MemoryInterface {
+ public:
+  using AddressRange = util::MemoryWatcher::AddressRange;
+  using Callback = absl::AnyInvocable<void(uint64_t, int)>;
+
+  static constexpr int kPageShift = 12;
+  // The maximum number of watched pages of an access type that are kept in the
+  // page set.
+  static constexpr uint64_t kMaxPageSetSize = 1024;
+
+  explicit RiscVMemoryWatcher(util::MemoryInterface *memory);
+  RiscVMemoryWatcher() = delete;
+  RiscVMemoryWatcher(const RiscVMemoryWatcher &) = delete;
+  RiscVMemoryWatcher &operator=(const RiscVMemoryWatcher &) = delete;
+  ~RiscVMemoryWatcher() override = default;
+
+  // Set/clear watch callbacks for loads and stores. These forward to, and
+  // return the status of, the corresponding util::MemoryWatcher methods.
+  absl::Status SetLoadWatchCallback(const AddressRange &range,
+                                    Callback callback);
+  absl::Status ClearLoadWatchCallback(uint64_t address);
+  absl::Status SetStoreWatchCallback(const AddressRange &range,
+                                     Callback callback);
+  absl::Status ClearStoreWatchCallback(uint64_t address);
+
+  // MemoryInterface overrides.
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Store(uint64_t address, DataBuffer *db) override;
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override;
+
+ private:
+  // The end addresses of the watch ranges by start address, and the last page
+  // of the disjoint page intervals overlapped by the watch ranges by their
+  // first page, for one access type. If the page intervals hold no more than
+  // kMaxPageSetSize pages, page_set holds each of those pages, otherwise it is
+  // empty and use_page_set is false.
+  struct WatchedPages {
+    absl::flat_hash_map<uint64_t, uint64_t> range_end;
+    std::map<uint64_t, uint64_t> page_intervals;
+    absl::flat_hash_set<uint64_t> page_set;
+    bool use_page_set = true;
+  };
+
+  // Adds/removes the range to/from the watched pages.
+  static void AddRange(const AddressRange &range, WatchedPages *watched);
+  static void RemoveRange(uint64_t address, WatchedPages *watched);
+  // Recomputes the page intervals and the page set from the watch ranges.
+  static void UpdatePageIntervals(WatchedPages *watched);
+  // Returns true if an access of 'size' bytes at 'address' may touch one of
+  // the watched ranges.
+  static bool IsWatched(const WatchedPages &watched, uint64_t address,
+                        uint64_t size);
+
+  util::MemoryInterface *memory_;
+  util::MemoryWatcher watcher_;
+  WatchedPages load_pages_;
+  WatchedPages store_pages_;
+};
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_RISCV_RISCV_RISCV_MEMORY_WATCHER_H_
@@ -0,0 +1,566 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_mmu.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_pmp.h"
+#include "riscv/riscv_state.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
+
+RiscVMmu::RiscVMmu(RiscVState *state) : state_(state) {
+  pte32_db_ = state_->db_factory()->Allocate<uint32_t>(1);
+  pte64_db_ = state_->db_factory()->Allocate<uint64_t>(1);
+}
+
+RiscVMmu::~RiscVMmu() {
+  pte32_db_->DecRef();
+  pte64_db_->DecRef();
+}
+
+bool RiscVMmu::IsSupportedSatp(uint64_t value) const {
+  // The single mode bit of the RV32 satp selects either bare or Sv32.
+  if (state_->xlen() == RiscVXlen::RV32) return true;
+  auto mode = static_cast<Mode>(value >> 60);
+  return (mode == Mode::kBare) || (mode == Mode::kSv39) ||
+         (mode == Mode::kSv48);
+}
+
+void RiscVMmu::SetSatp(uint64_t value) {
+  Mode mode;
+  uint64_t asid;
+  uint64_t root_ppn;
+  if (state_->xlen() == RiscVXlen::RV32) {
+    mode = (value >> 31) & 0x1 ? Mode::kSv32 : Mode::kBare;
+    asid = (value >> 22) & 0x1ff;
+    root_ppn = value & 0x3f'ffff;
+  } else {
+    mode = static_cast<Mode>(value >> 60);
+    asid = (value >> 44) & 0xffff;
+    root_ppn = value & 0xfff'ffff'ffffULL;
+  }
+  if ((mode == mode_) && (asid == asid_) && (root_ppn == root_ppn_)) return;
+  // The TLB entries are only valid for the mode they were created in.
+  if (mode != mode_) FlushAll();
+  mode_ = mode;
+  asid_ = asid;
+  root_ppn_ = root_ppn;
+  switch (mode_) {
+    case Mode::kSv32:
+      levels_ = 2;
+      vpn_bits_ = 10;
+      pte_size_ = 4;
+      ppn_mask_ = 0x3f'ffff;
+      va_bits_ = 32;
+      break;
+    case Mode::kSv39:
+      levels_ = 3;
+      vpn_bits_ = 9;
+      pte_size_ = 8;
+      ppn_mask_ = 0xfff'ffff'ffffULL;
+      va_bits_ = 39;
+      break;
+    case Mode::kSv48:
+      levels_ = 4;
+      vpn_bits_ = 9;
+      pte_size_ = 8;
+      ppn_mask_ = 0xfff'ffff'ffffULL;
+      va_bits_ = 48;
+      break;
+    default:
+      levels_ = 0;
+      break;
+  }
+  state_->set_address_translation(mode_ != Mode::kBare);
+  // The fetch context depends on the ASID, and on whether fetches are
+  // translated. The instructions decoded in other contexts remain valid.
+  state_->set_fetch_translation_changed(true);
+}
+
+PrivilegeMode RiscVMmu::AccessPrivilege(AccessType type) {
+  if (type == AccessType::kFetch) return state_->privilege_mode();
+  return state_->data_privilege_mode();
+}
+
+bool RiscVMmu::IsDataTranslationEnabled() {
+  if (mode_ == Mode::kBare) return false;
+  return AccessPrivilege(AccessType::kLoad) != PrivilegeMode::kMachine;
+}
+
+bool RiscVMmu::IsFetchTranslationEnabled() {
+  if (mode_ == Mode::kBare) return false;
+  return state_->privilege_mode() != PrivilegeMode::kMachine;
+}
+
+bool RiscVMmu::IsAccessAllowed(uint8_t flags, AccessType type,
+                               PrivilegeMode privilege) {
+  if (flags & kPteU) {
+    // Supervisor mode may only load from and store to user pages if
+    // mstatus.SUM is set, and never execute from them.
+    if ((privilege == PrivilegeMode::kSupervisor) &&
+        ((type == AccessType::kFetch) || !state_->mstatus()->sum())) {
+      return false;
+    }
+  } else if (privilege == PrivilegeMode::kUser) {
+    return false;
+  }
+  switch (type) {
+    case AccessType::kLoad:
+      return (flags & kPteR) ||
+             ((flags & kPteX) && state_->mstatus()->mxr());
+    case AccessType::kStore:
+      return flags & kPteW;
+    case AccessType::kFetch:
+      return flags & kPteX;
+  }
+  return false;
+}
+
+bool RiscVMmu::TranslateAddress(uint64_t address, AccessType type,
+                                uint64_t *physical, ExceptionCode *code) {
+  return TranslatePage(address, type, AccessPrivilege(type), physical, code);
+}
+
+bool RiscVMmu::TranslateDataAccess(uint64_t address, uint64_t size,
+                                   AccessType type, uint64_t *physical,
+                                   ExceptionCode *code,
+                                   uint64_t *fault_address) {
+  PrivilegeMode privilege = AccessPrivilege(type);
+  *fault_address = address;
+  if (!TranslatePage(address, type, privilege, physical, code)) return false;
+  uint64_t last = address + size - 1;
+  // Translate each of the following pages the access touches, if any, and
+  // check that they follow the first page in physical memory.
+  for (uint64_t page = (address >> kPageShift) + 1;
+       page <= (last >> kPageShift); page++) {
+    uint64_t next = page << kPageShift;
+    uint64_t next_physical;
+    if (!TranslatePage(next, type, privilege, &next_physical, code)) {
+      *fault_address = next;
+      return false;
+    }
+    if (next_physical != *physical + (next - address)) {
+      *code = (type == AccessType::kStore)
+                  ? ExceptionCode::kStoreAddressMisaligned
+                  : ExceptionCode::kLoadAddressMisaligned;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RiscVMmu::LookupDataTlb(uint64_t address, uint64_t *physical) {
+  uint64_t vpn = address >> kPageShift;
+  const TlbEntry &entry = dtlb_[vpn & (kTlbSize - 1)];
+  if ((entry.vpn != vpn) || (!(entry.flags & kPteG) && (entry.asid != asid_))) {
+    return false;
+  }
+  // Pages that are writable are also readable, so checking the store
+  // permission covers loads as well.
+  if (!(entry.flags & kPteD) ||
+      !IsAccessAllowed(entry.flags, AccessType::kStore,
+                       AccessPrivilege(AccessType::kStore))) {
+    return false;
+  }
+  *physical = (entry.ppn << kPageShift) | (address & (kPageSize - 1));
+  return true;
+}
+
+bool RiscVMmu::TranslatePage(uint64_t address, AccessType type,
+                             PrivilegeMode privilege, uint64_t *physical,
+                             ExceptionCode *code) {
+  uint64_t vpn = address >> kPageShift;
+  // Record the page even if the fetch faults, as the decode caches also hold
+  // the instructions that raise the fault.
+  if (type == AccessType::kFetch) RecordFetchPage(vpn, 0);
+  TlbEntry *tlb = (type == AccessType::kFetch) ? itlb_ : dtlb_;
+  TlbEntry &entry = tlb[vpn & (kTlbSize - 1)];
+  bool hit = (entry.vpn == vpn) &&
+             ((entry.flags & kPteG) || (entry.asid == asid_));
+  // A store to a page that isn't marked dirty yet has to walk the page table
+  // to set the dirty bit.
+  if (!hit || ((type == AccessType::kStore) && !(entry.flags & kPteD))) {
+    TlbEntry new_entry;
+    if (!Walk(address, type, privilege, &new_entry, code)) return false;
+    entry = new_entry;
+  } else if (!IsAccessAllowed(entry.flags, type, privilege)) {
+    *code = PageFault(type);
+    return false;
+  }
+  if ((type == AccessType::kFetch) && (entry.superpage_bits != 0)) {
+    RecordFetchPage(vpn, entry.superpage_bits);
+  }
+  *physical = (entry.ppn << kPageShift) | (address & (kPageSize - 1));
+  return true;
+}
+
+bool RiscVMmu::Walk(uint64_t address, AccessType type, PrivilegeMode privilege,
+                    TlbEntry *entry, ExceptionCode *code) {
+  *code = PageFault(type);
+  // For RV64 the address bits above the virtual address have to be the sign
+  // extension of the virtual address.
+  if (state_->xlen() == RiscVXlen::RV64) {
+    int64_t high = static_cast<int64_t>(address) >> (va_bits_ - 1);
+    if ((high != 0) && (high != -1)) return false;
+  }
+  uint64_t table = root_ppn_ << kPageShift;
+  uint64_t vpn_mask = (1ULL << vpn_bits_) - 1;
+  for (int level = levels_ - 1; level >= 0; level--) {
+    int shift = kPageShift + level * vpn_bits_;
+    uint64_t pte_address = table + ((address >> shift) & vpn_mask) * pte_size_;
+    if ((pte_address > state_->max_physical_address()) ||
+        !IsPteAccessAllowed(pte_address, *PmpCfgBits::kRead)) {
+      *code = AccessFault(type);
+      return false;
+    }
+    uint64_t pte = ReadPte(pte_address);
+    if (!(pte & kPteV) || (!(pte & kPteR) && (pte & kPteW))) return false;
+    // The reserved bits, and the bits of the unsupported Svnapot and Svpbmt
+    // extensions, must be zero.
+    if ((pte_size_ == 8) && ((pte >> 54) != 0)) return false;
+    uint64_t ppn = (pte >> 10) & ppn_mask_;
+    if (!(pte & (kPteR | kPteX))) {
+      // Pointer to the next level of the page table.
+      table = ppn << kPageShift;
+      continue;
+    }
+    // Leaf page table entry.
+    int superpage_bits = level * vpn_bits_;
+    uint64_t superpage_mask = (1ULL << superpage_bits) - 1;
+    // Superpages must be aligned.
+    if (ppn & superpage_mask) return false;
+    if (!IsAccessAllowed(pte & 0xff, type, privilege)) return false;
+    uint64_t updated = pte | kPteA;
+    if (type == AccessType::kStore) updated |= kPteD;
+    if (updated != pte) {
+      if (!IsPteAccessAllowed(pte_address, *PmpCfgBits::kWrite)) {
+        *code = AccessFault(type);
+        return false;
+      }
+      WritePte(pte_address, updated);
+      pte = updated;
+    }
+    uint64_t vpn = address >> kPageShift;
+    entry->vpn = vpn;
+    entry->ppn = ppn | (vpn & superpage_mask);
+    entry->asid = asid_;
+    entry->superpage_bits = superpage_bits;
+    entry->flags = pte & 0xff;
+    return true;
+  }
+  // No leaf entry was found.
+  return false;
+}
+
+bool RiscVMmu::IsPteAccessAllowed(uint64_t address, int permissions) {
+  // Page table accesses are checked as supervisor mode accesses.
+  return !state_->memory_protection() ||
+         state_->pmp()->IsAccessAllowed(address, pte_size_, permissions,
+                                        PrivilegeMode::kSupervisor);
+}
+
+uint64_t RiscVMmu::ReadPte(uint64_t address) {
+  if (pte_size_ == 4) {
+    state_->memory()->Load(address, pte32_db_, nullptr, nullptr);
+    return pte32_db_->Get<uint32_t>(0);
+  }
+  state_->memory()->Load(address, pte64_db_, nullptr, nullptr);
+  return pte64_db_->Get<uint64_t>(0);
+}
+
+void RiscVMmu::WritePte(uint64_t address, uint64_t pte) {
+  if (pte_size_ == 4) {
+    pte32_db_->Set<uint32_t>(0, static_cast<uint32_t>(pte));
+    state_->memory()->Store(address, pte32_db_);
+    return;
+  }
+  pte64_db_->Set<uint64_t>(0, pte);
+  state_->memory()->Store(address, pte64_db_);
+}
+
+template <typename Predicate>
+void RiscVMmu::FlushEntries(Predicate predicate) {
+  for (auto *tlb : {dtlb_, itlb_}) {
+    for (int i = 0; i < kTlbSize; i++) {
+      if ((tlb[i].vpn != kInvalidVpn) && predicate(tlb[i])) {
+        tlb[i] = TlbEntry();
+      }
+    }
+  }
+}
+
+void RiscVMmu::FlushAll() {
+  FlushEntries([](const TlbEntry &) { return true; });
+  InvalidateFetchPages();
+}
+
+void RiscVMmu::FlushAsid(uint64_t asid) {
+  asid = MaskAsid(asid);
+  FlushEntries([asid](const TlbEntry &entry) {
+    return !(entry.flags & kPteG) && (entry.asid == asid);
+  });
+  InvalidateFetchPages(asid);
+}
+
+void RiscVMmu::FlushAddress(uint64_t address) {
+  uint64_t vpn = address >> kPageShift;
+  // Entries that are part of the same superpage are flushed as well.
+  FlushEntries([vpn](const TlbEntry &entry) {
+    return (entry.vpn >> entry.superpage_bits) == (vpn >> entry.superpage_bits);
+  });
+  if (IsFetchPage(vpn)) InvalidateFetchPages();
+}
+
+void RiscVMmu::FlushAddressAsid(uint64_t address, uint64_t asid) {
+  asid = MaskAsid(asid);
+  uint64_t vpn = address >> kPageShift;
+  FlushEntries([vpn, asid](const TlbEntry &entry) {
+    return !(entry.flags & kPteG) && (entry.asid == asid) &&
+           ((entry.vpn >> entry.superpage_bits) ==
+            (vpn >> entry.superpage_bits));
+  });
+  if (IsFetchPage(vpn)) InvalidateFetchPages(asid);
+}
+
+uint64_t RiscVMmu::MaskAsid(uint64_t asid) const {
+  // The width of the satp ASID field.
+  return asid & (state_->xlen() == RiscVXlen::RV32 ? 0x1ff : 0xffff);
+}
+
+void RiscVMmu::RecordFetchPage(uint64_t vpn, int superpage_bits) {
+  fetch_pages_.insert({vpn >> superpage_bits, superpage_bits});
+}
+
+bool RiscVMmu::IsFetchPage(uint64_t vpn) const {
+  if (fetch_pages_.empty()) return false;
+  for (int level = 0; level < levels_; level++) {
+    int bits = level * vpn_bits_;
+    if (fetch_pages_.contains({vpn >> bits, bits})) return true;
+  }
+  return false;
+}
+
+void RiscVMmu::InvalidateFetchPages() {
+  if (fetch_pages_.empty()) return;
+  fetch_pages_.clear();
+  state_->InvalidateFetchContexts(RiscVState::kFetchContextTranslated,
+                                  RiscVState::kFetchContextTranslated);
+}
+
+void RiscVMmu::InvalidateFetchPages(uint64_t asid) {
+  // The pages are kept, as they may have been fetched from in other address
+  // spaces.
+  if (fetch_pages_.empty()) return;
+  uint64_t mask = ~((1ULL << RiscVState::kFetchContextAsidShift) - 1) |
+                  RiscVState::kFetchContextTranslated;
+  state_->InvalidateFetchContexts(
+      mask, (asid << RiscVState::kFetchContextAsidShift) |
+                RiscVState::kFetchContextTranslated);
+}
+
+ExceptionCode RiscVMmu::PageFault(AccessType type) {
+  switch (type) {
+    case AccessType::kLoad:
+      return ExceptionCode::kLoadPageFault;
+    case AccessType::kStore:
+      return ExceptionCode::kStorePageFault;
+    case AccessType::kFetch:
+      return ExceptionCode::kInstructionPageFault;
+  }
+  return ExceptionCode::kLoadPageFault;
+}
+
+ExceptionCode RiscVMmu::AccessFault(AccessType type) {
+  switch (type) {
+    case AccessType::kLoad:
+      return ExceptionCode::kLoadAccessFault;
+    case AccessType::kStore:
+      return ExceptionCode::kStoreAccessFault;
+    case AccessType::kFetch:
+      return ExceptionCode::kInstructionAccessFault;
+  }
+  return ExceptionCode::kLoadAccessFault;
+}
+
+RiscVMmuDecoder::RiscVMmuDecoder(RiscVState *state,
+                                 generic::DecoderInterface *decoder)
+    : state_(state), mmu_(state->mmu()), decoder_(decoder) {
+  parcel_db_ = state_->db_factory()->Allocate<uint16_t>(1);
+}
+
+RiscVMmuDecoder::~RiscVMmuDecoder() { parcel_db_->DecRef(); }
+
+generic::Instruction *RiscVMmuDecoder::DecodeInstruction(uint64_t address) {
+  bool translate = mmu_->IsFetchTranslationEnabled();
+  // Misaligned addresses are handled by the decoder.
+  if ((!translate && !state_->memory_protection()) || (address & 0x1)) {
+    auto *inst = decoder_->DecodeInstruction(address);
+    if (inst_word_memory_ != nullptr) {
+      RecordInstWord(inst, address, address + 2);
+    }
+    return inst;
+  }
+  uint64_t physical = address;
+  ExceptionCode code;
+  if (translate &&
+      !mmu_->TranslateAddress(address, RiscVMmu::AccessType::kFetch, &physical,
+                              &code)) {
+    return CreateFaultInstruction(address, address, code);
+  }
+  // An instruction in the last halfword of a page continues on the next page
+  // unless it is a compressed instruction.
+  uint64_t next_physical = physical + 2;
+  if (translate &&
+      ((address & (RiscVMmu::kPageSize - 1)) == RiscVMmu::kPageSize - 2) &&
+      (physical <= state_->max_physical_address())) {
+    state_->memory()->Load(physical, parcel_db_, nullptr, nullptr);
+    if ((parcel_db_->Get<uint16_t>(0) & 0b11) == 0b11) {
+      uint64_t next = address + 2;
+      if (!mmu_->TranslateAddress(next, RiscVMmu::AccessType::kFetch,
+                                  &next_physical, &code)) {
+        return CreateFaultInstruction(address, next, code);
+      }
+      if (next_physical != physical + 2) {
+        mmu_->SetFetchSplit(physical + 2, next_physical);
+      }
+    }
+  }
+  auto *inst = decoder_->DecodeInstruction(physical);
+  mmu_->ClearFetchSplit();
+  inst->set_address(address);
+  if (inst_word_memory_ != nullptr) {
+    RecordInstWord(inst, physical, next_physical);
+  }
+  if (!state_->memory_protection()) return inst;
+  // Check the instruction against the memory protection, separately for each
+  // page when it spans two pages that aren't physically contiguous.
+  auto *pmp = state_->pmp();
+  auto privilege = state_->privilege_mode();
+  int execute = *PmpCfgBits::kExecute;
+  uint64_t size = std::max(inst->size(), 2);
+  uint64_t fault_address = address;
+  bool allowed;
+  if (next_physical == physical + 2) {
+    allowed = pmp->IsAccessAllowed(physical, size, execute, privilege);
+  } else {
+    allowed = pmp->IsAccessAllowed(physical, 2, execute, privilege);
+    if (allowed) {
+      fault_address = address + 2;
+      allowed = pmp->IsAccessAllowed(next_physical, size - 2, execute,
+                                     privilege);
+    }
+  }
+  if (allowed) return inst;
+  inst->DecRef();
+  return CreateFaultInstruction(address, fault_address,
+                                ExceptionCode::kInstructionAccessFault);
+}
+
+generic::Instruction *RiscVMmuDecoder::CreateFaultInstruction(
+    uint64_t address, uint64_t fault_address, ExceptionCode code) {
+  auto *inst = new generic::Instruction(0, state_);
+  inst->set_size(0);
+  inst->SetDisassemblyString(code == ExceptionCode::kInstructionPageFault
+                                 ? "Instruction page fault"
+                                 : "Instruction access fault");
+  // Opcode 0 is the 'none' opcode in all the decoders.
+  inst->set_opcode(0);
+  inst->set_address(address);
+  inst->set_semantic_function(
+      [this, fault_address, code](generic::Instruction *inst) {
+        state_->Trap(/*is_interrupt*/ false, fault_address, *code,
+                     inst->address(), nullptr);
+      });
+  if (inst_word_memory_ != nullptr) inst_words_.erase(inst);
+  return inst;
+}
+
+void RiscVMmuDecoder::set_inst_word_memory(util::MemoryInterface *memory) {
+  inst_word_memory_ = memory;
+  if (memory == nullptr) inst_words_.clear();
+}
+
+void RiscVMmuDecoder::RecordInstWord(const generic::Instruction *inst,
+                                     uint64_t physical,
+                                     uint64_t next_physical) {
+  uint32_t word = 0;
+  int size = inst->size();
+  if ((size >= 2) && (physical <= state_->max_physical_address())) {
+    inst_word_memory_->Load(physical, parcel_db_, nullptr, nullptr);
+    word = parcel_db_->Get<uint16_t>(0);
+    if ((size >= 4) && (next_physical <= state_->max_physical_address())) {
+      inst_word_memory_->Load(next_physical, parcel_db_, nullptr, nullptr);
+      word |= static_cast<uint32_t>(parcel_db_->Get<uint16_t>(0)) << 16;
+    }
+  }
+  inst_words_[inst] = word;
+}
+
+RiscVFetchMemory::RiscVFetchMemory(RiscVMmu *mmu,
+                                   util::MemoryInterface *memory)
+    : mmu_(mmu), memory_(memory) {}
+
+void RiscVFetchMemory::Load(uint64_t address, generic::DataBuffer *db,
+                            generic::Instruction *inst,
+                            generic::ReferenceCount *context) {
+  uint64_t split = mmu_->fetch_split_address();
+  uint64_t size = db->size<uint8_t>();
+  if ((address >= split) || (address + size <= split)) {
+    memory_->Load(address, db, inst, context);
+    return;
+  }
+  // Read the bytes beyond the split address from the next page.
+  uint64_t first = split - address;
+  auto *next_db = db_factory_.Allocate<uint8_t>(size - first);
+  memory_->Load(mmu_->fetch_next_address(), next_db, nullptr, nullptr);
+  memory_->Load(address, db, nullptr, nullptr);
+  std::memcpy(static_cast<uint8_t *>(db->raw_ptr()) + first,
+              next_db->raw_ptr(), size - first);
+  next_db->DecRef();
+  if (inst != nullptr) inst->Execute(context);
+}
+
+void RiscVFetchMemory::Load(generic::DataBuffer *address_db,
+                            generic::DataBuffer *mask_db, int el_size,
+                            generic::DataBuffer *db, generic::Instruction *inst,
+                            generic::ReferenceCount *context) {
+  memory_->Load(address_db, mask_db, el_size, db, inst, context);
+}
+
+void RiscVFetchMemory::Store(uint64_t address, generic::DataBuffer *db) {
+  memory_->Store(address, db);
+}
+
+void RiscVFetchMemory::Store(generic::DataBuffer *address_db,
+                             generic::DataBuffer *mask_db, int el_size,
+                             generic::DataBuffer *db) {
+  memory_->Store(address_db, mask_db, el_size, db);
+}
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
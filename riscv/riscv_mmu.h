@@ -0,0 +1,329 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_MMU_H_
+#define MPACT_RISCV_RISCV_RISCV_MMU_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/decoder_interface.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_csr.h"
+#include "riscv/riscv_state.h"
+
+namespace mpact {
+namespace sim {
+namespace riscv {
+
+// This class implements the supervisor address translation for the Sv32 (for
+// RV32), Sv39 and Sv48 (for RV64) translation modes selected by the satp CSR.
+// Translations are cached in separate direct mapped data and instruction TLBs
+// of 4KB page entries, so that the page table walk is only needed on a miss.
+// The entries are tagged with the ASID, so they don't have to be flushed when
+// switching between address spaces. Superpages are cached as the 4KB pages
+// that are accessed. The accessed and dirty bits in the page table entries
+// are updated by the page table walk.
+class RiscVMmu {
+ public:
+  // Translation modes as encoded in the satp mode field.
+  enum class Mode : uint64_t {
+    kBare = 0,
+    kSv32 = 1,
+    kSv39 = 8,
+    kSv48 = 9,
+  };
+  enum class AccessType { kLoad, kStore, kFetch };
+
+  static constexpr int kPageShift = 12;
+  static constexpr uint64_t kPageSize = 1ULL << kPageShift;
+  // Number of entries in each of the TLBs. Must be a power of two.
+  static constexpr int kTlbSize = 256;
+
+  explicit RiscVMmu(RiscVState *state);
+  RiscVMmu() = delete;
+  RiscVMmu(const RiscVMmu &) = delete;
+  RiscVMmu &operator=(const RiscVMmu &) = delete;
+  ~RiscVMmu();
+
+  // Returns true if the value is a legal value for satp, i.e., if it selects
+  // a supported translation mode.
+  bool IsSupportedSatp(uint64_t value) const;
+  // Called when satp is written. Updates the translation mode, ASID and root
+  // page table.
+  void SetSatp(uint64_t value);
+
+  // Returns true if loads and stores are translated in the current privilege
+  // mode, taking mstatus.MPRV into account.
+  bool IsDataTranslationEnabled();
+  // Returns true if instruction fetches are translated in the current
+  // privilege mode.
+  bool IsFetchTranslationEnabled();
+
+  // Translates the virtual address to a physical address for an access of the
+  // given type. The access is assumed not to cross into another page. Returns
+  // false and the exception code of the fault if the translation fails.
+  bool TranslateAddress(uint64_t address, AccessType type, uint64_t *physical,
+                        ExceptionCode *code);
+  // Translates a data access of 'size' bytes. Accesses that cross into pages
+  // that aren't contiguous in physical memory raise an address misaligned
+  // fault. Returns false, the exception code and the virtual address that
+  // faulted, if the translation fails.
+  bool TranslateDataAccess(uint64_t address, uint64_t size, AccessType type,
+                           uint64_t *physical, ExceptionCode *code,
+                           uint64_t *fault_address);
+
+  // Looks up the translation of the address in the data TLB, without walking
+  // the page table or raising faults. Returns true and the physical address
+  // if there is an entry for the page that permits both loads and stores in
+  // the current data privilege mode, and that has the dirty bit set. This is
+  // used for direct host memory accesses, which go through
+  // TranslateDataAccess otherwise.
+  bool LookupDataTlb(uint64_t address, uint64_t *physical);
+
+  // Flushes the TLB entries as performed by sfence.vma, depending on whether
+  // rs1 (address) and rs2 (ASID) are x0 or not. Entries of global mappings
+  // are not flushed by the ASID selective flushes. Only the bits of the ASID
+  // that fit in the satp ASID field are used.
+  void FlushAll();
+  void FlushAsid(uint64_t asid);
+  void FlushAddress(uint64_t address);
+  void FlushAddressAsid(uint64_t address, uint64_t asid);
+
+  // Sets/clears the physical address at which an instruction fetch that is
+  // translated by RiscVMmuDecoder continues on the next page, when that page
+  // is not physically contiguous. This is used by RiscVFetchMemory.
+  void SetFetchSplit(uint64_t split_address, uint64_t next_address) {
+    fetch_split_address_ = split_address;
+    fetch_next_address_ = next_address;
+  }
+  void ClearFetchSplit() { fetch_split_address_ = kInvalidAddress; }
+
+  // Accessors.
+  Mode mode() const { return mode_; }
+  uint64_t asid() const { return asid_; }
+  uint64_t fetch_split_address() const { return fetch_split_address_; }
+  uint64_t fetch_next_address() const { return fetch_next_address_; }
+
+ private:
+  static constexpr uint64_t kInvalidVpn = ~0ULL;
+  static constexpr uint64_t kInvalidAddress = ~0ULL;
+
+  // Page table entry bits.
+  static constexpr uint64_t kPteV = 1 << 0;
+  static constexpr uint64_t kPteR = 1 << 1;
+  static constexpr uint64_t kPteW = 1 << 2;
+  static constexpr uint64_t kPteX = 1 << 3;
+  static constexpr uint64_t kPteU = 1 << 4;
+  static constexpr uint64_t kPteG = 1 << 5;
+  static constexpr uint64_t kPteA = 1 << 6;
+  static constexpr uint64_t kPteD = 1 << 7;
+
+  struct TlbEntry {
+    // Virtual page number of the 4KB page.
+    uint64_t vpn = kInvalidVpn;
+    // Physical page number of the 4KB page.
+    uint64_t ppn = 0;
+    uint64_t asid = 0;
+    // The number of low order bits of the vpn that are covered by the leaf
+    // page table entry, i.e., non-zero for superpages.
+    int superpage_bits = 0;
+    // The low order bits (V, R, W, X, U, G, A, D) of the page table entry.
+    uint8_t flags = 0;
+  };
+
+  // Returns the privilege mode used for the access type.
+  PrivilegeMode AccessPrivilege(AccessType type);
+  // Returns true if the page table entry flags permit the access.
+  bool IsAccessAllowed(uint8_t flags, AccessType type, PrivilegeMode privilege);
+  // Translates the address using the TLB for the access type, walking the
+  // page table on a miss.
+  bool TranslatePage(uint64_t address, AccessType type, PrivilegeMode privilege,
+                     uint64_t *physical, ExceptionCode *code);
+  // Walks the page table to translate the address, and fills in the TLB
+  // entry if successful.
+  bool Walk(uint64_t address, AccessType type, PrivilegeMode privilege,
+            TlbEntry *entry, ExceptionCode *code);
+  // Returns true if memory protection permits the page table entry access.
+  bool IsPteAccessAllowed(uint64_t address, int permissions);
+  // Page table entry accesses. These use physical addresses.
+  uint64_t ReadPte(uint64_t address);
+  void WritePte(uint64_t address, uint64_t pte);
+  // Invalidates the TLB entries for which the predicate returns true.
+  template <typename Predicate>
+  void FlushEntries(Predicate predicate);
+  // Returns the ASID truncated to the width of the satp ASID field.
+  uint64_t MaskAsid(uint64_t asid) const;
+  // Records that an instruction fetch was translated for the page.
+  void RecordFetchPage(uint64_t vpn, int superpage_bits);
+  // Returns true if instructions may have been decoded from the page.
+  bool IsFetchPage(uint64_t vpn) const;
+  // Signals the simulation loop that the instructions decoded from
+  // translated fetches have to be discarded, in all address spaces, or in the
+  // given one.
+  void InvalidateFetchPages();
+  void InvalidateFetchPages(uint64_t asid);
+
+  static ExceptionCode PageFault(AccessType type);
+  static ExceptionCode AccessFault(AccessType type);
+
+  RiscVState *state_;
+  Mode mode_ = Mode::kBare;
+  uint64_t asid_ = 0;
+  uint64_t root_ppn_ = 0;
+  // Page table geometry of the current mode.
+  int levels_ = 0;
+  int vpn_bits_ = 0;
+  int pte_size_ = 0;
+  uint64_t ppn_mask_ = 0;
+  // Number of valid virtual address bits (sign extended in the address).
+  int va_bits_ = 0;
+  TlbEntry dtlb_[kTlbSize];
+  TlbEntry itlb_[kTlbSize];
+  generic::DataBuffer *pte32_db_ = nullptr;
+  generic::DataBuffer *pte64_db_ = nullptr;
+  // The regions (virtual page number shifted right by the superpage bits,
+  // and superpage bits) of the pages that instructions were fetched from
+  // since the decode caches were last invalidated.
+  absl::flat_hash_set<std::pair<uint64_t, int>> fetch_pages_;
+  uint64_t fetch_split_address_ = kInvalidAddress;
+  uint64_t fetch_next_address_ = 0;
+};
+
+// The satp CSR. Writes that select an unsupported translation mode are
+// ignored, as permitted by the WARL field. Other writes are forwarded to the
+// mmu.
+template <typename T>
+class RiscVSatpCsr : public RiscVSimpleCsr<T> {
+ public:
+  RiscVSatpCsr(std::string name, RiscVCsrEnum index, RiscVMmu *mmu,
+               RiscVState *state)
+      : RiscVSimpleCsr<T>(name, index, 0, state), mmu_(mmu) {}
+
+  void Set(uint32_t value) override { Set(static_cast<uint64_t>(value)); }
+  void Set(uint64_t value) override {
+    T t_value = static_cast<T>(value);
+    if (!mmu_->IsSupportedSatp(t_value)) return;
+    RiscVSimpleCsr<T>::Set(value);
+    mmu_->SetSatp(t_value);
+  }
+
+ private:
+  RiscVMmu *mmu_;
+};
+
+// Decoder that translates the instruction fetch address before passing the
+// physical address to the decoder it wraps, when translation is enabled, and
+// checks the decoded instruction against the physical memory protection.
+// Fetches that fault return an instruction that raises the fault. The
+// decoded instruction is given the virtual address, so that the decode
+// caches, which this decoder is placed in front of, are indexed by virtual
+// address. The translation and PMP permissions are checked when an
+// instruction is decoded, not each time the cached instruction executes,
+// which is why the decode caches hold the instructions of each fetch context
+// (privilege mode and address space) separately, and the mmu and the pmp have
+// the affected contexts discarded when translations or PMP entries change.
+//
+// An instruction that starts in the last halfword of a page and continues on
+// a page that isn't physically contiguous is only read correctly if the
+// wrapped decoder reads instructions through RiscVFetchMemory.
+//
+// For commit traces, the decoder can also record the raw instruction word of
+// each instruction it decodes, read from the physical addresses of the fetch.
+class RiscVMmuDecoder : public generic::DecoderInterface {
+ public:
+  RiscVMmuDecoder(RiscVState *state, generic::DecoderInterface *decoder);
+  RiscVMmuDecoder() = delete;
+  ~RiscVMmuDecoder() override;
+
+  generic::Instruction *DecodeInstruction(uint64_t address) override;
+  int GetNumOpcodes() const override { return decoder_->GetNumOpcodes(); }
+  const char *GetOpcodeName(int index) const override {
+    return decoder_->GetOpcodeName(index);
+  }
+
+  // Sets the memory interface that the raw instruction words are read from,
+  // or nullptr to stop recording them. It should not be one that traces
+  // memory accesses. Only instructions decoded while it is set have their
+  // words recorded.
+  void set_inst_word_memory(util::MemoryInterface *memory);
+  // Returns the raw instruction word of the instruction, masked to the size
+  // of the instruction, or 0 if it wasn't recorded or the fetch faulted.
+  uint32_t GetInstWord(const generic::Instruction *inst) const {
+    auto it = inst_words_.find(inst);
+    if (it == inst_words_.end()) return 0;
+    return it->second;
+  }
+
+ private:
+  // Creates an instruction that raises the fetch fault.
+  generic::Instruction *CreateFaultInstruction(uint64_t address,
+                                               uint64_t fault_address,
+                                               ExceptionCode code);
+  // Records the instruction word of the instruction, whose first halfword is
+  // at the physical address 'physical' and the following bytes at
+  // 'next_physical'.
+  void RecordInstWord(const generic::Instruction *inst, uint64_t physical,
+                      uint64_t next_physical);
+
+  RiscVState *state_;
+  RiscVMmu *mmu_;
+  generic::DecoderInterface *decoder_;
+  generic::DataBuffer *parcel_db_ = nullptr;
+  // Raw instruction words, by instruction. An instruction object that is
+  // released and reallocated is given a new entry when it is decoded again.
+  util::MemoryInterface *inst_word_memory_ = nullptr;
+  absl::flat_hash_map<const generic::Instruction *, uint32_t> inst_words_;
+};
+
+// Memory interface for the instruction decoders to read instructions from.
+// Loads that span the fetch split address set in the mmu are completed from
+// the physical address of the next page. All other accesses are forwarded
+// to the memory interface unchanged.
+class RiscVFetchMemory : public util::MemoryInterface {
+ public:
+  RiscVFetchMemory(RiscVMmu *mmu, util::MemoryInterface *memory);
+  RiscVFetchMemory() = delete;
+  RiscVFetchMemory(const RiscVFetchMemory &) = delete;
+  RiscVFetchMemory &operator=(const RiscVFetchMemory &) = delete;
+  ~RiscVFetchMemory() override = default;
+
+  // MemoryInterface overrides.
+  void Load(uint64_t address, generic::DataBuffer *db,
+            generic::Instruction *inst,
+            generic::ReferenceCount *context) override;
+  void Load(generic::DataBuffer *address_db, generic::DataBuffer *mask_db,
+            int el_size, generic::DataBuffer *db, generic::Instruction *inst,
+            generic::ReferenceCount *context) override;
+  void Store(uint64_t address, generic::DataBuffer *db) override;
+  void Store(generic::DataBuffer *address_db, generic::DataBuffer *mask_db,
+             int el_size, generic::DataBuffer *db) override;
+
+ private:
+  RiscVMmu *mmu_;
+  util::MemoryInterface *memory_;
+  generic::DataBufferFactory db_factory_;
+};
+
+}  // namespace riscv
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_RISCV_RISCV_RISCV_MMU_H_
@@ -0,0 +1,187 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_pmp.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "riscv/riscv_state.h"
+
+namespace mpact::sim::riscv {
+
+static inline PmpAddressMatch AddressMatch(uint8_t cfg) {
+  return static_cast<PmpAddressMatch>((cfg & *PmpCfgBits::kAddressMatch) >> 3);
+}
+
+RiscVPmp::RiscVPmp(RiscVState* state) : state_(state) {
+  // Without enabled entries, a single range covers the address space.
+  ranges_.push_back({0, -1, kAllPermissions, 0});
+}
+
+uint64_t RiscVPmp::LegalizeCfg(int index, int num_entries,
+                               uint64_t value) const {
+  uint64_t legal = 0;
+  for (int i = 0; i < num_entries; i++) {
+    uint8_t cfg = static_cast<uint8_t>(value >> (8 * i));
+    if (cfg_[index + i] & *PmpCfgBits::kLock) {
+      cfg = cfg_[index + i];
+    } else {
+      cfg &= ~*PmpCfgBits::kReserved;
+      // The combination of write permission without read permission is
+      // reserved.
+      if (!(cfg & *PmpCfgBits::kRead)) cfg &= ~*PmpCfgBits::kWrite;
+    }
+    legal |= static_cast<uint64_t>(cfg) << (8 * i);
+  }
+  return legal;
+}
+
+bool RiscVPmp::IsAddressLocked(int index) const {
+  if (cfg_[index] & *PmpCfgBits::kLock) return true;
+  // The address also forms the bottom of the range of a following TOR entry.
+  if (index + 1 == kNumEntries) return false;
+  uint8_t next = cfg_[index + 1];
+  return (next & *PmpCfgBits::kLock) &&
+         (AddressMatch(next) == PmpAddressMatch::kTor);
+}
+
+void RiscVPmp::SetCfg(int index, int num_entries, uint64_t value) {
+  for (int i = 0; i < num_entries; i++) {
+    cfg_[index + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+  Reconfigure();
+}
+
+void RiscVPmp::SetAddress(int index, uint64_t value) {
+  address_[index] = value;
+  Reconfigure();
+}
+
+void RiscVPmp::Reconfigure() {
+  // Compute the address range [start, end) of each entry. Entries that are
+  // off, and TOR entries with an empty range, match no address.
+  uint64_t start[kNumEntries];
+  uint64_t end[kNumEntries];
+  std::vector<uint64_t> bounds = {0};
+  bool enabled = false;
+  for (int i = 0; i < kNumEntries; i++) {
+    start[i] = end[i] = 0;
+    switch (AddressMatch(cfg_[i])) {
+      case PmpAddressMatch::kOff:
+        continue;
+      case PmpAddressMatch::kTor:
+        start[i] = (i == 0) ? 0 : address_[i - 1] << 2;
+        end[i] = address_[i] << 2;
+        break;
+      case PmpAddressMatch::kNa4:
+        start[i] = address_[i] << 2;
+        end[i] = start[i] + 4;
+        break;
+      case PmpAddressMatch::kNapot: {
+        // The number of trailing ones encodes the size of the region.
+        int ones = absl::countr_one(address_[i]);
+        start[i] = (address_[i] & ~((1ULL << ones) - 1)) << 2;
+        end[i] = start[i] + (8ULL << ones);
+        break;
+      }
+    }
+    enabled = true;
+    if (start[i] >= end[i]) continue;
+    bounds.push_back(start[i]);
+    bounds.push_back(end[i]);
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  // Split the address space at each entry boundary, and assign each piece the
+  // lowest numbered entry that matches it. Adjacent pieces matched by the same
+  // entry are merged, so that an access that spans two ranges is one that is
+  // not fully contained in its highest priority matching entry, and fails.
+  ranges_.clear();
+  for (uint64_t bound : bounds) {
+    int entry = -1;
+    for (int i = 0; i < kNumEntries; i++) {
+      if ((start[i] <= bound) && (bound < end[i])) {
+        entry = i;
+        break;
+      }
+    }
+    if (!ranges_.empty() && (ranges_.back().entry == entry)) continue;
+    Range range = {bound, entry, kAllPermissions, 0};
+    if (entry >= 0) {
+      uint8_t permissions = cfg_[entry] & kAllPermissions;
+      range.permissions = permissions;
+      // Machine mode accesses are only restricted by locked entries.
+      if (cfg_[entry] & *PmpCfgBits::kLock) {
+        range.machine_permissions = permissions;
+      }
+    }
+    ranges_.push_back(range);
+  }
+  for (auto& entry : page_cache_) entry = PageCacheEntry();
+  state_->set_memory_protection(enabled);
+  // Instruction fetch permissions are checked when instructions are decoded,
+  // so the instructions decoded in all fetch contexts are discarded.
+  state_->InvalidateFetchContexts(/*mask*/ 0, /*value*/ 0);
+}
+
+int RiscVPmp::FindRange(uint64_t address) const {
+  // The first range starts at 0, so there is always a range that contains the
+  // address.
+  auto iter = std::upper_bound(
+      ranges_.begin(), ranges_.end(), address,
+      [](uint64_t address, const Range& range) {
+        return address < range.start;
+      });
+  return static_cast<int>(iter - ranges_.begin()) - 1;
+}
+
+bool RiscVPmp::CheckAccess(uint64_t address, uint64_t size, int permissions,
+                           PrivilegeMode privilege) const {
+  uint64_t last = address + size - 1;
+  if (last < address) return false;
+  int index = FindRange(address);
+  // All the bytes of the access have to be in the same range.
+  if ((index + 1 < static_cast<int>(ranges_.size())) &&
+      (last >= ranges_[index + 1].start)) {
+    return false;
+  }
+  const Range& range = ranges_[index];
+  uint8_t allowed = (privilege == PrivilegeMode::kMachine)
+                        ? range.machine_permissions
+                        : range.permissions;
+  return (allowed & permissions) == permissions;
+}
+
+void RiscVPmp::FillPageCacheEntry(uint64_t page, PrivilegeMode privilege,
+                                  PageCacheEntry* entry) const {
+  entry->tag = (page << 2) | *privilege;
+  entry->permissions = 0;
+  uint64_t address = page << kPageShift;
+  int index = FindRange(address);
+  uint64_t last = address + ((1ULL << kPageShift) - 1);
+  if ((index + 1 < static_cast<int>(ranges_.size())) &&
+      (last >= ranges_[index + 1].start)) {
+    return;
+  }
+  const Range& range = ranges_[index];
+  entry->permissions = (privilege == PrivilegeMode::kMachine)
+                           ? range.machine_permissions
+                           : range.permissions;
+}
+
+}  // namespace mpact::sim::riscv
@@ -15,39 +15,63 @@
 #ifndef THIRD_PARTY_MPACT_RISCV_RISCV_PMP_H_
 #define THIRD_PARTY_MPACT_RISCV_RISCV_PMP_H_
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "mpact/sim/generic/arch_state.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "riscv/riscv_csr.h"
+#include "riscv/riscv_state.h"
 
-// This file defines the RiscV Physical Memory Protection management class. For
-// now, this class only creates the CSRs and does not model the actual PMP
-// functionality. In the future, these classes may be extended to model the
-// actual PMP functionality.
+// This file defines the RiscV Physical Memory Protection management class. It
+// creates the pmpcfg and pmpaddr CSRs, and checks physical memory accesses
+// against the TOR, NA4 and NAPOT regions that they configure.
+//
+// Writes to the CSRs recompute a table of the address ranges that the enabled
+// entries divide the physical address space into, sorted by start address,
+// each with the permissions granted by the highest priority entry that
+// matches it. Checks first consult a small direct mapped cache of the
+// permissions of pages that lie entirely within one range, so the table is
+// only searched for accesses to pages that are split by an entry boundary, or
+// that lack the permissions needed.
 //
 // The CSRs are created internal to the class, and therefore are owned, and
-// subsequently destructed by the destructor. This is done so that in the future
-// it is easier to replace the CSRs with new PMP specific CSR classes that will
-// be able to (re)configure PMP checking upon CSR writes.
+// subsequently destructed by the destructor.
 
 namespace mpact::sim::riscv {
 
 using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
 using ::mpact::sim::generic::ArchState;
 
+// Bits of the 8-bit configuration of a PMP entry.
 enum class PmpCfgBits {
   kRead = 1 << 0,
   kWrite = 1 << 1,
   kExecute = 1 << 2,
-  kAtomic = 3 << 3,
-  kNone = 3 << 5,
-  kLock = 1 << 8,
+  kAddressMatch = 3 << 3,
+  kReserved = 3 << 5,
+  kLock = 1 << 7,
+};
+
+// Values of the address matching field of a PMP entry configuration.
+enum class PmpAddressMatch {
+  kOff = 0,
+  kTor = 1,
+  kNa4 = 2,
+  kNapot = 3,
 };
 
 class RiscVPmp {
  public:
-  explicit RiscVPmp(ArchState* state) : state_(state) {}
+  static constexpr int kNumEntries = 16;
+  static constexpr int kPageShift = 12;
+  // Number of entries in the page permission cache. Must be a power of two.
+  static constexpr int kPageCacheSize = 256;
+
+  explicit RiscVPmp(RiscVState* state);
   RiscVPmp(const RiscVPmp&) = delete;
   RiscVPmp& operator=(const RiscVPmp&) = delete;
 
@@ -59,10 +83,135 @@ class RiscVPmp {
     for (auto* pmp_addr : pmp_addr_) delete pmp_addr;
   }
 
+  // Returns true if the PMP entries permit an access of 'size' bytes at the
+  // physical address in the given privilege mode. The permissions are the
+  // PmpCfgBits kRead, kWrite and kExecute that the access requires, e.g.,
+  // both kRead and kWrite for an atomic memory operation.
+  inline bool IsAccessAllowed(uint64_t address, uint64_t size, int permissions,
+                              PrivilegeMode privilege) {
+    uint64_t page = address >> kPageShift;
+    if (((address + size - 1) >> kPageShift) == page) {
+      auto& entry = page_cache_[page & (kPageCacheSize - 1)];
+      uint64_t tag = (page << 2) | *privilege;
+      if (entry.tag != tag) FillPageCacheEntry(page, privilege, &entry);
+      if ((entry.permissions & permissions) == permissions) return true;
+    }
+    return CheckAccess(address, size, permissions, privilege);
+  }
+
+  // Methods called by the PMP CSRs.
+  // Returns the legal value for a write of 'value' to the configurations of
+  // the 'num_entries' entries starting at 'index'. Locked entries keep their
+  // configuration.
+  uint64_t LegalizeCfg(int index, int num_entries, uint64_t value) const;
+  // Returns true if writes to the address register of the entry are ignored
+  // because the entry, or the next entry when that is a locked TOR entry, is
+  // locked.
+  bool IsAddressLocked(int index) const;
+  // Update the configurations of the 'num_entries' entries starting at
+  // 'index', or the address of an entry, and recompute the address ranges.
+  void SetCfg(int index, int num_entries, uint64_t value);
+  void SetAddress(int index, uint64_t value);
+
  private:
-  ArchState* state_;
-  RiscVCsrInterface* pmp_addr_[16];
+  static constexpr uint64_t kInvalidTag = ~0ULL;
+  static constexpr uint8_t kAllPermissions = 0b111;
+
+  // A range of physical addresses from 'start' up to the start of the next
+  // range, or the end of the address space for the last range.
+  struct Range {
+    uint64_t start;
+    // Index of the highest priority matching entry, or -1 if none matches.
+    int entry;
+    // Permissions of machine mode and the less privileged modes.
+    uint8_t machine_permissions;
+    uint8_t permissions;
+  };
+
+  struct PageCacheEntry {
+    // Page number shifted left by 2, ored with the privilege mode.
+    uint64_t tag = kInvalidTag;
+    // Permissions for the whole page, or 0 if the page is split between
+    // ranges.
+    uint8_t permissions = 0;
+  };
+
+  // Recomputes the address ranges from the entries, and invalidates the page
+  // cache and the decoded instructions.
+  void Reconfigure();
+  // Returns the index of the range that contains the address.
+  int FindRange(uint64_t address) const;
+  // Checks the access against the address ranges.
+  bool CheckAccess(uint64_t address, uint64_t size, int permissions,
+                   PrivilegeMode privilege) const;
+  void FillPageCacheEntry(uint64_t page, PrivilegeMode privilege,
+                          PageCacheEntry* entry) const;
+
+  RiscVState* state_;
+  RiscVCsrInterface* pmp_addr_[kNumEntries];
   RiscVCsrInterface* pmp_cfg_[4];
+  uint8_t cfg_[kNumEntries] = {};
+  uint64_t address_[kNumEntries] = {};
+  std::vector<Range> ranges_;
+  PageCacheEntry page_cache_[kPageCacheSize];
+};
+
+// The pmpcfg CSRs. Each holds the 8-bit configurations of XLEN/8 entries.
+// Writes to locked entries, and to the reserved bits, are ignored.
+template <typename T>
+class RiscVPmpCfgCsr : public RiscVSimpleCsr<T> {
+ public:
+  RiscVPmpCfgCsr(std::string name, uint64_t index, int first_entry,
+                 RiscVPmp* pmp, ArchState* state)
+      : RiscVSimpleCsr<T>(name, index, state),
+        first_entry_(first_entry),
+        pmp_(pmp) {}
+
+  void Write(uint32_t value) override { Write(static_cast<uint64_t>(value)); }
+  void Write(uint64_t value) override {
+    Set(pmp_->LegalizeCfg(first_entry_, sizeof(T), value));
+  }
+  void Set(uint32_t value) override { Set(static_cast<uint64_t>(value)); }
+  void Set(uint64_t value) override {
+    RiscVSimpleCsr<T>::Set(value);
+    pmp_->SetCfg(first_entry_, sizeof(T), this->GetUint64());
+  }
+
+ private:
+  int first_entry_;
+  RiscVPmp* pmp_;
+};
+
+// The pmpaddr CSRs. They hold bits 2 and up of the physical address, which
+// for RV64 are limited to 56 bit physical addresses. Writes are ignored while
+// the entry is locked.
+template <typename T>
+class RiscVPmpAddrCsr : public RiscVSimpleCsr<T> {
+ public:
+  RiscVPmpAddrCsr(std::string name, uint64_t index, int entry, RiscVPmp* pmp,
+                  ArchState* state)
+      : RiscVSimpleCsr<T>(name, index, ~static_cast<T>(0),
+                          static_cast<T>(0x003f'ffff'ffff'ffffULL), state),
+        entry_(entry),
+        pmp_(pmp) {}
+
+  void Write(uint32_t value) override {
+    if (pmp_->IsAddressLocked(entry_)) return;
+    RiscVSimpleCsr<T>::Write(value);
+  }
+  void Write(uint64_t value) override {
+    if (pmp_->IsAddressLocked(entry_)) return;
+    RiscVSimpleCsr<T>::Write(value);
+  }
+  void Set(uint32_t value) override { Set(static_cast<uint64_t>(value)); }
+  void Set(uint64_t value) override {
+    RiscVSimpleCsr<T>::Set(value);
+    pmp_->SetAddress(entry_, this->GetUint64());
+  }
+
+ private:
+  int entry_;
+  RiscVPmp* pmp_;
 };
 
 template <typename T, typename E>
@@ -70,15 +219,17 @@ void RiscVPmp::CreatePmpCsrs(RiscVCsrSet* csr_set) {
   // Create the PMP configuration registers. Each configuration register
   // contains XLEN/8 configuration entries for a total of 16 configuration
   // entries. In the case of XLEN=64, there are only two configuration registers
-  // pmp_cfg_[0] and pmp_cfg_[2].
-  pmp_cfg_[0] = new RiscVSimpleCsr<T>("pmpcfg0", *E::kPmpCfg0, state_);
-  pmp_cfg_[1] = sizeof(T) == 8
-                    ? nullptr
-                    : new RiscVSimpleCsr<T>("pmpcfg1", *E::kPmpCfg1, state_);
-  pmp_cfg_[2] = new RiscVSimpleCsr<T>("pmpcfg2", *E::kPmpCfg2, state_);
-  pmp_cfg_[3] = sizeof(T) == 8
-                    ? nullptr
-                    : new RiscVSimpleCsr<T>("pmpcfg3", *E::kPmpCfg3, state_);
+  // pmp_cfg_[0] and pmp_cfg_[2]. Either way, pmpcfg<i> starts with the
+  // configuration of entry 4 * i.
+  for (int i = 0; i < 4; i++) {
+    if ((sizeof(T) == 8) && (i & 1)) {
+      pmp_cfg_[i] = nullptr;
+      continue;
+    }
+    pmp_cfg_[i] =
+        new RiscVPmpCfgCsr<T>(absl::StrCat("pmpcfg", i), *E::kPmpCfg0 + i,
+                              /*first_entry*/ 4 * i, this, state_);
+  }
   for (auto* pmp_cfg : pmp_cfg_) {
     if (pmp_cfg == nullptr) continue;
     auto status = csr_set->AddCsr(pmp_cfg);
@@ -88,22 +239,10 @@ void RiscVPmp::CreatePmpCsrs(RiscVCsrSet* csr_set) {
     }
   }
   // Create the 16 PMP address registers.
-  pmp_addr_[0] = new RiscVSimpleCsr<T>("pmpaddr0", *E::kPmpAddr0, state_);
-  pmp_addr_[1] = new RiscVSimpleCsr<T>("pmpaddr1", *E::kPmpAddr1, state_);
-  pmp_addr_[2] = new RiscVSimpleCsr<T>("pmpaddr2", *E::kPmpAddr2, state_);
-  pmp_addr_[3] = new RiscVSimpleCsr<T>("pmpaddr3", *E::kPmpAddr3, state_);
-  pmp_addr_[4] = new RiscVSimpleCsr<T>("pmpaddr4", *E::kPmpAddr4, state_);
-  pmp_addr_[5] = new RiscVSimpleCsr<T>("pmpaddr5", *E::kPmpAddr5, state_);
-  pmp_addr_[6] = new RiscVSimpleCsr<T>("pmpaddr6", *E::kPmpAddr6, state_);
-  pmp_addr_[7] = new RiscVSimpleCsr<T>("pmpaddr7", *E::kPmpAddr7, state_);
-  pmp_addr_[8] = new RiscVSimpleCsr<T>("pmpaddr8", *E::kPmpAddr8, state_);
-  pmp_addr_[9] = new RiscVSimpleCsr<T>("pmpaddr9", *E::kPmpAddr9, state_);
-  pmp_addr_[10] = new RiscVSimpleCsr<T>("pmpaddr10", *E::kPmpAddr10, state_);
-  pmp_addr_[11] = new RiscVSimpleCsr<T>("pmpaddr11", *E::kPmpAddr11, state_);
-  pmp_addr_[12] = new RiscVSimpleCsr<T>("pmpaddr12", *E::kPmpAddr12, state_);
-  pmp_addr_[13] = new RiscVSimpleCsr<T>("pmpaddr13", *E::kPmpAddr13, state_);
-  pmp_addr_[14] = new RiscVSimpleCsr<T>("pmpaddr14", *E::kPmpAddr14, state_);
-  pmp_addr_[15] = new RiscVSimpleCsr<T>("pmpaddr15", *E::kPmpAddr15, state_);
+  for (int i = 0; i < kNumEntries; i++) {
+    pmp_addr_[i] = new RiscVPmpAddrCsr<T>(absl::StrCat("pmpaddr", i),
+                                          *E::kPmpAddr0 + i, i, this, state_);
+  }
   for (auto* pmp_addr : pmp_addr_) {
     auto status = csr_set->AddCsr(pmp_addr);
     if (!status.ok()) {
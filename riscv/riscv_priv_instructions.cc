@@ -22,6 +22,7 @@
 #include "mpact/sim/generic/type_helpers.h"
 #include "riscv/riscv_csr.h"
 #include "riscv/riscv_misa.h"
+#include "riscv/riscv_mmu.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
 #include "riscv/riscv_xstatus.h"
@@ -307,7 +308,7 @@ void RiscVPrivSFenceVmaZZ(const Instruction *inst) {
                 *ExceptionCode::kIllegalInstruction, inst->address(), inst);
     return;
   }
-  // TODO Fill in semantics.
+  state->mmu()->FlushAll();
 }
 
 void RiscVPrivSFenceVmaZN(const Instruction *inst) {
@@ -320,7 +321,8 @@ void RiscVPrivSFenceVmaZN(const Instruction *inst) {
                 *ExceptionCode::kIllegalInstruction, inst->address(), inst);
     return;
   }
-  // TODO Fill in semantics.
+  // Flush the non-global translations of the address space in rs2.
+  state->mmu()->FlushAsid(inst->Source(1)->AsUint64(0));
 }
 
 void RiscVPrivSFenceVmaNZ(const Instruction *inst) {
@@ -333,7 +335,8 @@ void RiscVPrivSFenceVmaNZ(const Instruction *inst) {
                 *ExceptionCode::kIllegalInstruction, inst->address(), inst);
     return;
   }
-  // TODO Fill in semantics.
+  // Flush the translations of the virtual address in rs1.
+  state->mmu()->FlushAddress(inst->Source(0)->AsUint64(0));
 }
 
 void RiscVPrivSFenceVmaNN(const Instruction *inst) {
@@ -346,7 +349,8 @@ void RiscVPrivSFenceVmaNN(const Instruction *inst) {
                 *ExceptionCode::kIllegalInstruction, inst->address(), inst);
     return;
   }
-  // TODO Fill in semantics.
+  state->mmu()->FlushAddressAsid(inst->Source(0)->AsUint64(0),
+                                 inst->Source(1)->AsUint64(0));
 }
 
 }  // namespace riscv
@@ -232,6 +232,11 @@ DataBuffer *RV32VectorDestinationOperand::CopyDataBuffer(int i) {
   return db;
 }
 
+DataBuffer *RV32VectorDestinationOperand::WriteDataBuffer(int i,
+                                                          bool overwrite) {
+  return overwrite ? AllocateDataBuffer(i) : CopyDataBuffer(i);
+}
+
 std::any RV32VectorDestinationOperand::GetObject(int i) const {
   return std::any(registers_[i]);
 }
@@ -81,6 +81,20 @@ class RV32VectorSourceOperand : public generic::SourceOperandInterface {
   // New methods.
   std::any GetObject(int i) const;
   int size() const { return registers_.size(); }
+  // Returns the number of elements of type T held by each register in the
+  // group.
+  template <typename T>
+  int ElementsPerRegister() const {
+    return vector_byte_size_ / sizeof(T);
+  }
+  // Returns the elements of type T held by register i of the group. This
+  // allows semantic functions to iterate linearly over the register contents
+  // instead of calling the virtual As*(index) methods for each element, which
+  // compute the register and the offset within the register from the index.
+  template <typename T>
+  absl::Span<const T> GetRegisterSpan(int i) const {
+    return registers_[i]->data_buffer()->Get<T>();
+  }
 
  private:
   int group_size_ = 0;
@@ -131,8 +145,28 @@ class RV32VectorDestinationOperand
   generic::DataBuffer *AllocateDataBuffer(int i);
   void InitializeDataBuffer(int i, generic::DataBuffer *db);
   generic::DataBuffer *CopyDataBuffer(int i);
+  // Returns a data buffer for writing register i. If overwrite is true, the
+  // caller writes every element of the register, so the current register
+  // contents are not copied into the data buffer as by CopyDataBuffer(i), and
+  // its initial contents are undefined.
+  generic::DataBuffer *WriteDataBuffer(int i, bool overwrite);
+  // Same as CopyDataBuffer(i), but also returns the elements of type T of the
+  // new data buffer in span, so that they can be written linearly before the
+  // data buffer is submitted.
+  template <typename T>
+  generic::DataBuffer *CopyDataBuffer(int i, absl::Span<T> *span) {
+    generic::DataBuffer *db = CopyDataBuffer(i);
+    *span = db->Get<T>();
+    return db;
+  }
   std::any GetObject(int i) const;
   int size() const { return registers_.size(); }
+  // Returns the number of elements of type T held by each register in the
+  // group.
+  template <typename T>
+  int ElementsPerRegister() const {
+    return vector_byte_size_ / sizeof(T);
+  }
 
  private:
   generic::DataBufferFactory *db_factory_;
@@ -466,6 +466,8 @@ absl::Status RiscVRenode::SetConfig(const char *config_names[],
   if (clint_mmr_base != 0) {
     clint_ = new RiscVClint(/*period=*/100, riscv_top_->state()->mip());
     riscv_top_->counter_num_cycles()->AddListener(clint_);
+    riscv_top_->set_counter_deadline_fcn(
+        [clint = clint_]() { return clint->TicksToDeadline(); });
     // Core local interrupt controller - clint.
     CHECK_OK(router_->AddTarget<MemoryInterface>(clint_, clint_mmr_base,
                                                  clint_mmr_base + 0xffffULL));
@@ -15,6 +15,7 @@
 #include "riscv/riscv_state.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <string>
@@ -22,6 +23,7 @@
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "mpact/sim/generic/arch_state.h"
@@ -29,8 +31,10 @@
 #include "mpact/sim/util/memory/memory_interface.h"
 #include "riscv/riscv_counter_csr.h"
 #include "riscv/riscv_csr.h"
+#include "riscv/riscv_host_memory.h"
 #include "riscv/riscv_jvt.h"
 #include "riscv/riscv_misa.h"
+#include "riscv/riscv_mmu.h"
 #include "riscv/riscv_pmp.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_sim_csrs.h"
@@ -309,6 +313,13 @@ void CreateCsrs(RiscVState *state, std::vector<RiscVCsrInterface *> &csr_vec) {
                                         RiscVCsrEnum::kSScratch, 0, state),
            nullptr);
 
+  // satp - supervisor address translation and protection register. Writes
+  // are passed on to the mmu.
+  state->mmu_ = new RiscVMmu(state);
+  CHECK_NE(CreateCsr<RiscVSatpCsr<T>>(state, csr_vec, "satp",
+                                      RiscVCsrEnum::kSAtp, state->mmu_, state),
+           nullptr);
+
   // sideleg - machine mode interrupt delegation register.
   CHECK_NE(CreateCsr<RiscVSimpleCsr<T>>(state, state->sideleg_, csr_vec,
                                         "sideleg", RiscVCsrEnum::kSIDeleg, 0,
@@ -421,6 +432,13 @@ RiscVState::~RiscVState() {
     delete csr;
   }
   csr_vec_.clear();
+  delete mmu_;
+  for (auto *context : scalar_load_context_) {
+    if (context != nullptr) context->DecRef();
+  }
+  for (auto *db : scalar_store_db_) {
+    if (db != nullptr) db->DecRef();
+  }
 }
 
 void RiscVState::set_max_physical_address(uint64_t max_physical_address) {
@@ -436,52 +454,264 @@ void RiscVState::set_max_physical_address(uint64_t max_physical_address) {
     default:
       break;
   }
+  FlushHostPageTable();
+}
+
+void RiscVState::set_host_memory(RiscVHostMemory *host_memory) {
+  host_memory_ = host_memory;
+  FlushHostPageTable();
+}
+
+void RiscVState::DisableHostMemoryAccess(uint64_t address, uint64_t size) {
+  if (size == 0) return;
+  uint64_t first = address >> RiscVHostMemory::kPageShift;
+  uint64_t last = (address + size - 1) >> RiscVHostMemory::kPageShift;
+  for (uint64_t page = first; page <= last; page++) {
+    host_page_exclusions_[page]++;
+    auto &entry = host_page_table_[page & (kHostPageTableSize - 1)];
+    if (entry.page == page) entry = HostPageTableEntry();
+  }
+}
+
+void RiscVState::EnableHostMemoryAccess(uint64_t address, uint64_t size) {
+  if (size == 0) return;
+  uint64_t first = address >> RiscVHostMemory::kPageShift;
+  uint64_t last = (address + size - 1) >> RiscVHostMemory::kPageShift;
+  for (uint64_t page = first; page <= last; page++) {
+    auto iter = host_page_exclusions_.find(page);
+    if (iter == host_page_exclusions_.end()) continue;
+    if (--iter->second == 0) host_page_exclusions_.erase(iter);
+    auto &entry = host_page_table_[page & (kHostPageTableSize - 1)];
+    if (entry.page == page) entry = HostPageTableEntry();
+  }
+}
+
+void RiscVState::FlushHostPageTable() {
+  for (auto &entry : host_page_table_) entry = HostPageTableEntry();
+}
+
+void RiscVState::FillHostPageTableEntry(uint64_t page,
+                                        HostPageTableEntry *entry) {
+  entry->page = page;
+  entry->host_page = nullptr;
+  uint64_t address = page << RiscVHostMemory::kPageShift;
+  // Pages that are partially beyond the maximum physical address are left to
+  // LoadMemory/StoreMemory, which raise the access faults.
+  if (address + (RiscVHostMemory::kPageSize - 1) > max_physical_address_) {
+    return;
+  }
+  if (host_page_exclusions_.contains(page)) return;
+  entry->host_page = host_memory_->GetPage(address);
+}
+
+bool RiscVState::IsHostAccessAllowed(uint64_t address, int size) {
+  return pmp_->IsAccessAllowed(address, size,
+                               *PmpCfgBits::kRead | *PmpCfgBits::kWrite,
+                               data_privilege_mode());
+}
+
+bool RiscVState::TranslateHostAddress(uint64_t *address) {
+  if (!mmu_->IsDataTranslationEnabled()) return true;
+  return mmu_->LookupDataTlb(*address, address);
+}
+
+uint64_t RiscVState::fetch_context() const {
+  if (!address_translation_ && !memory_protection_) return 0;
+  uint64_t context = kFetchContextChecked | *privilege_mode_;
+  if (address_translation_ && mmu_->IsFetchTranslationEnabled()) {
+    context |=
+        kFetchContextTranslated | (mmu_->asid() << kFetchContextAsidShift);
+  }
+  return context;
+}
+
+bool RiscVState::TranslateDataAddress(const Instruction *inst, uint64_t size,
+                                      bool is_store, uint64_t *address) {
+  if (!address_translation_ || !mmu_->IsDataTranslationEnabled()) return true;
+  ExceptionCode code;
+  uint64_t fault_address;
+  auto type =
+      is_store ? RiscVMmu::AccessType::kStore : RiscVMmu::AccessType::kLoad;
+  if (mmu_->TranslateDataAccess(*address, size, type, address, &code,
+                                &fault_address)) {
+    return true;
+  }
+  Trap(/*is_interrupt*/ false, fault_address, *code, inst->address(), inst);
+  return false;
+}
+
+bool RiscVState::CheckMemoryProtection(const Instruction *inst,
+                                       uint64_t address,
+                                       uint64_t physical_address,
+                                       uint64_t size, int permissions) {
+  if (!memory_protection_ ||
+      pmp_->IsAccessAllowed(physical_address, size, permissions,
+                            data_privilege_mode())) {
+    return true;
+  }
+  auto code = (permissions & *PmpCfgBits::kWrite)
+                  ? ExceptionCode::kStoreAccessFault
+                  : ExceptionCode::kLoadAccessFault;
+  Trap(/*is_interrupt*/ false, address, *code, inst->address(), inst);
+  return false;
+}
+
+// Returns a copy of the address data buffer with the addresses of the active
+// elements translated, or nullptr if a translation faulted, in which case the
+// exception has been raised. The addresses of inactive elements are set to 0.
+static DataBuffer *TranslateVectorAddresses(RiscVState *state,
+                                            const Instruction *inst,
+                                            DataBuffer *address_db,
+                                            DataBuffer *mask_db, int el_size,
+                                            bool is_store) {
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  auto *translated_db = state->db_factory()->Allocate<uint64_t>(
+      addresses.size());
+  auto translated = translated_db->Get<uint64_t>();
+  for (size_t i = 0; i < addresses.size(); i++) {
+    translated[i] = 0;
+    if (!mask[i]) continue;
+    uint64_t address = addresses[i];
+    if (!state->TranslateDataAddress(inst, el_size, is_store, &address)) {
+      translated_db->DecRef();
+      return nullptr;
+    }
+    translated[i] = address;
+  }
+  return translated_db;
+}
+
+// Checks the physical addresses of the vector access, raising an access fault
+// and returning false for the first active element that is beyond the maximum
+// physical address or is not permitted by memory protection. The virtual
+// addresses are used for the trap value.
+static bool CheckVectorAddresses(RiscVState *state, const Instruction *inst,
+                                 DataBuffer *virtual_db, DataBuffer *address_db,
+                                 DataBuffer *mask_db, int el_size,
+                                 bool is_store) {
+  auto virtual_addresses = virtual_db->Get<uint64_t>();
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  int permissions = is_store ? *PmpCfgBits::kWrite : *PmpCfgBits::kRead;
+  for (size_t i = 0; i < addresses.size(); i++) {
+    if (addresses[i] > state->max_physical_address()) {
+      auto code = is_store ? ExceptionCode::kStoreAccessFault
+                           : ExceptionCode::kLoadAccessFault;
+      state->Trap(/*is_interrupt*/ false, addresses[i], *code, inst->address(),
+                  inst);
+      return false;
+    }
+    if (state->memory_protection() && mask[i] &&
+        !state->CheckMemoryProtection(inst, virtual_addresses[i], addresses[i],
+                                      el_size, permissions)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void RiscVState::LoadMemory(const Instruction *inst, uint64_t address,
                             DataBuffer *db, Instruction *child_inst,
                             ReferenceCount *context) {
-  if (address > max_physical_address_) {
-    Trap(/*is_interrupt*/ false, address, *ExceptionCode::kLoadAccessFault,
-         inst->address(), inst);
+  uint64_t physical_address = address;
+  if (address_translation_ &&
+      !TranslateDataAddress(inst, db->size<uint8_t>(), /*is_store*/ false,
+                            &physical_address)) {
+    return;
+  }
+  if (physical_address > max_physical_address_) {
+    Trap(/*is_interrupt*/ false, physical_address,
+         *ExceptionCode::kLoadAccessFault, inst->address(), inst);
+    return;
+  }
+  if (memory_protection_ &&
+      !CheckMemoryProtection(inst, address, physical_address,
+                             db->size<uint8_t>(), *PmpCfgBits::kRead)) {
     return;
   }
-  memory_->Load(address, db, child_inst, context);
+  memory_->Load(physical_address, db, child_inst, context);
+}
+
+LoadContext *RiscVState::GetScalarLoadContext(int size) {
+  auto *&context =
+      scalar_load_context_[absl::countr_zero(static_cast<unsigned>(size))];
+  if ((context == nullptr) || (context->ref_count() > 1) ||
+      (context->value_db->ref_count() > 1)) {
+    if (context != nullptr) context->DecRef();
+    context = new LoadContext(db_factory()->Allocate(size));
+  }
+  context->value_db->set_latency(0);
+  return context;
+}
+
+DataBuffer *RiscVState::GetScalarStoreDataBuffer(int size) {
+  auto *&db = scalar_store_db_[absl::countr_zero(static_cast<unsigned>(size))];
+  if ((db == nullptr) || (db->ref_count() > 1)) {
+    if (db != nullptr) db->DecRef();
+    db = db_factory()->Allocate(size);
+  }
+  return db;
 }
 
 void RiscVState::LoadMemory(const Instruction *inst, DataBuffer *address_db,
                             DataBuffer *mask_db, int el_size, DataBuffer *db,
                             Instruction *child_inst, ReferenceCount *context) {
-  for (auto address : address_db->Get<uint64_t>()) {
-    if (address > max_physical_address_) {
-      Trap(/*is_interrupt*/ false, address, *ExceptionCode::kLoadAccessFault,
-           inst->address(), inst);
-      return;
-    }
+  DataBuffer *translated_db = nullptr;
+  DataBuffer *virtual_db = address_db;
+  if (address_translation_ && mmu_->IsDataTranslationEnabled()) {
+    translated_db = TranslateVectorAddresses(this, inst, address_db, mask_db,
+                                             el_size, /*is_store*/ false);
+    if (translated_db == nullptr) return;
+    address_db = translated_db;
+  }
+  if (!CheckVectorAddresses(this, inst, virtual_db, address_db, mask_db,
+                            el_size, /*is_store*/ false)) {
+    if (translated_db != nullptr) translated_db->DecRef();
+    return;
   }
   memory_->Load(address_db, mask_db, el_size, db, child_inst, context);
+  if (translated_db != nullptr) translated_db->DecRef();
 }
 
 void RiscVState::StoreMemory(const Instruction *inst, uint64_t address,
                              DataBuffer *db) {
-  if (address > max_physical_address_) {
-    Trap(/*is_interrupt*/ false, address, *ExceptionCode::kStoreAccessFault,
-         inst->address(), inst);
+  uint64_t physical_address = address;
+  if (address_translation_ &&
+      !TranslateDataAddress(inst, db->size<uint8_t>(), /*is_store*/ true,
+                            &physical_address)) {
     return;
   }
-  memory_->Store(address, db);
+  if (physical_address > max_physical_address_) {
+    Trap(/*is_interrupt*/ false, physical_address,
+         *ExceptionCode::kStoreAccessFault, inst->address(), inst);
+    return;
+  }
+  if (memory_protection_ &&
+      !CheckMemoryProtection(inst, address, physical_address,
+                             db->size<uint8_t>(), *PmpCfgBits::kWrite)) {
+    return;
+  }
+  memory_->Store(physical_address, db);
 }
 
 void RiscVState::StoreMemory(const Instruction *inst, DataBuffer *address_db,
                              DataBuffer *mask_db, int el_size, DataBuffer *db) {
-  for (auto address : address_db->Get<uint64_t>()) {
-    if (address > max_physical_address_) {
-      Trap(/*is_interrupt*/ false, address, *ExceptionCode::kStoreAccessFault,
-           inst->address(), inst);
-      return;
-    }
+  DataBuffer *translated_db = nullptr;
+  DataBuffer *virtual_db = address_db;
+  if (address_translation_ && mmu_->IsDataTranslationEnabled()) {
+    translated_db = TranslateVectorAddresses(this, inst, address_db, mask_db,
+                                             el_size, /*is_store*/ true);
+    if (translated_db == nullptr) return;
+    address_db = translated_db;
+  }
+  if (!CheckVectorAddresses(this, inst, virtual_db, address_db, mask_db,
+                            el_size, /*is_store*/ true)) {
+    if (translated_db != nullptr) translated_db->DecRef();
+    return;
   }
   memory_->Store(address_db, mask_db, el_size, db);
+  if (translated_db != nullptr) translated_db->DecRef();
 }
 
 void RiscVState::Fence(const Instruction *inst, int fm, int predecessor,
@@ -735,17 +965,17 @@ void RiscVState::CheckForInterrupt() {
   }
 
   available_interrupt_code_ = code;
-  is_interrupt_available_ = true;
+  SetAttention(kInterruptAvailable, true);
 }
 
 // Take the interrupt that is pending.
 void RiscVState::TakeAvailableInterrupt(uint64_t epc) {
   // Make sure an interrupt is set as pending by CheckForInterrupt.
-  if (!is_interrupt_available_) return;
+  if (!HasAttention(kInterruptAvailable)) return;
   // Initiate the interrupt.
   Trap(/*is_interrupt*/ true, 0, *available_interrupt_code_, epc, nullptr);
   // Clear pending interrupt.
-  is_interrupt_available_ = false;
+  SetAttention(kInterruptAvailable, false);
   counter_interrupts_taken_.Increment(1);
   available_interrupt_code_ = InterruptCode::kNone;
 }
@@ -15,12 +15,15 @@
 #ifndef MPACT_RISCV_RISCV_RISCV_STATE_H_
 #define MPACT_RISCV_RISCV_RISCV_STATE_H_
 
+#include <atomic>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
@@ -28,11 +31,13 @@
 #include "mpact/sim/generic/arch_state.h"
 #include "mpact/sim/generic/counters.h"
 #include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/delay_line_interface.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/operand_interface.h"
 #include "mpact/sim/generic/ref_count.h"
 #include "mpact/sim/util/memory/memory_interface.h"
 #include "riscv/riscv_csr.h"
+#include "riscv/riscv_host_memory.h"
 #include "riscv/riscv_misa.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_vector_state.h"
@@ -184,6 +189,7 @@ template <typename T>
 void CreateCsrs(RiscVState *, std::vector<RiscVCsrInterface *> &);
 
 class RiscVFPState;
+class RiscVMmu;
 class RiscVPmp;
 
 // Class that extends ArchState with RiscV specific methods. These methods
@@ -253,6 +259,75 @@ class RiscVState : public ArchState {
   void StoreMemory(const Instruction *inst, uint64_t address, DataBuffer *db);
   void StoreMemory(const Instruction *inst, DataBuffer *address_db,
                    DataBuffer *mask_db, int el_size, DataBuffer *db);
+  // Translates the virtual address of a data access of 'size' bytes in place,
+  // if address translation applies to data accesses in the current privilege
+  // mode. If the translation faults, the exception is raised and false is
+  // returned. LoadMemory/StoreMemory call this, but it is also used for
+  // accesses that don't go through them, i.e., atomic memory operations.
+  bool TranslateDataAddress(const Instruction *inst, uint64_t size,
+                            bool is_store, uint64_t *address);
+  // Checks a data access of 'size' bytes at the physical address against the
+  // physical memory protection, using the privilege mode of data accesses.
+  // The permissions are the PmpCfgBits the access requires. If the access is
+  // not permitted, a load access fault, or a store access fault if write
+  // permission is required, is raised for the virtual address, and false is
+  // returned.
+  bool CheckMemoryProtection(const Instruction *inst, uint64_t address,
+                             uint64_t physical_address, uint64_t size,
+                             int permissions);
+  // Scalar loads and stores of size 1, 2, 4 or 8 bytes pass their value
+  // through a load context or data buffer that the state keeps from one access
+  // to the next, so that the common case, where the memory system completes
+  // the access immediately, doesn't allocate. If the memory system still holds
+  // a reference from a previous access, e.g., to complete it later, it is
+  // replaced by a new one. The state owns the returned objects.
+  LoadContext *GetScalarLoadContext(int size);
+  DataBuffer *GetScalarStoreDataBuffer(int size);
+  // Returns the host address of the 'size' bytes of memory at 'address' if the
+  // scalar load or store semantic functions may access them directly, and
+  // nullptr if the access has to go through LoadMemory/StoreMemory. This is
+  // the case if no host memory is set, if the access crosses a page boundary,
+  // if the data TLB doesn't hold a translation that permits both reads and
+  // writes (when loads and stores are translated), if any part of the
+  // physical page is beyond the maximum physical address, if the page has
+  // been excluded from direct access, or if memory protection does not permit
+  // both reads and writes. The translations are cached in a small direct
+  // mapped table of physical page to host page.
+  inline uint8_t *GetHostPointer(uint64_t address, int size) {
+    if (host_memory_ == nullptr) return nullptr;
+    uint64_t page = address >> RiscVHostMemory::kPageShift;
+    if (((address + size - 1) >> RiscVHostMemory::kPageShift) != page) {
+      return nullptr;
+    }
+    if (address_translation_) {
+      if (!TranslateHostAddress(&address)) return nullptr;
+      page = address >> RiscVHostMemory::kPageShift;
+    }
+    if (memory_protection_ && !IsHostAccessAllowed(address, size)) {
+      return nullptr;
+    }
+    auto &entry = host_page_table_[page & (kHostPageTableSize - 1)];
+    if (entry.page != page) FillHostPageTableEntry(page, &entry);
+    if (entry.host_page == nullptr) return nullptr;
+    return entry.host_page + (address & (RiscVHostMemory::kPageSize - 1));
+  }
+  // Sets the host memory that backs the memory interface chain, enabling
+  // direct access by GetHostPointer(). Direct accesses bypass the memory
+  // interface chain, so memory ranges that are not plain RAM, or that are
+  // watched, have to be excluded using DisableHostMemoryAccess(). Since
+  // set_memory() disables direct access, this must be called after the memory
+  // chain is complete, and not at all if the chain contains profilers, caches
+  // or routers that have to see every access.
+  void set_host_memory(RiscVHostMemory *host_memory);
+  RiscVHostMemory *host_memory() const { return host_memory_; }
+  // Excludes the pages overlapping [address, address + size) from, or allows
+  // them again for, direct access. Exclusions of a page are counted, so that
+  // overlapping exclusions, e.g., watchpoints on the same page, may be added
+  // and removed independently.
+  void DisableHostMemoryAccess(uint64_t address, uint64_t size);
+  void EnableHostMemoryAccess(uint64_t address, uint64_t size);
+  // Invalidates the cached guest page to host page translations.
+  void FlushHostPageTable();
   // Called by the fence instruction semantic function to signal a fence
   // operation.
   void Fence(const Instruction *inst, int fm, int predecessor, int successor);
@@ -295,8 +370,39 @@ class RiscVState : public ArchState {
            counter_interrupt_returns_.GetValue();
   }
 
+  // Creates a delay line that is owned and advanced by the RiscVState. This
+  // hides ArchState::CreateAndAddDelayLine, so that components that add
+  // delay lines through the RiscVState have them advanced by
+  // AdvanceDelayLines. Delay lines created directly through an ArchState
+  // pointer are only advanced while the ArchState data buffer or function
+  // delay lines hold entries.
+  template <typename T, typename... Ps>
+  T *CreateAndAddDelayLine(Ps... pargs) {
+    T *delay_line = new T(pargs...);
+    owned_delay_lines_.emplace_back(delay_line);
+    return delay_line;
+  }
+
+  // Advances the delay lines by one cycle. For most configurations all
+  // destinations have zero latency, and the delay lines stay empty. Since new
+  // entries are always scheduled relative to the current cycle, advancing an
+  // empty delay line has no effect, and is skipped.
+  inline void AdvanceDelayLines() {
+    if (!data_buffer_delay_line()->IsEmpty() ||
+        !function_delay_line()->IsEmpty()) {
+      ArchState::AdvanceDelayLines();
+    }
+    for (auto &delay_line : owned_delay_lines_) {
+      if (!delay_line->IsEmpty()) delay_line->Advance();
+    }
+  }
+
   // Accessors.
-  void set_memory(util::MemoryInterface *memory) { memory_ = memory; }
+  // Changing the memory chain disables direct host memory access.
+  void set_memory(util::MemoryInterface *memory) {
+    memory_ = memory;
+    host_memory_ = nullptr;
+  }
   util::MemoryInterface *memory() const { return memory_; }
   util::AtomicMemoryOpInterface *atomic_memory() const {
     return atomic_memory_;
@@ -344,21 +450,93 @@ class RiscVState : public ArchState {
 
   PrivilegeMode privilege_mode() const { return privilege_mode_; }
   void set_privilege_mode(PrivilegeMode privilege_mode) {
+    // The translation and permissions of instruction fetches depend on the
+    // privilege mode, so a change selects another fetch context.
+    if ((address_translation_ || memory_protection_) &&
+        (privilege_mode != privilege_mode_)) {
+      SetAttention(kFetchTranslationChanged, true);
+    }
     privilege_mode_ = privilege_mode;
   }
 
+  // The mmu implements the address translation selected by satp.
+  RiscVMmu *mmu() const { return mmu_; }
+  // True if satp selects a translation mode other than bare. Set by the mmu.
+  bool address_translation() const { return address_translation_; }
+  void set_address_translation(bool value) { address_translation_ = value; }
+  // The privilege mode that data accesses are performed in, which is given by
+  // mstatus.MPP in machine mode when mstatus.MPRV is set.
+  PrivilegeMode data_privilege_mode() const {
+    if ((privilege_mode_ == PrivilegeMode::kMachine) && mstatus_->mprv()) {
+      return static_cast<PrivilegeMode>(mstatus_->mpp());
+    }
+    return privilege_mode_;
+  }
+  // The physical memory protection configured by the pmp CSRs.
+  RiscVPmp *pmp() const { return pmp_; }
+  // True if any PMP entry is enabled, so that accesses have to be checked.
+  // Set by the pmp.
+  bool memory_protection() const { return memory_protection_; }
+  void set_memory_protection(bool value) { memory_protection_ = value; }
+  // Instruction fetches are translated and checked differently depending on
+  // the privilege mode and the address space, so the simulation loop caches
+  // decoded instructions separately for each fetch context. The fetch context
+  // is 0 when neither address translation nor memory protection is enabled,
+  // as fetches are then the same in all privilege modes. Otherwise it holds
+  // the privilege mode, the kFetchContextChecked bit, and for translated
+  // fetches, the kFetchContextTranslated bit and the ASID.
+  static constexpr uint64_t kFetchContextChecked = 1 << 2;
+  static constexpr uint64_t kFetchContextTranslated = 1 << 3;
+  static constexpr int kFetchContextAsidShift = 4;
+  uint64_t fetch_context() const;
+  // Selects the fetch contexts whose value, masked by 'mask', equals 'value'.
+  struct FetchContextFilter {
+    uint64_t mask;
+    uint64_t value;
+  };
+  // Requests that the instructions decoded in the selected fetch contexts are
+  // discarded before the next instruction is fetched, as the translation or
+  // permissions of fetches in those contexts changed.
+  void InvalidateFetchContexts(uint64_t mask, uint64_t value) {
+    fetch_invalidations_.push_back({mask, value});
+    SetAttention(kFetchTranslationChanged, true);
+  }
+  const std::vector<FetchContextFilter> &fetch_invalidations() const {
+    return fetch_invalidations_;
+  }
+  void clear_fetch_invalidations() { fetch_invalidations_.clear(); }
+  // Set when the fetch context may have changed, or when fetch contexts have
+  // been invalidated, so that the simulation loop selects the decoded
+  // instructions of the current fetch context before fetching the next one.
+  void set_fetch_translation_changed(bool value) {
+    SetAttention(kFetchTranslationChanged, value);
+  }
+  bool fetch_translation_changed() const {
+    return HasAttention(kFetchTranslationChanged);
+  }
+
   // Returns true if an interrupt is available for the core to take or false
   // otherwise.
-  inline bool is_interrupt_available() const { return is_interrupt_available_; }
+  inline bool is_interrupt_available() const {
+    return HasAttention(kInterruptAvailable);
+  }
   // Resets the is_interrupt_available flag to false. This should only be called
   // when resetting the RISCV core, as 'is_interrupt_available' is Normally
   // reset during the interrupt handling flow.
   inline void reset_is_interrupt_available() {
-    is_interrupt_available_ = false;
+    SetAttention(kInterruptAvailable, false);
   }
 
-  void set_branch(bool value) { branch_ = value; }
-  bool branch() const { return branch_; }
+  void set_branch(bool value) { SetAttention(kBranch, value); }
+  bool branch() const { return HasAttention(kBranch); }
+
+  // Returns true if the most recently executed instruction changed the flow of
+  // control or the translation of instruction fetches, or if an interrupt is
+  // available to be taken. The simulation loop only needs to check this
+  // single flag after each instruction.
+  inline bool needs_attention() const {
+    return attention_.load(std::memory_order_relaxed) != 0;
+  }
 
   // Getters for select CSRs.
   RiscVMStatus *mstatus() const { return mstatus_; }
@@ -379,7 +557,24 @@ class RiscVState : public ArchState {
   RiscVCsrInterface *sideleg() const { return sideleg_; }
 
  private:
+  // Number of entries in the host page table. Must be a power of two.
+  static constexpr int kHostPageTableSize = 256;
+  // Entry in the host page table. The page is the guest page number, and the
+  // host page is nullptr if the page cannot be accessed directly.
+  struct HostPageTableEntry {
+    uint64_t page = ~0ULL;
+    uint8_t *host_page = nullptr;
+  };
+
   InterruptCode PickInterrupt(uint32_t interrupts);
+  // Fills in the host page table entry for the guest page.
+  void FillHostPageTableEntry(uint64_t page, HostPageTableEntry *entry);
+  // Returns true if memory protection permits direct reads and writes of the
+  // 'size' bytes at 'address'.
+  bool IsHostAccessAllowed(uint64_t address, int size);
+  // Translates the address of a direct host memory access using the data TLB.
+  // Returns false if the access has to go through LoadMemory/StoreMemory.
+  bool TranslateHostAddress(uint64_t *address);
   RiscVXlen xlen_;
   uint64_t max_physical_address_;
   RiscVVectorState *rv_vector_ = nullptr;
@@ -395,6 +590,14 @@ class RiscVState : public ArchState {
   int flen_ = 0;
   util::MemoryInterface *memory_ = nullptr;
   util::AtomicMemoryOpInterface *atomic_memory_ = nullptr;
+  // Scalar load contexts and store data buffers, indexed by log2 of the size.
+  LoadContext *scalar_load_context_[4] = {};
+  DataBuffer *scalar_store_db_[4] = {};
+  // Host memory used for direct accesses, the cached page translations, and
+  // the number of exclusions of each excluded page.
+  RiscVHostMemory *host_memory_ = nullptr;
+  HostPageTableEntry host_page_table_[kHostPageTableSize];
+  absl::flat_hash_map<uint64_t, int> host_page_exclusions_;
   RiscVCsrSet *csr_set_ = nullptr;
   std::vector<absl::AnyInvocable<bool(const Instruction *)>> on_ebreak_;
   absl::AnyInvocable<bool(const Instruction *)> on_ecall_;
@@ -403,20 +606,44 @@ class RiscVState : public ArchState {
       on_trap_;
   absl::AnyInvocable<bool(const Instruction *)> on_wfi_;
   absl::AnyInvocable<bool(const Instruction *)> on_cease_;
+  // The delay lines created by CreateAndAddDelayLine.
+  std::vector<std::unique_ptr<generic::DelayLineInterface>> owned_delay_lines_;
   std::vector<RiscVCsrInterface *> csr_vec_;
+  // Flags that the simulation loop checks after each instruction. They are
+  // bits in one atomic word, so that an interrupt made available from another
+  // thread never races with the branch flag, and all flags can be tested with
+  // a single load. Relaxed ordering suffices, as the flags only ask the
+  // simulation loop to take a slower path.
+  // Flag set on branch instructions.
+  static constexpr uint32_t kBranch = 1 << 0;
   // For interrupt handling.
-  bool is_interrupt_available_ = false;
+  static constexpr uint32_t kInterruptAvailable = 1 << 1;
+  // Set when decoded instructions may be stale.
+  static constexpr uint32_t kFetchTranslationChanged = 1 << 2;
+  inline void SetAttention(uint32_t flag, bool value) {
+    if (value) {
+      attention_.fetch_or(flag, std::memory_order_relaxed);
+    } else {
+      attention_.fetch_and(~flag, std::memory_order_relaxed);
+    }
+  }
+  inline bool HasAttention(uint32_t flag) const {
+    return (attention_.load(std::memory_order_relaxed) & flag) != 0;
+  }
+  std::atomic<uint32_t> attention_{0};
   InterruptCode available_interrupt_code_ = InterruptCode::kNone;
   // By default, execute in machine mode.
   PrivilegeMode privilege_mode_ = PrivilegeMode::kMachine;
-  // Flag set on branch instructions.
-  bool branch_ = false;
   // Handles to frequently used CSRs.
   RiscVMStatus *mstatus_ = nullptr;
   RiscVMIsa *misa_ = nullptr;
   RiscVMIp *mip_ = nullptr;
   RiscVMIe *mie_ = nullptr;
   RiscVPmp *pmp_ = nullptr;
+  bool memory_protection_ = false;
+  RiscVMmu *mmu_ = nullptr;
+  bool address_translation_ = false;
+  std::vector<FetchContextFilter> fetch_invalidations_;
   RiscVCsrInterface *jvt_ = nullptr;
   RiscVCsrInterface *mtvec_ = nullptr;
   RiscVCsrInterface *mepc_ = nullptr;
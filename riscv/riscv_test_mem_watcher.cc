@@ -27,7 +27,12 @@ namespace riscv {
 void RiscVTestMemWatcher::Load(uint64_t address, generic::DataBuffer *db,
                                generic::Instruction *inst,
                                generic::ReferenceCount *context) {
-  absl::StrAppend(&trace_str_, " mem 0x", absl::Hex(address, absl::kZeroPad16));
+  if (commit_trace_ != nullptr) {
+    commit_trace_->AddLoad(address);
+  } else {
+    absl::StrAppend(&trace_str_, " mem 0x",
+                    absl::Hex(address, absl::kZeroPad16));
+  }
   memory_->Load(address, db, inst, context);
 }
 
@@ -44,6 +49,30 @@ void RiscVTestMemWatcher::Load(generic::DataBuffer *address_db,
 }
 
 void RiscVTestMemWatcher::Store(uint64_t address, generic::DataBuffer *db) {
+  if (commit_trace_ != nullptr) {
+    int size = db->size<uint8_t>();
+    uint64_t value = 0;
+    switch (size) {
+      case 1:
+        value = db->Get<uint8_t>(0);
+        break;
+      case 2:
+        value = db->Get<uint16_t>(0);
+        break;
+      case 4:
+        value = db->Get<uint32_t>(0);
+        break;
+      case 8:
+        value = db->Get<uint64_t>(0);
+        break;
+      default:
+        size = 0;
+        break;
+    }
+    commit_trace_->AddStore(address, value, size);
+    memory_->Store(address, db);
+    return;
+  }
   absl::StrAppend(&trace_str_, " mem 0x", absl::Hex(address, absl::kZeroPad16));
   switch (db->size<uint8_t>()) {
     case 1:
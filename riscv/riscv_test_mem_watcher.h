@@ -18,6 +18,7 @@
 #include <string>
 
 #include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_commit_trace.h"
 
 namespace mpact {
 namespace sim {
@@ -31,6 +32,9 @@ namespace riscv {
 // in text form to the trace_string. This trace string can be read out and
 // and printed, and subsequently cleared at any time, though it is assumed that
 // this always occur at the end of the simulator cpu cycle.
+//
+// If a commit trace is set, scalar loads and stores are added to the commit
+// trace instead of the trace string.
 
 class RiscVTestMemWatcher : public util::MemoryInterface {
  public:
@@ -50,8 +54,13 @@ class RiscVTestMemWatcher : public util::MemoryInterface {
   const std::string &trace_str() const { return trace_str_; }
   void clear_trace_str() { trace_str_.clear(); }
 
+  void set_commit_trace(RiscVCommitTrace *commit_trace) {
+    commit_trace_ = commit_trace;
+  }
+
  private:
   util::MemoryInterface *memory_;
+  RiscVCommitTrace *commit_trace_ = nullptr;
   std::string trace_str_;
 };
 
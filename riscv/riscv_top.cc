@@ -15,8 +15,10 @@
 #include "riscv/riscv_top.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <new>
 #include <string>
 #include <thread>  // NOLINT: third_party code.
 #include <utility>
@@ -36,13 +38,15 @@
 #include "mpact/sim/generic/core_debug_interface.h"
 #include "mpact/sim/generic/counters.h"
 #include "mpact/sim/generic/data_buffer.h"
-#include "mpact/sim/generic/decode_cache.h"
 #include "mpact/sim/generic/decoder_interface.h"
 #include "riscv/riscv_action_point_memory_interface.h"
+#include "riscv/riscv_basic_block_cache.h"
 #include "riscv/riscv_counter_csr.h"
 #include "riscv/riscv_csr.h"
 #include "riscv/riscv_debug_interface.h"
+#include "riscv/riscv_decode_cache.h"
 #include "riscv/riscv_fp_state.h"
+#include "riscv/riscv_memory_watcher.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
 // Uncomment if using resource checks below.
@@ -89,43 +93,57 @@ RiscVTop::RiscVTop(std::string name, RiscVState *state,
       counter_num_instructions_("num_instructions", 0),
       counter_num_cycles_("num_cycles", 0),
       icache_config_("icache", ""),
-      dcache_config_("dcache", "") {
+      dcache_config_("dcache", ""),
+      decode_cache_config_("decode_cache", ""),
+      branch_trace_config_("branch_trace", false) {
   CHECK_OK(AddConfig(&icache_config_));
   icache_config_.AddValueWrittenCallback(
       [this]() { ConfigureCache(icache_, icache_config_); });
   CHECK_OK(AddConfig(&dcache_config_));
   dcache_config_.AddValueWrittenCallback(
       [this]() { ConfigureCache(dcache_, dcache_config_); });
+  CHECK_OK(AddConfig(&decode_cache_config_));
+  decode_cache_config_.AddValueWrittenCallback(
+      [this]() { ConfigureDecodeCache(); });
+  CHECK_OK(AddConfig(&branch_trace_config_));
   Initialize();
 }
 
 RiscVTop::~RiscVTop() {
-  // If the simulator is still running, request a halt (set halted_ to true),
-  // and wait until the simulator finishes before continuing the destructor.
-  if (run_status_ == RunStatus::kRunning) {
-    run_halted_->WaitForNotification();
-    delete run_halted_;
-    run_halted_ = nullptr;
-  }
+  // If the simulator is still running, wait until the simulator finishes
+  // before continuing the destructor.
+  (void)RiscVTop::Wait();
 
   if (branch_trace_db_ != nullptr) branch_trace_db_->DecRef();
 
+  ::operator delete[](opcode_counts_, std::align_val_t(kCacheLineSize));
   delete icache_;
   delete dcache_;
   if (inst_db_) inst_db_->DecRef();
   delete rv_breakpoint_manager_;
   delete rv_action_point_manager_;
   delete rv_action_point_memory_interface_;
+  delete rv_block_cache_;
   delete rv_decode_cache_;
+  delete rv_mmu_decoder_;
   delete memory_watcher_;
 }
 
 void RiscVTop::Initialize() {
   pc_ = state_->registers()->at(RiscVState::kPcName);
-  rv_decode_cache_ = generic::DecodeCache::Create({16 * 1024, 2}, rv_decoder_);
+  // The decode caches are indexed by virtual address, so the fetch address is
+  // translated before the instruction is decoded.
+  rv_mmu_decoder_ = new RiscVMmuDecoder(state_, rv_decoder_);
+  rv_decode_cache_ = new RiscVDecodeCache(rv_mmu_decoder_);
+  rv_block_cache_ = new RiscVBasicBlockCache();
+  // The caches start out in fetch context 0. Have the context of the state
+  // selected before the first fetch.
+  fetch_contexts_.push_back(0);
+  state_->set_fetch_translation_changed(true);
 
-  // Replace the memory with the memory watcher.
-  memory_watcher_ = new util::MemoryWatcher(state_->memory());
+  // Replace the memory with the memory watcher. Accesses to pages without
+  // watchpoints bypass the watch range lookup.
+  memory_watcher_ = new RiscVMemoryWatcher(state_->memory());
   state_->set_memory(memory_watcher_);
 
   // Register instruction and cycle counters.
@@ -133,16 +151,28 @@ void RiscVTop::Initialize() {
       << "Failed to register instruction counter";
   CHECK_OK(AddCounter(&counter_num_cycles_))
       << "Failed to register cycle counter";
+  // Register decode cache counters.
+  CHECK_OK(AddCounter(rv_decode_cache_->counter_hits()))
+      << "Failed to register decode cache hit counter";
+  CHECK_OK(AddCounter(rv_decode_cache_->counter_misses()))
+      << "Failed to register decode cache miss counter";
+  CHECK_OK(AddCounter(rv_decode_cache_->counter_evictions()))
+      << "Failed to register decode cache eviction counter";
   // Register opcode counters.
   int num_opcodes = rv_decoder_->GetNumOpcodes();
   counter_opcode_.resize(num_opcodes);
   for (int i = 0; i < num_opcodes; i++) {
-    counter_opcode_.push_back(generic::SimpleCounter<uint64_t>());
     counter_opcode_[i].Initialize(
         absl::StrCat("num_", rv_decoder_->GetOpcodeName(i)), 0);
     CHECK_OK(AddCounter(&counter_opcode_[i]))
         << "Failed to register opcode counter";
   }
+  // The opcode counts are accumulated in a flat cache line aligned array that
+  // is folded into the opcode counters when the core halts.
+  num_opcode_counts_ = num_opcodes;
+  opcode_counts_ = static_cast<uint64_t *>(::operator new[](
+      num_opcodes * sizeof(uint64_t), std::align_val_t(kCacheLineSize)));
+  std::memset(opcode_counts_, 0, num_opcodes * sizeof(uint64_t));
 
   // Connect counters to instret(h) and mcycle(h) CSRs.
   auto csr_res = state_->csr_set()->GetCsr("minstret");
@@ -168,6 +198,10 @@ void RiscVTop::Initialize() {
     auto *mcycleh =
         reinterpret_cast<RiscVCounterCsrHigh<RiscVState> *>(csr_res.value());
     mcycleh->set_counter(&counter_num_cycles_);
+    minstret->set_sync_fcn([this]() { FlushRetirementCounts(); });
+    minstreth->set_sync_fcn([this]() { FlushRetirementCounts(); });
+    mcycle->set_sync_fcn([this]() { FlushRetirementCounts(); });
+    mcycleh->set_sync_fcn([this]() { FlushRetirementCounts(); });
   } else {
     // Minstret/minstreth.
     auto *minstret = reinterpret_cast<RiscVCounterCsr<uint64_t, RiscVState> *>(
@@ -177,12 +211,13 @@ void RiscVTop::Initialize() {
     auto *mcycle = reinterpret_cast<RiscVCounterCsr<uint64_t, RiscVState> *>(
         csr_res.value());
     mcycle->set_counter(&counter_num_cycles_);
+    minstret->set_sync_fcn([this]() { FlushRetirementCounts(); });
+    mcycle->set_sync_fcn([this]() { FlushRetirementCounts(); });
   }
 
   // Set up break and action points.
   rv_action_point_memory_interface_ = new RiscVActionPointMemoryInterface(
-      state_->memory(),
-      absl::bind_front(&generic::DecodeCache::Invalidate, rv_decode_cache_));
+      state_->memory(), absl::bind_front(&RiscVTop::InvalidateDecode, this));
   rv_action_point_manager_ =
       new ActionPointManagerBase(rv_action_point_memory_interface_);
   rv_breakpoint_manager_ = new BreakpointManager(
@@ -227,6 +262,30 @@ void RiscVTop::ConfigureCache(Cache *&cache, Config<std::string> &config) {
   }
 }
 
+void RiscVTop::ConfigureDecodeCache() {
+  if (run_status_ != RunStatus::kHalted) {
+    LOG(WARNING) << "Decode cache can only be configured when halted - ignored";
+    return;
+  }
+  absl::Status status =
+      rv_decode_cache_->Configure(decode_cache_config_.GetValue());
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to configure decode cache: " << status.message();
+  }
+  // Configuring the decode cache releases the instructions of all fetch
+  // contexts, so only the selected context remains.
+  rv_block_cache_->InvalidateAll();
+  fetch_contexts_.assign(1, rv_decode_cache_->context());
+}
+
+void RiscVTop::set_commit_trace(RiscVCommitTrace *commit_trace) {
+  commit_trace_ = commit_trace;
+  rv_mmu_decoder_->set_inst_word_memory(
+      commit_trace != nullptr ? commit_trace->memory() : nullptr);
+  rv_decode_cache_->InvalidateAll();
+  rv_block_cache_->InvalidateAll();
+}
+
 absl::Status RiscVTop::Halt() {
   // If it is already halted, just return.
   if (run_status_ == RunStatus::kHalted) {
@@ -236,8 +295,7 @@ absl::Status RiscVTop::Halt() {
   if (run_status_ != RunStatus::kRunning) {
     return absl::FailedPreconditionError("RiscVTop::Halt: Core is not running");
   }
-  halt_reason_ = *HaltReason::kUserRequest;
-  halted_ = true;
+  halt_reason_.store(*HaltReason::kUserRequest, std::memory_order_release);
   return absl::OkStatus();
 }
 
@@ -253,10 +311,17 @@ absl::Status RiscVTop::Halt(HaltReasonValueType halt_reason) {
 
 absl::Status RiscVTop::StepPastBreakpoint() {
   uint64_t pc = state_->pc_operand()->AsUint64(0);
+  // If the breakpoint or action point was removed, or the pc was changed,
+  // since the halt, the instruction at the pc executes normally. Writing the
+  // breakpoint instruction back would re-insert a removed breakpoint.
+  if (!rv_action_point_manager_->IsActionPointActive(pc)) {
+    return absl::OkStatus();
+  }
   uint64_t bpt_pc = pc;
   // Disable the breakpoint.
   (void)rv_action_point_manager_->ap_memory_interface()
       ->WriteOriginalInstruction(pc);
+  HandleFetchTranslationChange();
   // Execute the real instruction.
   auto real_inst = rv_decode_cache_->GetDecodedInstruction(pc);
   real_inst->IncRef();
@@ -269,8 +334,11 @@ absl::Status RiscVTop::StepPastBreakpoint() {
     state_->AdvanceDelayLines();
   } while (!executed);
   // Increment counters.
-  counter_opcode_[real_inst->opcode()].Increment(1);
+  opcode_counts_[real_inst->opcode()]++;
   counter_num_instructions_.Increment(1);
+  if (commit_trace_ != nullptr) {
+    commit_trace_->Commit(real_inst, rv_mmu_decoder_->GetInstWord(real_inst));
+  }
   real_inst->DecRef();
   // Re-enable the breakpoint.
   (void)rv_action_point_manager_->ap_memory_interface()
@@ -293,20 +361,21 @@ absl::StatusOr<int> RiscVTop::Step(int num) {
   if (run_status_ != RunStatus::kHalted) {
     return absl::FailedPreconditionError("RiscVTop::Step: Core must be halted");
   }
-  run_status_ = RunStatus::kSingleStep;
+  run_status_.store(RunStatus::kSingleStep, std::memory_order_release);
   int count = 0;
-  halted_ = false;
-  halt_reason_ = *HaltReason::kNone;
+  halt_reason_.store(*HaltReason::kNone, std::memory_order_relaxed);
   // First check to see if the previous halt was due to a breakpoint. If so,
   // need to step over the breakpoint.
   if (need_to_step_over_) {
     need_to_step_over_ = false;
+    bool at_breakpoint = rv_action_point_manager_->IsActionPointActive(
+        state_->pc_operand()->AsUint64(0));
     auto status = StepPastBreakpoint();
     if (!status.ok()) {
-      run_status_ = RunStatus::kHalted;
+      run_status_.store(RunStatus::kHalted, std::memory_order_release);
       return status;
     }
-    count++;
+    if (at_breakpoint) count++;
   }
 
   // Step the simulator forward until the number of steps have been achieved, or
@@ -320,8 +389,9 @@ absl::StatusOr<int> RiscVTop::Step(int num) {
   // be executed.
   uint64_t next_pc = pc_operand->AsUint64(0);
   pc = next_pc;
-  while (!halted_ && (count < num)) {
+  while (!halted() && (count < num)) {
     SetPc(pc);
+    HandleFetchTranslationChange();
     auto *inst = rv_decode_cache_->GetDecodedInstruction(pc);
     // Set the next_pc to the next sequential instruction.
     next_pc = pc + inst->size();
@@ -331,55 +401,49 @@ absl::StatusOr<int> RiscVTop::Step(int num) {
       executed = ExecuteInstruction(inst);
       counter_num_cycles_.Increment(1);
       state_->AdvanceDelayLines();
-      // Check for interrupt.
-      if (state_->is_interrupt_available()) {
-        uint64_t epc = (executed ? state_->pc_operand()->AsUint64(0) : next_pc);
-        state_->TakeAvailableInterrupt(epc);
-      }
     } while (!executed);
     count++;
     // Update counters.
-    counter_opcode_[inst->opcode()].Increment(1);
+    opcode_counts_[inst->opcode()]++;
     counter_num_instructions_.Increment(1);
-    // Get the next pc value.
-    auto pc_val = state_->pc_operand()->AsUint64(0);
-    if (state_->branch()) {
-      state_->set_branch(false);
-      AddToBranchTrace(pc, pc_val);
-      next_pc = pc_val;
+    if (commit_trace_ != nullptr) {
+      commit_trace_->Commit(inst, rv_mmu_decoder_->GetInstWord(inst));
     }
-    if (!halted_) {
+    // Resolve the next pc value and take any pending interrupt.
+    if (state_->needs_attention()) HandleAttention(pc, next_pc);
+    if (!halted()) {
       pc = next_pc;
       continue;
     }
     // If it's an action point, just step over and continue.
-    if (halt_reason_ == *HaltReason::kActionPoint) {
+    if (halt_reason_.load(std::memory_order_acquire) ==
+        *HaltReason::kActionPoint) {
       auto status = StepPastBreakpoint();
       if (!status.ok()) {
-        run_status_ = RunStatus::kHalted;
+        run_status_.store(RunStatus::kHalted, std::memory_order_release);
         return status;
       }
-      // Reset the halt reason and continue;
-      halted_ = false;
-      halt_reason_ = *HaltReason::kNone;
       need_to_step_over_ = false;
-      continue;
+      pc = pc_operand->AsUint64(0);
+      next_pc = pc;
+      // Reset the halt reason and continue, unless another halt was requested
+      // in the meantime.
+      if (ClearHaltReason(*HaltReason::kActionPoint)) continue;
     }
     break;
   }
   // Update the pc register, now that it can be read.
-  if (halt_reason_ == *HaltReason::kSoftwareBreakpoint) {
-    // If at a breakpoint, keep the pc at the current value.
+  if (need_to_step_over_) {
+    // If at a breakpoint or action point, keep the pc at the current value,
+    // as its instruction is stepped over when execution resumes. This also
+    // applies if another halt request replaced the halt reason.
     SetPc(pc);
   } else {
     // Otherwise set it to point to the next instruction.
     SetPc(next_pc);
   }
-  // If there is no halt request, there is no specific halt reason.
-  if (!halted_) {
-    halt_reason_ = *HaltReason::kNone;
-  }
-  run_status_ = RunStatus::kHalted;
+  FoldOpcodeCounts();
+  run_status_.store(RunStatus::kHalted, std::memory_order_release);
   return count;
 }
 
@@ -389,6 +453,8 @@ absl::Status RiscVTop::Run() {
     return absl::FailedPreconditionError(
         "RiscVTop::Run: core is already running");
   }
+  // Release the notification of a previous run that was not waited for.
+  (void)Wait();
   // First check to see if the previous halt was due to a breakpoint. If so,
   // need to step over the breakpoint.
   if (need_to_step_over_) {
@@ -403,9 +469,8 @@ absl::Status RiscVTop::Run() {
   run_started_ = new absl::Notification();
   // The thread is detached so it executes without having to be joined.
   std::thread([this]() {
-    run_status_ = RunStatus::kRunning;
-    halted_ = false;
-    halt_reason_ = *HaltReason::kNone;
+    halt_reason_.store(*HaltReason::kNone, std::memory_order_relaxed);
+    run_status_.store(RunStatus::kRunning, std::memory_order_release);
     run_started_->Notify();
     auto pc_operand = state_->pc_operand();
     // At the top of the loop this holds the address of the instruction to be
@@ -415,63 +480,45 @@ absl::Status RiscVTop::Run() {
     // This holds the value of the current pc, and post-loop, the address of
     // the most recently executed instruction.
     uint64_t pc = next_pc;
-    while (!halted_) {
-      auto *inst = rv_decode_cache_->GetDecodedInstruction(pc);
-      SetPc(pc);
-      next_pc = pc + inst->size();
-      bool executed = false;
-      if (icache_) ICacheFetch(pc);
-      do {
-        // Try executing the instruction. If it fails, advance a cycle
-        // and try again.
-        executed = ExecuteInstruction(inst);
-        counter_num_cycles_.Increment(1);
-        state_->AdvanceDelayLines();
-        // Check for interrupt.
-        if (state_->is_interrupt_available()) {
-          uint64_t epc = (executed ? state_->pc_operand()->AsUint64(0) : pc);
-          state_->TakeAvailableInterrupt(epc);
-        }
-      } while (!executed);
-      // Update counters.
-      counter_opcode_[inst->opcode()].Increment(1);
-      counter_num_instructions_.Increment(1);
-      // Get the next pc value.
-      uint64_t pc_val = pc_operand->AsUint64(0);
-      if (state_->branch()) {
-        state_->set_branch(false);
-        AddToBranchTrace(pc, pc_val);
-        next_pc = pc_val;
-      }
-      if (!halted_) {
-        pc = next_pc;
-        continue;
-      }
+    while (true) {
+      // Select the run loop specialization for the features that are active.
+      // This is done again after each action point, as actions may change
+      // which features are active.
+      RunBlocksFcn run_blocks = SelectRunBlocks();
+      (this->*run_blocks)(pc, next_pc);
+      FoldOpcodeCounts();
       // If it's an action point, just step over and continue executing, as
       // this is not a full breakpoint.
-      if (halt_reason_ == *HaltReason::kActionPoint) {
+      if (halt_reason_.load(std::memory_order_acquire) ==
+          *HaltReason::kActionPoint) {
         auto status = StepPastBreakpoint();
         if (!status.ok()) {
           // If there is an error, signal a simulator error.
-          halt_reason_ = *HaltReason::kSimulatorError;
+          halt_reason_.store(*HaltReason::kSimulatorError,
+                             std::memory_order_relaxed);
           break;
         };
-        // Reset the halt reason and continue;
-        halted_ = false;
-        halt_reason_ = *HaltReason::kNone;
-        continue;
+        need_to_step_over_ = false;
+        pc = pc_operand->AsUint64(0);
+        next_pc = pc;
+        // Reset the halt reason and continue from the instruction following
+        // the action point, unless another halt was requested in the
+        // meantime.
+        if (ClearHaltReason(*HaltReason::kActionPoint)) continue;
       }
       break;
     }
     // Update the pc register, now that it can be read.
-    if (halt_reason_ == *HaltReason::kSoftwareBreakpoint) {
-      // If at a breakpoint, keep the pc at the current value.
+    if (need_to_step_over_) {
+      // If at a breakpoint or action point, keep the pc at the current value,
+      // as its instruction is stepped over when execution resumes. This also
+      // applies if another halt request replaced the halt reason.
       SetPc(pc);
     } else {
       // Otherwise set it to point to the next instruction.
       SetPc(next_pc);
     }
-    run_status_ = RunStatus::kHalted;
+    run_status_.store(RunStatus::kHalted, std::memory_order_release);
     // Notify that the run has completed.
     run_halted_->Notify();
   }).detach();
@@ -482,15 +529,11 @@ absl::Status RiscVTop::Run() {
 }
 
 absl::Status RiscVTop::Wait() {
-  // If the simulator isn't running, then just return after deleting
-  // the notification object.
-  if (run_status_ != RunStatus::kRunning) {
-    delete run_halted_;
-    run_halted_ = nullptr;
-    return absl::OkStatus();
-  }
-
+  // If the simulator wasn't started by Run, then just return.
+  if (run_halted_ == nullptr) return absl::OkStatus();
   // Wait for the simulator to finish - i.e., a notification on run_halted_.
+  // This is done even if the run status is already halted, as the simulator
+  // thread notifies run_halted_ after setting the run status.
   run_halted_->WaitForNotification();
   // Now delete the notification object - it is single use only.
   delete run_halted_;
@@ -499,11 +542,11 @@ absl::Status RiscVTop::Wait() {
 }
 
 absl::StatusOr<RiscVTop::RunStatus> RiscVTop::GetRunStatus() {
-  return run_status_;
+  return run_status_.load(std::memory_order_acquire);
 }
 
 absl::StatusOr<RiscVTop::HaltReasonValueType> RiscVTop::GetLastHaltReason() {
-  return halt_reason_;
+  return halt_reason_.load(std::memory_order_acquire);
 }
 
 absl::StatusOr<uint64_t> RiscVTop::ReadRegister(const std::string &name) {
@@ -514,8 +557,14 @@ absl::StatusOr<uint64_t> RiscVTop::ReadRegister(const std::string &name) {
     auto result = state_->csr_set()->GetCsr(name);
     if (!result.ok()) {
       // See if it is $branch_trace_head.
-      if (name == "$branch_trace_head") return branch_trace_head_;
-      if (name == "$branch_trace_size") return branch_trace_size_;
+      if (name == "$branch_trace_head") {
+        branch_trace_requested_ = true;
+        return branch_trace_head_;
+      }
+      if (name == "$branch_trace_size") {
+        branch_trace_requested_ = true;
+        return branch_trace_size_;
+      }
       return absl::NotFoundError(
           absl::StrCat("Register '", name, "' not found"));
     }
@@ -564,6 +613,7 @@ absl::Status RiscVTop::WriteRegister(const std::string &name, uint64_t value) {
     auto result = state_->csr_set()->GetCsr(name);
     if (!result.ok()) {
       if (name == "$branch_trace_size") {
+        branch_trace_requested_ = true;
         return ResizeBranchTrace(value);
       }
       return absl::NotFoundError(
@@ -585,8 +635,8 @@ absl::Status RiscVTop::WriteRegister(const std::string &name, uint64_t value) {
 
   // If stopped at a software breakpoint and the pc is changed, change the
   // halt reason, since the next instruction won't be were we stopped.
-  if ((name == "pc") && (halt_reason_ == *HaltReason::kSoftwareBreakpoint)) {
-    halt_reason_ = *HaltReason::kNone;
+  if (name == "pc") {
+    ClearHaltReason(*HaltReason::kSoftwareBreakpoint);
   }
 
   auto *db = (iter->second)->data_buffer();
@@ -617,7 +667,10 @@ absl::StatusOr<DataBuffer *> RiscVTop::GetRegisterDataBuffer(
     return absl::FailedPreconditionError(
         "GetRegisterDataBuffer: Core must be halted");
   }
-  if (name == "$branch_trace") return branch_trace_db_;
+  if (name == "$branch_trace") {
+    branch_trace_requested_ = true;
+    return branch_trace_db_;
+  }
   auto iter = state_->registers()->find(name);
   if (iter == state_->registers()->end()) {
     return absl::NotFoundError(absl::StrCat("Register '", name, "' not found"));
@@ -767,6 +820,17 @@ absl::Status RiscVTop::SetDataWatchpoint(uint64_t address, size_t length,
       return wr_memory_status;
     }
   }
+  // Watched memory has to be accessed through the memory watcher.
+  if ((access_type == AccessType::kLoad) ||
+      (access_type == AccessType::kLoadStore)) {
+    load_watchpoint_length_[address] = length;
+    state_->DisableHostMemoryAccess(address, length);
+  }
+  if ((access_type == AccessType::kStore) ||
+      (access_type == AccessType::kLoadStore)) {
+    store_watchpoint_length_[address] = length;
+    state_->DisableHostMemoryAccess(address, length);
+  }
   return absl::OkStatus();
 }
 
@@ -776,11 +840,15 @@ absl::Status RiscVTop::ClearDataWatchpoint(uint64_t address,
       (access_type == AccessType::kLoadStore)) {
     auto rd_memory_status = memory_watcher_->ClearLoadWatchCallback(address);
     if (!rd_memory_status.ok()) return rd_memory_status;
+    auto node = load_watchpoint_length_.extract(address);
+    if (!node.empty()) state_->EnableHostMemoryAccess(address, node.mapped());
   }
   if ((access_type == AccessType::kStore) ||
       (access_type == AccessType::kLoadStore)) {
     auto wr_memory_status = memory_watcher_->ClearStoreWatchCallback(address);
     if (!wr_memory_status.ok()) return wr_memory_status;
+    auto node = store_watchpoint_length_.extract(address);
+    if (!node.empty()) state_->EnableHostMemoryAccess(address, node.mapped());
   }
   return absl::OkStatus();
 }
@@ -820,21 +888,235 @@ absl::StatusOr<std::string> RiscVTop::GetDisassembly(uint64_t address) {
 
 void RiscVTop::RequestHalt(HaltReasonValueType halt_reason,
                            const Instruction *inst) {
-  // First set the halt_reason_, then the halt flag.
-  halt_reason_ = halt_reason;
-  halted_ = true;
   // If the halt reason is either sw breakpoint or action point, set
-  // need_to_step_over to true.
-  if ((halt_reason_ == *HaltReason::kSoftwareBreakpoint) ||
-      (halt_reason_ == *HaltReason::kActionPoint)) {
+  // need_to_step_over to true. These are only requested by the simulation
+  // thread itself.
+  if ((halt_reason == *HaltReason::kSoftwareBreakpoint) ||
+      (halt_reason == *HaltReason::kActionPoint)) {
     need_to_step_over_ = true;
   }
+  // Publishing the halt reason is the halt request. The action point halt
+  // reason is cleared once the actions are performed, so it must not replace
+  // a pending halt request, e.g., from Halt().
+  if (halt_reason == *HaltReason::kActionPoint) {
+    HaltReasonValueType expected = *HaltReason::kNone;
+    halt_reason_.compare_exchange_strong(expected, halt_reason,
+                                         std::memory_order_acq_rel);
+    return;
+  }
+  halt_reason_.store(halt_reason, std::memory_order_release);
 }
 
 void RiscVTop::RequestHalt(HaltReason halt_reason, const Instruction *inst) {
   RequestHalt(*halt_reason, inst);
 }
 
+bool RiscVTop::ClearHaltReason(HaltReasonValueType halt_reason) {
+  return halt_reason_.compare_exchange_strong(halt_reason, *HaltReason::kNone,
+                                              std::memory_order_acq_rel);
+}
+
+void RiscVTop::InvalidateDecode(uint64_t address) {
+  rv_decode_cache_->Invalidate(address);
+  rv_block_cache_->Invalidate(address);
+  // This may be called from an action while a block is executing. Leave the
+  // block, so that the removed blocks are freed at the next block boundary.
+  state_->set_fetch_translation_changed(true);
+}
+
+bool RiscVTop::HandleFetchTranslationChange() {
+  if (!state_->fetch_translation_changed()) return false;
+  state_->set_fetch_translation_changed(false);
+  for (const auto &filter : state_->fetch_invalidations()) {
+    for (uint64_t context : fetch_contexts_) {
+      if ((context & filter.mask) != filter.value) continue;
+      rv_decode_cache_->InvalidateContext(context);
+      rv_block_cache_->InvalidateContext(context);
+    }
+  }
+  state_->clear_fetch_invalidations();
+  uint64_t context = state_->fetch_context();
+  auto it = std::find(fetch_contexts_.begin(), fetch_contexts_.end(), context);
+  if (it != fetch_contexts_.end()) {
+    std::rotate(fetch_contexts_.begin(), it, it + 1);
+  } else {
+    fetch_contexts_.insert(fetch_contexts_.begin(), context);
+    if (static_cast<int>(fetch_contexts_.size()) > kMaxFetchContexts) {
+      rv_decode_cache_->InvalidateContext(fetch_contexts_.back());
+      rv_block_cache_->InvalidateContext(fetch_contexts_.back());
+      fetch_contexts_.pop_back();
+    }
+  }
+  rv_decode_cache_->SelectContext(context);
+  rv_block_cache_->SelectContext(context);
+  // No block is executing, and the caller releases its reference to the
+  // previous block, so the removed blocks can be deleted.
+  rv_block_cache_->FreeStaleBlocks();
+  return true;
+}
+
+RiscVTop::RunBlocksFcn RiscVTop::SelectRunBlocks() {
+  // Table of run loop specializations indexed by the active features.
+  static constexpr RunBlocksFcn kRunBlocks[] = {
+      &RiscVTop::RunBlocks<false, false, false, false>,
+      &RiscVTop::RunBlocks<false, false, true, false>,
+      &RiscVTop::RunBlocks<false, true, false, false>,
+      &RiscVTop::RunBlocks<false, true, true, false>,
+      &RiscVTop::RunBlocks<true, false, false, false>,
+      &RiscVTop::RunBlocks<true, false, true, false>,
+      &RiscVTop::RunBlocks<true, true, false, false>,
+      &RiscVTop::RunBlocks<true, true, true, false>,
+      &RiscVTop::RunBlocks<false, false, false, true>,
+      &RiscVTop::RunBlocks<false, false, true, true>,
+      &RiscVTop::RunBlocks<false, true, false, true>,
+      &RiscVTop::RunBlocks<false, true, true, true>,
+      &RiscVTop::RunBlocks<true, false, false, true>,
+      &RiscVTop::RunBlocks<true, false, true, true>,
+      &RiscVTop::RunBlocks<true, true, false, true>,
+      &RiscVTop::RunBlocks<true, true, true, true>,
+  };
+  bool cache_model = (icache_ != nullptr) || (dcache_ != nullptr);
+  int index = (commit_trace_ != nullptr ? 0b1000 : 0) |
+              (cache_model ? 0b100 : 0) |
+              (counter_num_instructions_.IsEnabled() ? 0b010 : 0) |
+              (branch_trace_enabled() ? 0b001 : 0);
+  return kRunBlocks[index];
+}
+
+template <bool kCacheModel, bool kOpcodeStats, bool kBranchTrace,
+          bool kCommitTrace>
+void RiscVTop::RunBlocks(uint64_t &pc, uint64_t &next_pc) {
+  // The most recently executed block, used to chain to its successor.
+  RiscVBasicBlock *prev_block = nullptr;
+  while (!halted()) {
+    // The previous block is released if the decoded instructions are
+    // discarded.
+    if (HandleFetchTranslationChange()) prev_block = nullptr;
+    RiscVBasicBlock *block = nullptr;
+    if (prev_block != nullptr) {
+      block = prev_block->GetSuccessor(pc);
+      if (block == nullptr) {
+        block = rv_block_cache_->GetBlock(pc);
+        if (block != nullptr) rv_block_cache_->Link(prev_block, pc, block);
+      }
+    } else {
+      block = rv_block_cache_->GetBlock(pc);
+    }
+    if (block == nullptr) {
+      // There is no translated block at this address. Execute instructions
+      // one at a time from the decode cache, recording them into a new
+      // block, until the flow of control leaves the sequential path.
+      rv_block_cache_->StartRecording();
+      while (true) {
+        auto *inst = rv_decode_cache_->GetDecodedInstruction(pc);
+        bool has_room = rv_block_cache_->Record(inst);
+        bool branch = ExecuteRunInstruction<kCacheModel, kOpcodeStats,
+                                            kBranchTrace, kCommitTrace>(
+            inst, next_pc);
+        if (branch || halted() || !has_room) break;
+        pc = next_pc;
+      }
+      block = rv_block_cache_->FinishRecording();
+      if ((prev_block != nullptr) && (block != nullptr)) {
+        rv_block_cache_->Link(prev_block, block->start_address, block);
+      }
+    } else {
+      // Execute the translated block. Leave the block early if an
+      // instruction changes the flow of control, makes an interrupt
+      // available, or requests a halt.
+      for (auto *inst : block->instructions) {
+        pc = inst->address();
+        if (ExecuteRunInstruction<kCacheModel, kOpcodeStats, kBranchTrace,
+                                  kCommitTrace>(inst, next_pc) ||
+            halted()) {
+          break;
+        }
+      }
+    }
+    prev_block = block;
+    // Bring the counters up to date at the end of each block, so that any
+    // listeners (e.g., timers) see a timely value.
+    FlushRetirementCounts();
+    if (halted()) return;
+    // Interrupts are only taken at block boundaries.
+    TakePendingInterrupt<kBranchTrace>(pc, next_pc);
+    pc = next_pc;
+  }
+}
+
+template <bool kCacheModel, bool kOpcodeStats, bool kBranchTrace,
+          bool kCommitTrace>
+bool RiscVTop::ExecuteRunInstruction(Instruction *inst, uint64_t &next_pc) {
+  uint64_t pc = inst->address();
+  SetPc(pc);
+  next_pc = pc + inst->size();
+  bool executed = false;
+  if constexpr (kCacheModel) {
+    // The cache models use the cycle counter, so keep it up to date.
+    FlushRetirementCounts();
+    if (icache_) ICacheFetch(pc);
+  }
+  do {
+    // Try executing the instruction. If it fails, advance a cycle
+    // and try again.
+    executed = ExecuteInstruction(inst);
+    pending_cycles_++;
+    state_->AdvanceDelayLines();
+  } while (!executed);
+  // Update counters.
+  if constexpr (kOpcodeStats) opcode_counts_[inst->opcode()]++;
+  pending_instructions_++;
+  if constexpr (kCommitTrace) {
+    commit_trace_->Commit(inst, rv_mmu_decoder_->GetInstWord(inst));
+  }
+  // Reaching the next counter listener deadline ends the block, so that the
+  // counts are added to the counters at the end of the block.
+  bool deadline = pending_cycles_ >= cycles_to_deadline_;
+  // A single check covers a change in control flow, a pending interrupt, and
+  // a change in the translation of instruction fetches. Any of them ends the
+  // block.
+  if (!state_->needs_attention()) return deadline;
+  if (state_->branch()) {
+    state_->set_branch(false);
+    uint64_t pc_val = state_->pc_operand()->AsUint64(0);
+    if constexpr (kBranchTrace) AddToBranchTrace(pc, pc_val);
+    next_pc = pc_val;
+  }
+  return true;
+}
+
+void RiscVTop::HandleAttention(uint64_t pc, uint64_t &next_pc) {
+  if (state_->branch()) {
+    state_->set_branch(false);
+    uint64_t pc_val = state_->pc_operand()->AsUint64(0);
+    AddToBranchTrace(pc, pc_val);
+    next_pc = pc_val;
+  }
+  TakePendingInterrupt</*kBranchTrace*/ true>(pc, next_pc);
+}
+
+template <bool kBranchTrace>
+void RiscVTop::TakePendingInterrupt(uint64_t pc, uint64_t &next_pc) {
+  if (!state_->is_interrupt_available()) return;
+  // The most recent instruction has completed, so the interrupt is taken
+  // precisely at the instruction that would have executed next.
+  state_->TakeAvailableInterrupt(next_pc);
+  if (!state_->branch()) return;
+  state_->set_branch(false);
+  uint64_t pc_val = state_->pc_operand()->AsUint64(0);
+  if constexpr (kBranchTrace) AddToBranchTrace(pc, pc_val);
+  next_pc = pc_val;
+}
+
+void RiscVTop::FoldOpcodeCounts() {
+  for (int i = 0; i < num_opcode_counts_; i++) {
+    if (opcode_counts_[i] == 0) continue;
+    counter_opcode_[i].Increment(opcode_counts_[i]);
+    opcode_counts_[i] = 0;
+  }
+  rv_decode_cache_->FlushHits();
+}
+
 void RiscVTop::SetPc(uint64_t value) {
   if (pc_->data_buffer()->size<uint8_t>() == 4) {
     pc_->data_buffer()->Set<uint32_t>(0, static_cast<uint32_t>(value));
@@ -16,9 +16,12 @@
 #define MPACT_RISCV_RISCV_RISCV_TOP_H_
 
 // #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
@@ -33,15 +36,18 @@
 #include "mpact/sim/generic/core_debug_interface.h"
 #include "mpact/sim/generic/counters.h"
 #include "mpact/sim/generic/data_buffer.h"
-#include "mpact/sim/generic/decode_cache.h"
 #include "mpact/sim/generic/decoder_interface.h"
 #include "mpact/sim/generic/register.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "mpact/sim/util/memory/cache.h"
-#include "mpact/sim/util/memory/memory_watcher.h"
 #include "riscv/riscv_action_point_memory_interface.h"
+#include "riscv/riscv_basic_block_cache.h"
+#include "riscv/riscv_commit_trace.h"
 #include "riscv/riscv_debug_interface.h"
+#include "riscv/riscv_decode_cache.h"
 #include "riscv/riscv_fp_state.h"
+#include "riscv/riscv_memory_watcher.h"
+#include "riscv/riscv_mmu.h"
 #include "riscv/riscv_state.h"
 
 namespace mpact {
@@ -136,6 +142,19 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   // Accessors.
   RiscVState *state() const { return state_; }
 
+  // Sets the function that returns the number of cycles until the next
+  // deadline of a listener of the cycle or instruction counter, e.g.,
+  // RiscVClint::TicksToDeadline. The run loop adds its locally counted cycles
+  // and instructions to the counters once the deadline is reached, so that
+  // the listener acts on the exact cycle. The function is called each time
+  // the counts are added to the counters.
+  void set_counter_deadline_fcn(absl::AnyInvocable<uint64_t()> fcn) {
+    counter_deadline_fcn_ = std::move(fcn);
+    cycles_to_deadline_ = counter_deadline_fcn_ == nullptr
+                              ? std::numeric_limits<uint64_t>::max()
+                              : counter_deadline_fcn_();
+  }
+
   // The following are not const as callers may need to call non-const methods
   // of the counter.
   generic::SimpleCounter<uint64_t> *counter_num_instructions() {
@@ -146,7 +165,7 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   }
   generic::SimpleCounter<uint64_t> *counter_pc() { return &counter_pc_; }
   // Memory watchers used for data watch points.
-  util::MemoryWatcher *memory_watcher() { return memory_watcher_; }
+  RiscVMemoryWatcher *memory_watcher() { return memory_watcher_; }
 
   const std::string &halt_string() const { return halt_string_; }
   void set_halt_string(std::string halt_string) { halt_string_ = halt_string; }
@@ -154,13 +173,90 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   Cache *icache() const { return icache_; }
   Cache *dcache() const { return dcache_; }
 
+  // When set, each retired instruction is recorded in the commit trace. The
+  // commit trace is not owned by the top. The raw instruction words are read
+  // from the memory of the commit trace when the instructions are decoded, so
+  // the decoded instructions are discarded.
+  void set_commit_trace(RiscVCommitTrace *commit_trace);
+
  private:
   // Initialize the top.
   void Initialize();
   // Configure cache helper method.
   void ConfigureCache(Cache *&cache, Config<std::string> &config);
-  // Helper method to step past a breakpoint.
+  // Configure the decode cache from the decode_cache config.
+  void ConfigureDecodeCache();
+  // Helper method to step past the breakpoint or action point at the pc, if
+  // it is still active.
   absl::Status StepPastBreakpoint();
+  // Invalidate the decoding of the instruction at the given address. The run
+  // loop leaves the current block, as it may have been removed.
+  void InvalidateDecode(uint64_t address);
+  // If the fetch context may have changed, or fetch contexts were
+  // invalidated, discards the decoded instructions and translated blocks of
+  // the invalidated contexts, selects those of the current context, deletes
+  // the removed blocks, and returns true. This must only be called between
+  // blocks, and the caller must drop any pointer to a translated block.
+  bool HandleFetchTranslationChange();
+  // The run loop executes translated blocks until a halt is requested. It is
+  // specialized on which optional features are active (cache models, opcode
+  // statistics, branch trace, and commit trace), so that features that are not
+  // in use cost nothing. On return, pc holds the address of the most recently
+  // executed instruction, and next_pc the address of the next instruction.
+  using RunBlocksFcn = void (RiscVTop::*)(uint64_t &, uint64_t &);
+  RunBlocksFcn SelectRunBlocks();
+  template <bool kCacheModel, bool kOpcodeStats, bool kBranchTrace,
+            bool kCommitTrace>
+  void RunBlocks(uint64_t &pc, uint64_t &next_pc);
+  // Execute an instruction from the run loop and update the counters. Returns
+  // true if the instruction changed the flow of control or the translation of
+  // instruction fetches, or an interrupt became available, in which case the
+  // current block should be exited. next_pc is
+  // set to the new pc value on a change in control flow, otherwise to the
+  // address of the next sequential instruction.
+  template <bool kCacheModel, bool kOpcodeStats, bool kBranchTrace,
+            bool kCommitTrace>
+  bool ExecuteRunInstruction(Instruction *inst, uint64_t &next_pc);
+  // Resolves next_pc after the instruction at pc changed the flow of control,
+  // and takes any pending interrupt. Used when single stepping.
+  void HandleAttention(uint64_t pc, uint64_t &next_pc);
+  // Takes the pending interrupt, if any, once the instruction at pc has
+  // completed. The interrupt epc is next_pc, which is then updated to the
+  // trap handler address. The branch to the handler is added to the branch
+  // trace if kBranchTrace is true.
+  template <bool kBranchTrace>
+  void TakePendingInterrupt(uint64_t pc, uint64_t &next_pc);
+  // The run loop records the branch trace if the branch_trace config is set,
+  // or once the branch trace has been accessed through the debug interface.
+  bool branch_trace_enabled() {
+    return branch_trace_config_.GetValue() || branch_trace_requested_;
+  }
+  // The run loop counts retired instructions and cycles locally. This adds
+  // the pending counts to the instruction and cycle counters.
+  inline void FlushRetirementCounts() {
+    if (pending_cycles_ != 0) {
+      counter_num_cycles_.Increment(pending_cycles_);
+      pending_cycles_ = 0;
+    }
+    if (pending_instructions_ != 0) {
+      counter_num_instructions_.Increment(pending_instructions_);
+      pending_instructions_ = 0;
+    }
+    if (counter_deadline_fcn_ != nullptr) {
+      cycles_to_deadline_ = counter_deadline_fcn_();
+    }
+  }
+  // Adds the accumulated opcode counts to the opcode counters, and the decode
+  // cache hits to the hit counter.
+  void FoldOpcodeCounts();
+  // Returns true if there is a pending halt request. This is checked on the
+  // fast path of the simulation loops, so it uses a relaxed load.
+  inline bool halted() const {
+    return halt_reason_.load(std::memory_order_relaxed) != *HaltReason::kNone;
+  }
+  // Clears the given halt reason, unless it was replaced by a new halt
+  // request. Returns true if the halt request was cleared.
+  bool ClearHaltReason(HaltReasonValueType halt_reason);
   // Set the pc value.
   void SetPc(uint64_t value);
   void ICacheFetch(uint64_t address);
@@ -169,11 +265,18 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
 
   // The DB factory is used to manage data buffers for memory read/writes.
   generic::DataBufferFactory db_factory_;
-  // Current status and last halt reasons.
-  RunStatus run_status_ = RunStatus::kHalted;
-  HaltReasonValueType halt_reason_ = *HaltReason::kNone;
-  // Halting flag. This is set to true when execution must halt.
-  bool halted_ = false;
+  // Current run status. It is written by the thread that executes the
+  // simulation, and read by the controlling threads.
+  std::atomic<RunStatus> run_status_ = RunStatus::kHalted;
+  // The halt request and the last halt reason. Any thread (including signal
+  // handlers) may request a halt by storing a reason other than kNone. The
+  // simulation loop polls it with relaxed loads, and halts as soon as it sees
+  // a reason other than kNone. It is only reset to kNone by the simulation
+  // thread, using a compare and exchange so that a concurrent request is not
+  // lost.
+  std::atomic<HaltReasonValueType> halt_reason_ = *HaltReason::kNone;
+  static_assert(std::atomic<HaltReasonValueType>::is_always_lock_free);
+  static_assert(std::atomic<RunStatus>::is_always_lock_free);
   // Set to true if the next instruction requires a step-over.
   bool need_to_step_over_ = false;
   absl::Notification *run_halted_ = nullptr;
@@ -192,9 +295,23 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   generic::RegisterBase *pc_;
   // RiscV32 decoder instance.
   generic::DecoderInterface *rv_decoder_ = nullptr;
+  // Decoder that translates the fetch addresses for the decoder instance.
+  RiscVMmuDecoder *rv_mmu_decoder_ = nullptr;
   // Decode cache, memory and memory watcher.
-  generic::DecodeCache *rv_decode_cache_ = nullptr;
-  util::MemoryWatcher *memory_watcher_ = nullptr;
+  RiscVDecodeCache *rv_decode_cache_ = nullptr;
+  // Cache of translated blocks used by the run loop.
+  RiscVBasicBlockCache *rv_block_cache_ = nullptr;
+  // The fetch contexts that the decode and block caches hold instructions
+  // for, most recently selected first. The least recently selected context is
+  // discarded when there are more than kMaxFetchContexts.
+  static constexpr int kMaxFetchContexts = 16;
+  std::vector<uint64_t> fetch_contexts_;
+  RiscVMemoryWatcher *memory_watcher_ = nullptr;
+  // Lengths of the load and store data watchpoints, by start address. These
+  // are needed to allow direct host memory access to the watched memory again
+  // when a watchpoint is cleared.
+  absl::flat_hash_map<uint64_t, size_t> load_watchpoint_length_;
+  absl::flat_hash_map<uint64_t, size_t> store_watchpoint_length_;
   // Branch trace info - uses a circular buffer. The size is defined by the
   // constant kBranchTraceSize in the .cc file.
   BranchTraceEntry *branch_trace_;
@@ -206,10 +323,26 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   int branch_trace_head_ = 0;
   int branch_trace_mask_ = kBranchTraceSize - 1;
   int branch_trace_size_ = kBranchTraceSize;
+  // True once the branch trace has been accessed through the debug interface.
+  bool branch_trace_requested_ = false;
   // Counter for the number of instructions simulated.
   std::vector<generic::SimpleCounter<uint64_t>> counter_opcode_;
+  // Per-opcode execution counts accumulated by the simulation loops, indexed
+  // by opcode. The array is cache line aligned.
+  static constexpr size_t kCacheLineSize = 64;
+  uint64_t *opcode_counts_ = nullptr;
+  int num_opcode_counts_ = 0;
   generic::SimpleCounter<uint64_t> counter_num_instructions_;
   generic::SimpleCounter<uint64_t> counter_num_cycles_;
+  // Instructions and cycles counted by the run loop, but not yet added to the
+  // above counters.
+  uint64_t pending_instructions_ = 0;
+  uint64_t pending_cycles_ = 0;
+  // The run loop leaves the current block once pending_cycles_ reaches this
+  // value, so that the counts are added to the counters in time for the next
+  // listener deadline.
+  absl::AnyInvocable<uint64_t()> counter_deadline_fcn_;
+  uint64_t cycles_to_deadline_ = std::numeric_limits<uint64_t>::max();
   // Counter used for profiling by connecting it to a profiler. This allows
   // the pc to be written to the counter, and the profiling can be enabled/
   // disabled with the other counters.
@@ -218,6 +351,13 @@ class RiscVTop : public generic::Component, public RiscVDebugInterface {
   // Configuration items.
   Config<std::string> icache_config_;
   Config<std::string> dcache_config_;
+  // Decode cache organization, see riscv_decode_cache.h.
+  Config<std::string> decode_cache_config_;
+  // When true, the run loop records the branch trace. It is off by default, as
+  // it adds work to every taken branch.
+  Config<bool> branch_trace_config_;
+  // Commit trace, or nullptr.
+  RiscVCommitTrace *commit_trace_ = nullptr;
   // ICache & DCache.
   Cache *dcache_ = nullptr;
   Cache *icache_ = nullptr;
@@ -16,7 +16,6 @@
 
 #include <cmath>
 #include <cstdint>
-#include <functional>
 #include <tuple>
 
 #include "absl/log/log.h"
@@ -730,9 +729,8 @@ void Vfsgnjx(const Instruction *inst) {
 }
 
 // Templated helper function for vfmin and vfmax instructions.
-template <typename T>
-inline std::tuple<T, uint32_t> MaxMinHelper(T vs2, T vs1,
-                                            std::function<T(T, T)> operation) {
+template <typename T, typename Operation>
+inline std::tuple<T, uint32_t> MaxMinHelper(T vs2, T vs1, Operation operation) {
   // If either operand is a signaling NaN or if both operands are NaNs, then
   // return a canonical (non-signaling) NaN.
   uint32_t flag = 0;
@@ -14,12 +14,13 @@
 
 #include "riscv/riscv_vector_fp_reduction_instructions.h"
 
-#include <functional>
+#include <cstdint>
 
 #include "absl/log/log.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "riscv/riscv_fp_host.h"
 #include "riscv/riscv_fp_state.h"
+#include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
 #include "riscv/riscv_vector_instruction_helpers.h"
 #include "riscv/riscv_vector_state.h"
@@ -87,9 +88,109 @@ void Vfwredosum(const Instruction *inst) {
   }
 }
 
+// Helper for the unordered sum reductions. The spec allows the active elements
+// to be summed in any order. When all the elements in [0, vl) are active, they
+// are summed into kLanes independent partial sums, which the compiler can
+// vectorize, and the partial sums are then added pairwise. Otherwise the
+// elements are summed in order, which is also a valid result.
+template <typename Vd, typename Vs2>
+void UnorderedSumReduction(RiscVVectorState *rv_vector,
+                           const Instruction *inst) {
+  constexpr int kLanes = 8;
+  auto ordered_sum = [](Vd acc, Vs2 vs2) -> Vd {
+    return acc + static_cast<Vd>(vs2);
+  };
+  if (rv_vector->vector_exception() || (rv_vector->vstart() != 0)) {
+    return RiscVBinaryReductionVectorOp<Vd, Vs2, Vd>(rv_vector, inst,
+                                                     ordered_sum);
+  }
+  int num_elements = rv_vector->vector_length();
+  int lmul = rv_vector->vector_length_multiplier();
+  int lmul_vd = lmul * sizeof(Vd) / rv_vector->selected_element_width();
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
+  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  auto vs2 = GetContiguousRegisterGroup<Vs2>(rv_vector, inst, 0, 0);
+  if ((num_elements < kLanes) || (lmul == 0) || (lmul > 64) ||
+      (lmul_vd == 0) || (lmul_vd > 64) ||
+      (static_cast<int>(vs2.size()) < num_elements) ||
+      !MaskRangeIsAllOnes(mask_span, 0, num_elements)) {
+    return RiscVBinaryReductionVectorOp<Vd, Vs2, Vd>(rv_vector, inst,
+                                                     ordered_sum);
+  }
+  Vd partial[kLanes];
+  for (int lane = 0; lane < kLanes; lane++) {
+    partial[lane] = static_cast<Vd>(vs2[lane]);
+  }
+  int i = kLanes;
+  for (; i + kLanes <= num_elements; i += kLanes) {
+    for (int lane = 0; lane < kLanes; lane++) {
+      partial[lane] += static_cast<Vd>(vs2[i + lane]);
+    }
+  }
+  for (int lane = 0; i < num_elements; i++, lane++) {
+    partial[lane] += static_cast<Vd>(vs2[i]);
+  }
+  for (int width = kLanes / 2; width > 0; width /= 2) {
+    for (int lane = 0; lane < width; lane++) {
+      partial[lane] += partial[lane + width];
+    }
+  }
+  Vd accumulator = generic::GetInstructionSource<Vd>(inst, 1, 0) + partial[0];
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  auto *dest_db = dest_op->CopyDataBuffer();
+  dest_db->Set<Vd>(0, accumulator);
+  dest_db->Submit();
+  rv_vector->clear_vstart();
+}
+
+// Unordered sum reduction.
+void Vfredusum(const Instruction *inst) {
+  auto *rv_fp = static_cast<RiscVState *>(inst->state())->rv_fp();
+  auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (!rv_fp->rounding_mode_valid()) {
+    LOG(ERROR) << "Invalid rounding mode";
+    rv_vector->set_vector_exception();
+    return;
+  }
+  int sew = rv_vector->selected_element_width();
+  ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
+  switch (sew) {
+    case 4:
+      return UnorderedSumReduction<float, float>(rv_vector, inst);
+    case 8:
+      return UnorderedSumReduction<double, double>(rv_vector, inst);
+    default:
+      rv_vector->set_vector_exception();
+      LOG(ERROR) << "Illegal SEW value";
+      return;
+  }
+}
+
+// Unordered widening sum reduction.
+void Vfwredusum(const Instruction *inst) {
+  auto *rv_fp = static_cast<RiscVState *>(inst->state())->rv_fp();
+  auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (!rv_fp->rounding_mode_valid()) {
+    LOG(ERROR) << "Invalid rounding mode";
+    rv_vector->set_vector_exception();
+    return;
+  }
+  int sew = rv_vector->selected_element_width();
+  ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
+  switch (sew) {
+    case 4:
+      return UnorderedSumReduction<double, float>(rv_vector, inst);
+    default:
+      rv_vector->set_vector_exception();
+      LOG(ERROR) << "Illegal SEW value";
+      return;
+  }
+}
+
 // Templated helper function for vfmin and vfmax instructions.
-template <typename T>
-inline T MaxMinHelper(T vs2, T vs1, std::function<T(T, T)> operation) {
+template <typename T, typename Operation>
+inline T MaxMinHelper(T vs2, T vs1, Operation operation) {
   // If either operand is a signaling NaN or if both operands are NaNs, then
   // return a canonical (non-signaling) NaN.
   if (FPTypeInfo<T>::IsSNaN(vs1) || FPTypeInfo<T>::IsSNaN(vs2) ||
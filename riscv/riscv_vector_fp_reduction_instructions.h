@@ -29,9 +29,12 @@ using Instruction = ::mpact::sim::generic::Instruction;
 // Each of these instruction semantic functions take 3 source operands and 1
 // destination operand. Source 0 is a vector register group, source 1 is a
 // vector register, and source 2 is the vector mask register. Destination
-// operand 0 is a vector register group.
+// operand 0 is a vector register group. The ordered sums add the elements in
+// element order, while the unordered sums may add them in any order.
 void Vfredosum(const Instruction *inst);
 void Vfwredosum(const Instruction *inst);
+void Vfredusum(const Instruction *inst);
+void Vfwredusum(const Instruction *inst);
 void Vfredmin(const Instruction *inst);
 void Vfredmax(const Instruction *inst);
 
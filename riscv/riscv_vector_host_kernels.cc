@@ -0,0 +1,499 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_vector_host_kernels.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The kernels are written once, using the GCC/Clang vector extensions for the
+// host vector types, and instantiated for each vector width. On x86 the
+// instantiations are compiled with the target attribute of the instruction
+// set they are meant for, and the one to use is selected at runtime, so that
+// the simulator binary doesn't require AVX2 to run.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MPACT_RISCV_X86_HOST_KERNELS
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define MPACT_RISCV_NEON_HOST_KERNELS
+#endif
+
+namespace mpact::sim::riscv {
+
+namespace {
+
+// Host vector type with kBytes bytes of elements of type T.
+template <typename T, int kBytes>
+struct HostVector {
+  typedef T type __attribute__((vector_size(kBytes)));
+};
+
+// Applies the operation to a pair of scalar elements.
+template <VectorHostOp kOp, typename T>
+inline T ScalarOp(T vs2, T vs1) {
+  using S = std::make_signed_t<T>;
+  constexpr T kShiftMask = sizeof(T) * 8 - 1;
+  if constexpr (kOp == VectorHostOp::kAdd) {
+    return static_cast<T>(vs2 + vs1);
+  } else if constexpr (kOp == VectorHostOp::kSub) {
+    return static_cast<T>(vs2 - vs1);
+  } else if constexpr (kOp == VectorHostOp::kRsub) {
+    return static_cast<T>(vs1 - vs2);
+  } else if constexpr (kOp == VectorHostOp::kAnd) {
+    return vs2 & vs1;
+  } else if constexpr (kOp == VectorHostOp::kOr) {
+    return vs2 | vs1;
+  } else if constexpr (kOp == VectorHostOp::kXor) {
+    return vs2 ^ vs1;
+  } else if constexpr (kOp == VectorHostOp::kSll) {
+    return static_cast<T>(vs2 << (vs1 & kShiftMask));
+  } else if constexpr (kOp == VectorHostOp::kSrl) {
+    return static_cast<T>(vs2 >> (vs1 & kShiftMask));
+  } else if constexpr (kOp == VectorHostOp::kSra) {
+    return static_cast<T>(static_cast<S>(vs2) >> (vs1 & kShiftMask));
+  } else if constexpr (kOp == VectorHostOp::kMinu) {
+    return vs2 < vs1 ? vs2 : vs1;
+  } else if constexpr (kOp == VectorHostOp::kMin) {
+    return static_cast<S>(vs2) < static_cast<S>(vs1) ? vs2 : vs1;
+  } else if constexpr (kOp == VectorHostOp::kMaxu) {
+    return vs2 > vs1 ? vs2 : vs1;
+  } else {
+    static_assert(kOp == VectorHostOp::kMax);
+    return static_cast<S>(vs2) > static_cast<S>(vs1) ? vs2 : vs1;
+  }
+}
+
+// Returns the bits of a where mask is set, and those of b elsewhere. Used for
+// both 64 bit words and host vectors, where each lane of the mask is either
+// all ones or all zeros.
+#define MPACT_RISCV_SELECT(mask, a, b) (((a) & (mask)) | ((b) & ~(mask)))
+
+// The host vector helpers return their result through a reference, as
+// passing vectors by value depends on the instruction set that the caller is
+// compiled for.
+
+// Applies the operation to a pair of host vectors of elements of type T.
+template <VectorHostOp kOp, typename T, typename V>
+inline __attribute__((always_inline)) void VectorOp(const V &vs2, const V &vs1,
+                                                    V &result) {
+  using SV = typename HostVector<std::make_signed_t<T>, sizeof(V)>::type;
+  constexpr T kShiftMask = sizeof(T) * 8 - 1;
+  if constexpr (kOp == VectorHostOp::kAdd) {
+    result = vs2 + vs1;
+  } else if constexpr (kOp == VectorHostOp::kSub) {
+    result = vs2 - vs1;
+  } else if constexpr (kOp == VectorHostOp::kRsub) {
+    result = vs1 - vs2;
+  } else if constexpr (kOp == VectorHostOp::kAnd) {
+    result = vs2 & vs1;
+  } else if constexpr (kOp == VectorHostOp::kOr) {
+    result = vs2 | vs1;
+  } else if constexpr (kOp == VectorHostOp::kXor) {
+    result = vs2 ^ vs1;
+  } else if constexpr (kOp == VectorHostOp::kSll) {
+    result = vs2 << (vs1 & kShiftMask);
+  } else if constexpr (kOp == VectorHostOp::kSrl) {
+    result = vs2 >> (vs1 & kShiftMask);
+  } else if constexpr (kOp == VectorHostOp::kSra) {
+    result = (V)((SV)vs2 >> (SV)(vs1 & kShiftMask));
+  } else if constexpr (kOp == VectorHostOp::kMinu) {
+    V mask = (V)(vs2 < vs1);
+    result = MPACT_RISCV_SELECT(mask, vs2, vs1);
+  } else if constexpr (kOp == VectorHostOp::kMin) {
+    V mask = (V)((SV)vs2 < (SV)vs1);
+    result = MPACT_RISCV_SELECT(mask, vs2, vs1);
+  } else if constexpr (kOp == VectorHostOp::kMaxu) {
+    V mask = (V)(vs2 > vs1);
+    result = MPACT_RISCV_SELECT(mask, vs2, vs1);
+  } else {
+    static_assert(kOp == VectorHostOp::kMax);
+    V mask = (V)((SV)vs2 > (SV)vs1);
+    result = MPACT_RISCV_SELECT(mask, vs2, vs1);
+  }
+}
+
+// Shifts by the same amount in each lane can use the host's uniform shift
+// instructions.
+template <VectorHostOp kOp>
+constexpr bool kIsShift = (kOp == VectorHostOp::kSll) ||
+                          (kOp == VectorHostOp::kSrl) ||
+                          (kOp == VectorHostOp::kSra);
+
+template <VectorHostOp kOp, typename T, typename V>
+inline __attribute__((always_inline)) void VectorShift(const V &vs2, T amount,
+                                                       V &result) {
+  using S = std::make_signed_t<T>;
+  using SV = typename HostVector<S, sizeof(V)>::type;
+  if constexpr (kOp == VectorHostOp::kSll) {
+    result = vs2 << amount;
+  } else if constexpr (kOp == VectorHostOp::kSrl) {
+    result = vs2 >> amount;
+  } else {
+    result = (V)((SV)vs2 >> static_cast<S>(amount));
+  }
+}
+
+template <typename T>
+inline T LoadElement(const uint8_t *data, int index) {
+  T value;
+  std::memcpy(&value, data + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+template <typename T>
+inline void StoreElement(uint8_t *data, int index, T value) {
+  std::memcpy(data + index * sizeof(T), &value, sizeof(T));
+}
+
+// Returns count (<= 57) bits of the packed mask, starting at bit. The mask
+// bits are stored least significant bit first, which on a little endian host
+// is also the bit order of the loaded word.
+inline uint64_t GetMaskBits(const uint8_t *mask, int bit, int count) {
+  uint64_t word = 0;
+  int num_bytes = ((bit & 0b111) + count + 7) >> 3;
+  std::memcpy(&word, mask + (bit >> 3), num_bytes);
+  return (word >> (bit & 0b111)) & ((uint64_t{1} << count) - 1);
+}
+
+// Maps each byte of mask bits to the eight byte masks of the elements.
+constexpr std::array<uint64_t, 256> MakeByteMaskTable() {
+  std::array<uint64_t, 256> table{};
+  for (int bits = 0; bits < 256; bits++) {
+    for (int i = 0; i < 8; i++) {
+      if (bits & (1 << i)) table[bits] |= uint64_t{0xff} << (i * 8);
+    }
+  }
+  return table;
+}
+constexpr std::array<uint64_t, 256> kByteMaskTable = MakeByteMaskTable();
+
+// The loops below are shared by all the vector widths. A width of 0 selects
+// the scalar implementation.
+
+template <VectorHostOp kOp, typename T, int kBytes>
+inline __attribute__((always_inline)) void VVLoop(uint8_t *vd,
+                                                  const uint8_t *vs2,
+                                                  const uint8_t *vs1,
+                                                  int num_elements) {
+  int i = 0;
+  if constexpr (kBytes > 0) {
+    using V = typename HostVector<T, kBytes>::type;
+    constexpr int kLanes = kBytes / sizeof(T);
+    for (; i + kLanes <= num_elements; i += kLanes) {
+      V a, b;
+      std::memcpy(&a, vs2 + i * sizeof(T), kBytes);
+      std::memcpy(&b, vs1 + i * sizeof(T), kBytes);
+      V result;
+      VectorOp<kOp, T>(a, b, result);
+      std::memcpy(vd + i * sizeof(T), &result, kBytes);
+    }
+  }
+  for (; i < num_elements; i++) {
+    StoreElement<T>(vd, i,
+                    ScalarOp<kOp, T>(LoadElement<T>(vs2, i),
+                                     LoadElement<T>(vs1, i)));
+  }
+}
+
+template <VectorHostOp kOp, typename T, int kBytes>
+inline __attribute__((always_inline)) void VXLoop(uint8_t *vd,
+                                                  const uint8_t *vs2,
+                                                  uint64_t rs1,
+                                                  int num_elements) {
+  const T scalar = static_cast<T>(rs1);
+  int i = 0;
+  if constexpr (kBytes > 0) {
+    using V = typename HostVector<T, kBytes>::type;
+    constexpr int kLanes = kBytes / sizeof(T);
+    const V broadcast = V{} + scalar;
+    const T amount = scalar & static_cast<T>(sizeof(T) * 8 - 1);
+    for (; i + kLanes <= num_elements; i += kLanes) {
+      V a;
+      std::memcpy(&a, vs2 + i * sizeof(T), kBytes);
+      V result;
+      if constexpr (kIsShift<kOp>) {
+        VectorShift<kOp, T>(a, amount, result);
+      } else {
+        VectorOp<kOp, T>(a, broadcast, result);
+      }
+      std::memcpy(vd + i * sizeof(T), &result, kBytes);
+    }
+  }
+  for (; i < num_elements; i++) {
+    StoreElement<T>(vd, i, ScalarOp<kOp, T>(LoadElement<T>(vs2, i), scalar));
+  }
+}
+
+// Merges the elements of vs2 and of vs1 (which is either a pointer to the
+// elements of a vector, or a scalar value) according to the mask.
+template <typename T, int kBytes, typename Vs1>
+inline __attribute__((always_inline)) void MergeLoop(uint8_t *vd,
+                                                     const uint8_t *vs2,
+                                                     Vs1 vs1,
+                                                     const uint8_t *mask,
+                                                     int mask_offset,
+                                                     int num_elements) {
+  constexpr bool kScalar = std::is_same_v<Vs1, uint64_t>;
+  auto get_vs1 = [vs1](int index) -> T {
+    if constexpr (kScalar) {
+      return static_cast<T>(vs1);
+    } else {
+      return LoadElement<T>(vs1, index);
+    }
+  };
+  int i = 0;
+  if constexpr (sizeof(T) == 1) {
+    // Byte elements are merged eight at a time using 64 bit words, as there
+    // are more of them in a host vector than bits in an element.
+    const uint64_t broadcast = uint64_t{0x0101'0101'0101'0101} *
+                               static_cast<uint8_t>(get_vs1(0));
+    for (; i + 8 <= num_elements; i += 8) {
+      uint64_t select = kByteMaskTable[GetMaskBits(mask, mask_offset + i, 8)];
+      uint64_t a = LoadElement<uint64_t>(vs2 + i, 0);
+      uint64_t b = broadcast;
+      if constexpr (!kScalar) b = LoadElement<uint64_t>(vs1 + i, 0);
+      StoreElement<uint64_t>(vd + i, 0, MPACT_RISCV_SELECT(select, b, a));
+    }
+  } else if constexpr (kBytes > 0) {
+    // Each lane selects its own bit of the mask bits of the host vector.
+    using V = typename HostVector<T, kBytes>::type;
+    constexpr int kLanes = kBytes / sizeof(T);
+    V lane_bits;
+    for (int lane = 0; lane < kLanes; lane++) {
+      lane_bits[lane] = static_cast<T>(T{1} << lane);
+    }
+    const V broadcast = V{} + get_vs1(0);
+    for (; i + kLanes <= num_elements; i += kLanes) {
+      V bits =
+          V{} + static_cast<T>(GetMaskBits(mask, mask_offset + i, kLanes));
+      V select = (V)((bits & lane_bits) != 0);
+      V a, b = broadcast;
+      std::memcpy(&a, vs2 + i * sizeof(T), kBytes);
+      if constexpr (!kScalar) std::memcpy(&b, vs1 + i * sizeof(T), kBytes);
+      V result = MPACT_RISCV_SELECT(select, b, a);
+      std::memcpy(vd + i * sizeof(T), &result, kBytes);
+    }
+  }
+  for (; i < num_elements; i++) {
+    int bit = mask_offset + i;
+    bool selected = (mask[bit >> 3] >> (bit & 0b111)) & 0b1;
+    StoreElement<T>(vd, i, selected ? get_vs1(i) : LoadElement<T>(vs2, i));
+  }
+}
+
+// The operations that can be used for reductions.
+template <VectorHostOp kOp>
+constexpr bool kIsReduction =
+    (kOp == VectorHostOp::kAdd) || (kOp == VectorHostOp::kAnd) ||
+    (kOp == VectorHostOp::kOr) || (kOp == VectorHostOp::kXor) ||
+    (kOp == VectorHostOp::kMinu) || (kOp == VectorHostOp::kMin) ||
+    (kOp == VectorHostOp::kMaxu) || (kOp == VectorHostOp::kMax);
+
+// Reduces the elements into one host vector of partial results, which are then
+// combined with the accumulator. The elements that don't fill a host vector
+// are combined with the result one at a time.
+template <VectorHostOp kOp, typename T, int kBytes>
+inline __attribute__((always_inline)) uint64_t ReduceLoop(uint64_t acc,
+                                                          const uint8_t *vs2,
+                                                          int num_elements) {
+  T result = static_cast<T>(acc);
+  int i = 0;
+  if constexpr (kBytes > 0) {
+    using V = typename HostVector<T, kBytes>::type;
+    constexpr int kLanes = kBytes / sizeof(T);
+    if (num_elements >= kLanes) {
+      V partial;
+      std::memcpy(&partial, vs2, kBytes);
+      for (i = kLanes; i + kLanes <= num_elements; i += kLanes) {
+        V a;
+        std::memcpy(&a, vs2 + i * sizeof(T), kBytes);
+        VectorOp<kOp, T>(partial, a, partial);
+      }
+      for (int lane = 0; lane < kLanes; lane++) {
+        result = ScalarOp<kOp, T>(result, partial[lane]);
+      }
+    }
+  }
+  for (; i < num_elements; i++) {
+    result = ScalarOp<kOp, T>(result, LoadElement<T>(vs2, i));
+  }
+  return result;
+}
+
+// Sums the elements of type T, extended to the unsigned type W that is twice as
+// wide, into one host vector of partial sums, which are then added to the
+// accumulator.
+template <typename T, typename W, int kBytes>
+inline __attribute__((always_inline)) uint64_t WideningSumLoop(
+    uint64_t acc, const uint8_t *vs2, int num_elements) {
+  W result = static_cast<W>(acc);
+  int i = 0;
+  if constexpr (kBytes > 0) {
+    // Signed elements are sign extended to the signed wide type.
+    using ExtendedT = std::conditional_t<std::is_signed_v<T>,
+                                         std::make_signed_t<W>, W>;
+    using V = typename HostVector<T, kBytes / 2>::type;
+    using EV = typename HostVector<ExtendedT, kBytes>::type;
+    using WV = typename HostVector<W, kBytes>::type;
+    constexpr int kLanes = kBytes / sizeof(W);
+    WV partial = {};
+    for (; i + kLanes <= num_elements; i += kLanes) {
+      V a;
+      std::memcpy(&a, vs2 + i * sizeof(T), kBytes / 2);
+      partial += (WV)__builtin_convertvector(a, EV);
+    }
+    for (int lane = 0; lane < kLanes; lane++) result += partial[lane];
+  }
+  for (; i < num_elements; i++) {
+    result += static_cast<W>(LoadElement<T>(vs2, i));
+  }
+  return result;
+}
+
+// Each set of kernels is defined by a struct with the kernel function
+// templates. This defines a struct of kernels that use host vectors of the
+// given number of bytes (0 for scalar code), compiled with the given target
+// attribute.
+#define MPACT_RISCV_HOST_KERNELS(class_name, name, bytes, attribute)          \
+  struct class_name {                                                         \
+    static constexpr char kName[] = name;                                     \
+                                                                              \
+    template <VectorHostOp kOp, typename T>                                   \
+    attribute static void VV(uint8_t *vd, const uint8_t *vs2,                 \
+                             const uint8_t *vs1, int num_elements) {          \
+      VVLoop<kOp, T, bytes>(vd, vs2, vs1, num_elements);                      \
+    }                                                                         \
+    template <VectorHostOp kOp, typename T>                                   \
+    attribute static void VX(uint8_t *vd, const uint8_t *vs2, uint64_t rs1,   \
+                             int num_elements) {                              \
+      VXLoop<kOp, T, bytes>(vd, vs2, rs1, num_elements);                      \
+    }                                                                         \
+    template <typename T>                                                     \
+    attribute static void MergeVV(uint8_t *vd, const uint8_t *vs2,            \
+                                  const uint8_t *vs1, const uint8_t *mask,    \
+                                  int mask_offset, int num_elements) {        \
+      MergeLoop<T, bytes>(vd, vs2, vs1, mask, mask_offset, num_elements);     \
+    }                                                                         \
+    template <typename T>                                                     \
+    attribute static void MergeVX(uint8_t *vd, const uint8_t *vs2,            \
+                                  uint64_t rs1, const uint8_t *mask,          \
+                                  int mask_offset, int num_elements) {        \
+      MergeLoop<T, bytes>(vd, vs2, rs1, mask, mask_offset, num_elements);     \
+    }                                                                         \
+    template <VectorHostOp kOp, typename T>                                   \
+    attribute static uint64_t Reduce(uint64_t acc, const uint8_t *vs2,        \
+                                     int num_elements) {                      \
+      return ReduceLoop<kOp, T, bytes>(acc, vs2, num_elements);               \
+    }                                                                         \
+    template <typename T, typename W>                                         \
+    attribute static uint64_t WideningSum(uint64_t acc, const uint8_t *vs2,   \
+                                          int num_elements) {                 \
+      return WideningSumLoop<T, W, bytes>(acc, vs2, num_elements);            \
+    }                                                                         \
+  }
+
+MPACT_RISCV_HOST_KERNELS(ScalarKernels, "scalar", 0, );
+#if defined(MPACT_RISCV_X86_HOST_KERNELS)
+MPACT_RISCV_HOST_KERNELS(Avx2Kernels, "avx2", 32,
+                         __attribute__((target("avx2"))));
+MPACT_RISCV_HOST_KERNELS(Sse42Kernels, "sse4.2", 16,
+                         __attribute__((target("sse4.2"))));
+#elif defined(MPACT_RISCV_NEON_HOST_KERNELS)
+MPACT_RISCV_HOST_KERNELS(NeonKernels, "neon", 16, );
+#endif
+
+#undef MPACT_RISCV_HOST_KERNELS
+#undef MPACT_RISCV_SELECT
+
+template <typename Kernels, VectorHostOp kOp>
+void AddOpKernels(VectorHostKernels &kernels) {
+  constexpr int kIndex = static_cast<int>(kOp);
+  kernels.vv[kIndex][0] = Kernels::template VV<kOp, uint8_t>;
+  kernels.vv[kIndex][1] = Kernels::template VV<kOp, uint16_t>;
+  kernels.vv[kIndex][2] = Kernels::template VV<kOp, uint32_t>;
+  kernels.vv[kIndex][3] = Kernels::template VV<kOp, uint64_t>;
+  kernels.vx[kIndex][0] = Kernels::template VX<kOp, uint8_t>;
+  kernels.vx[kIndex][1] = Kernels::template VX<kOp, uint16_t>;
+  kernels.vx[kIndex][2] = Kernels::template VX<kOp, uint32_t>;
+  kernels.vx[kIndex][3] = Kernels::template VX<kOp, uint64_t>;
+  if constexpr (kIsReduction<kOp>) {
+    kernels.reduce[kIndex][0] = Kernels::template Reduce<kOp, uint8_t>;
+    kernels.reduce[kIndex][1] = Kernels::template Reduce<kOp, uint16_t>;
+    kernels.reduce[kIndex][2] = Kernels::template Reduce<kOp, uint32_t>;
+    kernels.reduce[kIndex][3] = Kernels::template Reduce<kOp, uint64_t>;
+  } else {
+    for (auto &kernel : kernels.reduce[kIndex]) kernel = nullptr;
+  }
+}
+
+template <typename Kernels, int... kOps>
+VectorHostKernels MakeKernels(std::integer_sequence<int, kOps...>) {
+  VectorHostKernels kernels;
+  kernels.name = Kernels::kName;
+  (AddOpKernels<Kernels, static_cast<VectorHostOp>(kOps)>(kernels), ...);
+  kernels.merge_vv[0] = Kernels::template MergeVV<uint8_t>;
+  kernels.merge_vv[1] = Kernels::template MergeVV<uint16_t>;
+  kernels.merge_vv[2] = Kernels::template MergeVV<uint32_t>;
+  kernels.merge_vv[3] = Kernels::template MergeVV<uint64_t>;
+  kernels.merge_vx[0] = Kernels::template MergeVX<uint8_t>;
+  kernels.merge_vx[1] = Kernels::template MergeVX<uint16_t>;
+  kernels.merge_vx[2] = Kernels::template MergeVX<uint32_t>;
+  kernels.merge_vx[3] = Kernels::template MergeVX<uint64_t>;
+  kernels.widening_sum[0][0] = Kernels::template WideningSum<uint8_t, uint16_t>;
+  kernels.widening_sum[0][1] =
+      Kernels::template WideningSum<uint16_t, uint32_t>;
+  kernels.widening_sum[0][2] =
+      Kernels::template WideningSum<uint32_t, uint64_t>;
+  kernels.widening_sum[1][0] = Kernels::template WideningSum<int8_t, uint16_t>;
+  kernels.widening_sum[1][1] = Kernels::template WideningSum<int16_t, uint32_t>;
+  kernels.widening_sum[1][2] = Kernels::template WideningSum<int32_t, uint64_t>;
+  return kernels;
+}
+
+template <typename Kernels>
+VectorHostKernels MakeKernels() {
+  constexpr int kNumOps = static_cast<int>(VectorHostOp::kPastMaxValue);
+  return MakeKernels<Kernels>(std::make_integer_sequence<int, kNumOps>());
+}
+
+}  // namespace
+
+std::vector<const VectorHostKernels *> GetSupportedVectorHostKernels() {
+  std::vector<const VectorHostKernels *> supported;
+#if defined(MPACT_RISCV_X86_HOST_KERNELS)
+  static const VectorHostKernels avx2 = MakeKernels<Avx2Kernels>();
+  static const VectorHostKernels sse42 = MakeKernels<Sse42Kernels>();
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) supported.push_back(&avx2);
+  if (__builtin_cpu_supports("sse4.2")) supported.push_back(&sse42);
+#elif defined(MPACT_RISCV_NEON_HOST_KERNELS)
+  static const VectorHostKernels neon = MakeKernels<NeonKernels>();
+  supported.push_back(&neon);
+#endif
+  static const VectorHostKernels scalar = MakeKernels<ScalarKernels>();
+  supported.push_back(&scalar);
+  return supported;
+}
+
+const VectorHostKernels &GetVectorHostKernels() {
+  static const VectorHostKernels *const kernels =
+      GetSupportedVectorHostKernels().front();
+  return *kernels;
+}
+
+}  // namespace mpact::sim::riscv
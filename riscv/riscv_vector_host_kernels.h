@@ -0,0 +1,125 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_RISCV_RISCV_RISCV_VECTOR_HOST_KERNELS_H_
+#define MPACT_RISCV_RISCV_RISCV_VECTOR_HOST_KERNELS_H_
+
+#include <cstdint>
+#include <vector>
+
+// This file declares kernels that compute vector operations over contiguous
+// arrays of elements using the host's SIMD instructions. They are used by the
+// vector semantic functions for the common case of unmasked operations that
+// start at element 0, where the operation can be applied to each register of
+// a group as a whole. The kernels are selected the first time they are
+// requested, based on the features of the host cpu (AVX2 or SSE4.2 on x86,
+// NEON on ARM, with a portable scalar fallback).
+
+namespace mpact::sim::riscv {
+
+// Element-wise binary integer operations with host kernels. The operations
+// are defined as vd[i] = vs2[i] op vs1[i], as in the RiscV vector spec.
+enum class VectorHostOp : int {
+  kAdd = 0,
+  kSub,
+  // vs1 - vs2.
+  kRsub,
+  kAnd,
+  kOr,
+  kXor,
+  // Shift amounts are taken modulo the element width in bits.
+  kSll,
+  kSrl,
+  kSra,
+  kMinu,
+  kMin,
+  kMaxu,
+  kMax,
+  kPastMaxValue,
+};
+
+// Computes num_elements elements of vd from the vectors vs2 and vs1. The
+// element width is determined by the kernel. The destination may be the same
+// array as either source, but may not overlap them otherwise.
+using VectorHostVVKernel = void (*)(uint8_t *vd, const uint8_t *vs2,
+                                    const uint8_t *vs1, int num_elements);
+// Same as above, but vs1 is a scalar. Only the low element width bits of rs1
+// are used.
+using VectorHostVXKernel = void (*)(uint8_t *vd, const uint8_t *vs2,
+                                    uint64_t rs1, int num_elements);
+// Computes vd[i] = mask[i] ? vs1[i] : vs2[i] for num_elements elements, where
+// mask[i] is bit (mask_offset + i) of the packed mask array.
+using VectorHostMergeVVKernel = void (*)(uint8_t *vd, const uint8_t *vs2,
+                                         const uint8_t *vs1,
+                                         const uint8_t *mask, int mask_offset,
+                                         int num_elements);
+using VectorHostMergeVXKernel = void (*)(uint8_t *vd, const uint8_t *vs2,
+                                         uint64_t rs1, const uint8_t *mask,
+                                         int mask_offset, int num_elements);
+// Reduces num_elements elements of vs2 into the accumulator acc and returns
+// the result. Only the low bits of acc that fit the accumulator width of the
+// kernel are used. The elements are combined in an unspecified order, so the
+// operation must be associative and commutative.
+using VectorHostReduceKernel = uint64_t (*)(uint64_t acc, const uint8_t *vs2,
+                                            int num_elements);
+
+// The kernels are indexed by log2 of the element width in bytes.
+struct VectorHostKernels {
+  static constexpr int kNumElementWidths = 4;
+
+  // Returns the index of the kernels for the given element width in bytes, or
+  // -1 if there are none.
+  static constexpr int WidthIndex(int element_width) {
+    switch (element_width) {
+      case 1:
+        return 0;
+      case 2:
+        return 1;
+      case 4:
+        return 2;
+      case 8:
+        return 3;
+      default:
+        return -1;
+    }
+  }
+
+  // Name of the instruction set the kernels use, for instance "avx2".
+  const char *name;
+  VectorHostVVKernel vv[static_cast<int>(VectorHostOp::kPastMaxValue)]
+                       [kNumElementWidths];
+  VectorHostVXKernel vx[static_cast<int>(VectorHostOp::kPastMaxValue)]
+                       [kNumElementWidths];
+  VectorHostMergeVVKernel merge_vv[kNumElementWidths];
+  VectorHostMergeVXKernel merge_vx[kNumElementWidths];
+  // Reductions with the operation, for the associative operations kAdd, kAnd,
+  // kOr, kXor, kMinu, kMin, kMaxu and kMax. The others are nullptr.
+  VectorHostReduceKernel reduce[static_cast<int>(VectorHostOp::kPastMaxValue)]
+                               [kNumElementWidths];
+  // Widening sums, where the accumulator is twice the element width. The
+  // elements are zero extended by widening_sum[0] and sign extended by
+  // widening_sum[1]. Indexed by the width of the elements.
+  VectorHostReduceKernel widening_sum[2][kNumElementWidths - 1];
+};
+
+// Returns the best kernels for the host cpu.
+const VectorHostKernels &GetVectorHostKernels();
+// Returns all the kernels that the host cpu supports, from best to worst. The
+// last one is always the portable scalar implementation. Used for testing and
+// benchmarking.
+std::vector<const VectorHostKernels *> GetSupportedVectorHostKernels();
+
+}  // namespace mpact::sim::riscv
+
+#endif  // MPACT_RISCV_RISCV_RISCV_VECTOR_HOST_KERNELS_H_
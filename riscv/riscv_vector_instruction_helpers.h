@@ -17,12 +17,13 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <functional>
+#include <cstring>
 #include <limits>
 #include <optional>
 #include <type_traits>
 
 #include "absl/log/log.h"
+#include "absl/types/span.h"
 #include "mpact/sim/generic/instruction.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
@@ -34,28 +35,165 @@ namespace riscv {
 
 using ::mpact::sim::generic::GetInstructionSource;
 
-// This helper function handles the case of instructions that target a vector
+// The helpers below take the element operation as a template parameter rather
+// than as a std::function, so that the operation is inlined into the element
+// loop instead of being called indirectly once per element. The element types
+// are given explicitly by the callers, and the operation type is deduced.
+
+// Reads the elements of source operand index of an instruction for the helpers
+// below, which iterate over the destination one register at a time. When the
+// operand is a vector register group with elements of the same width as the
+// destination, element i of destination register reg is element i of register
+// reg of the operand, and it is read directly from that register's span.
+// Otherwise (scalar operands, or narrower or wider elements, where the element
+// maps to a different register of the group) it is read with
+// GetInstructionSource using the element index within the whole group.
+template <typename T>
+class RiscVVectorSourceReader {
+ public:
+  // elements_per_vector is the number of destination elements per register.
+  RiscVVectorSourceReader(const Instruction *inst, int index,
+                          int elements_per_vector)
+      : inst_(inst), index_(index) {
+    // Scalar registers and immediates have a shape of {1}.
+    if (inst->Source(index)->shape()[0] == 1) return;
+    auto *op = static_cast<RV32VectorSourceOperand *>(inst->Source(index));
+    if (op->ElementsPerRegister<T>() != elements_per_vector) return;
+    op_ = op;
+  }
+
+  // Selects the register of the operand group that Get() reads from.
+  void SetRegister(int reg) {
+    span_ = ((op_ != nullptr) && (reg < op_->size()))
+                ? op_->GetRegisterSpan<T>(reg)
+                : absl::Span<const T>();
+  }
+
+  // Returns element i of the selected register, where vector_index is the
+  // corresponding element index within the whole group.
+  T Get(int i, int vector_index) const {
+    if (!span_.empty()) return span_[i];
+    return GetInstructionSource<T>(inst_, index_, vector_index);
+  }
+
+ private:
+  const Instruction *inst_;
+  int index_;
+  RV32VectorSourceOperand *op_ = nullptr;
+  absl::Span<const T> span_;
+};
+
+// Returns the elements of type T of the register group of the vector source
+// operand as one contiguous span, for operations that index elements across
+// the registers of the group. A single register is returned in place, and
+// larger groups are copied into the given slot of the vector state's register
+// group buffer, so the span is valid until the slot is used again. Returns an
+// empty span if the operand isn't a group of whole vector registers, in which
+// case the elements have to be read with GetInstructionSource.
+template <typename T>
+absl::Span<const T> GetContiguousRegisterGroup(RiscVVectorState *rv_vector,
+                                               const Instruction *inst,
+                                               int index, int slot) {
+  // Scalar registers and immediates have a shape of {1}.
+  if (inst->Source(index)->shape()[0] == 1) return absl::Span<const T>();
+  auto *op = static_cast<RV32VectorSourceOperand *>(inst->Source(index));
+  int vlenb = rv_vector->vector_register_byte_length();
+  if ((op->ElementsPerRegister<uint8_t>() != vlenb) ||
+      (op->size() > RiscVVectorState::kMaxGroupSize)) {
+    return absl::Span<const T>();
+  }
+  if (op->size() == 1) return op->GetRegisterSpan<T>(0);
+  uint8_t *buffer = rv_vector->group_buffer(slot);
+  for (int reg = 0; reg < op->size(); reg++) {
+    std::memcpy(buffer + reg * vlenb, op->GetRegisterSpan<uint8_t>(reg).data(),
+                vlenb);
+  }
+  return absl::Span<const T>(reinterpret_cast<const T *>(buffer),
+                             op->size() * vlenb / sizeof(T));
+}
+
+// Mask registers hold one bit per element, packed in little endian order. On a
+// (little endian) host, the mask bits of elements [64 * word, 64 * word + 64)
+// are thus the 64 bit word at byte offset 8 * word of the register, which the
+// functions below use to operate on masks a word at a time.
+
+// Returns mask word number word of the span. Bytes past the end of the span
+// read as 0.
+inline uint64_t GetMaskWord(absl::Span<const uint8_t> span, int word) {
+  int offset = word * sizeof(uint64_t);
+  int size = std::clamp<int>(span.size() - offset, 0, sizeof(uint64_t));
+  uint64_t value = 0;
+  std::memcpy(&value, span.data() + offset, size);
+  return value;
+}
+
+// Writes mask word number word of the span. Bytes past the end of the span are
+// not written.
+inline void SetMaskWord(absl::Span<uint8_t> span, int word, uint64_t value) {
+  int offset = word * sizeof(uint64_t);
+  int size = std::clamp<int>(span.size() - offset, 0, sizeof(uint64_t));
+  std::memcpy(span.data() + offset, &value, size);
+}
+
+// Returns mask word number word with the bits of the elements in [begin, end)
+// set.
+inline uint64_t MaskWordRange(int word, int begin, int end) {
+  int low = std::clamp(begin - word * 64, 0, 64);
+  int high = std::clamp(end - word * 64, 0, 64);
+  if (low >= high) return 0;
+  constexpr uint64_t kOnes = ~uint64_t{0};
+  return (kOnes << low) & (kOnes >> (64 - high));
+}
+
+// Returns true if the bits of the elements in [begin, end) are all set in the
 // mask.
-// It clears the masked bit and uses the mask value in the
-// instruction, such as carry generation from add with carry.
-// Note that this function will modify masked bits no matter what the mask
-// value is.
-template <typename Vs2, typename Vs1>
-void RiscVSetMaskBinaryVectorMaskOp(RiscVVectorState *rv_vector,
-                                    const Instruction *inst,
-                                    std::function<bool(Vs2, Vs1, bool)> op) {
+inline bool MaskRangeIsAllOnes(absl::Span<const uint8_t> mask_span, int begin,
+                               int end) {
+  for (int word = begin >> 6; word * 64 < end; word++) {
+    uint64_t range = MaskWordRange(word, begin, end);
+    if ((GetMaskWord(mask_span, word) & range) != range) return false;
+  }
+  return true;
+}
+
+// Returns true if an operation on the active elements in [vstart, vl) writes
+// every element of register reg of a destination group with
+// elements_per_vector elements per register. The prior contents of such a
+// register don't have to be preserved, so the helpers below get its data
+// buffer with WriteDataBuffer(reg, true), which doesn't copy them.
+inline bool OverwritesRegister(absl::Span<const uint8_t> mask_span, int reg,
+                               int elements_per_vector, int vstart, int vl) {
+  int begin = reg * elements_per_vector;
+  int end = begin + elements_per_vector;
+  if ((begin < vstart) || (end > vl)) return false;
+  return MaskRangeIsAllOnes(mask_span, begin, end);
+}
+
+// Computes the bits of a mask destination for elements [vstart, vl). The
+// result bits are accumulated into 64 bit words, and each word is merged into
+// the destination register once. If skip_inactive is true, elements that are
+// masked off are left undisturbed, otherwise the operation is called for them
+// with a false mask value. Used by the two helpers below.
+template <bool skip_inactive, typename Vs2, typename Vs1, typename Operation>
+void RiscVVectorMaskDestinationOp(RiscVVectorState *rv_vector,
+                                  const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   auto *dest_op =
       static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
   // Get the vector start element index and compute where to start
   // the operation.
   const int num_elements = rv_vector->vector_length();
-  const int vector_index = rv_vector->vstart();
+  int vector_index = rv_vector->vstart();
+  const int elements_per_vector =
+      rv_vector->vector_register_byte_length() / sizeof(Vs2);
+  int item_index = vector_index % elements_per_vector;
   // Allocate data buffer for the new register data.
   auto *dest_db = dest_op->CopyDataBuffer();
   auto dest_span = dest_db->Get<uint8_t>();
   // Determine if it's vector-vector or vector-scalar.
   const bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
+  RiscVVectorSourceReader<Vs1> vs1_reader(inst, 1, elements_per_vector);
   // Get the vector mask.
   auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
   bool vm_unmasked_bit = false;
@@ -64,81 +202,75 @@ void RiscVSetMaskBinaryVectorMaskOp(RiscVVectorState *rv_vector,
   }
   const bool mask_used = !vm_unmasked_bit;
   auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  for (int i = vector_index; i < num_elements; i++) {
-    const int mask_index = i >> 3;
-    const int mask_offset = i & 0b111;
-    const bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
-    const Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, i);
-    const Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1, vector_scalar ? 0 : i);
-
-    // Clear the masked register bit.
-    dest_span[mask_index] &= ~(1 << mask_offset);
-
-    // Mask value is used only when `vm_unmasked_bit` is 0.
-    dest_span[mask_index] |=
-        (op(vs2, vs1, mask_used & mask_value) << mask_offset);
+  // The current mask word, the result bits and the bits that are written.
+  int word = vector_index >> 6;
+  uint64_t mask_word = GetMaskWord(mask_span, word);
+  uint64_t result = 0;
+  uint64_t written = 0;
+  for (int reg = vector_index / elements_per_vector;
+       vector_index < num_elements; reg++) {
+    vs2_reader.SetRegister(reg);
+    vs1_reader.SetRegister(vector_scalar ? 0 : reg);
+    for (int i = item_index;
+         (i < elements_per_vector) && (vector_index < num_elements);
+         i++, vector_index++) {
+      if ((vector_index >> 6) != word) {
+        SetMaskWord(dest_span, word,
+                    (GetMaskWord(dest_span, word) & ~written) | result);
+        word = vector_index >> 6;
+        mask_word = GetMaskWord(mask_span, word);
+        result = 0;
+        written = 0;
+      }
+      const int bit = vector_index & 0b11'1111;
+      const bool mask_value = ((mask_word >> bit) & 0b1) != 0;
+      if (skip_inactive && mask_used && !mask_value) continue;
+      const Vs2 vs2 = vs2_reader.Get(i, vector_index);
+      const Vs1 vs1 = vs1_reader.Get(i, vector_scalar ? 0 : vector_index);
+      // Mask value is used only when `vm_unmasked_bit` is 0.
+      const bool value = op(vs2, vs1, mask_used & mask_value);
+      result |= static_cast<uint64_t>(value) << bit;
+      written |= uint64_t{1} << bit;
+    }
+    item_index = 0;
+  }
+  if (written != 0) {
+    SetMaskWord(dest_span, word,
+                (GetMaskWord(dest_span, word) & ~written) | result);
   }
   // Submit the destination db .
   dest_db->Submit();
   rv_vector->clear_vstart();
 }
 
+// This helper function handles the case of instructions that target a vector
+// mask.
+// It clears the masked bit and uses the mask value in the
+// instruction, such as carry generation from add with carry.
+// Note that this function will modify masked bits no matter what the mask
+// value is.
+template <typename Vs2, typename Vs1, typename Operation>
+void RiscVSetMaskBinaryVectorMaskOp(RiscVVectorState *rv_vector,
+                                    const Instruction *inst, Operation op) {
+  RiscVVectorMaskDestinationOp</*skip_inactive=*/false, Vs2, Vs1>(rv_vector,
+                                                                  inst, op);
+}
+
 // This helper function handles the case of instructions that target a vector
 // mask and uses the mask value in the instruction, such as carry generation
 // from add with carry.
-template <typename Vs2, typename Vs1>
+template <typename Vs2, typename Vs1, typename Operation>
 void RiscVMaskBinaryVectorMaskOp(RiscVVectorState *rv_vector,
-                                 const Instruction *inst,
-                                 std::function<bool(Vs2, Vs1, bool)> op) {
-  if (rv_vector->vector_exception()) return;
-  auto *dest_op =
-      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
-  // Get the vector start element index and compute where to start
-  // the operation.
-  int num_elements = rv_vector->vector_length();
-  int vector_index = rv_vector->vstart();
-  // Allocate data buffer for the new register data.
-  auto *dest_db = dest_op->CopyDataBuffer();
-  auto dest_span = dest_db->Get<uint8_t>();
-  // Determine if it's vector-vector or vector-scalar.
-  bool vector_scalar = inst->Source(1)->shape()[0] == 1;
-  // Get the vector mask.
-  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
-  bool vm_unmasked_bit = false;
-  if (inst->SourcesSize() > 3) {
-    vm_unmasked_bit = GetInstructionSource<bool>(inst, 3);
-  }
-  const bool mask_used = !vm_unmasked_bit;
-  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  for (int i = vector_index; i < num_elements; i++) {
-    int mask_index = i >> 3;
-    int mask_offset = i & 0b111;
-    bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
-    if (mask_used && !mask_value) {
-      continue;
-    }
-
-    Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, i);
-    Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1, vector_scalar ? 0 : i);
-
-    // Clear the masked register bit.
-    dest_span[mask_index] &= ~(1 << mask_offset);
-
-    // Mask value is used only when `vm_unmasked_bit` is 0.
-    dest_span[mask_index] |=
-        (op(vs2, vs1, mask_used & mask_value) << mask_offset);
-  }
-  // Submit the destination db .
-  dest_db->Submit();
-  rv_vector->clear_vstart();
+                                 const Instruction *inst, Operation op) {
+  RiscVVectorMaskDestinationOp</*skip_inactive=*/true, Vs2, Vs1>(rv_vector,
+                                                                 inst, op);
 }
 
 // This helper function handles the case of vector mask
 // operations.
-template <typename Vs2, typename Vs1>
+template <typename Vs2, typename Vs1, typename Operation>
 void RiscVBinaryVectorMaskOp(RiscVVectorState *rv_vector,
-                             const Instruction *inst,
-                             std::function<bool(Vs2, Vs1)> op) {
+                             const Instruction *inst, Operation op) {
   RiscVMaskBinaryVectorMaskOp<Vs2, Vs1>(
       rv_vector, inst, [op](Vs2 vs2, Vs1 vs1, bool mask_value) -> bool {
         if (mask_value) {
@@ -151,10 +283,9 @@ void RiscVBinaryVectorMaskOp(RiscVVectorState *rv_vector,
 // This helper function handles the case of nullary vector
 // operations. It implements all the checking necessary for both widening and
 // narrowing operations.
-template <typename Vd>
+template <typename Vd, typename Operation>
 void RiscVMaskNullaryVectorOp(RiscVVectorState *rv_vector,
-                              const Instruction *inst,
-                              std::function<Vd(bool)> op) {
+                              const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int elements_per_vector =
@@ -182,6 +313,10 @@ void RiscVMaskNullaryVectorOp(RiscVVectorState *rv_vector,
     mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
   }
   auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  absl::Span<const uint8_t> rs2_span;
+  if (vs2_op != nullptr) {
+    rs2_span = vs2_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  }
   // Get the vector start element index and compute where to start
   // the operation.
   int vector_index = rv_vector->vstart();
@@ -190,8 +325,11 @@ void RiscVMaskNullaryVectorOp(RiscVVectorState *rv_vector,
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
@@ -204,8 +342,6 @@ void RiscVMaskNullaryVectorOp(RiscVVectorState *rv_vector,
       bool operation_mask = mask_value;
       // Instruction with rs2 operand checks vs2 bit value.
       if (vs2_op != nullptr) {
-        const auto rs2_span =
-            vs2_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
         const bool rs2_value = ((rs2_span[mask_index] >> mask_offset) & 0b1);
         // If rs2 is set, then the operation is performed.
         operation_mask &= rs2_value;
@@ -227,9 +363,9 @@ void RiscVMaskNullaryVectorOp(RiscVVectorState *rv_vector,
 // This helper function handles the case of unary vector
 // operations. It implements all the checking necessary for both widening and
 // narrowing operations.
-template <typename Vd, typename Vs2>
+template <typename Vd, typename Vs2, typename Operation>
 void RiscVUnaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
-                        std::function<Vd(Vs2)> op) {
+                        Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int lmul = rv_vector->vector_length_multiplier();
@@ -267,12 +403,17 @@ void RiscVUnaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
   int vector_index = rv_vector->vstart();
   int start_reg = vector_index / elements_per_vector;
   int item_index = vector_index % elements_per_vector;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
+    vs2_reader.SetRegister(reg);
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
     for (int i = item_index;
@@ -283,7 +424,7 @@ void RiscVUnaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
       bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
       if (mask_value) {
         // Compute result.
-        Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
+        Vs2 vs2 = vs2_reader.Get(i, vector_index);
         dest_span[i] = op(vs2);
       }
       vector_index++;
@@ -298,10 +439,9 @@ void RiscVUnaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
 // This helper function handles the case of unary vector operations that set
 // fflags. It implements all the checking necessary for both widening and
 // narrowing operations.
-template <typename Vd, typename Vs2>
-void RiscVUnaryVectorOpWithFflags(
-    RiscVVectorState *rv_vector, const Instruction *inst,
-    std::function<std::tuple<Vd, uint32_t>(Vs2)> op) {
+template <typename Vd, typename Vs2, typename Operation>
+void RiscVUnaryVectorOpWithFflags(RiscVVectorState *rv_vector,
+                                  const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int lmul = rv_vector->vector_length_multiplier();
@@ -339,13 +479,18 @@ void RiscVUnaryVectorOpWithFflags(
   int vector_index = rv_vector->vstart();
   int start_reg = vector_index / elements_per_vector;
   int item_index = vector_index % elements_per_vector;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
   // Iterate over the number of registers to write.
   uint32_t fflags = 0;
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
+    vs2_reader.SetRegister(reg);
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
     for (int i = item_index;
@@ -356,7 +501,7 @@ void RiscVUnaryVectorOpWithFflags(
       bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
       if (mask_value) {
         // Compute result.
-        Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
+        Vs2 vs2 = vs2_reader.Get(i, vector_index);
         auto [value, flag] = op(vs2);
         dest_span[i] = value;
         fflags |= flag;
@@ -376,10 +521,9 @@ void RiscVUnaryVectorOpWithFflags(
 // This helper function handles the case of mask + two source operand vector
 // operations. It implements all the checking necessary for both widening and
 // narrowing operations.
-template <typename Vd, typename Vs2, typename Vs1>
-void RiscVMaskBinaryVectorOp(
-    RiscVVectorState *rv_vector, const Instruction *inst,
-    std::function<std::optional<Vd>(Vs2, Vs1, bool)> op) {
+template <typename Vd, typename Vs2, typename Vs1, typename Operation>
+void RiscVMaskBinaryVectorOp(RiscVVectorState *rv_vector,
+                             const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int lmul = rv_vector->vector_length_multiplier();
@@ -420,13 +564,20 @@ void RiscVMaskBinaryVectorOp(
   int item_index = vector_index % elements_per_vector;
   // Determine if it's vector-vector or vector-scalar.
   bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
+  RiscVVectorSourceReader<Vs1> vs1_reader(inst, 1, elements_per_vector);
   // Iterate over the number of registers to write.
   bool exception = false;
   for (int reg = start_reg;
        !exception && (reg < max_regs) && (vector_index < num_elements); reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
+    vs2_reader.SetRegister(reg);
+    vs1_reader.SetRegister(reg);
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
     for (int i = item_index;
@@ -436,9 +587,8 @@ void RiscVMaskBinaryVectorOp(
       int mask_offset = vector_index & 0b111;
       bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
       // Compute result.
-      Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
-      Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1,
-                                          (vector_scalar ? 0 : vector_index));
+      Vs2 vs2 = vs2_reader.Get(i, vector_index);
+      Vs1 vs1 = vs1_reader.Get(i, vector_scalar ? 0 : vector_index);
       auto value = op(vs2, vs1, mask_value);
       if (value.has_value()) {
         dest_span[i] = value.value();
@@ -453,6 +603,15 @@ void RiscVMaskBinaryVectorOp(
       }
       vector_index++;
     }
+    if (exception && overwrite) {
+      // The elements from the faulting one on are left undisturbed, so merge
+      // the elements computed so far into a copy of the register.
+      auto *copy_db = dest_op->CopyDataBuffer(reg);
+      std::memcpy(copy_db->raw_ptr(), dest_db->raw_ptr(),
+                  (vector_index - reg * elements_per_vector) * sizeof(Vd));
+      dest_db->DecRef();
+      dest_db = copy_db;
+    }
     // Submit the destination db .
     dest_db->Submit();
     item_index = 0;
@@ -463,9 +622,9 @@ void RiscVMaskBinaryVectorOp(
 // This helper function handles the case of two source operand vector
 // operations. It implements all the checking necessary for both widening and
 // narrowing operations.
-template <typename Vd, typename Vs2, typename Vs1>
+template <typename Vd, typename Vs2, typename Vs1, typename Operation>
 void RiscVBinaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
-                         std::function<Vd(Vs2, Vs1)> op) {
+                         Operation op) {
   RiscVMaskBinaryVectorOp<Vd, Vs2, Vs1>(
       rv_vector, inst,
       [op](Vs2 vs2, Vs1 vs1, bool mask_value) -> std::optional<Vd> {
@@ -476,10 +635,9 @@ void RiscVBinaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
       });
 }
 
-template <typename Vd, typename Vs2, typename Vs1>
-void RiscVBinaryVectorOpWithFflags(
-    RiscVVectorState *rv_vector, const Instruction *inst,
-    std::function<std::tuple<Vd, uint32_t>(Vs2, Vs1)> op) {
+template <typename Vd, typename Vs2, typename Vs1, typename Operation>
+void RiscVBinaryVectorOpWithFflags(RiscVVectorState *rv_vector,
+                                   const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int lmul = rv_vector->vector_length_multiplier();
@@ -520,14 +678,21 @@ void RiscVBinaryVectorOpWithFflags(
   int item_index = vector_index % elements_per_vector;
   // Determine if it's vector-vector or vector-scalar.
   bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
+  RiscVVectorSourceReader<Vs1> vs1_reader(inst, 1, elements_per_vector);
   // Iterate over the number of registers to write.
   bool exception = false;
   uint32_t fflags = 0;
   for (int reg = start_reg;
        !exception && (reg < max_regs) && (vector_index < num_elements); reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
+    vs2_reader.SetRegister(reg);
+    vs1_reader.SetRegister(reg);
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
     for (int i = item_index;
@@ -537,9 +702,8 @@ void RiscVBinaryVectorOpWithFflags(
       int mask_offset = vector_index & 0b111;
       bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
       // Compute result.
-      Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
-      Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1,
-                                          (vector_scalar ? 0 : vector_index));
+      Vs2 vs2 = vs2_reader.Get(i, vector_index);
+      Vs1 vs1 = vs1_reader.Get(i, vector_scalar ? 0 : vector_index);
       if (mask_value) {
         auto [value, flag] = op(vs2, vs1);
         dest_span[i] = value;
@@ -552,6 +716,15 @@ void RiscVBinaryVectorOpWithFflags(
       }
       vector_index++;
     }
+    if (exception && overwrite) {
+      // The elements from the faulting one on are left undisturbed, so merge
+      // the elements computed so far into a copy of the register.
+      auto *copy_db = dest_op->CopyDataBuffer(reg);
+      std::memcpy(copy_db->raw_ptr(), dest_db->raw_ptr(),
+                  (vector_index - reg * elements_per_vector) * sizeof(Vd));
+      dest_db->DecRef();
+      dest_db = copy_db;
+    }
     // Submit the destination dbs.
     dest_db->Submit();
     item_index = 0;
@@ -565,9 +738,9 @@ void RiscVBinaryVectorOpWithFflags(
 // This helper function handles three source operand vector operations. It
 // implements all the checking necessary for both widening and narrowing
 // operations.
-template <typename Vd, typename Vs2, typename Vs1>
+template <typename Vd, typename Vs2, typename Vs1, typename Operation>
 void RiscVTernaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
-                          std::function<Vd(Vs2, Vs1, Vd)> op) {
+                          Operation op) {
   if (rv_vector->vector_exception()) return;
   int num_elements = rv_vector->vector_length();
   int lmul = rv_vector->vector_length_multiplier();
@@ -608,12 +781,21 @@ void RiscVTernaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
   int item_index = vector_index % elements_per_vector;
   // Determine if it's vector-vector or vector-scalar.
   bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  RiscVVectorSourceReader<Vs2> vs2_reader(inst, 0, elements_per_vector);
+  RiscVVectorSourceReader<Vs1> vs1_reader(inst, 1, elements_per_vector);
+  RiscVVectorSourceReader<Vd> vd_reader(inst, 2, elements_per_vector);
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    // Allocate data buffer for the new register data. The register contents
+    // are only copied if some of its elements are left undisturbed.
+    bool overwrite = OverwritesRegister(mask_span, reg, elements_per_vector,
+                                        rv_vector->vstart(), num_elements);
+    auto *dest_db = dest_op->WriteDataBuffer(reg, overwrite);
     auto dest_span = dest_db->Get<Vd>();
+    vs2_reader.SetRegister(reg);
+    vs1_reader.SetRegister(reg);
+    vd_reader.SetRegister(reg);
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
     for (int i = item_index;
@@ -623,10 +805,9 @@ void RiscVTernaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
       int mask_offset = vector_index & 0b111;
       bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
       // Compute result.
-      Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
-      Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1,
-                                          (vector_scalar ? 0 : vector_index));
-      Vd vd = GetInstructionSource<Vd>(inst, 2, vector_index);
+      Vs2 vs2 = vs2_reader.Get(i, vector_index);
+      Vs1 vs1 = vs1_reader.Get(i, vector_scalar ? 0 : vector_index);
+      Vd vd = vd_reader.Get(i, vector_index);
       if (mask_value) {
         dest_span[i] = op(vs2, vs1, vd);
       }
@@ -642,10 +823,9 @@ void RiscVTernaryVectorOp(RiscVVectorState *rv_vector, const Instruction *inst,
 // The reduction instructions take Vs1[0], and all the elements (subject to
 // masking) from Vs2 and apply the reduction operation to produce a single
 // element that is written to Vd[0].
-template <typename Vd, typename Vs2, typename Vs1>
+template <typename Vd, typename Vs2, typename Vs1, typename Operation>
 void RiscVBinaryReductionVectorOp(RiscVVectorState *rv_vector,
-                                  const Instruction *inst,
-                                  std::function<Vd(Vd, Vs2)> op) {
+                                  const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   if (rv_vector->vstart()) {
     rv_vector->vector_exception();
@@ -16,15 +16,21 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <new>
+#include <utility>
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/register.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "riscv/riscv_mmu.h"
+#include "riscv/riscv_pmp.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
+#include "riscv/riscv_vector_instruction_helpers.h"
 #include "riscv/riscv_vector_state.h"
 
 namespace mpact {
@@ -32,6 +38,329 @@ namespace sim {
 namespace riscv {
 
 using generic::GetInstructionSource;
+using generic::operator*;  // NOLINT: is used below (clang error).
+
+// Unit stride fast path. Unit stride loads and stores where all the elements
+// in [vstart, vl) are active access a contiguous block of memory that maps to
+// a contiguous byte range of the register group. Instead of computing a
+// buffer of element addresses and element masks for a gather/scatter memory
+// access, these helpers perform the access with a single block load or store
+// and copy the data directly between the memory data buffer and the register
+// data buffers. Masked and strided accesses, and accesses that would fault,
+// use the generic element by element path.
+
+// Returns true if all the elements in [start, end) are active in the mask
+// operand at source index mask_index.
+static bool AllElementsActive(const Instruction *inst, int mask_index,
+                              int start, int end) {
+  auto *mask_op =
+      static_cast<RV32VectorSourceOperand *>(inst->Source(mask_index));
+  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  return MaskRangeIsAllOnes(mask_span, start, end);
+}
+
+// Translates the address of an access to the memory range [address, address +
+// size) and checks that the access can be performed without a fault. Returns
+// false, without raising an exception, if it can't, so that the generic path
+// is used instead, which raises the exception for the first faulting element.
+// When address translation is enabled, the range has to be within a single
+// page, as the pages may not be contiguous in physical memory.
+static bool TranslateContiguous(RiscVState *state, uint64_t address, int size,
+                                bool is_store, uint64_t *physical) {
+  uint64_t last = address + size - 1;
+  if (last < address) return false;
+  *physical = address;
+  if (state->address_translation() &&
+      state->mmu()->IsDataTranslationEnabled()) {
+    if ((last >> RiscVMmu::kPageShift) != (address >> RiscVMmu::kPageShift)) {
+      return false;
+    }
+    ExceptionCode code;
+    uint64_t fault_address;
+    auto type =
+        is_store ? RiscVMmu::AccessType::kStore : RiscVMmu::AccessType::kLoad;
+    if (!state->mmu()->TranslateDataAccess(address, size, type, physical,
+                                           &code, &fault_address)) {
+      return false;
+    }
+    last = *physical + size - 1;
+  }
+  if (last > state->max_physical_address()) return false;
+  int permissions = is_store ? *PmpCfgBits::kWrite : *PmpCfgBits::kRead;
+  return !state->memory_protection() ||
+         state->pmp()->IsAccessAllowed(*physical, size, permissions,
+                                       state->data_privilege_mode());
+}
+
+// Loads bytes [start_byte, end_byte) of the destination register group of the
+// child instruction from memory at base + start_byte with a single memory
+// access. Returns false, without performing the load, if the generic path
+// has to be used instead.
+static bool LoadContiguous(const Instruction *inst, uint64_t base,
+                           int start_byte, int end_byte) {
+  auto *state = static_cast<RiscVState *>(inst->state());
+  int num_bytes = end_byte - start_byte;
+  if ((num_bytes <= 0) || (inst->child() == nullptr)) return false;
+  uint64_t physical;
+  if (!TranslateContiguous(state, base + start_byte, num_bytes,
+                           /*is_store*/ false, &physical)) {
+    return false;
+  }
+  int vlenb = state->rv_vector()->vector_register_byte_length();
+  auto *dest_op = static_cast<RV32VectorDestinationOperand *>(
+      inst->child()->Destination(0));
+  if (dest_op->size() * vlenb < end_byte) return false;
+  auto *data_db = state->db_factory()->Allocate<uint8_t>(num_bytes);
+  data_db->set_latency(0);
+  // The access has been translated and checked, so it can't fault.
+  state->memory()->Load(physical, data_db, nullptr, nullptr);
+  auto *data = static_cast<uint8_t *>(data_db->raw_ptr());
+  for (int reg = start_byte / vlenb; reg * vlenb < end_byte; reg++) {
+    int reg_start = std::max(start_byte, reg * vlenb);
+    int reg_end = std::min(end_byte, (reg + 1) * vlenb);
+    // Only copy the prior register contents if part of it is preserved.
+    bool whole_register = (reg_end - reg_start) == vlenb;
+    auto *dest_db = dest_op->WriteDataBuffer(reg, whole_register);
+    std::memcpy(static_cast<uint8_t *>(dest_db->raw_ptr()) + reg_start -
+                    reg * vlenb,
+                data + reg_start - start_byte, reg_end - reg_start);
+    dest_db->Submit(0);
+  }
+  data_db->DecRef();
+  return true;
+}
+
+// Stores bytes [start_byte, end_byte) of the register group of the source
+// operand at index data_index to memory at base + start_byte with a single
+// memory access. Returns false, without performing the store, if the generic
+// path has to be used instead.
+static bool StoreContiguous(const Instruction *inst, int data_index,
+                            uint64_t base, int start_byte, int end_byte) {
+  auto *state = static_cast<RiscVState *>(inst->state());
+  int num_bytes = end_byte - start_byte;
+  if (num_bytes <= 0) return false;
+  uint64_t physical;
+  if (!TranslateContiguous(state, base + start_byte, num_bytes,
+                           /*is_store*/ true, &physical)) {
+    return false;
+  }
+  int vlenb = state->rv_vector()->vector_register_byte_length();
+  auto *src_op =
+      static_cast<RV32VectorSourceOperand *>(inst->Source(data_index));
+  if ((src_op->size() * vlenb < end_byte) ||
+      (src_op->ElementsPerRegister<uint8_t>() != vlenb)) {
+    return false;
+  }
+  auto *data_db = state->db_factory()->Allocate<uint8_t>(num_bytes);
+  auto *data = static_cast<uint8_t *>(data_db->raw_ptr());
+  for (int reg = start_byte / vlenb; reg * vlenb < end_byte; reg++) {
+    int reg_start = std::max(start_byte, reg * vlenb);
+    int reg_end = std::min(end_byte, (reg + 1) * vlenb);
+    std::memcpy(data + reg_start - start_byte,
+                src_op->GetRegisterSpan<uint8_t>(reg).data() + reg_start -
+                    reg * vlenb,
+                reg_end - reg_start);
+  }
+  state->memory()->Store(physical, data_db);
+  data_db->DecRef();
+  return true;
+}
+
+// Unit stride segment loads and stores where all the segments in [vstart, vl)
+// are active access a contiguous block of memory that holds the interleaved
+// fields of the segments. They are performed with a single block access, and
+// the fields are de-interleaved into (or interleaved from) the field register
+// groups one register at a time.
+
+// Copies count segments of kNumFields elements of type T from the interleaved
+// array src to the field arrays fields[0..kNumFields). The number of fields is
+// a compile time constant so that the field loop is unrolled and the copy can
+// be vectorized by the compiler.
+template <typename T, int kNumFields>
+void DeinterleaveSegments(const uint8_t *src, uint8_t *const *fields,
+                          int count) {
+  const T *segments = reinterpret_cast<const T *>(src);
+  T *field_values[kNumFields];
+  for (int field = 0; field < kNumFields; field++) {
+    field_values[field] = reinterpret_cast<T *>(fields[field]);
+  }
+  for (int i = 0; i < count; i++) {
+    for (int field = 0; field < kNumFields; field++) {
+      field_values[field][i] = segments[i * kNumFields + field];
+    }
+  }
+}
+
+// Copies count segments of kNumFields elements of type T from the field arrays
+// fields[0..kNumFields) to the interleaved array dest.
+template <typename T, int kNumFields>
+void InterleaveSegments(const uint8_t *const *fields, uint8_t *dest,
+                        int count) {
+  T *segments = reinterpret_cast<T *>(dest);
+  const T *field_values[kNumFields];
+  for (int field = 0; field < kNumFields; field++) {
+    field_values[field] = reinterpret_cast<const T *>(fields[field]);
+  }
+  for (int i = 0; i < count; i++) {
+    for (int field = 0; field < kNumFields; field++) {
+      segments[i * kNumFields + field] = field_values[field][i];
+    }
+  }
+}
+
+using DeinterleaveFunction = void (*)(const uint8_t *, uint8_t *const *, int);
+using InterleaveFunction = void (*)(const uint8_t *const *, uint8_t *, int);
+
+// Returns the de-interleave and interleave functions for elements of type T
+// and the given number of fields.
+template <typename T>
+std::pair<DeinterleaveFunction, InterleaveFunction> GetSegmentFunctions(
+    int num_fields) {
+  switch (num_fields) {
+    case 1:
+      return {DeinterleaveSegments<T, 1>, InterleaveSegments<T, 1>};
+    case 2:
+      return {DeinterleaveSegments<T, 2>, InterleaveSegments<T, 2>};
+    case 3:
+      return {DeinterleaveSegments<T, 3>, InterleaveSegments<T, 3>};
+    case 4:
+      return {DeinterleaveSegments<T, 4>, InterleaveSegments<T, 4>};
+    case 5:
+      return {DeinterleaveSegments<T, 5>, InterleaveSegments<T, 5>};
+    case 6:
+      return {DeinterleaveSegments<T, 6>, InterleaveSegments<T, 6>};
+    case 7:
+      return {DeinterleaveSegments<T, 7>, InterleaveSegments<T, 7>};
+    case 8:
+      return {DeinterleaveSegments<T, 8>, InterleaveSegments<T, 8>};
+    default:
+      return {nullptr, nullptr};
+  }
+}
+
+// Returns the de-interleave and interleave functions for the given element
+// width and number of fields, or nullptrs if there are none.
+static std::pair<DeinterleaveFunction, InterleaveFunction> GetSegmentFunctions(
+    int element_width, int num_fields) {
+  switch (element_width) {
+    case 1:
+      return GetSegmentFunctions<uint8_t>(num_fields);
+    case 2:
+      return GetSegmentFunctions<uint16_t>(num_fields);
+    case 4:
+      return GetSegmentFunctions<uint32_t>(num_fields);
+    case 8:
+      return GetSegmentFunctions<uint64_t>(num_fields);
+    default:
+      return {nullptr, nullptr};
+  }
+}
+
+// Loads segments [start, num_segments) from memory at base + start * segment
+// size with a single memory access, and de-interleaves them into the field
+// register groups of the child instruction destination. Field f occupies
+// registers [f * regs_per_field, (f + 1) * regs_per_field). Returns false,
+// without performing the load, if the generic path has to be used instead.
+static bool LoadSegmentsContiguous(const Instruction *inst, uint64_t base,
+                                   int element_width, int num_fields,
+                                   int regs_per_field, int start,
+                                   int num_segments) {
+  auto *state = static_cast<RiscVState *>(inst->state());
+  if ((start >= num_segments) || (inst->child() == nullptr)) return false;
+  auto deinterleave = GetSegmentFunctions(element_width, num_fields).first;
+  if (deinterleave == nullptr) return false;
+  int segment_size = num_fields * element_width;
+  int num_bytes = (num_segments - start) * segment_size;
+  uint64_t address = base + start * segment_size;
+  uint64_t physical;
+  if (!TranslateContiguous(state, address, num_bytes, /*is_store*/ false,
+                           &physical)) {
+    return false;
+  }
+  int elements_per_vector =
+      state->rv_vector()->vector_register_byte_length() / element_width;
+  auto *dest_op = static_cast<RV32VectorDestinationOperand *>(
+      inst->child()->Destination(0));
+  if ((dest_op->size() < num_fields * regs_per_field) ||
+      (num_segments > regs_per_field * elements_per_vector)) {
+    return false;
+  }
+  auto *data_db = state->db_factory()->Allocate<uint8_t>(num_bytes);
+  data_db->set_latency(0);
+  state->memory()->Load(physical, data_db, nullptr, nullptr);
+  auto *data = static_cast<const uint8_t *>(data_db->raw_ptr());
+  generic::DataBuffer *field_dbs[8];
+  uint8_t *fields[8];
+  for (int reg = start / elements_per_vector;
+       reg * elements_per_vector < num_segments; reg++) {
+    int first = std::max(start, reg * elements_per_vector);
+    int last = std::min(num_segments, (reg + 1) * elements_per_vector);
+    // Only copy the prior register contents if part of it is preserved.
+    bool whole_register = (last - first) == elements_per_vector;
+    int offset = (first - reg * elements_per_vector) * element_width;
+    for (int field = 0; field < num_fields; field++) {
+      int dest_reg = field * regs_per_field + reg;
+      field_dbs[field] = dest_op->WriteDataBuffer(dest_reg, whole_register);
+      fields[field] =
+          static_cast<uint8_t *>(field_dbs[field]->raw_ptr()) + offset;
+    }
+    deinterleave(data + (first - start) * segment_size, fields, last - first);
+    for (int field = 0; field < num_fields; field++) {
+      field_dbs[field]->Submit(0);
+    }
+  }
+  data_db->DecRef();
+  return true;
+}
+
+// Interleaves segments [start, num_segments) from the field register groups of
+// the source operand at index data_index, laid out as for the load above, and
+// stores them to memory at base + start * segment size with a single memory
+// access. Returns false, without performing the store, if the generic path has
+// to be used instead.
+static bool StoreSegmentsContiguous(const Instruction *inst, int data_index,
+                                    uint64_t base, int element_width,
+                                    int num_fields, int regs_per_field,
+                                    int start, int num_segments) {
+  auto *state = static_cast<RiscVState *>(inst->state());
+  if (start >= num_segments) return false;
+  auto interleave = GetSegmentFunctions(element_width, num_fields).second;
+  if (interleave == nullptr) return false;
+  int segment_size = num_fields * element_width;
+  int num_bytes = (num_segments - start) * segment_size;
+  uint64_t address = base + start * segment_size;
+  uint64_t physical;
+  if (!TranslateContiguous(state, address, num_bytes, /*is_store*/ true,
+                           &physical)) {
+    return false;
+  }
+  int vlenb = state->rv_vector()->vector_register_byte_length();
+  int elements_per_vector = vlenb / element_width;
+  auto *src_op =
+      static_cast<RV32VectorSourceOperand *>(inst->Source(data_index));
+  if ((src_op->size() < num_fields * regs_per_field) ||
+      (src_op->ElementsPerRegister<uint8_t>() != vlenb) ||
+      (num_segments > regs_per_field * elements_per_vector)) {
+    return false;
+  }
+  auto *data_db = state->db_factory()->Allocate<uint8_t>(num_bytes);
+  auto *data = static_cast<uint8_t *>(data_db->raw_ptr());
+  const uint8_t *fields[8];
+  for (int reg = start / elements_per_vector;
+       reg * elements_per_vector < num_segments; reg++) {
+    int first = std::max(start, reg * elements_per_vector);
+    int last = std::min(num_segments, (reg + 1) * elements_per_vector);
+    int offset = (first - reg * elements_per_vector) * element_width;
+    for (int field = 0; field < num_fields; field++) {
+      int src_reg = field * regs_per_field + reg;
+      fields[field] = src_op->GetRegisterSpan<uint8_t>(src_reg).data() + offset;
+    }
+    interleave(fields, data + (first - start) * segment_size, last - first);
+  }
+  state->memory()->Store(physical, data_db);
+  data_db->DecRef();
+  return true;
+}
 
 // Helper function used by the load child instructions (non segment loads) that
 // writes the loaded data into the registers.
@@ -89,10 +418,11 @@ absl::Status WriteBackLoadData(int vector_register_byte_length,
 }
 
 // Helper function used by the load child instructions (for segment loads) that
-// writes the loaded data into the registers.
+// writes the loaded data into the registers. Each field is written to its own
+// group of num_regs (EMUL) registers, independent of the vector length.
 template <typename T>
 absl::Status WriteBackSegmentLoadData(int vector_register_byte_length,
-                                      const Instruction *inst) {
+                                      int num_regs, const Instruction *inst) {
   // The number of fields in each segment.
   int num_fields = GetInstructionSource<uint32_t>(inst, 0) + 1;
   // Get values from context.
@@ -100,51 +430,45 @@ absl::Status WriteBackSegmentLoadData(int vector_register_byte_length,
   auto masks = context->mask_db->Get<bool>();
   auto values = context->value_db->Get<T>();
   int start_segment = context->vstart;
-  int vector_length = context->vlength;
+  int num_segments = context->vlength;
 
-  int element_size = sizeof(T);
-  int num_segments = masks.size() / num_fields;
-  // Number of registers written for each field.
-  int max_elements_per_vector =
-      std::min(vector_register_byte_length / element_size, num_segments);
-  int num_regs =
-      std::max(1, num_segments * element_size / vector_register_byte_length);
-  // Total number of registers written.
-  int total_regs = num_fields * num_regs;
+  if (static_cast<int>(masks.size()) != num_fields * num_segments) {
+    return absl::InternalError(
+        absl::StrCat("The number of mask elements (", masks.size(),
+                     ") differs from the number of elements to write (",
+                     num_fields * num_segments, ")"));
+  }
+  int elements_per_vector = vector_register_byte_length / sizeof(T);
+  if (num_segments > num_regs * elements_per_vector) {
+    return absl::InternalError(
+        absl::StrCat("Vector length (", num_segments,
+                     ") exceeds the register group size (",
+                     num_regs * elements_per_vector, ")"));
+  }
   // Verify that the dest_op has enough registers. Else signal error.
   auto *dest_op =
       static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
-  if (dest_op->size() < total_regs) {
+  if (dest_op->size() < num_fields * num_regs) {
     return absl::InternalError("Not enough registers in destination operand");
   }
-  // Compute the number of segments to be written.
-  if (vector_length - start_segment != num_segments) {
-    return absl::InternalError(
-        absl::StrCat("The number of mask elements (", num_segments,
-                     ") differs from the number of elements to write (",
-                     vector_length - start_segment, ")"));
-  }
-  int load_data_index = 0;
   // Data is organized by field. So write back in that order.
   for (int field = 0; field < num_fields; field++) {
-    int start_reg =
-        field * num_regs + (start_segment / max_elements_per_vector);
-    int offset = start_segment % max_elements_per_vector;
-    int remaining_data = num_segments;
-    for (int reg = start_reg; reg < start_reg + num_regs; reg++) {
+    int index = field * num_segments + start_segment;
+    int end_index = (field + 1) * num_segments;
+    int reg = field * num_regs + start_segment / elements_per_vector;
+    int offset = start_segment % elements_per_vector;
+    while (index < end_index) {
       auto *dest_db = dest_op->CopyDataBuffer(reg);
       auto span = dest_db->Get<T>();
-      int max_entry =
-          std::min(remaining_data + offset, max_elements_per_vector);
-      for (int i = offset; i < max_entry; i++) {
-        if (masks[load_data_index]) {
-          span[i] = values[load_data_index];
+      int max_entry = std::min(elements_per_vector, offset + end_index - index);
+      for (int i = offset; i < max_entry; i++, index++) {
+        if (masks[index]) {
+          span[i] = values[index];
         }
-        load_data_index++;
-        remaining_data--;
       }
-      offset = 0;
       dest_db->Submit(0);
+      offset = 0;
+      reg++;
     }
   }
   return absl::OkStatus();
@@ -231,6 +555,14 @@ void VlStrided(int element_width, const Instruction *inst) {
   int num_elements = rv_vector->vector_length();
   int num_elements_loaded = num_elements - start;
 
+  if ((stride == element_width) &&
+      AllElementsActive(inst, 2, start, num_elements) &&
+      LoadContiguous(inst, base, start * element_width,
+                     num_elements * element_width)) {
+    rv_vector->clear_vstart();
+    return;
+  }
+
   // Allocate address data buffer.
   auto *db_factory = inst->state()->db_factory();
   auto *address_db = db_factory->Allocate<uint64_t>(num_elements_loaded);
@@ -416,6 +748,10 @@ void VlRegister(int num_regs, int element_width_bytes,
   uint64_t base = GetInstructionSource<uint64_t>(inst, 0);
   int num_elements =
       rv_vector->vector_register_byte_length() * num_regs / element_width_bytes;
+  if (LoadContiguous(inst, base, 0, num_elements * element_width_bytes)) {
+    rv_vector->clear_vstart();
+    return;
+  }
   // Allocate data buffers.
   auto *db_factory = inst->state()->db_factory();
   auto *data_db = db_factory->Allocate(num_elements * element_width_bytes);
@@ -477,6 +813,12 @@ void VlSegment(int element_width, const Instruction *inst) {
     return;
   }
   int num_segments = rv_vector->vector_length();
+  if (AllElementsActive(inst, 1, start, num_segments) &&
+      LoadSegmentsContiguous(inst, base, element_width, num_fields,
+                             std::max(1, emul / 8), start, num_segments)) {
+    rv_vector->clear_vstart();
+    return;
+  }
   int segment_stride = num_fields * element_width;
   int num_elements = num_fields * num_segments;
   // Set up data buffers.
@@ -697,18 +1039,25 @@ void VlSegmentChild(int element_width, const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
   absl::Status status;
   int byte_length = rv_vector->vector_register_byte_length();
-  switch (static_cast<VectorLoadContext *>(inst->context())->element_width) {
+  int data_width =
+      static_cast<VectorLoadContext *>(inst->context())->element_width;
+  // Each field occupies a register group of EMUL registers. Use the width of
+  // the loaded data, as for indexed loads the bound width is the index width.
+  int emul = (data_width * rv_vector->vector_length_multiplier()) /
+             rv_vector->selected_element_width();
+  int num_regs = std::max(1, emul / 8);
+  switch (data_width) {
     case 1:
-      status = WriteBackSegmentLoadData<uint8_t>(byte_length, inst);
+      status = WriteBackSegmentLoadData<uint8_t>(byte_length, num_regs, inst);
       break;
     case 2:
-      status = WriteBackSegmentLoadData<uint16_t>(byte_length, inst);
+      status = WriteBackSegmentLoadData<uint16_t>(byte_length, num_regs, inst);
       break;
     case 4:
-      status = WriteBackSegmentLoadData<uint32_t>(byte_length, inst);
+      status = WriteBackSegmentLoadData<uint32_t>(byte_length, num_regs, inst);
       break;
     case 8:
-      status = WriteBackSegmentLoadData<uint64_t>(byte_length, inst);
+      status = WriteBackSegmentLoadData<uint64_t>(byte_length, num_regs, inst);
       break;
     default:
       LOG(ERROR) << "Illegal element width";
@@ -776,6 +1125,13 @@ void VsStrided(int element_width, const Instruction *inst) {
   }
   int vlength = rv_vector->vector_length();
   int vstart = rv_vector->vstart();
+  if ((GetInstructionSource<int64_t>(inst, 2) == element_width) &&
+      AllElementsActive(inst, 3, vstart, vlength) &&
+      StoreContiguous(inst, 0, GetInstructionSource<uint64_t>(inst, 1),
+                      vstart * element_width, vlength * element_width)) {
+    rv_vector->clear_vstart();
+    return;
+  }
   switch (element_width) {
     case 1:
       StoreVectorStrided<uint8_t>(vlength, vstart, emul, inst);
@@ -933,6 +1289,10 @@ void VsRegister(int num_regs, const Instruction *inst) {
   uint64_t base = GetInstructionSource<uint64_t>(inst, 1);
   int num_elements =
       rv_vector->vector_register_byte_length() * num_regs / sizeof(uint64_t);
+  if (StoreContiguous(inst, 0, base, 0, num_elements * sizeof(uint64_t))) {
+    rv_vector->clear_vstart();
+    return;
+  }
   // Allocate data buffers.
   auto *db_factory = inst->state()->db_factory();
   auto *data_db = db_factory->Allocate<uint64_t>(num_elements);
@@ -980,6 +1340,12 @@ void VsSegment(int element_width, const Instruction *inst) {
   int num_elements_per_reg =
       rv_vector->vector_register_byte_length() / element_width;
   int reg_mul = std::max(1, emul / 8);
+  if (AllElementsActive(inst, 2, start, num_segments) &&
+      StoreSegmentsContiguous(inst, 0, base_address, element_width,
+                              num_fields, reg_mul, start, num_segments)) {
+    rv_vector->clear_vstart();
+    return;
+  }
   // Set up data buffers.
   auto *db_factory = inst->state()->db_factory();
   auto *data_db = db_factory->Allocate(num_elements * element_width);
@@ -21,10 +21,12 @@
 #include <type_traits>
 
 #include "absl/log/log.h"
+#include "absl/types/span.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
+#include "riscv/riscv_vector_host_kernels.h"
 #include "riscv/riscv_vector_instruction_helpers.h"
 #include "riscv/riscv_vector_state.h"
 
@@ -41,11 +43,134 @@ using ::mpact::sim::generic::MakeUnsigned;
 using ::mpact::sim::generic::WideType;
 using std::numeric_limits;
 
+// Host kernel fast path.
+
+// Checks whether the instruction can be executed by the host kernels, and if
+// so, returns the number of registers of the destination group that are
+// written. That is the case if it starts at element 0, the source and
+// destination operands are vector register groups large enough to hold vl
+// elements, and source 1 is either a vector register group or a scalar.
+// Otherwise returns 0, and the instruction is executed element by element,
+// which also reports any errors.
+static int HostVectorOpRegisters(RiscVVectorState *rv_vector,
+                                 const Instruction *inst) {
+  if (rv_vector->vector_exception() || (rv_vector->vstart() != 0)) return 0;
+  int num_elements = rv_vector->vector_length();
+  int lmul = rv_vector->vector_length_multiplier();
+  if ((num_elements == 0) || (lmul == 0) || (lmul > 64)) return 0;
+  int sew = rv_vector->selected_element_width();
+  int vlenb = rv_vector->vector_register_byte_length();
+  int elements_per_vector = vlenb / sew;
+  int num_regs = (num_elements + elements_per_vector - 1) / elements_per_vector;
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  if (dest_op->size() < num_regs) return 0;
+  for (int i = 0; i < 2; i++) {
+    auto *op = inst->Source(i);
+    // Source 1 may be a scalar.
+    if ((i == 1) && (op->shape()[0] == 1)) continue;
+    auto *vector_op = static_cast<RV32VectorSourceOperand *>(op);
+    if ((vector_op->size() < num_regs) ||
+        (vector_op->ElementsPerRegister<uint8_t>() != vlenb)) {
+      return 0;
+    }
+  }
+  return num_regs;
+}
+
+// Executes the binary operation with the host kernels if the instruction is
+// unmasked, or the mask has all the active elements enabled, and the operands
+// allow it. Returns false if the instruction must be executed element by
+// element instead.
+static bool HostBinaryVectorOp(RiscVVectorState *rv_vector,
+                               const Instruction *inst, VectorHostOp op) {
+  int width_index =
+      VectorHostKernels::WidthIndex(rv_vector->selected_element_width());
+  if (width_index < 0) return false;
+  int num_regs = HostVectorOpRegisters(rv_vector, inst);
+  if (num_regs == 0) return false;
+  int num_elements = rv_vector->vector_length();
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
+  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  if (!MaskRangeIsAllOnes(mask_span, 0, num_elements)) return false;
+  auto &kernels = GetVectorHostKernels();
+  auto vv_kernel = kernels.vv[static_cast<int>(op)][width_index];
+  auto vx_kernel = kernels.vx[static_cast<int>(op)][width_index];
+  auto *vs2_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  auto *vs1_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
+  uint64_t rs1 = vector_scalar ? GetInstructionSource<uint64_t>(inst, 1, 0) : 0;
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  int elements_per_vector =
+      rv_vector->vector_register_byte_length() >> width_index;
+  for (int reg = 0; reg < num_regs; reg++) {
+    // Elements past vl are left undisturbed.
+    int count =
+        std::min(elements_per_vector, num_elements - reg * elements_per_vector);
+    auto *dest_db =
+        dest_op->WriteDataBuffer(reg, count == elements_per_vector);
+    uint8_t *vd = dest_db->Get<uint8_t>().data();
+    const uint8_t *vs2 = vs2_op->GetRegisterSpan<uint8_t>(reg).data();
+    if (vector_scalar) {
+      vx_kernel(vd, vs2, rs1, count);
+    } else {
+      vv_kernel(vd, vs2, vs1_op->GetRegisterSpan<uint8_t>(reg).data(), count);
+    }
+    dest_db->Submit();
+  }
+  rv_vector->clear_vstart();
+  return true;
+}
+
+// Executes vmerge with the host kernels if the operands allow it. Returns false
+// if the instruction must be executed element by element instead.
+static bool HostVectorMerge(RiscVVectorState *rv_vector,
+                            const Instruction *inst) {
+  int width_index =
+      VectorHostKernels::WidthIndex(rv_vector->selected_element_width());
+  if (width_index < 0) return false;
+  int num_regs = HostVectorOpRegisters(rv_vector, inst);
+  if (num_regs == 0) return false;
+  int num_elements = rv_vector->vector_length();
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
+  const uint8_t *mask =
+      mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>().data();
+  auto &kernels = GetVectorHostKernels();
+  auto *vs2_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  auto *vs1_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
+  uint64_t rs1 = vector_scalar ? GetInstructionSource<uint64_t>(inst, 1, 0) : 0;
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  int elements_per_vector =
+      rv_vector->vector_register_byte_length() >> width_index;
+  for (int reg = 0; reg < num_regs; reg++) {
+    int offset = reg * elements_per_vector;
+    int count = std::min(elements_per_vector, num_elements - offset);
+    auto *dest_db =
+        dest_op->WriteDataBuffer(reg, count == elements_per_vector);
+    uint8_t *vd = dest_db->Get<uint8_t>().data();
+    const uint8_t *vs2 = vs2_op->GetRegisterSpan<uint8_t>(reg).data();
+    if (vector_scalar) {
+      kernels.merge_vx[width_index](vd, vs2, rs1, mask, offset, count);
+    } else {
+      kernels.merge_vv[width_index](
+          vd, vs2, vs1_op->GetRegisterSpan<uint8_t>(reg).data(), mask, offset,
+          count);
+    }
+    dest_db->Submit();
+  }
+  rv_vector->clear_vstart();
+  return true;
+}
+
 // Vector arithmetic operations.
 
 // Vector add.
 void Vadd(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kAdd)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -74,6 +199,7 @@ void Vadd(Instruction *inst) {
 // Vector subtract.
 void Vsub(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kSub)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -102,6 +228,7 @@ void Vsub(Instruction *inst) {
 // Vector reverse subtract.
 void Vrsub(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kRsub)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -132,6 +259,7 @@ void Vrsub(Instruction *inst) {
 // Vector and.
 void Vand(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kAnd)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -160,6 +288,7 @@ void Vand(Instruction *inst) {
 // Vector or.
 void Vor(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kOr)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -188,6 +317,7 @@ void Vor(Instruction *inst) {
 // Vector xor.
 void Vxor(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kXor)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -218,6 +348,7 @@ void Vxor(Instruction *inst) {
 // Vector shift left logical.
 void Vsll(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kSll)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -250,6 +381,7 @@ void Vsll(Instruction *inst) {
 // Vector shift right logical.
 void Vsrl(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kSrl)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -282,6 +414,7 @@ void Vsrl(Instruction *inst) {
 // Vector shift right arithmetic.
 void Vsra(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kSra)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -387,6 +520,7 @@ void Vnsra(Instruction *inst) {
 // Vector unsigned min.
 void Vminu(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kMinu)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -419,6 +553,7 @@ void Vminu(Instruction *inst) {
 // Vector signed min.
 void Vmin(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kMin)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -450,6 +585,7 @@ void Vmin(Instruction *inst) {
 // Vector unsigned max.
 void Vmaxu(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kMaxu)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -482,6 +618,7 @@ void Vmaxu(Instruction *inst) {
 // Vector signed max.
 void Vmax(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostBinaryVectorOp(rv_vector, inst, VectorHostOp::kMax)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -1098,6 +1235,7 @@ void Vmsbc(Instruction *inst) {
 // Vector merge.
 void Vmerge(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostVectorMerge(rv_vector, inst)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
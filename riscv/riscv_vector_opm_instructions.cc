@@ -15,7 +15,6 @@
 #include "riscv/riscv_vector_opm_instructions.h"
 
 #include <cstdint>
-#include <functional>
 #include <limits>
 #include <optional>
 #include <type_traits>
@@ -186,10 +185,10 @@ void Vasub(const Instruction *inst) {
 
 // Mask operands only operate on a single vector register. This helper function
 // is used by the following bitwise mask manipulation instruction semantic
-// functions.
-static inline void BitwiseMaskBinaryOp(
-    RiscVVectorState *rv_vector, const Instruction *inst,
-    std::function<uint8_t(uint8_t, uint8_t)> op) {
+// functions. The operation is applied to 64 bit words of the mask registers.
+template <typename Operation>
+static inline void BitwiseMaskBinaryOp(RiscVVectorState *rv_vector,
+                                       const Instruction *inst, Operation op) {
   if (rv_vector->vector_exception()) return;
   int vstart = rv_vector->vstart();
   int vlen = rv_vector->vector_length();
@@ -202,25 +201,15 @@ static inline void BitwiseMaskBinaryOp(
       static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
   auto *vd_db = vd_op->CopyDataBuffer();
   auto vd_span = vd_db->Get<uint8_t>();
-  // Compute start and end locations.
-  int start_byte = vstart / 8;
-  int start_offset = vstart % 8;
-  uint8_t start_mask = 0b1111'1111 << start_offset;
-  int end_byte = (vlen - 1) / 8;
-  int end_offset = (vlen - 1) % 8;
-  uint8_t end_mask = 0b1111'1111 >> (7 - end_offset);
-  // The start byte is computed first, applying a mask to mask out any preceding
-  // bits.
-  vd_span[start_byte] =
-      (op(vs2_span[start_byte], vs1_span[start_byte]) & start_mask) |
-      (vd_span[start_byte] & ~start_mask);
-  // Perform the bitwise operation on each byte between start and end.
-  for (int i = start_byte + 1; i < end_byte; i++) {
-    vd_span[i] = op(vs2_span[i], vs1_span[i]);
+  // Perform the bitwise operation on each word that holds elements in
+  // [vstart, vl), masking out the bits of any elements outside that range.
+  for (int word = vstart >> 6; word * 64 < vlen; word++) {
+    uint64_t range = MaskWordRange(word, vstart, vlen);
+    uint64_t result =
+        op(GetMaskWord(vs2_span, word), GetMaskWord(vs1_span, word));
+    SetMaskWord(vd_span, word,
+                (result & range) | (GetMaskWord(vd_span, word) & ~range));
   }
-  // Perform the bitwise operation with a mask on the end byte.
-  vd_span[end_byte] = (op(vs2_span[end_byte], vs1_span[end_byte]) & end_mask) |
-                      (vd_span[end_byte] & ~end_mask);
   vd_db->Submit();
   rv_vector->clear_vstart();
 }
@@ -228,52 +217,60 @@ static inline void BitwiseMaskBinaryOp(
 // Bitwise vector mask instructions. The operation is clear by their name.
 void Vmandnot(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return vs2 & ~vs1;
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return vs2 & ~vs1;
+                      });
 }
 
 void Vmand(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return vs2 & vs1;
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return vs2 & vs1;
+                      });
 }
 void Vmor(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return vs2 | vs1;
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return vs2 | vs1;
+                      });
 }
 void Vmxor(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return vs2 ^ vs1;
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return vs2 ^ vs1;
+                      });
 }
 void Vmornot(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return vs2 | ~vs1;
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return vs2 | ~vs1;
+                      });
 }
 void Vmnand(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return ~(vs2 & vs1);
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return ~(vs2 & vs1);
+                      });
 }
 void Vmnor(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return ~(vs2 | vs1);
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return ~(vs2 | vs1);
+                      });
 }
 void Vmxnor(const Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  BitwiseMaskBinaryOp(rv_vector, inst, [](uint8_t vs2, uint8_t vs1) -> uint8_t {
-    return ~(vs2 ^ vs1);
-  });
+  BitwiseMaskBinaryOp(rv_vector, inst,
+                      [](uint64_t vs2, uint64_t vs1) -> uint64_t {
+                        return ~(vs2 ^ vs1);
+                      });
 }
 
 // Vector unsigned divide. Note, just like the scalar divide instruction, a
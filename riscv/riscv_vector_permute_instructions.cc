@@ -17,10 +17,12 @@
 #include <algorithm>
 
 #include "absl/log/log.h"
+#include "absl/types/span.h"
 #include "mpact/sim/generic/data_buffer.h"
 #include "mpact/sim/generic/instruction.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
+#include "riscv/riscv_vector_instruction_helpers.h"
 #include "riscv/riscv_vector_state.h"
 
 namespace mpact {
@@ -65,6 +67,12 @@ void VrgatherHelper(RiscVVectorState *rv_vector, Instruction *inst) {
   bool vector_scalar = inst->Source(1)->shape()[0] == 1;
   auto src0_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
   int max_index = src0_op->size() * elements_per_vector;
+  // Read the source elements from contiguous copies of the register groups.
+  auto vs2_group = GetContiguousRegisterGroup<Vs2>(rv_vector, inst, 0, 0);
+  absl::Span<const Vs1> vs1_group;
+  if (!vector_scalar) {
+    vs1_group = GetContiguousRegisterGroup<Vs1>(rv_vector, inst, 1, 1);
+  }
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
@@ -85,12 +93,16 @@ void VrgatherHelper(RiscVVectorState *rv_vector, Instruction *inst) {
         if (vector_scalar) {
           vs1 = generic::GetInstructionSource<RV32Register::ValueType>(inst, 1,
                                                                        0);
+        } else if (vector_index < vs1_group.size()) {
+          vs1 = vs1_group[vector_index];
         } else {
           vs1 = generic::GetInstructionSource<Vs1>(inst, 1, vector_index);
         }
         Vs2 vs2 = 0;
         if (vs1 < max_index) {
-          vs2 = generic::GetInstructionSource<Vs2>(inst, 0, vs1);
+          vs2 = (vs1 < vs2_group.size())
+                    ? vs2_group[vs1]
+                    : generic::GetInstructionSource<Vs2>(inst, 0, vs1);
         }
         dest_span[i] = vs2;
       }
@@ -170,6 +182,8 @@ void VSlideHelper(RiscVVectorState *rv_vector, Instruction *inst, int offset) {
   int vector_index = rv_vector->vstart();
   int start_reg = vector_index / elements_per_vector;
   int item_index = vector_index % elements_per_vector;
+  // Read the source elements from a contiguous copy of the register group.
+  auto src_group = GetContiguousRegisterGroup<Vd>(rv_vector, inst, 0, 0);
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
@@ -189,7 +203,10 @@ void VSlideHelper(RiscVVectorState *rv_vector, Instruction *inst, int offset) {
         // Compute result.
         Vd src_value = 0;
         if (src_index < rv_vector->max_vector_length()) {
-          src_value = generic::GetInstructionSource<Vd>(inst, 0, src_index);
+          src_value =
+              (static_cast<size_t>(src_index) < src_group.size())
+                  ? src_group[src_index]
+                  : generic::GetInstructionSource<Vd>(inst, 0, src_index);
         }
         dest_span[i] = src_value;
       }
@@ -277,6 +294,8 @@ void VSlide1Helper(RiscVVectorState *rv_vector, Instruction *inst, int offset) {
   int start_reg = vector_index / elements_per_vector;
   int item_index = vector_index % elements_per_vector;
   auto slide_value = generic::GetInstructionSource<Vd>(inst, 1, 0);
+  // Read the source elements from a contiguous copy of the register group.
+  auto src_group = GetContiguousRegisterGroup<Vd>(rv_vector, inst, 0, 0);
   // Iterate over the number of registers to write.
   for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
        reg++) {
@@ -296,7 +315,10 @@ void VSlide1Helper(RiscVVectorState *rv_vector, Instruction *inst, int offset) {
         Vd src_value = slide_value;
         int src_index = vector_index - offset;
         if ((src_index > 0) && (src_index < rv_vector->max_vector_length())) {
-          src_value = generic::GetInstructionSource<Vd>(inst, 0, src_index);
+          src_value =
+              (static_cast<size_t>(src_index) < src_group.size())
+                  ? src_group[src_index]
+                  : generic::GetInstructionSource<Vd>(inst, 0, src_index);
         }
         dest_span[i] = src_value;
       }
@@ -405,6 +427,8 @@ void VCompressHelper(RiscVVectorState *rv_vector, Instruction *inst) {
   int prev_reg = -1;
   absl::Span<Vd> dest_span;
   generic::DataBuffer *dest_db = nullptr;
+  // Read the source elements from a contiguous copy of the register group.
+  auto src_group = GetContiguousRegisterGroup<Vd>(rv_vector, inst, 0, 0);
   // Iterate over the input elements.
   for (int i = vector_index; i < num_elements; i++) {
     // Get mask value.
@@ -423,7 +447,9 @@ void VCompressHelper(RiscVVectorState *rv_vector, Instruction *inst) {
         prev_reg = reg;
       }
       // Copy the source value to the dest_index.
-      Vd src_value = generic::GetInstructionSource<Vd>(inst, 0, i);
+      Vd src_value = (i < src_group.size())
+                         ? src_group[i]
+                         : generic::GetInstructionSource<Vd>(inst, 0, i);
       dest_span[dest_index % elements_per_vector] = src_value;
       ++dest_index;
     }
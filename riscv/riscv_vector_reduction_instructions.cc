@@ -15,17 +15,100 @@
 #include "riscv/riscv_vector_reduction_instructions.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 #include "absl/log/log.h"
+#include "mpact/sim/generic/instruction.h"
+#include "riscv/riscv_register.h"
+#include "riscv/riscv_state.h"
+#include "riscv/riscv_vector_host_kernels.h"
 #include "riscv/riscv_vector_instruction_helpers.h"
+#include "riscv/riscv_vector_state.h"
 
 namespace mpact {
 namespace sim {
 namespace riscv {
 
+// Host kernel fast path.
+
+// Reduces the elements of vs2 into acc with the host kernel, and writes the
+// low acc_width bytes of the result to element 0 of vd, if the reduction
+// starts at element 0, the mask has all the elements in [0, vl) enabled, and
+// vs2 is a register group large enough to hold vl elements. The kernel is
+// called once per register of the group, carrying the accumulator across.
+// Returns false if the reduction must be executed element by element instead,
+// which also reports any errors.
+static bool HostReduction(RiscVVectorState *rv_vector, const Instruction *inst,
+                          VectorHostReduceKernel kernel, uint64_t acc,
+                          int acc_width) {
+  if (rv_vector->vector_exception() || (rv_vector->vstart() != 0)) {
+    return false;
+  }
+  int sew = rv_vector->selected_element_width();
+  int lmul = rv_vector->vector_length_multiplier();
+  int lmul_vd = lmul * acc_width / sew;
+  if ((lmul == 0) || (lmul > 64) || (lmul_vd == 0) || (lmul_vd > 64)) {
+    return false;
+  }
+  int num_elements = rv_vector->vector_length();
+  int vlenb = rv_vector->vector_register_byte_length();
+  int elements_per_vector = vlenb / sew;
+  int num_regs = (num_elements + elements_per_vector - 1) / elements_per_vector;
+  auto *vs2_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  if ((vs2_op->size() < num_regs) ||
+      (vs2_op->ElementsPerRegister<uint8_t>() != vlenb)) {
+    return false;
+  }
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(2));
+  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  if (!MaskRangeIsAllOnes(mask_span, 0, num_elements)) return false;
+  for (int reg = 0; reg < num_regs; reg++) {
+    int count =
+        std::min(elements_per_vector, num_elements - reg * elements_per_vector);
+    acc = kernel(acc, vs2_op->GetRegisterSpan<uint8_t>(reg).data(), count);
+  }
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  auto *dest_db = dest_op->CopyDataBuffer();
+  std::memcpy(dest_db->raw_ptr(), &acc, acc_width);
+  dest_db->Submit();
+  rv_vector->clear_vstart();
+  return true;
+}
+
+// Single width reduction with the host kernel for the operation. The
+// accumulator is element 0 of vs1.
+static bool HostReductionOp(RiscVVectorState *rv_vector,
+                            const Instruction *inst, VectorHostOp op) {
+  int sew = rv_vector->selected_element_width();
+  int width_index = VectorHostKernels::WidthIndex(sew);
+  if (width_index < 0) return false;
+  auto kernel =
+      GetVectorHostKernels().reduce[static_cast<int>(op)][width_index];
+  uint64_t acc = generic::GetInstructionSource<uint64_t>(inst, 1, 0);
+  return HostReduction(rv_vector, inst, kernel, acc, sew);
+}
+
+// Widening sum with the host kernel. As in the element by element version,
+// the accumulator is the SEW wide element 0 of vs1, extended to 2 * SEW.
+static bool HostWideningSum(RiscVVectorState *rv_vector,
+                            const Instruction *inst, bool is_signed) {
+  int sew = rv_vector->selected_element_width();
+  int width_index = VectorHostKernels::WidthIndex(sew);
+  if ((width_index < 0) || (sew == 8)) return false;
+  auto kernel = GetVectorHostKernels().widening_sum[is_signed][width_index];
+  int shift = 64 - sew * 8;
+  uint64_t acc = generic::GetInstructionSource<uint64_t>(inst, 1, 0) << shift;
+  acc = is_signed ? static_cast<uint64_t>(static_cast<int64_t>(acc) >> shift)
+                  : acc >> shift;
+  return HostReduction(rv_vector, inst, kernel, acc, sew * 2);
+}
+
 // Sum reduction.
 void Vredsum(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kAdd)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -57,6 +140,7 @@ void Vredsum(Instruction *inst) {
 // And reduction.
 void Vredand(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kAnd)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -88,6 +172,7 @@ void Vredand(Instruction *inst) {
 // Or reduction.
 void Vredor(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kOr)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -119,6 +204,7 @@ void Vredor(Instruction *inst) {
 // Xor reduction.
 void Vredxor(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kXor)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -150,6 +236,7 @@ void Vredxor(Instruction *inst) {
 // Unsigned min reduction.
 void Vredminu(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kMinu)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -185,6 +272,7 @@ void Vredminu(Instruction *inst) {
 // Signed min reduction.
 void Vredmin(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kMin)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -219,6 +307,7 @@ void Vredmin(Instruction *inst) {
 // Unsigned max reduction.
 void Vredmaxu(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kMaxu)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -254,6 +343,7 @@ void Vredmaxu(Instruction *inst) {
 // Signed max reduction.
 void Vredmax(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostReductionOp(rv_vector, inst, VectorHostOp::kMax)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -288,6 +378,7 @@ void Vredmax(Instruction *inst) {
 // Unsigned widening (SEW->SEW * 2) reduction.
 void Vwredsumu(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostWideningSum(rv_vector, inst, /*is_signed=*/false)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
@@ -318,6 +409,7 @@ void Vwredsumu(Instruction *inst) {
 // Signed widening (SEW->SEW * 2) reduction.
 void Vwredsum(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
+  if (HostWideningSum(rv_vector, inst, /*is_signed=*/true)) return;
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 1:
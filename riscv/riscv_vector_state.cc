@@ -14,7 +14,9 @@
 
 #include "riscv/riscv_vector_state.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 
 #include "absl/log/log.h"
 #include "riscv/riscv_csr.h"
@@ -147,6 +149,14 @@ RiscVVectorState::RiscVVectorState(RiscVState* state, int byte_length)
       vxrm_csr_(this),
       vcsr_csr_(this) {
   state_ = state;
+  // Allocate the register group buffer with room for aligning its start.
+  size_t group_buffer_size =
+      kNumGroupBufferSlots * kMaxGroupSize * vector_register_byte_length_;
+  size_t storage_size = group_buffer_size + kGroupBufferAlignment;
+  group_buffer_storage_ = std::make_unique<uint8_t[]>(storage_size);
+  void* group_buffer = group_buffer_storage_.get();
+  group_buffer_ = static_cast<uint8_t*>(std::align(
+      kGroupBufferAlignment, group_buffer_size, group_buffer, storage_size));
   state->set_rv_vector(this);
   state->set_vector_register_width(byte_length);
 
@@ -16,6 +16,7 @@
 #define MPACT_RISCV_RISCV_RISCV_VECTOR_STATE_H_
 
 #include <cstdint>
+#include <memory>
 
 #include "riscv/riscv_csr.h"
 
@@ -154,6 +155,20 @@ class RiscVVectorState {
   const RiscVState* riscv_state() const { return state_; }
   RiscVState* riscv_state() { return state_; }
 
+  // The vector registers each hold their own data buffer, which is replaced
+  // when the register is written, so a register group is not contiguous in
+  // host memory. Operations that index elements across the registers of a
+  // group (gather, slides, compress) copy the source group into one of the
+  // slots of this kGroupBufferAlignment byte aligned buffer instead, which
+  // each hold a group of up to kMaxGroupSize registers. See
+  // GetContiguousRegisterGroup() in riscv_vector_instruction_helpers.h.
+  static constexpr int kMaxGroupSize = 8;
+  static constexpr int kNumGroupBufferSlots = 2;
+  static constexpr int kGroupBufferAlignment = 64;
+  uint8_t* group_buffer(int slot) {
+    return group_buffer_ + slot * kMaxGroupSize * vector_register_byte_length_;
+  }
+
  private:
   // Vector length multiplier is scaled by 8, to provide integer representation
   // of values from 1/8, 1/4, 1/2, 1, 2, 4, 8, as 1, 2, 4, 8, 16, 32, 64.
@@ -181,6 +196,10 @@ class RiscVVectorState {
   bool vxsat_ = false;
   int vxrm_ = 0;
 
+  // Storage for the register group buffer, and its aligned start.
+  std::unique_ptr<uint8_t[]> group_buffer_storage_;
+  uint8_t* group_buffer_ = nullptr;
+
   RiscVVl vl_csr_;
   RiscVVtype vtype_csr_;
   RiscVSimpleCsr<uint32_t> vlenb_csr_;
@@ -21,6 +21,7 @@
 #include <type_traits>
 
 #include "absl/log/log.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "mpact/sim/generic/instruction.h"
@@ -116,12 +117,10 @@ void Vcpop(Instruction *inst) {
   auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
   auto *dest_db = inst->Destination(0)->AllocateDataBuffer();
   uint64_t count = 0;
-  for (int i = 0; i < vlen; i++) {
-    int index = i >> 3;
-    int offset = i & 0b111;
-    int mask_value = (mask_span[index] >> offset);
-    int src_value = (src_span[index] >> offset);
-    count += mask_value & src_value & 0b1;
+  for (int word = 0; word * 64 < vlen; word++) {
+    count += absl::popcount(GetMaskWord(src_span, word) &
+                            GetMaskWord(mask_span, word) &
+                            MaskWordRange(word, 0, vlen));
   }
   if (rv_state->xlen() == RiscVXlen::RV32) {
     dest_db->Set<RV32Register::ValueType>(0, count);
@@ -155,13 +154,11 @@ void Vfirst(Instruction *inst) {
   // Initialize the element index to -1.
   uint64_t element_index = -1LL;
   int vlen = rv_vector->vector_length();
-  for (int i = 0; i < vlen; i++) {
-    int index = i >> 3;
-    int offset = i & 0b111;
-    int mask_value = (mask_span[index] >> offset);
-    int src_value = (src_span[index] >> offset);
-    if (mask_value & src_value & 0b1) {
-      element_index = i;
+  for (int word = 0; word * 64 < vlen; word++) {
+    uint64_t bits = GetMaskWord(src_span, word) & GetMaskWord(mask_span, word) &
+                    MaskWordRange(word, 0, vlen);
+    if (bits != 0) {
+      element_index = word * 64 + absl::countr_zero(bits);
       break;
     }
   }
@@ -294,8 +291,14 @@ void Vsext8(Instruction *inst) {
   }
 }
 
-// Vector mask set-before-first mask bit.
-void Vmsbf(Instruction *inst) {
+// Helper for the vector mask set first instructions. It finds the first active
+// set bit of the source mask register, and then sets the active elements of
+// the destination mask register in [0, vl) to 1 if they are before the first
+// set bit (set_before), or at the first set bit (set_first), and to 0
+// otherwise. Inactive elements are left undisturbed. The mask registers are
+// processed a 64 bit word at a time.
+static void VectorMaskSetFirst(Instruction *inst, bool set_before,
+                               bool set_first) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
   if (rv_vector->vstart()) {
     rv_vector->set_vector_exception();
@@ -310,101 +313,97 @@ void Vmsbf(Instruction *inst) {
       static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
   auto *dest_db = dest_op->CopyDataBuffer(0);
   auto dest_span = dest_db->Get<uint8_t>();
-  bool before_first = true;
-  int last = 0;
-  // Set the bits before the first active 1.
-  for (int i = 0; i < vlen; i++) {
-    last = i;
-    int index = i >> 3;
-    int offset = i & 0b111;
-    int mask_value = (mask_span[index] >> offset) & 0b1;
-    int src_value = (src_span[index] >> offset) & 0b1;
-    if (mask_value) {
-      before_first = before_first && (src_value == 0);
-      if (!before_first) break;
-
-      dest_span[index] |= 1 << offset;
+  int num_words = (vlen + 63) / 64;
+  // Find the first active set bit, or vl if there is none.
+  int first = vlen;
+  for (int word = 0; word < num_words; word++) {
+    uint64_t bits = GetMaskWord(src_span, word) & GetMaskWord(mask_span, word) &
+                    MaskWordRange(word, 0, vlen);
+    if (bits != 0) {
+      first = word * 64 + absl::countr_zero(bits);
+      break;
     }
   }
-  // Clear the remaining bits.
-  for (int i = last; !before_first && (i < vlen); i++) {
-    int index = i >> 3;
-    int offset = i & 0b111;
-    dest_span[index] &= ~(1 << offset);
+  int set_begin = set_before ? 0 : first;
+  int set_end = set_first ? first + 1 : first;
+  for (int word = 0; word < num_words; word++) {
+    uint64_t active =
+        GetMaskWord(mask_span, word) & MaskWordRange(word, 0, vlen);
+    uint64_t set = active & MaskWordRange(word, set_begin, set_end);
+    SetMaskWord(dest_span, word,
+                (GetMaskWord(dest_span, word) & ~active) | set);
   }
   dest_db->Submit();
   rv_vector->clear_vstart();
 }
 
+// Vector mask set-before-first mask bit.
+void Vmsbf(Instruction *inst) {
+  VectorMaskSetFirst(inst, /*set_before=*/true, /*set_first=*/false);
+}
+
 // Vector mask set-including-first mask bit.
 void Vmsif(Instruction *inst) {
-  auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  if (rv_vector->vstart()) {
-    rv_vector->set_vector_exception();
-    return;
-  }
-  int vlen = rv_vector->vector_length();
-  auto src_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
-  auto src_span = src_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  auto mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
-  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  auto dest_op =
-      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
-  auto *dest_db = dest_op->CopyDataBuffer(0);
-  auto dest_span = dest_db->Get<uint8_t>();
-  uint8_t value = 1;
-  for (int i = 0; i < vlen; i++) {
-    int index = i >> 3;
-    int offset = i & 0b111;
-    int mask_value = (mask_span[index] >> offset) & 0b1;
-    int src_value = (src_span[index] >> offset) & 0b1;
-    if (mask_value) {
-      if (value) {
-        dest_span[index] |= 1 << offset;
-      } else {
-        dest_span[index] &= ~(1 << offset);
-      }
-      if (src_value) {
-        value = 0;
-      }
-    }
-  }
-  dest_db->Submit();
-  rv_vector->clear_vstart();
+  VectorMaskSetFirst(inst, /*set_before=*/true, /*set_first=*/true);
 }
 
 // Vector maks set-only-first mask bit.
 void Vmsof(Instruction *inst) {
-  auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
-  if (rv_vector->vstart()) {
+  VectorMaskSetFirst(inst, /*set_before=*/false, /*set_first=*/true);
+}
+
+// Helper for the vector iota instruction, for element type Vd. It writes the
+// destination one register at a time, while the source and mask registers are
+// read a 64 bit word at a time.
+template <typename Vd>
+static void ViotaHelper(RiscVVectorState *rv_vector, const Instruction *inst) {
+  if (rv_vector->vector_exception()) return;
+  int num_elements = rv_vector->vector_length();
+  int elements_per_vector =
+      rv_vector->vector_register_byte_length() / sizeof(Vd);
+  int max_regs = (num_elements + elements_per_vector - 1) / elements_per_vector;
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  // Verify that there are enough registers in the destination operand.
+  if (dest_op->size() < max_regs) {
     rv_vector->set_vector_exception();
+    LOG(ERROR) << absl::StrCat(
+        "Vector destination '", dest_op->AsString(), "' has fewer registers (",
+        dest_op->size(), ") than required by the operation (", max_regs, ")");
     return;
   }
-  int vlen = rv_vector->vector_length();
-  auto src_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  auto *src_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
   auto src_span = src_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  auto mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
   auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
-  auto dest_op =
-      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
-  auto *dest_db = dest_op->CopyDataBuffer(0);
-  auto dest_span = dest_db->Get<uint8_t>();
-  bool first = true;
-  for (int i = 0; i < vlen; i++) {
-    int index = i >> 3;
-    int offset = i & 0b111;
-    int mask_value = (mask_span[index] >> offset) & 0b1;
-    int src_value = (src_span[index] >> offset) & 0b1;
-    if (mask_value) {
-      if (first & src_value) {
-        dest_span[index] |= (1 << offset);
-        first = false;
-      } else {
-        dest_span[index] &= ~(1 << offset);
+  int vector_index = rv_vector->vstart();
+  int item_index = vector_index % elements_per_vector;
+  // The current mask word, and the active source bits in that word.
+  int word = -1;
+  uint64_t mask_word = 0;
+  uint64_t src_word = 0;
+  Vd count = 0;
+  for (int reg = vector_index / elements_per_vector;
+       vector_index < num_elements; reg++) {
+    auto *dest_db = dest_op->CopyDataBuffer(reg);
+    auto dest_span = dest_db->Get<Vd>();
+    for (int i = item_index;
+         (i < elements_per_vector) && (vector_index < num_elements);
+         i++, vector_index++) {
+      if ((vector_index >> 6) != word) {
+        word = vector_index >> 6;
+        mask_word = GetMaskWord(mask_span, word);
+        src_word = GetMaskWord(src_span, word) & mask_word;
+      }
+      int bit = vector_index & 0b11'1111;
+      if ((mask_word >> bit) & 0b1) {
+        dest_span[i] = count;
+        count += (src_word >> bit) & 0b1;
       }
     }
+    dest_db->Submit();
+    item_index = 0;
   }
-  dest_db->Submit();
   rv_vector->clear_vstart();
 }
 
@@ -415,32 +414,15 @@ void Vmsof(Instruction *inst) {
 void Viota(Instruction *inst) {
   auto *rv_vector = static_cast<RiscVState *>(inst->state())->rv_vector();
   int sew = rv_vector->selected_element_width();
-  int count = 0;
   switch (sew) {
     case 1:
-      return RiscVMaskNullaryVectorOp<uint8_t>(
-          rv_vector, inst, [&count](bool mask) -> uint8_t {
-            return mask ? static_cast<uint8_t>(count++)
-                        : static_cast<uint8_t>(count);
-          });
+      return ViotaHelper<uint8_t>(rv_vector, inst);
     case 2:
-      return RiscVMaskNullaryVectorOp<uint16_t>(
-          rv_vector, inst, [&count](bool mask) -> uint16_t {
-            return mask ? static_cast<uint16_t>(count++)
-                        : static_cast<uint16_t>(count);
-          });
+      return ViotaHelper<uint16_t>(rv_vector, inst);
     case 4:
-      return RiscVMaskNullaryVectorOp<uint32_t>(
-          rv_vector, inst, [&count](bool mask) -> uint32_t {
-            return mask ? static_cast<uint32_t>(count++)
-                        : static_cast<uint32_t>(count);
-          });
+      return ViotaHelper<uint32_t>(rv_vector, inst);
     case 8:
-      return RiscVMaskNullaryVectorOp<uint64_t>(
-          rv_vector, inst, [&count](bool mask) -> uint64_t {
-            return mask ? static_cast<uint64_t>(count++)
-                        : static_cast<uint64_t>(count);
-          });
+      return ViotaHelper<uint64_t>(rv_vector, inst);
     default:
       rv_vector->set_vector_exception();
       LOG(ERROR) << "Illegal SEW value";
@@ -42,7 +42,6 @@
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/proto/component_data.pb.h"
 #include "mpact/sim/util/memory/atomic_memory.h"
-#include "mpact/sim/util/memory/flat_demand_memory.h"
 #include "mpact/sim/util/memory/memory_interface.h"
 #include "mpact/sim/util/memory/memory_watcher.h"
 #include "mpact/sim/util/program_loader/elf_program_loader.h"
@@ -51,6 +50,8 @@
 #include "riscv/riscv64_decoder.h"
 #include "riscv/riscv_arm_semihost.h"
 #include "riscv/riscv_fp_state.h"
+#include "riscv/riscv_host_memory.h"
+#include "riscv/riscv_mmu.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_register_aliases.h"
 #include "riscv/riscv_state.h"
@@ -61,7 +62,9 @@ using ::mpact::sim::generic::Instruction;
 using ::mpact::sim::proto::ComponentData;
 using ::mpact::sim::riscv::RiscV64Decoder;
 using ::mpact::sim::riscv::RiscVArmSemihost;
+using ::mpact::sim::riscv::RiscVFetchMemory;
 using ::mpact::sim::riscv::RiscVFPState;
+using ::mpact::sim::riscv::RiscVHostMemory;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVXlen;
 using ::mpact::sim::riscv::RV64Register;
@@ -214,7 +217,7 @@ int main(int argc, char **argv) {
       full_file_name.substr(full_file_name.find_last_of('/') + 1);
   std::string file_basename = file_name.substr(0, file_name.find_first_of('.'));
 
-  auto *memory = new mpact::sim::util::FlatDemandMemory();
+  auto *memory = new RiscVHostMemory();
   mpact::sim::util::MemoryWatcher *memory_watcher = nullptr;
   mpact::sim::util::AtomicMemory *atomic_memory = nullptr;
   if (absl::GetFlag(FLAGS_exit_on_tohost)) {
@@ -244,8 +247,12 @@ int main(int argc, char **argv) {
   // For floating point support add the fp state.
   RiscVFPState rv_fp_state(rv_state.csr_set(), &rv_state);
   rv_state.set_rv_fp(&rv_fp_state);
+  // The decoder reads instructions through the fetch memory, so that
+  // instructions that cross into a physically discontiguous page are read
+  // correctly when address translation is enabled.
+  RiscVFetchMemory fetch_memory(rv_state.mmu(), memory);
   // Create the instruction decoder.
-  RiscV64Decoder rv_decoder(&rv_state, memory);
+  RiscV64Decoder rv_decoder(&rv_state, &fetch_memory);
 
   // Make sure the architectural and abi register aliases are added.
   std::string reg_name;
@@ -296,6 +303,8 @@ int main(int argc, char **argv) {
                   << status.message();
         return -1;
       }
+      // Stores to 'tohost' have to go through the memory watcher.
+      rv_state.DisableHostMemoryAccess(tohost_addr, sizeof(uint64_t));
     } else {
       std::cerr << "Error: no symbol 'tohost' found";
       return -1;
@@ -380,6 +389,10 @@ int main(int argc, char **argv) {
     });
   }
 
+  // Once the memory chain is complete, let scalar loads and stores access
+  // the memory directly.
+  rv_state.set_host_memory(memory);
+
   mpact::sim::generic::SimpleCounter<double> counter_sec("simulation_time_sec",
                                                          0.0);
 
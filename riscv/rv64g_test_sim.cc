@@ -14,11 +14,14 @@
 
 #include <signal.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <string>
@@ -27,8 +30,6 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/log.h"
-#include "absl/strings/str_cat.h"
-#include "absl/strings/str_format.h"
 #include "mpact/sim/generic/core_debug_interface.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "mpact/sim/util/memory/atomic_memory.h"
@@ -36,6 +37,7 @@
 #include "mpact/sim/util/memory/memory_watcher.h"
 #include "mpact/sim/util/program_loader/elf_program_loader.h"
 #include "riscv/riscv64_decoder.h"
+#include "riscv/riscv_commit_trace.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_state.h"
 #include "riscv/riscv_test_mem_watcher.h"
@@ -50,6 +52,7 @@ using HaltReasonValueType =
 using AddressRange = ::mpact::sim::util::MemoryWatcher::AddressRange;
 using ::mpact::sim::generic::operator*;  // NOLINT: clang-tidy false positive.
 using ::mpact::sim::riscv::RiscV64Decoder;
+using ::mpact::sim::riscv::RiscVCommitTrace;
 using ::mpact::sim::riscv::RiscVFPState;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVTop;
@@ -124,91 +127,36 @@ int main(int argc, char **argv) {
     return -1;
   }
 
+  // Set up commit tracing. The raw instruction words are read directly from
+  // memory, so that the reads aren't traced as loads.
+  std::unique_ptr<RiscVCommitTrace> commit_trace;
+  if (absl::GetFlag(FLAGS_log_commits)) {
+    commit_trace =
+        std::make_unique<RiscVCommitTrace>(&rv_state, &memory, &std::cerr);
+    test_watcher->set_commit_trace(commit_trace.get());
+    riscv_top.set_commit_trace(commit_trace.get());
+  }
+
   // Run the executable.
-  HaltReasonValueType halt_reason;
-  bool ok = true;
-  uint64_t pc = entry_point;
-  bool commit_trace = absl::GetFlag(FLAGS_log_commits);
-  auto *register_map = riscv_top.state()->registers();
-  mpact::sim::generic::DataBuffer *inst_db =
-      riscv_top.state()->db_factory()->Allocate<uint32_t>(1);
-  int64_t count = 0;
+  bool ok = false;
   int64_t max_count = absl::GetFlag(FLAGS_max_cycles);
-  do {
-    ok = false;
-    auto status = riscv_top.Step(1);
-    if (!status.ok()) break;
-    count++;
-    if (max_count > 0 && count > max_count) {
-      riscv_top.RequestHalt(RiscVTop::HaltReason::kUserRequest, nullptr);
-    }
+  if (max_count > 0) {
+    int num = std::min<int64_t>(max_count + 1, std::numeric_limits<int>::max());
+    ok = riscv_top.Step(num).ok();
+  } else {
+    ok = riscv_top.Run().ok() && riscv_top.Wait().ok();
+  }
+  HaltReasonValueType halt_reason = *HaltReason::kNone;
+  if (ok) {
     auto halt_status = riscv_top.GetLastHaltReason();
-    if (!halt_status.ok()) break;
-    halt_reason = halt_status.value();
-    ok = true;
-    if (commit_trace) {
-      // This IncRef's the inst instance. Need to DecRef it when we are done.
-      auto *inst = riscv_top.GetInstruction(pc).value();
-      std::string trace_str;
-      absl::StrAppend(
-          &trace_str, "core   0: ", *(riscv_top.state()->privilege_mode()),
-          " 0x", absl::Hex(inst->address(), absl::PadSpec::kZeroPad16));
-      memory.Load(inst->address(), inst_db, nullptr, nullptr);
-      absl::StrAppend(
-          &trace_str, " (0x",
-          absl::Hex(inst_db->Get<uint32_t>(0), absl::PadSpec::kZeroPad8), ")");
-      for (int i = 0; i < inst->DestinationsSize(); ++i) {
-        auto *dest = inst->Destination(i);
-        if (dest == nullptr) continue;
-        auto name = dest->AsString();
-        if (name == "pc") continue;
-        if (name == "x0") continue;
-        auto iter = register_map->find(name);
-        if (iter == register_map->end()) {
-          continue;
-        } else {
-          auto *db = iter->second->data_buffer();
-          auto size = db->size<uint8_t>();
-          if (size != sizeof(uint64_t)) {
-            continue;
-          }
-          absl::StrAppend(
-              &trace_str, " ", absl::StrFormat("%-3s", name), " 0x",
-              absl::Hex(db->Get<uint64_t>(0), absl::PadSpec::kZeroPad16));
-        }
-      }
-      auto *child = inst->child();
-      while (child != nullptr) {
-        for (int i = 0; i < child->DestinationsSize(); ++i) {
-          auto *dest = child->Destination(i);
-          if (dest == nullptr) continue;
-          auto name = dest->AsString();
-          if (name == "pc") continue;
-          if (name == "x0") continue;
-          auto iter = register_map->find(name);
-          if (iter == register_map->end()) {
-            continue;
-          } else {
-            auto *db = iter->second->data_buffer();
-            auto size = db->size<uint8_t>();
-            if (size != sizeof(uint64_t)) {
-              absl::StrAppend(&trace_str, " size issue:  ", name);
-              continue;
-            }
-            absl::StrAppend(
-                &trace_str, " ", absl::StrFormat("%-3s", name), " 0x",
-                absl::Hex(db->Get<uint64_t>(0), absl::PadSpec::kZeroPad16));
-          }
-        }
-        child = child->next();
-      }
-      trace_str.append(test_watcher->trace_str());
-      test_watcher->clear_trace_str();
-      std::cerr << trace_str << std::endl;
-      inst->DecRef();
-    }
-    pc = riscv_top.ReadRegister("pc").value();
-  } while (halt_reason == *HaltReason::kNone);
+    ok = halt_status.ok();
+    if (ok) halt_reason = halt_status.value();
+  }
+  // Reaching the maximum count is treated as a halt request.
+  if (halt_reason == *HaltReason::kNone) {
+    halt_reason = *HaltReason::kUserRequest;
+  }
+  if (commit_trace != nullptr) commit_trace->Flush();
 
   if (!ok) {
     std::cerr << "Failure in stepping or obtaining halt reason";
@@ -43,7 +43,6 @@
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/proto/component_data.pb.h"
 #include "mpact/sim/util/memory/atomic_memory.h"
-#include "mpact/sim/util/memory/flat_demand_memory.h"
 #include "mpact/sim/util/memory/memory_interface.h"
 #include "mpact/sim/util/memory/memory_watcher.h"
 #include "mpact/sim/util/program_loader/elf_program_loader.h"
@@ -53,6 +52,8 @@
 #include "riscv/riscv64gzb_vec_decoder.h"
 #include "riscv/riscv_arm_semihost.h"
 #include "riscv/riscv_fp_state.h"
+#include "riscv/riscv_host_memory.h"
+#include "riscv/riscv_mmu.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_register_aliases.h"
 #include "riscv/riscv_state.h"
@@ -65,7 +66,9 @@ using ::mpact::sim::proto::ComponentData;
 using ::mpact::sim::riscv::RiscV64GVecDecoder;
 using ::mpact::sim::riscv::RiscV64GZBVecDecoder;
 using ::mpact::sim::riscv::RiscVArmSemihost;
+using ::mpact::sim::riscv::RiscVFetchMemory;
 using ::mpact::sim::riscv::RiscVFPState;
+using ::mpact::sim::riscv::RiscVHostMemory;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVVectorState;
 using ::mpact::sim::riscv::RiscVXlen;
@@ -219,7 +222,7 @@ int main(int argc, char **argv) {
       full_file_name.substr(full_file_name.find_last_of('/') + 1);
   std::string file_basename = file_name.substr(0, file_name.find_first_of('.'));
 
-  auto *memory = new mpact::sim::util::FlatDemandMemory();
+  auto *memory = new RiscVHostMemory();
   mpact::sim::util::MemoryWatcher *memory_watcher = nullptr;
   mpact::sim::util::AtomicMemory *atomic_memory = nullptr;
   if (absl::GetFlag(FLAGS_exit_on_tohost)) {
@@ -251,12 +254,16 @@ int main(int argc, char **argv) {
   // Set up the vector state.
   RiscVVectorState rv_vector_state(&rv_state, 64);
   rv_state.set_rv_vector(&rv_vector_state);
+  // The decoder reads instructions through the fetch memory, so that
+  // instructions that cross into a physically discontiguous page are read
+  // correctly when address translation is enabled.
+  RiscVFetchMemory fetch_memory(rv_state.mmu(), memory);
   // Create the instruction decoder.
   mpact::sim::generic::DecoderInterface *rv_decoder = nullptr;
   if (absl::GetFlag(FLAGS_bitmanip)) {
-    rv_decoder = new RiscV64GZBVecDecoder(&rv_state, memory);
+    rv_decoder = new RiscV64GZBVecDecoder(&rv_state, &fetch_memory);
   } else {
-    rv_decoder = new RiscV64GVecDecoder(&rv_state, memory);
+    rv_decoder = new RiscV64GVecDecoder(&rv_state, &fetch_memory);
   }
 
   // Make sure the architectural and abi register aliases are added.
@@ -308,6 +315,8 @@ int main(int argc, char **argv) {
                   << status.message();
         return -1;
       }
+      // Stores to 'tohost' have to go through the memory watcher.
+      rv_state.DisableHostMemoryAccess(tohost_addr, sizeof(uint64_t));
     } else {
       std::cerr << "Error: no symbol 'tohost' found";
       return -1;
@@ -392,6 +401,10 @@ int main(int argc, char **argv) {
     });
   }
 
+  // Once the memory chain is complete, let scalar loads and stores access
+  // the memory directly.
+  rv_state.set_host_memory(memory);
+
   mpact::sim::generic::SimpleCounter<double> counter_sec("simulation_time_sec",
                                                          0.0);
 
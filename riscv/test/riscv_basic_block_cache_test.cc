@@ -0,0 +1,206 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_basic_block_cache.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace {
+
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::riscv::RiscVBasicBlock;
+using ::mpact::sim::riscv::RiscVBasicBlockCache;
+
+constexpr uint64_t kBlockAddress = 0x1000;
+constexpr int kNumInstructions = 4;
+
+class RiscVBasicBlockCacheTest : public ::testing::Test {
+ protected:
+  RiscVBasicBlockCacheTest() {
+    for (int i = 0; i < kNumInstructions; i++) {
+      auto *inst = new Instruction(kBlockAddress + i * 4, nullptr);
+      inst->set_size(4);
+      instructions_.push_back(inst);
+    }
+  }
+
+  ~RiscVBasicBlockCacheTest() override {
+    for (auto *inst : instructions_) inst->DecRef();
+  }
+
+  // Records a block consisting of all the instructions.
+  RiscVBasicBlock *RecordBlock() {
+    cache_.StartRecording();
+    for (auto *inst : instructions_) {
+      EXPECT_TRUE(cache_.Record(inst));
+    }
+    return cache_.FinishRecording();
+  }
+
+  RiscVBasicBlockCache cache_;
+  std::vector<Instruction *> instructions_;
+};
+
+// Verify that a recorded block can be looked up by its start address.
+TEST_F(RiscVBasicBlockCacheTest, RecordBlock) {
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  auto *block = RecordBlock();
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), block);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress + 4), nullptr);
+  EXPECT_EQ(block->start_address, kBlockAddress);
+  EXPECT_EQ(block->end_address, kBlockAddress + kNumInstructions * 4);
+  EXPECT_EQ(block->instructions.size(), kNumInstructions);
+  EXPECT_EQ(cache_.num_blocks(), 1);
+}
+
+// Invalidating an address inside the block removes the block, invalidating
+// an address outside of the block does not.
+TEST_F(RiscVBasicBlockCacheTest, Invalidate) {
+  RecordBlock();
+  cache_.Invalidate(kBlockAddress + kNumInstructions * 4);
+  EXPECT_NE(cache_.GetBlock(kBlockAddress), nullptr);
+  cache_.Invalidate(kBlockAddress + 8);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  EXPECT_EQ(cache_.num_blocks(), 0);
+}
+
+// Successor links are returned for their exit addresses, and are cleared
+// when a block is invalidated.
+TEST_F(RiscVBasicBlockCacheTest, Link) {
+  auto *block = RecordBlock();
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(block->GetSuccessor(block->end_address), nullptr);
+  cache_.Link(block, block->end_address, block);
+  cache_.Link(block, kBlockAddress, block);
+  EXPECT_EQ(block->GetSuccessor(block->end_address), block);
+  EXPECT_EQ(block->GetSuccessor(kBlockAddress), block);
+  EXPECT_EQ(block->GetSuccessor(kBlockAddress + 4), nullptr);
+  // Invalidating an unrelated address keeps the links.
+  cache_.Invalidate(0x8000);
+  EXPECT_EQ(block->GetSuccessor(kBlockAddress), block);
+  // Record a second block and link to it, then invalidate it.
+  auto *inst = new Instruction(0x2000, nullptr);
+  inst->set_size(4);
+  cache_.StartRecording();
+  cache_.Record(inst);
+  auto *other = cache_.FinishRecording();
+  inst->DecRef();
+  ASSERT_NE(other, nullptr);
+  cache_.Link(block, 0x2000, other);
+  EXPECT_EQ(block->GetSuccessor(0x2000), other);
+  cache_.Invalidate(0x2000);
+  EXPECT_EQ(block->GetSuccessor(0x2000), nullptr);
+  EXPECT_EQ(block->GetSuccessor(block->end_address), nullptr);
+}
+
+// A block that is being recorded when an invalidation happens is discarded.
+TEST_F(RiscVBasicBlockCacheTest, InvalidateWhileRecording) {
+  cache_.StartRecording();
+  cache_.Record(instructions_[0]);
+  cache_.Invalidate(0x8000);
+  cache_.Record(instructions_[1]);
+  EXPECT_EQ(cache_.FinishRecording(), nullptr);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+}
+
+// Recording stops accepting instructions at the maximum block size.
+TEST_F(RiscVBasicBlockCacheTest, MaxBlockSize) {
+  auto *inst = instructions_[0];
+  cache_.StartRecording();
+  for (int i = 1; i < RiscVBasicBlockCache::kMaxBlockSize; i++) {
+    EXPECT_TRUE(cache_.Record(inst));
+  }
+  EXPECT_FALSE(cache_.Record(inst));
+  EXPECT_NE(cache_.FinishRecording(), nullptr);
+}
+
+// Blocks are kept per fetch context.
+TEST_F(RiscVBasicBlockCacheTest, Contexts) {
+  auto *block = RecordBlock();
+  ASSERT_NE(block, nullptr);
+  cache_.SelectContext(1);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  auto *other = RecordBlock();
+  ASSERT_NE(other, nullptr);
+  EXPECT_NE(other, block);
+  cache_.SelectContext(0);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), block);
+  // Invalidating context 1 leaves the blocks of context 0.
+  cache_.InvalidateContext(1);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), block);
+  cache_.SelectContext(1);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  // Invalidating an address applies to all contexts.
+  RecordBlock();
+  cache_.Invalidate(kBlockAddress);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  cache_.SelectContext(0);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+}
+
+// A block that ends in an instruction of size 0, which signals a fetch fault,
+// still contains the address of that instruction.
+TEST_F(RiscVBasicBlockCacheTest, FaultInstruction) {
+  auto *fault = new Instruction(kBlockAddress + 4, nullptr);
+  fault->set_size(0);
+  cache_.StartRecording();
+  cache_.Record(instructions_[0]);
+  cache_.Record(fault);
+  auto *block = cache_.FinishRecording();
+  fault->DecRef();
+  ASSERT_NE(block, nullptr);
+  EXPECT_EQ(block->end_address, kBlockAddress + 5);
+  cache_.Invalidate(kBlockAddress + 4);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+}
+
+// A block that is being recorded when another context is selected is
+// discarded.
+TEST_F(RiscVBasicBlockCacheTest, SelectContextWhileRecording) {
+  cache_.StartRecording();
+  cache_.Record(instructions_[0]);
+  cache_.SelectContext(1);
+  EXPECT_EQ(cache_.FinishRecording(), nullptr);
+}
+
+// A block that is removed while it executes stays valid until the stale blocks
+// are freed.
+TEST_F(RiscVBasicBlockCacheTest, InvalidateExecutingBlock) {
+  auto *block = RecordBlock();
+  ASSERT_NE(block, nullptr);
+  std::vector<uint64_t> addresses;
+  for (auto *inst : block->instructions) {
+    addresses.push_back(inst->address());
+    if (inst->address() == kBlockAddress + 4) cache_.Invalidate(kBlockAddress);
+  }
+  EXPECT_EQ(addresses.size(), kNumInstructions);
+  EXPECT_EQ(cache_.GetBlock(kBlockAddress), nullptr);
+  EXPECT_EQ(cache_.num_blocks(), 0);
+  EXPECT_EQ(cache_.num_stale_blocks(), 1);
+  EXPECT_EQ(block->instructions.back()->address(),
+            kBlockAddress + (kNumInstructions - 1) * 4);
+  // Removing all blocks also defers their deletion.
+  RecordBlock();
+  cache_.InvalidateAll();
+  EXPECT_EQ(cache_.num_stale_blocks(), 2);
+  cache_.FreeStaleBlocks();
+  EXPECT_EQ(cache_.num_stale_blocks(), 0);
+}
+
+}  // namespace
@@ -1,6 +1,7 @@
 #include "riscv/riscv_clint.h"
 
 #include <cstdint>
+#include <limits>
 
 #include "googlemock/include/gmock/gmock.h"
 #include "mpact/sim/generic/counters.h"
@@ -178,6 +179,29 @@ TEST_F(RiscVClintTest, MTimeCmp) {
   db->DecRef();
 }
 
+// Test the number of counter ticks until mtip is set, when the counter is
+// updated in batches.
+TEST_F(RiscVClintTest, TicksToDeadline) {
+  auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+  auto *clint = new RiscVClint(/*period=*/100, state_->mip());
+  cycle_counter_.AddListener(clint);
+  db->Set<uint32_t>(0, 10);
+  clint->Store(kMTimeCmp, db);
+  EXPECT_EQ(state_->mip()->mtip(), 0);
+  // The first update counts as a single tick, whatever its size.
+  EXPECT_EQ(clint->TicksToDeadline(), 1);
+  cycle_counter_.Increment(1);
+  EXPECT_EQ(clint->TicksToDeadline(), 999);
+  cycle_counter_.Increment(998);
+  EXPECT_EQ(state_->mip()->mtip(), 0);
+  EXPECT_EQ(clint->TicksToDeadline(), 1);
+  cycle_counter_.Increment(1);
+  EXPECT_EQ(state_->mip()->mtip(), 1);
+  EXPECT_EQ(clint->TicksToDeadline(), std::numeric_limits<uint64_t>::max());
+  delete clint;
+  db->DecRef();
+}
+
 // Test the reads/writes to mtime.
 TEST_F(RiscVClintTest, MTime) {
   auto *db = state_->db_factory()->Allocate<uint32_t>(1);
@@ -248,4 +272,28 @@ TEST_F(RiscVClintTest, MTime) {
   db->DecRef();
 }
 
+// Test that batched counter updates advance mtime by the full amount.
+TEST_F(RiscVClintTest, BatchedUpdates) {
+  auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+  auto clint = new RiscVClint(/*period=*/100, state_->mip());
+  cycle_counter_.AddListener(clint);
+  // The first update counts as a single tick.
+  cycle_counter_.Increment(1);
+  // Together with the initial update, this adds up to 2 periods.
+  cycle_counter_.Increment(198);
+  clint->Load(kMTime, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 2);
+  // Advance by several periods in one update.
+  cycle_counter_.Increment(350);
+  clint->Load(kMTime, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 5);
+  // The remainder carries over to the next update.
+  cycle_counter_.Increment(50);
+  clint->Load(kMTime, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 6);
+
+  delete clint;
+  db->DecRef();
+}
+
 }  // namespace
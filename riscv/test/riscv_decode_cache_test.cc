@@ -0,0 +1,177 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_decode_cache.h"
+
+#include <cstdint>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/decoder_interface.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace {
+
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::riscv::RiscVDecodeCache;
+
+// Decoder that creates an empty instruction for each address, and counts the
+// number of decode calls.
+class TestDecoder : public ::mpact::sim::generic::DecoderInterface {
+ public:
+  Instruction *DecodeInstruction(uint64_t address) override {
+    num_decodes_++;
+    auto *inst = new Instruction(address, nullptr);
+    inst->set_size(4);
+    return inst;
+  }
+  int GetNumOpcodes() const override { return 1; }
+  const char *GetOpcodeName(int index) const override { return "none"; }
+
+  int num_decodes() const { return num_decodes_; }
+
+ private:
+  int num_decodes_ = 0;
+};
+
+class RiscVDecodeCacheTest : public ::testing::Test {
+ protected:
+  RiscVDecodeCacheTest() : cache_(&decoder_) {}
+
+  uint64_t hits() { return cache_.counter_hits()->GetValue(); }
+  uint64_t misses() { return cache_.counter_misses()->GetValue(); }
+  uint64_t evictions() { return cache_.counter_evictions()->GetValue(); }
+
+  TestDecoder decoder_;
+  RiscVDecodeCache cache_;
+};
+
+// The default geometry is direct mapped with 16K entries.
+TEST_F(RiscVDecodeCacheTest, DefaultGeometry) {
+  EXPECT_FALSE(cache_.paged());
+  EXPECT_EQ(cache_.num_entries(), RiscVDecodeCache::kDefaultNumEntries);
+  EXPECT_EQ(cache_.num_ways(), 1);
+  auto *inst = cache_.GetDecodedInstruction(0x1000);
+  EXPECT_EQ(inst->address(), 0x1000);
+  EXPECT_EQ(cache_.GetDecodedInstruction(0x1000), inst);
+  EXPECT_EQ(decoder_.num_decodes(), 1);
+  EXPECT_EQ(hits(), 1);
+  EXPECT_EQ(misses(), 1);
+  EXPECT_EQ(evictions(), 0);
+}
+
+// Malformed configurations are rejected.
+TEST_F(RiscVDecodeCacheTest, BadConfig) {
+  EXPECT_FALSE(cache_.Configure("1024").ok());
+  EXPECT_FALSE(cache_.Configure("1000,1").ok());
+  EXPECT_FALSE(cache_.Configure("1024,3").ok());
+  EXPECT_FALSE(cache_.Configure("4,8").ok());
+  EXPECT_FALSE(cache_.Configure("pages").ok());
+  EXPECT_TRUE(cache_.Configure("1024,4").ok());
+  EXPECT_EQ(cache_.num_entries(), 1024);
+  EXPECT_EQ(cache_.num_ways(), 4);
+}
+
+// Addresses that map to the same set don't evict each other until the set is
+// full, after which the ways are replaced round-robin.
+TEST_F(RiscVDecodeCacheTest, SetAssociative) {
+  EXPECT_TRUE(cache_.Configure("8,2").ok());
+  // With 4 sets and a minimum pc increment of 2, these map to the same set.
+  constexpr uint64_t kStride = 4 * RiscVDecodeCache::kMinPcIncrement;
+  cache_.GetDecodedInstruction(0);
+  cache_.GetDecodedInstruction(kStride);
+  cache_.GetDecodedInstruction(0);
+  cache_.GetDecodedInstruction(kStride);
+  EXPECT_EQ(misses(), 2);
+  EXPECT_EQ(hits(), 2);
+  EXPECT_EQ(evictions(), 0);
+  cache_.GetDecodedInstruction(2 * kStride);
+  EXPECT_EQ(misses(), 3);
+  EXPECT_EQ(evictions(), 1);
+  EXPECT_EQ(decoder_.num_decodes(), 3);
+}
+
+// The paged organization never evicts.
+TEST_F(RiscVDecodeCacheTest, Paged) {
+  EXPECT_TRUE(cache_.Configure("paged").ok());
+  EXPECT_TRUE(cache_.paged());
+  constexpr int kNumInstructions = 64 * 1024;
+  for (int i = 0; i < kNumInstructions; i++) {
+    cache_.GetDecodedInstruction(i * 4);
+  }
+  for (int i = 0; i < kNumInstructions; i++) {
+    EXPECT_EQ(cache_.GetDecodedInstruction(i * 4)->address(), i * 4);
+  }
+  EXPECT_EQ(misses(), kNumInstructions);
+  EXPECT_EQ(hits(), kNumInstructions);
+  EXPECT_EQ(evictions(), 0);
+  EXPECT_EQ(cache_.num_pages(),
+            kNumInstructions * 4 / RiscVDecodeCache::kPageSize);
+}
+
+// Invalidating an address causes it to be decoded again.
+TEST_F(RiscVDecodeCacheTest, Invalidate) {
+  for (auto *config : {"", "paged"}) {
+    EXPECT_TRUE(cache_.Configure(config).ok());
+    int num_decodes = decoder_.num_decodes();
+    cache_.GetDecodedInstruction(0x2000);
+    cache_.GetDecodedInstruction(0x2004);
+    cache_.Invalidate(0x2000);
+    cache_.GetDecodedInstruction(0x2000);
+    cache_.GetDecodedInstruction(0x2004);
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 3) << config;
+    cache_.InvalidateAll();
+    cache_.GetDecodedInstruction(0x2004);
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 4) << config;
+  }
+}
+
+// Each fetch context has its own instructions, which are kept when another
+// context is selected, and can be invalidated separately.
+TEST_F(RiscVDecodeCacheTest, Contexts) {
+  for (auto *config : {"", "paged"}) {
+    EXPECT_TRUE(cache_.Configure(config).ok());
+    int num_decodes = decoder_.num_decodes();
+    auto *inst = cache_.GetDecodedInstruction(0x2000);
+    cache_.SelectContext(1);
+    EXPECT_EQ(cache_.context(), 1);
+    auto *other = cache_.GetDecodedInstruction(0x2000);
+    EXPECT_NE(other, inst) << config;
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 2) << config;
+    // Switching back uses the instructions decoded in context 0.
+    cache_.SelectContext(0);
+    EXPECT_EQ(cache_.GetDecodedInstruction(0x2000), inst) << config;
+    cache_.SelectContext(1);
+    EXPECT_EQ(cache_.GetDecodedInstruction(0x2000), other) << config;
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 2) << config;
+    // Invalidating context 0 doesn't affect context 1.
+    cache_.InvalidateContext(0);
+    EXPECT_EQ(cache_.GetDecodedInstruction(0x2000), other) << config;
+    cache_.SelectContext(0);
+    cache_.GetDecodedInstruction(0x2000);
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 3) << config;
+    // Invalidating an address applies to all contexts.
+    cache_.Invalidate(0x2000);
+    cache_.GetDecodedInstruction(0x2000);
+    cache_.SelectContext(1);
+    cache_.GetDecodedInstruction(0x2000);
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 5) << config;
+    // Invalidating the selected context.
+    cache_.InvalidateContext(1);
+    cache_.GetDecodedInstruction(0x2000);
+    EXPECT_EQ(decoder_.num_decodes(), num_decodes + 6) << config;
+    cache_.SelectContext(0);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,109 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_host_memory.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+
+namespace {
+
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::riscv::RiscVHostMemory;
+
+constexpr uint64_t kPageSize = RiscVHostMemory::kPageSize;
+constexpr uint64_t kBase = 0x1'0000;
+
+class RiscVHostMemoryTest : public ::testing::Test {
+ protected:
+  DataBufferFactory db_factory_;
+  RiscVHostMemory memory_;
+};
+
+// Memory that has not been written reads as zero.
+TEST_F(RiscVHostMemoryTest, InitialValue) {
+  auto *db = db_factory_.Allocate<uint64_t>(1);
+  db->Set<uint64_t>(0, 0xdead'beef'dead'beefULL);
+  memory_.Load(kBase, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint64_t>(0), 0);
+  db->DecRef();
+  for (uint64_t i = 0; i < kPageSize; i++) {
+    EXPECT_EQ(memory_.GetPage(kBase)[i], 0);
+  }
+}
+
+// Stores are visible through the host page, and the other way around.
+TEST_F(RiscVHostMemoryTest, HostPage) {
+  uint8_t *page = memory_.GetPage(kBase + 0x10);
+  EXPECT_EQ(page, memory_.GetPage(kBase));
+  auto *db = db_factory_.Allocate<uint32_t>(1);
+  db->Set<uint32_t>(0, 0x1234'5678);
+  memory_.Store(kBase + 0x10, db);
+  uint32_t value;
+  std::memcpy(&value, page + 0x10, sizeof(value));
+  EXPECT_EQ(value, 0x1234'5678);
+  value = 0x8765'4321;
+  std::memcpy(page + 0x20, &value, sizeof(value));
+  memory_.Load(kBase + 0x20, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0x8765'4321);
+  db->DecRef();
+}
+
+// Accesses that cross page boundaries.
+TEST_F(RiscVHostMemoryTest, CrossPage) {
+  constexpr int kSize = 64;
+  auto *st_db = db_factory_.Allocate<uint8_t>(kSize);
+  auto *ld_db = db_factory_.Allocate<uint8_t>(kSize);
+  for (int i = 0; i < kSize; i++) st_db->Set<uint8_t>(i, i + 1);
+  uint64_t address = kBase + kPageSize - kSize / 2;
+  memory_.Store(address, st_db);
+  memory_.Load(address, ld_db, nullptr, nullptr);
+  for (int i = 0; i < kSize; i++) {
+    EXPECT_EQ(ld_db->Get<uint8_t>(i), i + 1) << i;
+  }
+  EXPECT_EQ(memory_.GetPage(kBase + kPageSize)[0], kSize / 2 + 1);
+  st_db->DecRef();
+  ld_db->DecRef();
+}
+
+// Vector accesses only access the elements whose mask bit is set.
+TEST_F(RiscVHostMemoryTest, Vector) {
+  constexpr int kNumElements = 8;
+  auto *address_db = db_factory_.Allocate<uint64_t>(kNumElements);
+  auto *mask_db = db_factory_.Allocate<bool>(kNumElements);
+  auto *st_db = db_factory_.Allocate<uint16_t>(kNumElements);
+  auto *ld_db = db_factory_.Allocate<uint16_t>(kNumElements);
+  for (int i = 0; i < kNumElements; i++) {
+    // Spread the elements out over several pages.
+    address_db->Set<uint64_t>(i, kBase + i * (kPageSize + 6));
+    mask_db->Set<bool>(i, (i & 1) == 0);
+    st_db->Set<uint16_t>(i, 0x100 + i);
+    ld_db->Set<uint16_t>(i, 0xffff);
+  }
+  memory_.Store(address_db, mask_db, sizeof(uint16_t), st_db);
+  for (int i = 0; i < kNumElements; i++) mask_db->Set<bool>(i, true);
+  memory_.Load(address_db, mask_db, sizeof(uint16_t), ld_db, nullptr, nullptr);
+  for (int i = 0; i < kNumElements; i++) {
+    EXPECT_EQ(ld_db->Get<uint16_t>(i), (i & 1) == 0 ? 0x100 + i : 0) << i;
+  }
+  address_db->DecRef();
+  mask_db->DecRef();
+  st_db->DecRef();
+  ld_db->DecRef();
+}
+
+}  // namespace
@@ -0,0 +1,166 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This microbenchmark measures the cost of executing scalar semantic functions
+// implemented with the helpers in riscv_instruction_helpers.h, which take the
+// operation as a template parameter, against the same semantic functions
+// implemented with helpers that take a std::function.
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
+#include "riscv/riscv_i_instructions.h"
+#include "riscv/riscv_instruction_helpers.h"
+#include "riscv/riscv_register.h"
+#include "riscv/riscv_state.h"
+
+ABSL_FLAG(int64_t, iterations, 50'000'000,
+          "Number of times each semantic function is executed");
+
+namespace {
+
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::riscv::RiscVState;
+using ::mpact::sim::riscv::RiscVXlen;
+using ::mpact::sim::riscv::RV32Register;
+using ::mpact::sim::util::FlatDemandMemory;
+
+// Binary op helper taking a std::function, as the helpers used to.
+template <typename Register, typename Result, typename Argument>
+inline void FunctionBinaryOp(
+    const Instruction *instruction,
+    std::function<Result(Argument, Argument)> operation) {
+  using RegValue = typename Register::ValueType;
+  Argument lhs =
+      ::mpact::sim::generic::GetInstructionSource<Argument>(instruction, 0);
+  Argument rhs =
+      ::mpact::sim::generic::GetInstructionSource<Argument>(instruction, 1);
+  Result dest_value = operation(lhs, rhs);
+  auto *reg =
+      static_cast<::mpact::sim::generic::RegisterDestinationOperand<RegValue>
+                      *>(instruction->Destination(0))
+          ->GetRegister();
+  reg->data_buffer()->template Set<Result>(0, dest_value);
+}
+
+// Conditional branch helper taking a std::function, as the helpers used to.
+// The benchmark only executes branches that are not taken.
+template <typename ValueType>
+inline void FunctionBranchConditional(
+    const Instruction *instruction,
+    std::function<bool(ValueType, ValueType)> cond) {
+  ValueType a =
+      ::mpact::sim::generic::GetInstructionSource<ValueType>(instruction, 0);
+  ValueType b =
+      ::mpact::sim::generic::GetInstructionSource<ValueType>(instruction, 1);
+  if (cond(a, b)) {
+    static_cast<RiscVState *>(instruction->state())->set_branch(true);
+  }
+}
+
+void FunctionAdd(const Instruction *instruction) {
+  FunctionBinaryOp<RV32Register, uint32_t, uint32_t>(
+      instruction, [](uint32_t a, uint32_t b) { return a + b; });
+}
+
+void FunctionBeq(const Instruction *instruction) {
+  FunctionBranchConditional<uint32_t>(
+      instruction, [](uint32_t a, uint32_t b) { return a == b; });
+}
+
+void TemplateBeq(const Instruction *instruction) {
+  ::mpact::sim::riscv::BranchConditional<RV32Register, uint32_t>(
+      instruction, [](uint32_t a, uint32_t b) { return a == b; });
+}
+
+class Benchmark {
+ public:
+  Benchmark() {
+    state_ = new RiscVState("bench", RiscVXlen::RV32, &memory_);
+    SetRegister("x1", 0x1234);
+    SetRegister("x2", 0x5678);
+  }
+  ~Benchmark() { delete state_; }
+
+  // Returns the average time in ns to execute an instruction with the given
+  // semantic function, with x1 and x2 as sources, and x3 as destination.
+  double Run(Instruction::SemanticFunction fcn, int64_t iterations) {
+    auto *inst = new Instruction(0x1000, state_);
+    inst->set_size(4);
+    for (auto *name : {"x1", "x2"}) {
+      auto *reg = state_->GetRegister<RV32Register>(name).first;
+      inst->AppendSource(reg->CreateSourceOperand());
+    }
+    auto *reg = state_->GetRegister<RV32Register>("x3").first;
+    inst->AppendDestination(reg->CreateDestinationOperand(0));
+    inst->set_semantic_function(fcn);
+    absl::Time start = absl::Now();
+    for (int64_t i = 0; i < iterations; i++) {
+      inst->Execute(nullptr);
+    }
+    absl::Duration duration = absl::Now() - start;
+    inst->DecRef();
+    return absl::ToDoubleNanoseconds(duration) / iterations;
+  }
+
+ private:
+  void SetRegister(const std::string &name, uint32_t value) {
+    auto *reg = state_->GetRegister<RV32Register>(name).first;
+    auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+    db->Set<uint32_t>(0, value);
+    reg->SetDataBuffer(db);
+    db->DecRef();
+  }
+
+  FlatDemandMemory memory_;
+  RiscVState *state_;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  int64_t iterations = absl::GetFlag(FLAGS_iterations);
+  Benchmark benchmark;
+  struct Case {
+    std::string name;
+    Instruction::SemanticFunction function_version;
+    Instruction::SemanticFunction template_version;
+  };
+  std::vector<Case> cases = {
+      {"add", FunctionAdd, ::mpact::sim::riscv::RV32::RiscVIAdd},
+      {"beq (not taken)", FunctionBeq, TemplateBeq},
+  };
+  std::cout << absl::StrFormat("%-16s %16s %16s\n", "instruction",
+                               "std::function", "template");
+  for (auto &c : cases) {
+    double function_ns = benchmark.Run(c.function_version, iterations);
+    double template_ns = benchmark.Run(c.template_version, iterations);
+    std::cout << absl::StrFormat("%-16s %13.2f ns %13.2f ns\n", c.name,
+                                 function_ns, template_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,216 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_memory_watcher.h"
+
+#include <cstdint>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::riscv::RiscVMemoryWatcher;
+using ::mpact::sim::util::FlatDemandMemory;
+using AddressRange = RiscVMemoryWatcher::AddressRange;
+
+constexpr uint64_t kPageSize = 1ULL << RiscVMemoryWatcher::kPageShift;
+constexpr uint64_t kWatchStart = 0x1'0100;
+constexpr uint64_t kWatchEnd = 0x1'0107;
+
+class RiscVMemoryWatcherTest : public ::testing::Test {
+ protected:
+  RiscVMemoryWatcherTest() : watcher_(&memory_) {
+    db_ = db_factory_.Allocate<uint32_t>(1);
+  }
+  ~RiscVMemoryWatcherTest() override { db_->DecRef(); }
+
+  // Sets load and store watch ranges that count the callbacks.
+  void SetWatches(uint64_t start, uint64_t end) {
+    EXPECT_TRUE(watcher_
+                    .SetLoadWatchCallback(
+                        AddressRange(start, end),
+                        [this](uint64_t, int) { load_count_++; })
+                    .ok());
+    EXPECT_TRUE(watcher_
+                    .SetStoreWatchCallback(
+                        AddressRange(start, end),
+                        [this](uint64_t, int) { store_count_++; })
+                    .ok());
+  }
+
+  DataBufferFactory db_factory_;
+  FlatDemandMemory memory_;
+  RiscVMemoryWatcher watcher_;
+  DataBuffer *db_ = nullptr;
+  int load_count_ = 0;
+  int store_count_ = 0;
+};
+
+// Loads and stores are performed whether or not they are watched, and only
+// accesses that overlap a watch range of the same type trigger the callback.
+TEST_F(RiscVMemoryWatcherTest, WatchedAccesses) {
+  SetWatches(kWatchStart, kWatchEnd);
+  // Watched word.
+  db_->Set<uint32_t>(0, 0x1234'5678);
+  watcher_.Store(kWatchStart + 4, db_);
+  EXPECT_EQ(store_count_, 1);
+  db_->Set<uint32_t>(0, 0);
+  watcher_.Load(kWatchStart + 4, db_, nullptr, nullptr);
+  EXPECT_EQ(load_count_, 1);
+  EXPECT_EQ(db_->Get<uint32_t>(0), 0x1234'5678);
+  // Same page, but outside the watch range.
+  watcher_.Store(kWatchEnd + 1, db_);
+  watcher_.Load(kWatchEnd + 1, db_, nullptr, nullptr);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_EQ(load_count_, 1);
+  // Unwatched page.
+  db_->Set<uint32_t>(0, 0x8765'4321);
+  watcher_.Store(kWatchStart + kPageSize, db_);
+  db_->Set<uint32_t>(0, 0);
+  watcher_.Load(kWatchStart + kPageSize, db_, nullptr, nullptr);
+  EXPECT_EQ(db_->Get<uint32_t>(0), 0x8765'4321);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_EQ(load_count_, 1);
+}
+
+// After the watch ranges are cleared, accesses no longer trigger callbacks.
+TEST_F(RiscVMemoryWatcherTest, ClearWatch) {
+  SetWatches(kWatchStart, kWatchEnd);
+  EXPECT_TRUE(watcher_.ClearLoadWatchCallback(kWatchStart).ok());
+  watcher_.Load(kWatchStart, db_, nullptr, nullptr);
+  watcher_.Store(kWatchStart, db_);
+  EXPECT_EQ(load_count_, 0);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_TRUE(watcher_.ClearStoreWatchCallback(kWatchStart).ok());
+  watcher_.Store(kWatchStart, db_);
+  EXPECT_EQ(store_count_, 1);
+  // Clearing a range that isn't set fails.
+  EXPECT_FALSE(watcher_.ClearStoreWatchCallback(kWatchStart).ok());
+}
+
+// An access that crosses into a watched page is passed to the watcher.
+TEST_F(RiscVMemoryWatcherTest, CrossPage) {
+  SetWatches(kPageSize, kPageSize);
+  watcher_.Store(kPageSize - 2, db_);
+  EXPECT_EQ(store_count_, 1);
+}
+
+// Watch ranges that span a large part of the address space are supported, and
+// are combined correctly with other watch ranges when they are cleared.
+TEST_F(RiscVMemoryWatcherTest, LargeRange) {
+  constexpr uint64_t kLargeStart = 0x1'0000'0000;
+  constexpr uint64_t kLargeEnd = 0xffff'ffff'ffff'0fff;
+  SetWatches(kLargeStart, kLargeEnd);
+  SetWatches(kWatchStart, kWatchEnd);
+  watcher_.Store(kLargeStart - sizeof(uint32_t), db_);
+  watcher_.Load(kLargeEnd + 1, db_, nullptr, nullptr);
+  EXPECT_EQ(store_count_, 0);
+  EXPECT_EQ(load_count_, 0);
+  watcher_.Store(0x8000'0000'0000, db_);
+  watcher_.Load(kLargeEnd - 3, db_, nullptr, nullptr);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_EQ(load_count_, 1);
+  // Clearing the large range leaves the small one in place.
+  EXPECT_TRUE(watcher_.ClearStoreWatchCallback(kLargeStart).ok());
+  EXPECT_TRUE(watcher_.ClearLoadWatchCallback(kLargeStart).ok());
+  watcher_.Store(0x8000'0000'0000, db_);
+  watcher_.Load(kLargeEnd - 3, db_, nullptr, nullptr);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_EQ(load_count_, 1);
+  watcher_.Store(kWatchStart, db_);
+  watcher_.Load(kWatchStart, db_, nullptr, nullptr);
+  EXPECT_EQ(store_count_, 2);
+  EXPECT_EQ(load_count_, 2);
+}
+
+// Watch ranges on the same and on adjacent pages are merged into one page
+// interval, which is split up again as the ranges are cleared.
+TEST_F(RiscVMemoryWatcherTest, MergedRanges) {
+  SetWatches(kPageSize, 2 * kPageSize + 7);
+  SetWatches(3 * kPageSize, 3 * kPageSize + 7);
+  SetWatches(2 * kPageSize + 8, 2 * kPageSize + 15);
+  watcher_.Store(3 * kPageSize + 4, db_);
+  EXPECT_EQ(store_count_, 1);
+  EXPECT_TRUE(watcher_.ClearStoreWatchCallback(kPageSize).ok());
+  watcher_.Store(kPageSize, db_);
+  EXPECT_EQ(store_count_, 1);
+  watcher_.Store(2 * kPageSize + 8, db_);
+  watcher_.Store(3 * kPageSize, db_);
+  EXPECT_EQ(store_count_, 3);
+}
+
+// Watch ranges that share pages, or whose pages are nested in the pages of
+// another range, are merged, and the watched pages are kept correctly as the
+// ranges are cleared in any order. This is checked both while the watched pages
+// are few enough to be kept in the page set, and while a range with more pages
+// than that is also set.
+TEST_F(RiscVMemoryWatcherTest, OverlappingPages) {
+  constexpr uint64_t kMaxPages = RiscVMemoryWatcher::kMaxPageSetSize;
+  constexpr uint64_t kLargeStart = 0x100'0000;
+  constexpr uint64_t kLargeEnd = kLargeStart + (kMaxPages + 1) * kPageSize - 1;
+  auto clear_watches = [this](uint64_t address) {
+    EXPECT_TRUE(watcher_.ClearLoadWatchCallback(address).ok());
+    EXPECT_TRUE(watcher_.ClearStoreWatchCallback(address).ok());
+  };
+  for (bool large : {false, true}) {
+    SCOPED_TRACE(large ? "large" : "small");
+    if (large) SetWatches(kLargeStart, kLargeEnd);
+    // Pages 1-4 and 4-6 overlap on page 4, and page 1 of the first range is
+    // also watched by a range of its own. Pages 8-9 are an interval of their
+    // own.
+    SetWatches(kPageSize, kPageSize + 7);
+    SetWatches(kPageSize + 8, 4 * kPageSize + 7);
+    SetWatches(4 * kPageSize + 8, 6 * kPageSize + 15);
+    SetWatches(8 * kPageSize + 4, 9 * kPageSize + 7);
+    store_count_ = 0;
+    for (uint64_t page = 0; page < 11; page++) {
+      watcher_.Store(page * kPageSize + 4, db_);
+    }
+    EXPECT_EQ(store_count_, 8);
+    // Clear the range of pages 1-4. Page 1 and 4 are still watched.
+    clear_watches(kPageSize + 8);
+    store_count_ = 0;
+    watcher_.Store(kPageSize + 4, db_);
+    watcher_.Store(4 * kPageSize + 8, db_);
+    EXPECT_EQ(store_count_, 2);
+    // Clear the range of pages 4-6. Page 1 and pages 8-9 are still watched.
+    clear_watches(4 * kPageSize + 8);
+    store_count_ = 0;
+    watcher_.Store(kPageSize + 4, db_);
+    watcher_.Store(8 * kPageSize + 4, db_);
+    watcher_.Store(9 * kPageSize + 4, db_);
+    EXPECT_EQ(store_count_, 3);
+    // The large range is watched on each of its pages.
+    if (large) {
+      watcher_.Store(kLargeStart, db_);
+      watcher_.Store(kLargeStart + kMaxPages * kPageSize, db_);
+      watcher_.Store(kLargeEnd - 3, db_);
+      EXPECT_EQ(store_count_, 6);
+      clear_watches(kLargeStart);
+    }
+    // With the large range cleared, the remaining pages are still watched.
+    store_count_ = 0;
+    watcher_.Store(kPageSize + 4, db_);
+    watcher_.Store(9 * kPageSize + 4, db_);
+    EXPECT_EQ(store_count_, 2);
+    clear_watches(kPageSize);
+    clear_watches(8 * kPageSize + 4);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,734 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_mmu.h"
+
+#include <cstdint>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/decoder_interface.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "riscv/riscv_csr.h"
+#include "riscv/riscv_host_memory.h"
+#include "riscv/riscv_state.h"
+
+namespace {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: clang-tidy false positive.
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::DecoderInterface;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::riscv::ExceptionCode;
+using ::mpact::sim::riscv::RiscVFetchMemory;
+using ::mpact::sim::riscv::PrivilegeMode;
+using ::mpact::sim::riscv::RiscVCsrInterface;
+using ::mpact::sim::riscv::RiscVHostMemory;
+using ::mpact::sim::riscv::RiscVMmu;
+using ::mpact::sim::riscv::RiscVMmuDecoder;
+using ::mpact::sim::riscv::RiscVState;
+using ::mpact::sim::riscv::RiscVXlen;
+using ::mpact::sim::util::FlatDemandMemory;
+using ::mpact::sim::util::MemoryInterface;
+using AccessType = RiscVMmu::AccessType;
+
+// Page table entry bits.
+constexpr uint64_t kV = 1 << 0;
+constexpr uint64_t kR = 1 << 1;
+constexpr uint64_t kW = 1 << 2;
+constexpr uint64_t kX = 1 << 3;
+constexpr uint64_t kU = 1 << 4;
+constexpr uint64_t kG = 1 << 5;
+constexpr uint64_t kA = 1 << 6;
+constexpr uint64_t kD = 1 << 7;
+
+// Physical addresses of the Sv39 page table pages.
+constexpr uint64_t kRootTable = 0x1000;
+constexpr uint64_t kLevel1Table = 0x2000;
+constexpr uint64_t kLevel0Table = 0x3000;
+constexpr uint64_t kSv39 = 8ULL << 60;
+
+// The virtual pages used by the tests. They are all in the first 2MB
+// megapage (vpn[1] == 0) of the first 1GB gigapage (vpn[2] == 0), except for
+// the megapage mapped in the Superpage test.
+constexpr uint64_t kCodePage = 0x5000;
+constexpr uint64_t kDataPage = 0x6000;
+constexpr uint64_t kPhysicalCode = 0x10'0000;
+constexpr uint64_t kPhysicalData = 0x20'0000;
+
+// Decoder that reads a 32 bit instruction word from the memory interface,
+// and creates an instruction of size 2 for compressed encodings, and 4
+// otherwise. The address and the word of the last decode are recorded.
+class TestDecoder : public DecoderInterface {
+ public:
+  TestDecoder(RiscVState *state, MemoryInterface *memory)
+      : state_(state), memory_(memory) {
+    db_ = state_->db_factory()->Allocate<uint32_t>(1);
+  }
+  ~TestDecoder() override { db_->DecRef(); }
+
+  Instruction *DecodeInstruction(uint64_t address) override {
+    num_decodes_++;
+    address_ = address;
+    memory_->Load(address, db_, nullptr, nullptr);
+    word_ = db_->Get<uint32_t>(0);
+    auto *inst = new Instruction(address, state_);
+    inst->set_size((word_ & 0b11) == 0b11 ? 4 : 2);
+    return inst;
+  }
+  int GetNumOpcodes() const override { return 1; }
+  const char *GetOpcodeName(int index) const override { return "none"; }
+
+  int num_decodes() const { return num_decodes_; }
+  uint64_t address() const { return address_; }
+  uint32_t word() const { return word_; }
+
+ private:
+  RiscVState *state_;
+  MemoryInterface *memory_;
+  DataBuffer *db_;
+  int num_decodes_ = 0;
+  uint64_t address_ = 0;
+  uint32_t word_ = 0;
+};
+
+class RiscVMmuTest : public ::testing::Test {
+ protected:
+  RiscVMmuTest() {
+    state_ = new RiscVState("test", RiscVXlen::RV64, &memory_);
+    mmu_ = state_->mmu();
+    satp_ = state_->csr_set()->GetCsr("satp").value();
+    // Point the root table at the level 1 table, and that at the level 0
+    // table.
+    WritePte(kRootTable, ((kLevel1Table >> 12) << 10) | kV);
+    WritePte(kLevel1Table, ((kLevel0Table >> 12) << 10) | kV);
+    state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  }
+
+  ~RiscVMmuTest() override { delete state_; }
+
+  // Maps the 4KB virtual page to the physical page with the given flags.
+  void Map(uint64_t page, uint64_t physical, uint64_t flags) {
+    WritePte(kLevel0Table + ((page >> 12) & 0x1ff) * 8,
+             ((physical >> 12) << 10) | flags);
+  }
+
+  void WritePte(uint64_t address, uint64_t pte) {
+    auto *db = state_->db_factory()->Allocate<uint64_t>(1);
+    db->Set<uint64_t>(0, pte);
+    memory_.Store(address, db);
+    db->DecRef();
+  }
+
+  uint64_t ReadPte(uint64_t address) {
+    auto *db = state_->db_factory()->Allocate<uint64_t>(1);
+    memory_.Load(address, db, nullptr, nullptr);
+    uint64_t pte = db->Get<uint64_t>(0);
+    db->DecRef();
+    return pte;
+  }
+
+  uint64_t PteAddress(uint64_t page) {
+    return kLevel0Table + ((page >> 12) & 0x1ff) * 8;
+  }
+
+  // Translates the address, returning the physical address, or ~0 if the
+  // translation faults, in which case the exception code is stored in code_.
+  uint64_t Translate(uint64_t address, AccessType type) {
+    uint64_t physical;
+    if (!mmu_->TranslateAddress(address, type, &physical, &code_)) return ~0ULL;
+    return physical;
+  }
+
+  void WriteHalf(uint64_t address, uint16_t value) {
+    auto *db = state_->db_factory()->Allocate<uint16_t>(1);
+    db->Set<uint16_t>(0, value);
+    memory_.Store(address, db);
+    db->DecRef();
+  }
+
+  // Executes the instruction, which is expected to trap, and returns the trap
+  // value, exception code and epc.
+  void ExecuteFault(Instruction *inst, uint64_t *trap_value, uint64_t *code,
+                    uint64_t *epc) {
+    state_->set_on_trap([=](bool, uint64_t value, uint64_t exception_code,
+                            uint64_t pc, const Instruction *) {
+      *trap_value = value;
+      *code = exception_code;
+      *epc = pc;
+      return true;
+    });
+    inst->Execute(nullptr);
+    state_->set_on_trap(nullptr);
+  }
+
+  void SetSum(bool value) {
+    state_->mstatus()->set_sum(value);
+    state_->mstatus()->Submit();
+  }
+
+  RiscVHostMemory memory_;
+  RiscVState *state_;
+  RiscVMmu *mmu_;
+  RiscVCsrInterface *satp_;
+  ExceptionCode code_ = ExceptionCode::kIllegalInstruction;
+};
+
+// Writes selecting an unsupported translation mode are ignored.
+TEST_F(RiscVMmuTest, Satp) {
+  EXPECT_FALSE(state_->address_translation());
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  EXPECT_EQ(satp_->AsUint64(), kSv39 | (kRootTable >> 12));
+  EXPECT_EQ(mmu_->mode(), RiscVMmu::Mode::kSv39);
+  EXPECT_TRUE(state_->address_translation());
+  // Sv57 is not supported.
+  satp_->Write(static_cast<uint64_t>(10) << 60);
+  EXPECT_EQ(satp_->AsUint64(), kSv39 | (kRootTable >> 12));
+  satp_->Write(static_cast<uint64_t>(0));
+  EXPECT_EQ(mmu_->mode(), RiscVMmu::Mode::kBare);
+  EXPECT_FALSE(state_->address_translation());
+}
+
+// Translation only applies below machine mode, and for data accesses, to
+// machine mode with mstatus.MPRV set.
+TEST_F(RiscVMmuTest, TranslationEnabled) {
+  EXPECT_FALSE(mmu_->IsDataTranslationEnabled());
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  EXPECT_TRUE(mmu_->IsDataTranslationEnabled());
+  EXPECT_TRUE(mmu_->IsFetchTranslationEnabled());
+  state_->set_privilege_mode(PrivilegeMode::kMachine);
+  EXPECT_FALSE(mmu_->IsDataTranslationEnabled());
+  EXPECT_FALSE(mmu_->IsFetchTranslationEnabled());
+  state_->mstatus()->set_mpp(*PrivilegeMode::kSupervisor);
+  state_->mstatus()->set_mprv(1);
+  state_->mstatus()->Submit();
+  EXPECT_TRUE(mmu_->IsDataTranslationEnabled());
+  EXPECT_FALSE(mmu_->IsFetchTranslationEnabled());
+}
+
+// Basic 4KB page translation and page faults.
+TEST_F(RiscVMmuTest, Translate) {
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kCodePage + 0x10, AccessType::kFetch),
+            kPhysicalCode + 0x10);
+  EXPECT_EQ(Translate(kDataPage + 0x20, AccessType::kLoad),
+            kPhysicalData + 0x20);
+  EXPECT_EQ(Translate(kDataPage + 0x20, AccessType::kStore),
+            kPhysicalData + 0x20);
+  // Permission faults.
+  EXPECT_EQ(Translate(kCodePage, AccessType::kStore), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kStorePageFault);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kFetch), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kInstructionPageFault);
+  // Unmapped page.
+  EXPECT_EQ(Translate(kDataPage + 0x1000, AccessType::kLoad), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kLoadPageFault);
+  // Non-canonical address.
+  EXPECT_EQ(Translate(kDataPage | (1ULL << 40), AccessType::kLoad), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kLoadPageFault);
+}
+
+// User pages are only accessible from supervisor mode with mstatus.SUM set,
+// and never executable, and supervisor pages are not accessible from user
+// mode.
+TEST_F(RiscVMmuTest, UserPages) {
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kU | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), ~0ULL);
+  SetSum(true);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kFetch), ~0ULL);
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kFetch), kPhysicalCode);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), ~0ULL);
+}
+
+// The accessed and dirty bits are set by the page table walk.
+TEST_F(RiscVMmuTest, AccessedDirty) {
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kDataPage, kPhysicalData, kV | kR | kW);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  EXPECT_EQ(ReadPte(PteAddress(kDataPage)) & (kA | kD), kA);
+  // The TLB entry isn't dirty, so the store walks the page table again.
+  EXPECT_EQ(Translate(kDataPage, AccessType::kStore), kPhysicalData);
+  EXPECT_EQ(ReadPte(PteAddress(kDataPage)) & (kA | kD), kA | kD);
+}
+
+// Translations are cached until flushed by sfence.vma, and the ASID
+// selective flushes don't flush global mappings.
+TEST_F(RiscVMmuTest, Flush) {
+  constexpr uint64_t kAsid = 5;
+  satp_->Write(kSv39 | (kAsid << 44) | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kG | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  // Remap both pages.
+  Map(kCodePage, kPhysicalCode + 0x1000, kV | kR | kX | kG | kA);
+  Map(kDataPage, kPhysicalData + 0x1000, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  // Flushing another address space has no effect.
+  mmu_->FlushAsid(kAsid + 1);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  mmu_->FlushAsid(kAsid);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData + 0x1000);
+  mmu_->FlushAddress(kCodePage);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode + 0x1000);
+  // An entry from another address space is not used.
+  satp_->Write(kSv39 | ((kAsid + 1) << 44) | (kRootTable >> 12));
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+}
+
+// The ASID operand of the ASID selective flushes is truncated to the width of
+// the satp ASID field.
+TEST_F(RiscVMmuTest, FlushAsidMask) {
+  constexpr uint64_t kAsid = 5;
+  constexpr uint64_t kWideAsid = (1ULL << 16) | kAsid;
+  satp_->Write(kSv39 | (kAsid << 44) | (kRootTable >> 12));
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  Map(kDataPage, kPhysicalData + 0x1000, kV | kR | kW | kA | kD);
+  mmu_->FlushAsid(kWideAsid);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData + 0x1000);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  mmu_->FlushAddressAsid(kDataPage, kWideAsid);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  // The fetch contexts of the address space are invalidated.
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kFetch), kPhysicalCode);
+  state_->set_fetch_translation_changed(false);
+  mmu_->FlushAddressAsid(kCodePage, kWideAsid);
+  ASSERT_EQ(state_->fetch_invalidations().size(), 1);
+  auto filter = state_->fetch_invalidations()[0];
+  EXPECT_EQ(state_->fetch_context() & filter.mask, filter.value);
+  state_->clear_fetch_invalidations();
+}
+
+// Returns true if the filter of a fetch context invalidation selects the
+// context.
+bool Selects(const RiscVState::FetchContextFilter &filter, uint64_t context) {
+  return (context & filter.mask) == filter.value;
+}
+
+// Changes of the fetch context are signaled, so that the decoded instructions
+// of the context can be selected, and changes in fetch translations are
+// signaled with the contexts they affect, so that their instructions can be
+// discarded.
+TEST_F(RiscVMmuTest, FetchTranslationChanged) {
+  constexpr uint64_t kAsid = 5;
+  constexpr uint64_t kTranslated = RiscVState::kFetchContextChecked |
+                                   RiscVState::kFetchContextTranslated;
+  constexpr int kAsidShift = RiscVState::kFetchContextAsidShift;
+  EXPECT_EQ(state_->fetch_context(), 0);
+  satp_->Write(kSv39 | (kAsid << 44) | (kRootTable >> 12));
+  EXPECT_TRUE(state_->fetch_translation_changed());
+  EXPECT_TRUE(state_->fetch_invalidations().empty());
+  uint64_t supervisor = state_->fetch_context();
+  EXPECT_EQ(supervisor, kTranslated | (kAsid << kAsidShift) |
+                            *PrivilegeMode::kSupervisor);
+  state_->set_fetch_translation_changed(false);
+  // Privilege mode changes select another context without discarding any.
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  EXPECT_TRUE(state_->fetch_translation_changed());
+  EXPECT_TRUE(state_->fetch_invalidations().empty());
+  uint64_t user = state_->fetch_context();
+  EXPECT_EQ(user, kTranslated | (kAsid << kAsidShift) | *PrivilegeMode::kUser);
+  state_->set_privilege_mode(PrivilegeMode::kMachine);
+  uint64_t machine = state_->fetch_context();
+  EXPECT_EQ(machine,
+            RiscVState::kFetchContextChecked | *PrivilegeMode::kMachine);
+  state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  state_->set_fetch_translation_changed(false);
+  uint64_t other_asid =
+      (supervisor & ~(0xffffULL << kAsidShift)) | ((kAsid + 1) << kAsidShift);
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kCodePage, AccessType::kFetch), kPhysicalCode);
+  // Flushing a data page doesn't affect the fetches.
+  mmu_->FlushAddress(kDataPage);
+  EXPECT_FALSE(state_->fetch_translation_changed());
+  // An ASID selective flush of a code page discards the contexts of the
+  // address space.
+  mmu_->FlushAddressAsid(kCodePage, kAsid);
+  EXPECT_TRUE(state_->fetch_translation_changed());
+  ASSERT_EQ(state_->fetch_invalidations().size(), 1);
+  auto filter = state_->fetch_invalidations()[0];
+  EXPECT_TRUE(Selects(filter, supervisor));
+  EXPECT_TRUE(Selects(filter, user));
+  EXPECT_FALSE(Selects(filter, other_asid));
+  EXPECT_FALSE(Selects(filter, machine));
+  EXPECT_FALSE(Selects(filter, 0));
+  state_->clear_fetch_invalidations();
+  state_->set_fetch_translation_changed(false);
+  // Other flushes of a code page discard all translated contexts.
+  mmu_->FlushAddress(kCodePage);
+  EXPECT_TRUE(state_->fetch_translation_changed());
+  ASSERT_EQ(state_->fetch_invalidations().size(), 1);
+  filter = state_->fetch_invalidations()[0];
+  EXPECT_TRUE(Selects(filter, supervisor));
+  EXPECT_TRUE(Selects(filter, user));
+  EXPECT_TRUE(Selects(filter, other_asid));
+  EXPECT_FALSE(Selects(filter, machine));
+  EXPECT_FALSE(Selects(filter, 0));
+  state_->clear_fetch_invalidations();
+  state_->set_fetch_translation_changed(false);
+  // No instructions have been fetched since, so there is nothing to discard.
+  mmu_->FlushAll();
+  EXPECT_FALSE(state_->fetch_translation_changed());
+}
+
+// Direct host memory accesses are translated using the data TLB, which must
+// hold a translation that permits both loads and stores. The physical page is
+// then accessed directly.
+TEST_F(RiscVMmuTest, HostPointer) {
+  state_->set_host_memory(&memory_);
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA);
+  uint8_t *data = memory_.GetPage(kPhysicalData);
+  // The translation isn't in the TLB yet.
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4), nullptr);
+  // A load caches the translation, but the page isn't dirty until stored to.
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), kPhysicalData);
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4), nullptr);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kStore), kPhysicalData);
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4), data + 8);
+  // Pages that aren't writable are accessed through the memory interface.
+  EXPECT_EQ(Translate(kCodePage, AccessType::kLoad), kPhysicalCode);
+  EXPECT_EQ(state_->GetHostPointer(kCodePage, 4), nullptr);
+  // The permissions of the privilege mode are checked.
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4), nullptr);
+  // Machine mode accesses are not translated.
+  state_->set_privilege_mode(PrivilegeMode::kMachine);
+  EXPECT_EQ(state_->GetHostPointer(kPhysicalData + 8, 4), data + 8);
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4),
+            memory_.GetPage(kDataPage) + 8);
+  // Flushing the translation disables direct access.
+  state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  mmu_->FlushAddress(kDataPage);
+  EXPECT_EQ(state_->GetHostPointer(kDataPage + 8, 4), nullptr);
+}
+
+// The mmu decoder decodes the instruction at the physical address, and gives
+// it the virtual address. Fetches that fail translation return an instruction
+// that raises an instruction page fault, without decoding.
+TEST_F(RiscVMmuTest, DecoderPageFault) {
+  TestDecoder decoder(state_, &memory_);
+  RiscVMmuDecoder mmu_decoder(state_, &decoder);
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  WritePte(kPhysicalCode + 0x10, 0x0000'0013);
+  auto *inst = mmu_decoder.DecodeInstruction(kCodePage + 0x10);
+  EXPECT_EQ(decoder.address(), kPhysicalCode + 0x10);
+  EXPECT_EQ(decoder.word(), 0x0000'0013);
+  EXPECT_EQ(inst->address(), kCodePage + 0x10);
+  EXPECT_EQ(inst->size(), 4);
+  inst->DecRef();
+  // The data page isn't executable.
+  inst = mmu_decoder.DecodeInstruction(kDataPage + 0x20);
+  EXPECT_EQ(decoder.num_decodes(), 1);
+  EXPECT_EQ(inst->address(), kDataPage + 0x20);
+  EXPECT_EQ(inst->size(), 0);
+  EXPECT_EQ(inst->opcode(), 0);
+  EXPECT_EQ(inst->AsString(), "Instruction page fault");
+  uint64_t trap_value;
+  uint64_t code;
+  uint64_t epc;
+  ExecuteFault(inst, &trap_value, &code, &epc);
+  EXPECT_EQ(trap_value, kDataPage + 0x20);
+  EXPECT_EQ(code, *ExceptionCode::kInstructionPageFault);
+  EXPECT_EQ(epc, kDataPage + 0x20);
+  inst->DecRef();
+  // User mode can't execute the supervisor page.
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  inst = mmu_decoder.DecodeInstruction(kCodePage + 0x10);
+  EXPECT_EQ(decoder.num_decodes(), 1);
+  ExecuteFault(inst, &trap_value, &code, &epc);
+  EXPECT_EQ(trap_value, kCodePage + 0x10);
+  EXPECT_EQ(code, *ExceptionCode::kInstructionPageFault);
+  inst->DecRef();
+}
+
+// Fetches from physical memory that the PMP entries don't permit to execute
+// return an instruction that raises an instruction access fault.
+TEST_F(RiscVMmuTest, DecoderAccessFault) {
+  TestDecoder decoder(state_, &memory_);
+  RiscVMmuDecoder mmu_decoder(state_, &decoder);
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kDataPage, kPhysicalData, kV | kR | kX | kA);
+  // Entry 0 makes the physical data page read only, entry 1 grants all
+  // access to the rest of memory.
+  auto *csr_set = state_->csr_set();
+  csr_set->GetCsr("pmpaddr0").value()->Write(
+      static_cast<uint64_t>((kPhysicalData >> 2) | 0x1ff));
+  csr_set->GetCsr("pmpaddr1").value()->Write(~static_cast<uint64_t>(0));
+  csr_set->GetCsr("pmpcfg0").value()->Write(static_cast<uint64_t>(0x1f19));
+  WritePte(kPhysicalCode, 0x0000'0013);
+  auto *inst = mmu_decoder.DecodeInstruction(kCodePage);
+  EXPECT_EQ(inst->size(), 4);
+  inst->DecRef();
+  inst = mmu_decoder.DecodeInstruction(kDataPage + 0x8);
+  EXPECT_EQ(inst->size(), 0);
+  EXPECT_EQ(inst->AsString(), "Instruction access fault");
+  uint64_t trap_value;
+  uint64_t code;
+  uint64_t epc;
+  ExecuteFault(inst, &trap_value, &code, &epc);
+  EXPECT_EQ(trap_value, kDataPage + 0x8);
+  EXPECT_EQ(code, *ExceptionCode::kInstructionAccessFault);
+  EXPECT_EQ(epc, kDataPage + 0x8);
+  inst->DecRef();
+  // Machine mode fetches are checked too, but not translated.
+  csr_set->GetCsr("pmpcfg0").value()->Write(static_cast<uint64_t>(0x1f99));
+  state_->set_privilege_mode(PrivilegeMode::kMachine);
+  inst = mmu_decoder.DecodeInstruction(kPhysicalData + 0x8);
+  ExecuteFault(inst, &trap_value, &code, &epc);
+  EXPECT_EQ(trap_value, kPhysicalData + 0x8);
+  EXPECT_EQ(code, *ExceptionCode::kInstructionAccessFault);
+  inst->DecRef();
+}
+
+// An instruction in the last halfword of a page continues on the next page,
+// which is read from its physical address through the fetch memory when the
+// pages aren't physically contiguous.
+TEST_F(RiscVMmuTest, DecoderCrossPage) {
+  RiscVFetchMemory fetch_memory(mmu_, &memory_);
+  TestDecoder decoder(state_, &fetch_memory);
+  RiscVMmuDecoder mmu_decoder(state_, &decoder);
+  constexpr uint64_t kNextPage = kCodePage + 0x1000;
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kNextPage, kPhysicalData, kV | kR | kX | kA);
+  WriteHalf(kPhysicalCode + 0xffe, 0x5677);
+  WriteHalf(kPhysicalData, 0x1234);
+  auto *inst = mmu_decoder.DecodeInstruction(kCodePage + 0xffe);
+  EXPECT_EQ(decoder.address(), kPhysicalCode + 0xffe);
+  EXPECT_EQ(decoder.word(), 0x1234'5677);
+  EXPECT_EQ(inst->address(), kCodePage + 0xffe);
+  EXPECT_EQ(inst->size(), 4);
+  EXPECT_EQ(mmu_->fetch_split_address(), ~0ULL);
+  inst->DecRef();
+  // A fault on the next page is reported with the address of that page.
+  Map(kNextPage, 0, 0);
+  mmu_->FlushAll();
+  inst = mmu_decoder.DecodeInstruction(kCodePage + 0xffe);
+  EXPECT_EQ(decoder.num_decodes(), 1);
+  uint64_t trap_value;
+  uint64_t code;
+  uint64_t epc;
+  ExecuteFault(inst, &trap_value, &code, &epc);
+  EXPECT_EQ(trap_value, kNextPage);
+  EXPECT_EQ(code, *ExceptionCode::kInstructionPageFault);
+  EXPECT_EQ(epc, kCodePage + 0xffe);
+  inst->DecRef();
+  // A compressed instruction doesn't need the next page.
+  WriteHalf(kPhysicalCode + 0xffe, 0x0001);
+  inst = mmu_decoder.DecodeInstruction(kCodePage + 0xffe);
+  EXPECT_EQ(decoder.num_decodes(), 2);
+  EXPECT_EQ(inst->size(), 2);
+  inst->DecRef();
+}
+
+// The raw instruction words are recorded from the physical addresses of the
+// fetch, and masked to the size of the instruction.
+TEST_F(RiscVMmuTest, DecoderInstWords) {
+  RiscVFetchMemory fetch_memory(mmu_, &memory_);
+  TestDecoder decoder(state_, &fetch_memory);
+  RiscVMmuDecoder mmu_decoder(state_, &decoder);
+  constexpr uint64_t kNextPage = kCodePage + 0x1000;
+  WritePte(kPhysicalCode, 0x1234'0001'0000'0013ULL);
+  WriteHalf(kPhysicalCode + 0xffe, 0x5677);
+  WriteHalf(kPhysicalData, 0x1234);
+  // Words are only recorded while the memory is set.
+  auto *inst = mmu_decoder.DecodeInstruction(kPhysicalCode);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0);
+  inst->DecRef();
+  mmu_decoder.set_inst_word_memory(&memory_);
+  // Untranslated fetches.
+  inst = mmu_decoder.DecodeInstruction(kPhysicalCode);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0x0000'0013);
+  inst->DecRef();
+  inst = mmu_decoder.DecodeInstruction(kPhysicalCode + 4);
+  EXPECT_EQ(inst->size(), 2);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0x0001);
+  inst->DecRef();
+  // Translated fetches, including one that spans two pages that aren't
+  // physically contiguous.
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kCodePage, kPhysicalCode, kV | kR | kX | kA);
+  Map(kNextPage, kPhysicalData, kV | kR | kX | kA);
+  inst = mmu_decoder.DecodeInstruction(kCodePage);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0x0000'0013);
+  inst->DecRef();
+  inst = mmu_decoder.DecodeInstruction(kCodePage + 0xffe);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0x1234'5677);
+  inst->DecRef();
+  // Fetches that fault have no instruction word.
+  inst = mmu_decoder.DecodeInstruction(kNextPage + 0x1000);
+  EXPECT_EQ(inst->size(), 0);
+  EXPECT_EQ(mmu_decoder.GetInstWord(inst), 0);
+  inst->DecRef();
+}
+
+// Loads through the fetch memory that span the fetch split address read the
+// bytes beyond it from the next address. Other loads are unchanged.
+TEST_F(RiscVMmuTest, FetchMemorySplit) {
+  RiscVFetchMemory fetch_memory(mmu_, &memory_);
+  WritePte(kPhysicalCode + 0xff8, 0x1111'2222'3333'4444ULL);
+  WritePte(kPhysicalData, 0x5555'6666'7777'8888ULL);
+  auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+  mmu_->SetFetchSplit(kPhysicalCode + 0x1000, kPhysicalData);
+  fetch_memory.Load(kPhysicalCode + 0xffe, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0x8888'1111);
+  fetch_memory.Load(kPhysicalCode + 0xffc, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0x1111'2222);
+  fetch_memory.Load(kPhysicalCode + 0x1000, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0);
+  mmu_->ClearFetchSplit();
+  WritePte(kPhysicalCode + 0x1000, 0x9999'aaaa'bbbb'ccccULL);
+  fetch_memory.Load(kPhysicalCode + 0xffe, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0xcccc'1111);
+  db->DecRef();
+}
+
+// Superpages are translated, but must be aligned.
+TEST_F(RiscVMmuTest, Superpage) {
+  constexpr uint64_t kMegapage = 0x20'0000;
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  // Map the second megapage (vpn[1] == 1) to physical address 0x40'0000.
+  WritePte(kLevel1Table + 8, ((0x40'0000ULL >> 12) << 10) | kV | kR | kA);
+  EXPECT_EQ(Translate(kMegapage + 0x1'2345, AccessType::kLoad),
+            0x41'2345ULL);
+  // Misaligned megapage.
+  WritePte(kLevel1Table + 8, ((0x40'1000ULL >> 12) << 10) | kV | kR | kA);
+  mmu_->FlushAll();
+  EXPECT_EQ(Translate(kMegapage, AccessType::kLoad), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kLoadPageFault);
+}
+
+// Data accesses that cross into a page that isn't physically contiguous
+// raise a misaligned fault.
+TEST_F(RiscVMmuTest, CrossPage) {
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  Map(kDataPage + 0x1000, kPhysicalData + 0x1000, kV | kR | kW | kA | kD);
+  uint64_t physical;
+  uint64_t fault_address;
+  EXPECT_TRUE(mmu_->TranslateDataAccess(kDataPage + 0xffc, 8, AccessType::kLoad,
+                                        &physical, &code_, &fault_address));
+  EXPECT_EQ(physical, kPhysicalData + 0xffc);
+  Map(kDataPage + 0x1000, kPhysicalCode, kV | kR | kW | kA | kD);
+  mmu_->FlushAll();
+  EXPECT_FALSE(mmu_->TranslateDataAccess(kDataPage + 0xffc, 8,
+                                         AccessType::kStore, &physical, &code_,
+                                         &fault_address));
+  EXPECT_EQ(code_, ExceptionCode::kStoreAddressMisaligned);
+  // A fault on the second page reports the address of that page.
+  Map(kDataPage + 0x1000, 0, 0);
+  mmu_->FlushAll();
+  EXPECT_FALSE(mmu_->TranslateDataAccess(kDataPage + 0xffc, 8,
+                                         AccessType::kLoad, &physical, &code_,
+                                         &fault_address));
+  EXPECT_EQ(code_, ExceptionCode::kLoadPageFault);
+  EXPECT_EQ(fault_address, kDataPage + 0x1000);
+}
+
+// Page table accesses are checked against the PMP entries as supervisor
+// mode accesses, and raise access faults.
+TEST_F(RiscVMmuTest, PmpPageTable) {
+  satp_->Write(kSv39 | (kRootTable >> 12));
+  Map(kDataPage, kPhysicalData, kV | kR | kW);
+  auto *csr_set = state_->csr_set();
+  // Entry 0 makes the level 0 table read only, entry 1 grants access to the
+  // rest of memory.
+  csr_set->GetCsr("pmpaddr0").value()->Write(
+      static_cast<uint64_t>((kLevel0Table >> 2) | 0x1ff));
+  csr_set->GetCsr("pmpaddr1").value()->Write(~static_cast<uint64_t>(0));
+  csr_set->GetCsr("pmpcfg0").value()->Write(static_cast<uint64_t>(0x1f19));
+  // Setting the accessed bit requires write access.
+  EXPECT_EQ(Translate(kDataPage, AccessType::kLoad), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kLoadAccessFault);
+  Map(kDataPage, kPhysicalData, kV | kR | kW | kA | kD);
+  EXPECT_EQ(Translate(kDataPage, AccessType::kStore), kPhysicalData);
+  // Without read access the walk faults.
+  mmu_->FlushAll();
+  csr_set->GetCsr("pmpcfg0").value()->Write(static_cast<uint64_t>(0x1f18));
+  EXPECT_EQ(Translate(kDataPage, AccessType::kStore), ~0ULL);
+  EXPECT_EQ(code_, ExceptionCode::kStoreAccessFault);
+}
+
+// Sv32 uses two levels of 4 byte page table entries.
+TEST(RiscVMmuSv32Test, Translate) {
+  FlatDemandMemory memory;
+  RiscVState state("test", RiscVXlen::RV32, &memory);
+  state.set_privilege_mode(PrivilegeMode::kSupervisor);
+  auto *satp = state.csr_set()->GetCsr("satp").value();
+  auto *db = state.db_factory()->Allocate<uint32_t>(1);
+  // Root table at 0x1000, level 0 table at 0x2000. Map virtual address
+  // 0x8040'3000 (vpn[1] == 0x201, vpn[0] == 3) to 0x5000.
+  db->Set<uint32_t>(0, ((0x2000 >> 12) << 10) | kV);
+  memory.Store(0x1000 + 0x201 * 4, db);
+  db->Set<uint32_t>(0, ((0x5000 >> 12) << 10) | kV | kR | kA);
+  memory.Store(0x2000 + 3 * 4, db);
+  db->DecRef();
+  satp->Write(static_cast<uint32_t>(0x8000'0000 | (0x1000 >> 12)));
+  EXPECT_EQ(state.mmu()->mode(), RiscVMmu::Mode::kSv32);
+  uint64_t physical;
+  ExceptionCode code;
+  EXPECT_TRUE(state.mmu()->TranslateAddress(0x8040'3123, AccessType::kLoad,
+                                            &physical, &code));
+  EXPECT_EQ(physical, 0x5123);
+}
+
+// RV32 ASIDs are 9 bits wide.
+TEST(RiscVMmuSv32Test, FlushAsidMask) {
+  FlatDemandMemory memory;
+  RiscVState state("test", RiscVXlen::RV32, &memory);
+  state.set_privilege_mode(PrivilegeMode::kSupervisor);
+  auto *satp = state.csr_set()->GetCsr("satp").value();
+  auto *db = state.db_factory()->Allocate<uint32_t>(1);
+  // Root table at 0x1000, level 0 table at 0x2000. Map virtual address
+  // 0x3000 to 0x5000.
+  db->Set<uint32_t>(0, ((0x2000 >> 12) << 10) | kV);
+  memory.Store(0x1000, db);
+  db->Set<uint32_t>(0, ((0x5000 >> 12) << 10) | kV | kR | kA);
+  memory.Store(0x2000 + 3 * 4, db);
+  satp->Write(static_cast<uint32_t>(0x8000'0000 | (3 << 22) | (0x1000 >> 12)));
+  uint64_t physical;
+  ExceptionCode code;
+  EXPECT_TRUE(state.mmu()->TranslateAddress(0x3000, AccessType::kLoad,
+                                            &physical, &code));
+  EXPECT_EQ(physical, 0x5000);
+  db->Set<uint32_t>(0, ((0x6000 >> 12) << 10) | kV | kR | kA);
+  memory.Store(0x2000 + 3 * 4, db);
+  db->DecRef();
+  state.mmu()->FlushAsid(0x200 | 3);
+  EXPECT_TRUE(state.mmu()->TranslateAddress(0x3000, AccessType::kLoad,
+                                            &physical, &code));
+  EXPECT_EQ(physical, 0x6000);
+}
+
+}  // namespace
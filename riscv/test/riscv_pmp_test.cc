@@ -5,17 +5,33 @@
 #include "absl/strings/str_cat.h"
 #include "googlemock/include/gmock/gmock.h"
 #include "mpact/sim/generic/type_helpers.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
 #include "riscv/riscv_csr.h"
 #include "riscv/riscv_state.h"
 
 namespace {
 
+using ::mpact::sim::riscv::PmpAddressMatch;
+using ::mpact::sim::riscv::PmpCfgBits;
+using ::mpact::sim::riscv::PrivilegeMode;
 using ::mpact::sim::riscv::RiscVCsrEnum;
 using ::mpact::sim::riscv::RiscVPmp;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVXlen;
+using ::mpact::sim::util::FlatDemandMemory;
 using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
 
+constexpr int kR = *PmpCfgBits::kRead;
+constexpr int kW = *PmpCfgBits::kWrite;
+constexpr int kX = *PmpCfgBits::kExecute;
+constexpr int kL = *PmpCfgBits::kLock;
+constexpr int kTor = *PmpAddressMatch::kTor << 3;
+constexpr int kNa4 = *PmpAddressMatch::kNa4 << 3;
+constexpr int kNapot = *PmpAddressMatch::kNapot << 3;
+
+constexpr PrivilegeMode kMachine = PrivilegeMode::kMachine;
+constexpr PrivilegeMode kUser = PrivilegeMode::kUser;
+
 // Test that the expected PMP CSRs are created.
 TEST(RiscVPmpTest, CreatePmpCsrs32) {
   RiscVState state("test", RiscVXlen::RV32, nullptr, nullptr);
@@ -62,4 +78,173 @@ TEST(RiscVPmpTest, CreatePmpCsrs64) {
   }
 }
 
+class RiscVPmpCheckTest : public ::testing::Test {
+ protected:
+  RiscVPmpCheckTest() {
+    state_ = new RiscVState("test", RiscVXlen::RV64, &memory_);
+    pmp_ = state_->pmp();
+  }
+
+  ~RiscVPmpCheckTest() override { delete state_; }
+
+  // Writes the configuration of the entry, leaving the other entries in the
+  // same pmpcfg register unchanged. On RV64 pmpcfg0 and pmpcfg2 hold eight
+  // entries each.
+  void WriteCfg(int entry, uint8_t cfg) {
+    auto *csr = state_->csr_set()
+                    ->GetCsr(absl::StrCat("pmpcfg", (entry / 8) * 2))
+                    .value();
+    int shift = (entry % 8) * 8;
+    uint64_t value = csr->AsUint64() & ~(0xffULL << shift);
+    csr->Write(value | (static_cast<uint64_t>(cfg) << shift));
+  }
+
+  uint8_t ReadCfg(int entry) {
+    auto *csr = state_->csr_set()
+                    ->GetCsr(absl::StrCat("pmpcfg", (entry / 8) * 2))
+                    .value();
+    return static_cast<uint8_t>(csr->AsUint64() >> ((entry % 8) * 8));
+  }
+
+  void WriteAddress(int entry, uint64_t value) {
+    state_->csr_set()
+        ->GetCsr(absl::StrCat("pmpaddr", entry))
+        .value()
+        ->Write(value);
+  }
+
+  uint64_t ReadAddress(int entry) {
+    return state_->csr_set()
+        ->GetCsr(absl::StrCat("pmpaddr", entry))
+        .value()
+        ->AsUint64();
+  }
+
+  bool Allowed(uint64_t address, uint64_t size, int permissions,
+               PrivilegeMode privilege) {
+    return pmp_->IsAccessAllowed(address, size, permissions, privilege);
+  }
+
+  FlatDemandMemory memory_;
+  RiscVState *state_;
+  RiscVPmp *pmp_;
+};
+
+// Checking is only enabled once an entry is enabled.
+TEST_F(RiscVPmpCheckTest, MemoryProtection) {
+  EXPECT_FALSE(state_->memory_protection());
+  WriteAddress(0, 0x1000 >> 2);
+  EXPECT_FALSE(state_->memory_protection());
+  WriteCfg(0, kTor | kR);
+  EXPECT_TRUE(state_->memory_protection());
+  WriteCfg(0, 0);
+  EXPECT_FALSE(state_->memory_protection());
+}
+
+// A TOR entry matches addresses from the previous entry's address up to its
+// own. Unlocked entries don't restrict machine mode, and addresses that no
+// entry matches are only accessible in machine mode.
+TEST_F(RiscVPmpCheckTest, Tor) {
+  WriteAddress(0, 0x1000 >> 2);
+  WriteAddress(1, 0x3000 >> 2);
+  WriteCfg(1, kTor | kR | kX);
+  EXPECT_TRUE(Allowed(0x1000, 4, kR, kUser));
+  EXPECT_TRUE(Allowed(0x2ffc, 4, kX, kUser));
+  EXPECT_FALSE(Allowed(0x2000, 4, kW, kUser));
+  EXPECT_FALSE(Allowed(0xffc, 4, kR, kUser));
+  EXPECT_FALSE(Allowed(0x3000, 4, kR, kUser));
+  EXPECT_TRUE(Allowed(0x2000, 4, kW, kMachine));
+  EXPECT_TRUE(Allowed(0x3000, 4, kR | kW | kX, kMachine));
+  // The first entry matches from address 0.
+  WriteCfg(0, kTor | kR | kW);
+  EXPECT_TRUE(Allowed(0, 8, kR | kW, kUser));
+  // An access that isn't fully within the matching entry fails.
+  EXPECT_FALSE(Allowed(0xffc, 8, kR, kUser));
+  EXPECT_FALSE(Allowed(0xffc, 8, kR, kMachine));
+}
+
+// NA4 and NAPOT entries match naturally aligned regions, and the lowest
+// numbered matching entry determines the permissions.
+TEST_F(RiscVPmpCheckTest, NaturallyAligned) {
+  constexpr uint64_t kBase = 0x8000'0000;
+  // 64KB region with read/write permission.
+  WriteAddress(1, (kBase >> 2) | ((0x1'0000 >> 3) - 1));
+  WriteCfg(1, kNapot | kR | kW);
+  EXPECT_TRUE(Allowed(kBase, 4, kR | kW, kUser));
+  EXPECT_TRUE(Allowed(kBase + 0xfff8, 8, kW, kUser));
+  EXPECT_FALSE(Allowed(kBase + 0x1'0000, 4, kR, kUser));
+  EXPECT_FALSE(Allowed(kBase - 4, 4, kR, kUser));
+  EXPECT_FALSE(Allowed(kBase, 4, kX, kUser));
+  // A higher priority NA4 entry without permissions inside the region.
+  WriteAddress(0, (kBase + 0x100) >> 2);
+  WriteCfg(0, kNa4);
+  EXPECT_FALSE(Allowed(kBase + 0x100, 4, kR, kUser));
+  EXPECT_FALSE(Allowed(kBase + 0xfc, 8, kR, kUser));
+  EXPECT_TRUE(Allowed(kBase + 0xf8, 8, kR, kUser));
+  EXPECT_TRUE(Allowed(kBase + 0x104, 4, kR, kUser));
+  // A lower priority NA4 entry has no effect.
+  WriteCfg(0, 0);
+  WriteAddress(2, (kBase + 0x200) >> 2);
+  WriteCfg(2, kNa4);
+  EXPECT_TRUE(Allowed(kBase + 0x200, 4, kR, kUser));
+}
+
+// Locked entries also apply to machine mode, and can't be modified.
+TEST_F(RiscVPmpCheckTest, Lock) {
+  WriteAddress(0, 0x1000 >> 2);
+  WriteAddress(1, 0x2000 >> 2);
+  WriteCfg(1, kTor | kR | kL);
+  EXPECT_TRUE(Allowed(0x1000, 4, kR, kMachine));
+  EXPECT_FALSE(Allowed(0x1000, 4, kW, kMachine));
+  EXPECT_TRUE(Allowed(0x2000, 4, kW, kMachine));
+  // The configuration and the addresses of the entry and of the bottom of
+  // its range are locked.
+  WriteCfg(1, kTor | kR | kW);
+  EXPECT_EQ(ReadCfg(1), kTor | kR | kL);
+  WriteAddress(1, 0x4000 >> 2);
+  WriteAddress(0, 0);
+  EXPECT_EQ(ReadAddress(1), 0x2000 >> 2);
+  EXPECT_EQ(ReadAddress(0), 0x1000 >> 2);
+  EXPECT_FALSE(Allowed(0x1000, 4, kW, kMachine));
+  // Other entries can still be written.
+  WriteCfg(2, kNa4 | kR);
+  EXPECT_EQ(ReadCfg(2), kNa4 | kR);
+}
+
+// Write permission without read permission is reserved, and is cleared.
+TEST_F(RiscVPmpCheckTest, Legalize) {
+  WriteCfg(3, kNapot | kW | kX | 0x60);
+  EXPECT_EQ(ReadCfg(3), kNapot | kX);
+  // RV64 pmpaddr registers hold 54 bits.
+  WriteAddress(3, ~0ULL);
+  EXPECT_EQ(ReadAddress(3), 0x003f'ffff'ffff'ffffULL);
+}
+
+// Cached page permissions are updated when the entries change.
+TEST_F(RiscVPmpCheckTest, PageCache) {
+  WriteAddress(0, (0x1'0000 >> 2) | ((0x1000 >> 3) - 1));
+  WriteCfg(0, kNapot | kR | kW);
+  EXPECT_TRUE(Allowed(0x1'0800, 4, kW, kUser));
+  WriteCfg(0, kNapot | kR);
+  EXPECT_FALSE(Allowed(0x1'0800, 4, kW, kUser));
+  EXPECT_TRUE(Allowed(0x1'0800, 4, kR, kUser));
+  // Moving the entry to the middle of the page splits it.
+  WriteAddress(0, (0x1'0800 >> 2) | ((0x800 >> 3) - 1));
+  EXPECT_FALSE(Allowed(0x1'0000, 4, kR, kUser));
+  EXPECT_TRUE(Allowed(0x1'0800, 4, kR, kUser));
+}
+
+// On RV32 each pmpcfg register holds the configurations of four entries.
+TEST(RiscVPmpRv32Test, CfgLayout) {
+  FlatDemandMemory memory;
+  RiscVState state("test", RiscVXlen::RV32, &memory);
+  auto *csr_set = state.csr_set();
+  // Entry 5 is the second entry of pmpcfg1.
+  csr_set->GetCsr("pmpaddr5").value()->Write(static_cast<uint32_t>(0x100));
+  csr_set->GetCsr("pmpcfg1").value()->Write(
+      static_cast<uint32_t>((kNa4 | kR) << 8));
+  EXPECT_TRUE(state.pmp()->IsAccessAllowed(0x400, 4, kR, kUser));
+  EXPECT_FALSE(state.pmp()->IsAccessAllowed(0x404, 4, kR, kUser));
+}
+
 }  // namespace
@@ -15,17 +15,22 @@
 #include "riscv/riscv_state.h"
 
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <ostream>
 #include <string>
 
 #include "absl/log/check.h"
 #include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/arch_state.h"
 #include "mpact/sim/util/memory/flat_demand_memory.h"
+#include "riscv/riscv_host_memory.h"
 #include "riscv/riscv_register.h"
 
 namespace {
 
+using ::mpact::sim::generic::FunctionDelayLine;
+using ::mpact::sim::riscv::RiscVHostMemory;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVXlen;
 using ::mpact::sim::riscv::RV32Register;
@@ -96,4 +101,108 @@ TEST(RiscVStateTest, OutOfBoundLoad) {
   delete state;
 }
 
+// The scalar load contexts and store data buffers are reused, unless a
+// reference to them is still held.
+TEST(RiscVStateTest, ScalarAccessBuffers) {
+  FlatDemandMemory memory;
+  auto *state = new RiscVState("test", RiscVXlen::RV32, &memory);
+  auto *context = state->GetScalarLoadContext(sizeof(uint32_t));
+  EXPECT_EQ(context->value_db->size<uint8_t>(), sizeof(uint32_t));
+  EXPECT_EQ(state->GetScalarLoadContext(sizeof(uint32_t)), context);
+  EXPECT_NE(state->GetScalarLoadContext(sizeof(uint16_t)), context);
+  context->IncRef();
+  auto *new_context = state->GetScalarLoadContext(sizeof(uint32_t));
+  EXPECT_NE(new_context, context);
+  EXPECT_EQ(new_context->value_db->size<uint8_t>(), sizeof(uint32_t));
+  context->DecRef();
+
+  auto *db = state->GetScalarStoreDataBuffer(sizeof(uint64_t));
+  EXPECT_EQ(db->size<uint8_t>(), sizeof(uint64_t));
+  db->Set<uint64_t>(0, kMemValue);
+  state->StoreMemory(nullptr, kMemAddr, db);
+  EXPECT_EQ(state->GetScalarStoreDataBuffer(sizeof(uint64_t)), db);
+  db->IncRef();
+  EXPECT_NE(state->GetScalarStoreDataBuffer(sizeof(uint64_t)), db);
+  db->DecRef();
+  delete state;
+}
+
+// Host pointers are only returned for accesses within a page that is below the
+// maximum physical address and not excluded, and only while the host memory is
+// set.
+TEST(RiscVStateTest, HostPointer) {
+  RiscVHostMemory memory;
+  auto *state = new RiscVState("test", RiscVXlen::RV32, &memory);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), nullptr);
+  state->set_host_memory(&memory);
+  uint8_t *host = state->GetHostPointer(kMemAddr, sizeof(uint32_t));
+  ASSERT_NE(host, nullptr);
+  EXPECT_EQ(host, memory.GetPage(kMemAddr) +
+                      (kMemAddr & (RiscVHostMemory::kPageSize - 1)));
+  // Data stored through the host pointer is visible through the state.
+  std::memcpy(host, &kMemValue, sizeof(kMemValue));
+  auto *db = state->db_factory()->Allocate<uint32_t>(1);
+  state->LoadMemory(nullptr, kMemAddr, db, nullptr, nullptr);
+  EXPECT_EQ(db->Get<uint32_t>(0), kMemValue);
+  db->DecRef();
+  // Accesses that cross a page boundary.
+  EXPECT_EQ(state->GetHostPointer(RiscVHostMemory::kPageSize - 2, 4), nullptr);
+  EXPECT_NE(state->GetHostPointer(RiscVHostMemory::kPageSize - 4, 4), nullptr);
+  // Exclusions are counted.
+  state->DisableHostMemoryAccess(kMemAddr + 0x10, 4);
+  state->DisableHostMemoryAccess(kMemAddr + 0x20, 4);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), nullptr);
+  state->EnableHostMemoryAccess(kMemAddr + 0x10, 4);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), nullptr);
+  state->EnableHostMemoryAccess(kMemAddr + 0x20, 4);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), host);
+  // Pages beyond the maximum physical address.
+  state->set_max_physical_address(kMemAddr);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), nullptr);
+  state->set_max_physical_address(0xffff'ffff);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), host);
+  // Changing the memory disables host pointers.
+  state->set_memory(&memory);
+  EXPECT_EQ(state->GetHostPointer(kMemAddr, sizeof(uint32_t)), nullptr);
+  delete state;
+}
+
+// Writes delayed through a delay line created by the RiscVState, and through
+// the data buffer delay line, still land on the right cycle after a number of
+// idle cycles in which the delay lines are not advanced.
+TEST(RiscVStateTest, DelayLines) {
+  FlatDemandMemory memory;
+  auto *state = new RiscVState("test", RiscVXlen::RV32, &memory);
+  auto *owned_line = state->CreateAndAddDelayLine<FunctionDelayLine>();
+  auto *x1 = state->GetRegister<RV32Register>("x1").first;
+  auto *x2 = state->GetRegister<RV32Register>("x2").first;
+  // Idle cycles, with all delay lines empty.
+  for (int i = 0; i < 5; i++) state->AdvanceDelayLines();
+  // Write x1 through the owned delay line, while the ArchState delay lines
+  // stay empty.
+  owned_line->Add(3, [x1]() {
+    x1->data_buffer()->Set<uint32_t>(0, kMemValue);
+  });
+  state->AdvanceDelayLines();
+  EXPECT_EQ(x1->data_buffer()->Get<uint32_t>(0), 0);
+  state->AdvanceDelayLines();
+  EXPECT_EQ(x1->data_buffer()->Get<uint32_t>(0), 0);
+  state->AdvanceDelayLines();
+  EXPECT_EQ(x1->data_buffer()->Get<uint32_t>(0), kMemValue);
+  // More idle cycles, then write x2 with latency through the ArchState data
+  // buffer delay line.
+  for (int i = 0; i < 5; i++) state->AdvanceDelayLines();
+  auto *dest = x2->CreateDestinationOperand(/*latency=*/2);
+  auto *db = dest->AllocateDataBuffer();
+  db->Set<uint32_t>(0, kMemValue);
+  db->Submit();
+  EXPECT_EQ(x2->data_buffer()->Get<uint32_t>(0), 0);
+  state->AdvanceDelayLines();
+  EXPECT_EQ(x2->data_buffer()->Get<uint32_t>(0), 0);
+  state->AdvanceDelayLines();
+  EXPECT_EQ(x2->data_buffer()->Get<uint32_t>(0), kMemValue);
+  delete dest;
+  delete state;
+}
+
 }  // namespace
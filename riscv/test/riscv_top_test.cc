@@ -14,14 +14,19 @@
 
 #include "riscv/riscv_top.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <sstream>
 #include <string>
+#include <thread>  // NOLINT: used to request halts from another thread.
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "googlemock/include/gmock/gmock.h"
 #include "mpact/sim/generic/core_debug_interface.h"
+#include "mpact/sim/generic/counters.h"
 #include "mpact/sim/generic/decoder_interface.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
@@ -33,6 +38,8 @@
 #include "riscv/riscv32_htif_semihost.h"
 #include "riscv/riscv64_decoder.h"
 #include "riscv/riscv_arm_semihost.h"
+#include "riscv/riscv_clint.h"
+#include "riscv/riscv_commit_trace.h"
 #include "riscv/riscv_register.h"
 #include "riscv/riscv_register_aliases.h"
 #include "riscv/riscv_state.h"
@@ -45,11 +52,17 @@ using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
 #define EXPECT_OK(x) EXPECT_TRUE(x.ok())
 #endif
 
+using ::mpact::sim::generic::AccessType;
 using ::mpact::sim::generic::DecoderInterface;
 using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::SimpleCounter;
 using ::mpact::sim::riscv::RiscV32Decoder;
 using ::mpact::sim::riscv::RiscV64Decoder;
 using ::mpact::sim::riscv::RiscVArmSemihost;
+using ::mpact::sim::riscv::RiscVClint;
+using ::mpact::sim::riscv::RiscVCommitTrace;
+using ::mpact::sim::riscv::BranchTraceEntry;
+using ::mpact::sim::riscv::PrivilegeMode;
 using ::mpact::sim::riscv::RiscVFPState;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVTop;
@@ -67,6 +80,17 @@ constexpr char kArm64FileName[] = "hello_world_64.elf";
 // The depot path to the test directory.
 constexpr char kDepotPath[] = "riscv/test/";
 
+// RV32 instruction words used by the tests that write their own programs.
+constexpr uint32_t kNop = 0x0000'0013;
+constexpr uint32_t kAddiX5 = 0x0012'8293;     // addi x5, x5, 1
+constexpr uint32_t kCsrwMieX6 = 0x3043'1073;  // csrw mie, x6
+constexpr uint32_t kBltX5X6 = 0xfe62'cee3;    // blt x5, x6, -4
+constexpr uint32_t kEbreak = 0x0010'0073;
+constexpr uint32_t kJ0 = 0x0000'006f;         // j 0
+constexpr uint32_t kJm4 = 0xffdf'f06f;        // j -4
+constexpr uint32_t kMachineTimerInterrupt = 0x8000'0007;
+constexpr uint32_t kMtip = 1 << 7;
+
 // Helper function to get symbol addresses from the loader.
 static bool GetMagicAddresses(
     mpact::sim::util::ElfProgramLoader *loader,
@@ -206,6 +230,90 @@ class RiscVTopTest : public testing::Test {
     entry_point_ = result.value();
   }
 
+  // Writes the instruction words to memory starting at 'address'.
+  void WriteProgram(uint64_t address, const std::vector<uint32_t> &program) {
+    for (auto word : program) {
+      CHECK_OK(riscv_top_->WriteMemory(address, &word, sizeof(word)));
+      address += sizeof(word);
+    }
+  }
+
+  // Halts the simulation on ebreak instructions that are not breakpoints.
+  void HaltOnEbreak() {
+    state_->AddEbreakHandler([this](const Instruction *) {
+      riscv_top_->RequestHalt(HaltReason::kUserRequest, nullptr);
+      return true;
+    });
+  }
+
+  // Sets up a program in which the write of x6 to mie in the middle of a
+  // block makes a pending machine timer interrupt available. The interrupt
+  // handler at 0x2000 ends with an ebreak.
+  void SetupInterruptProgram() {
+    WriteProgram(0x1000,
+                 {kAddiX5, kAddiX5, kCsrwMieX6, kAddiX5, kAddiX5, kEbreak});
+    WriteProgram(0x2000, {kEbreak});
+    HaltOnEbreak();
+    state_->mtvec()->Write(0x2000U);
+    state_->mip()->set_mtip(1);
+  }
+
+  // Sets up a loop that increments x5 until it reaches x6, followed by an
+  // ebreak.
+  void SetupLoopProgram() {
+    WriteProgram(0x1000, {kAddiX5, kBltX5X6, kEbreak});
+    HaltOnEbreak();
+  }
+
+  // Runs the loop program for 'count' iterations.
+  void RunLoopProgram(int count) {
+    CHECK_OK(riscv_top_->WriteRegister("x5", 0));
+    CHECK_OK(riscv_top_->WriteRegister("x6", count));
+    CHECK_OK(riscv_top_->WriteRegister("pc", 0x1000));
+    CHECK_OK(riscv_top_->Run());
+    CHECK_OK(riscv_top_->Wait());
+  }
+
+  // Returns the value of the opcode counter for 'opcode'.
+  uint64_t GetOpcodeCount(const std::string &opcode) {
+    auto *counter = riscv_top_->counter_map().at(absl::StrCat("num_", opcode));
+    return static_cast<SimpleCounter<uint64_t> *>(counter)->GetValue();
+  }
+
+  // Sets up a program of straight line code that is interrupted by the clint
+  // timer once the cycle counter reaches 'mtimecmp'. The interrupt handler at
+  // 0x2000 ends with an ebreak.
+  void SetupTimerProgram(RiscVClint *clint, uint32_t mtimecmp) {
+    std::vector<uint32_t> program(100, kAddiX5);
+    program.push_back(kEbreak);
+    WriteProgram(0x1000, program);
+    WriteProgram(0x2000, {kEbreak});
+    HaltOnEbreak();
+    state_->mtvec()->Write(0x2000U);
+    riscv_top_->counter_num_cycles()->AddListener(clint);
+    riscv_top_->set_counter_deadline_fcn(
+        [clint]() { return clint->TicksToDeadline(); });
+    auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+    db->Set<uint32_t>(0, mtimecmp);
+    clint->Store(0x4000, db);
+    db->DecRef();
+    ResetInterruptProgram(0);
+    state_->mie()->Write(kMtip);
+  }
+
+  // Resets the state used by the interrupt program, so that it executes from
+  // the beginning with interrupts enabled by mie value 'mie'.
+  void ResetInterruptProgram(uint32_t mie) {
+    state_->mie()->Write(0U);
+    state_->mstatus()->set_mie(1);
+    state_->mstatus()->Submit();
+    state_->mepc()->Write(0U);
+    state_->mcause()->Write(0U);
+    CHECK_OK(riscv_top_->WriteRegister("x5", 0));
+    CHECK_OK(riscv_top_->WriteRegister("x6", mie));
+    CHECK_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  }
+
   uint64_t entry_point_;
   RiscVTop *riscv_top_ = nullptr;
   mpact::sim::util::ElfProgramLoader *loader_ = nullptr;
@@ -517,6 +625,383 @@ TEST_F(RiscVTopTest, ReadWriteOutOfBoundMemory) {
   EXPECT_FALSE(result.ok());
 }
 
+// Instructions are fetched with the permissions of the current privilege
+// mode, even if they were decoded for another privilege mode at the same
+// virtual address.
+TEST_F(RiscVTopTest, FetchPermissionsPerPrivilegeMode) {
+  constexpr uint32_t kInstructionPageFault = 12;
+  // Sv32 page tables: the root table at 0x1000 points to the level 0 table at
+  // 0x2000, which maps the supervisor page 0x5000 to 0x10000 and the user
+  // page 0x6000 to 0x11000.
+  constexpr uint32_t kV = 0x01, kR = 0x02, kX = 0x08, kU = 0x10, kA = 0x40;
+  uint32_t pte = ((0x2000 >> 12) << 10) | kV;
+  EXPECT_OK(riscv_top_->WriteMemory(0x1000, &pte, sizeof(pte)));
+  pte = ((0x10000 >> 12) << 10) | kV | kR | kX | kA;
+  EXPECT_OK(riscv_top_->WriteMemory(0x2000 + 5 * 4, &pte, sizeof(pte)));
+  pte = ((0x11000 >> 12) << 10) | kV | kR | kX | kU | kA;
+  EXPECT_OK(riscv_top_->WriteMemory(0x2000 + 6 * 4, &pte, sizeof(pte)));
+  uint32_t nop = kNop;
+  EXPECT_OK(riscv_top_->WriteMemory(0x10000, &nop, sizeof(nop)));
+  EXPECT_OK(riscv_top_->WriteMemory(0x11000, &nop, sizeof(nop)));
+  auto *satp = state_->csr_set()->GetCsr("satp").value();
+  satp->Write(0x8000'0001U);
+
+  uint32_t pc;
+  // Supervisor mode executes the supervisor page.
+  state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x5000));
+  EXPECT_OK(riscv_top_->Step(1));
+  pc = riscv_top_->ReadRegister("pc").value();
+  EXPECT_EQ(pc, 0x5004);
+  // User mode can't fetch from the same page, even though its instruction was
+  // decoded in supervisor mode.
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x5000));
+  EXPECT_OK(riscv_top_->Step(1));
+  EXPECT_EQ(state_->privilege_mode(), PrivilegeMode::kMachine);
+  EXPECT_EQ(state_->mcause()->AsUint32(), kInstructionPageFault);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x5000);
+  // User mode executes the user page.
+  state_->set_privilege_mode(PrivilegeMode::kUser);
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x6000));
+  EXPECT_OK(riscv_top_->Step(1));
+  pc = riscv_top_->ReadRegister("pc").value();
+  EXPECT_EQ(pc, 0x6004);
+  // Supervisor mode can't fetch from the user page.
+  state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  state_->mcause()->Write(0U);
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x6000));
+  EXPECT_OK(riscv_top_->Step(1));
+  EXPECT_EQ(state_->privilege_mode(), PrivilegeMode::kMachine);
+  EXPECT_EQ(state_->mcause()->AsUint32(), kInstructionPageFault);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x6000);
+  // Returning to supervisor mode still executes the supervisor page.
+  state_->set_privilege_mode(PrivilegeMode::kSupervisor);
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x5000));
+  EXPECT_OK(riscv_top_->Step(1));
+  pc = riscv_top_->ReadRegister("pc").value();
+  EXPECT_EQ(pc, 0x5004);
+}
+
+// An interrupt that becomes available in the middle of a block of translated
+// instructions is taken right after the instruction that made it available,
+// with mepc pointing to the next instruction.
+TEST_F(RiscVTopTest, InterruptInRun) {
+  SetupInterruptProgram();
+  // The first run leaves interrupts disabled, and translates the program into
+  // a single block.
+  ResetInterruptProgram(0);
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 4);
+  EXPECT_EQ(state_->mcause()->AsUint32(), 0);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0);
+  // The second run executes the translated block, and takes the interrupt
+  // when mie is written, without executing the rest of the block.
+  ResetInterruptProgram(kMtip);
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 2);
+  EXPECT_EQ(state_->mcause()->AsUint32(), kMachineTimerInterrupt);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x100c);
+  EXPECT_EQ(state_->privilege_mode(), PrivilegeMode::kMachine);
+  EXPECT_FALSE(state_->mstatus()->mie());
+}
+
+// Step takes an interrupt after the instruction that made it available, and
+// the next step executes the first instruction of the handler.
+TEST_F(RiscVTopTest, InterruptInStep) {
+  SetupInterruptProgram();
+  ResetInterruptProgram(kMtip);
+  EXPECT_OK(riscv_top_->Step(2));
+  EXPECT_EQ(state_->mcause()->AsUint32(), 0);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1008);
+  EXPECT_OK(riscv_top_->Step(1));
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 2);
+  EXPECT_EQ(state_->mcause()->AsUint32(), kMachineTimerInterrupt);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x100c);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x2000);
+  // Step and Run give the same result.
+  ResetInterruptProgram(kMtip);
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 2);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x100c);
+}
+
+// An action that sets an action point in the block that is executing removes
+// the block. Execution continues correctly, and the new action point takes
+// effect.
+TEST_F(RiscVTopTest, ActionInvalidatesExecutingBlock) {
+  WriteProgram(0x1000, {kAddiX5, kAddiX5, kAddiX5, kAddiX5, kEbreak});
+  HaltOnEbreak();
+  int first_count = 0;
+  int second_count = 0;
+  auto *top = riscv_top_;
+  auto result = riscv_top_->SetActionPoint(
+      0x1004, [top, &first_count, &second_count](uint64_t, int) {
+        if (first_count++ > 0) return;
+        auto result = top->SetActionPoint(
+            0x1000, [&second_count](uint64_t, int) { second_count++; });
+        EXPECT_OK(result.status());
+      });
+  EXPECT_OK(result.status());
+  for (int i = 0; i < 2; i++) {
+    EXPECT_OK(riscv_top_->WriteRegister("x5", 0));
+    EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+    EXPECT_OK(riscv_top_->Run());
+    EXPECT_OK(riscv_top_->Wait());
+    EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 4);
+  }
+  EXPECT_EQ(first_count, 2);
+  EXPECT_EQ(second_count, 1);
+}
+
+// The clint timer interrupt is taken on the exact cycle when the cycle
+// counter reaches mtimecmp, even though the run loop adds the cycles to the
+// counter in batches.
+TEST_F(RiscVTopTest, TimerInterruptInRun) {
+  RiscVClint clint(/*period=*/1, state_->mip());
+  SetupTimerProgram(&clint, 10);
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(state_->mcause()->AsUint32(), kMachineTimerInterrupt);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x1000 + 10 * 4);
+  // A later deadline, reached in a translated block.
+  auto *db = state_->db_factory()->Allocate<uint32_t>(1);
+  db->Set<uint32_t>(0, 50);
+  clint.Store(0x4000, db);
+  db->DecRef();
+  uint64_t cycles = riscv_top_->counter_num_cycles()->GetValue();
+  ResetInterruptProgram(0);
+  state_->mie()->Write(kMtip);
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(state_->mcause()->AsUint32(), kMachineTimerInterrupt);
+  EXPECT_EQ(riscv_top_->counter_num_cycles()->GetValue(), 50 + 1);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 50 - cycles);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x1000 + (50 - cycles) * 4);
+}
+
+// Step takes the clint timer interrupt on the same cycle as Run.
+TEST_F(RiscVTopTest, TimerInterruptInStep) {
+  RiscVClint clint(/*period=*/1, state_->mip());
+  SetupTimerProgram(&clint, 10);
+  EXPECT_OK(riscv_top_->Step(200).status());
+  EXPECT_EQ(state_->mcause()->AsUint32(), kMachineTimerInterrupt);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  EXPECT_EQ(state_->mepc()->AsUint32(), 0x1000 + 10 * 4);
+}
+
+// A halt requested right after Run returns, or while Wait is waiting, stops
+// the simulation with the user request halt reason.
+TEST_F(RiscVTopTest, HaltRacesWithRunAndWait) {
+  WriteProgram(0x1000, {kJ0});
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  for (int i = 0; i < 20; i++) {
+    EXPECT_OK(riscv_top_->Run());
+    EXPECT_OK(riscv_top_->Halt());
+    EXPECT_OK(riscv_top_->Wait());
+    EXPECT_EQ(riscv_top_->GetRunStatus().value(), RiscVTop::RunStatus::kHalted);
+    EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+              *HaltReason::kUserRequest);
+  }
+  for (int i = 0; i < 20; i++) {
+    EXPECT_OK(riscv_top_->Run());
+    std::thread halt_thread([this]() { EXPECT_OK(riscv_top_->Halt()); });
+    EXPECT_OK(riscv_top_->Wait());
+    halt_thread.join();
+    EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+              *HaltReason::kUserRequest);
+  }
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1000);
+}
+
+// The run loop clears the action point halt reason after performing the
+// actions, but not a halt that was requested in the meantime.
+TEST_F(RiscVTopTest, ActionPointKeepsOtherHaltReason) {
+  WriteProgram(0x1000, {kAddiX5, kJm4});
+  int count = 0;
+  auto *top = riscv_top_;
+  auto result =
+      riscv_top_->SetActionPoint(0x1000, [top, &count](uint64_t, int) {
+        if (++count == 3) {
+          top->RequestHalt(HaltReason::kUserRequest, nullptr);
+        }
+      });
+  EXPECT_OK(result.status());
+  EXPECT_OK(riscv_top_->WriteRegister("x5", 0));
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+            *HaltReason::kUserRequest);
+  EXPECT_EQ(count, 3);
+  // The instruction at the action point is executed when the simulation
+  // resumes.
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 2);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1000);
+  EXPECT_OK(riscv_top_->Step(1).status());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 3);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1004);
+  // A halt requested from another thread while the action point is hit over
+  // and over is not lost either.
+  for (int i = 0; i < 20; i++) {
+    EXPECT_OK(riscv_top_->Run());
+    EXPECT_OK(riscv_top_->Halt());
+    EXPECT_OK(riscv_top_->Wait());
+    EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+              *HaltReason::kUserRequest);
+  }
+}
+
+// The run loop only records the branch trace once it has been requested
+// through the debug interface.
+TEST_F(RiscVTopTest, BranchTraceOnlyWhenRequested) {
+  SetupLoopProgram();
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  // This requests the branch trace, but it is still empty.
+  auto result = riscv_top_->GetRegisterDataBuffer("$branch_trace");
+  EXPECT_OK(result.status());
+  auto *trace = reinterpret_cast<BranchTraceEntry *>(result.value()->raw_ptr());
+  int size = riscv_top_->ReadRegister("$branch_trace_size").value();
+  for (int i = 0; i < size; i++) EXPECT_EQ(trace[i].count, 0) << i;
+  // Once requested, the branches are recorded.
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  int head = riscv_top_->ReadRegister("$branch_trace_head").value();
+  EXPECT_EQ(trace[head].from, 0x1004);
+  EXPECT_EQ(trace[head].to, 0x1000);
+  EXPECT_EQ(trace[head].count, 9);
+}
+
+// The run loop specializations selected for the active features all execute
+// the program the same way.
+TEST_F(RiscVTopTest, RunLoopSpecializations) {
+  SetupLoopProgram();
+  // 10 addi, 10 blt, and the ebreak.
+  constexpr uint64_t kNumInstructions = 21;
+  auto *instructions = riscv_top_->counter_num_instructions();
+  auto *cycles = riscv_top_->counter_num_cycles();
+  auto check_run = [&](const std::string &what) {
+    SCOPED_TRACE(what);
+    uint64_t num_instructions = instructions->GetValue();
+    uint64_t num_cycles = cycles->GetValue();
+    RunLoopProgram(10);
+    EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+              *HaltReason::kUserRequest);
+    EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+    EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x100c);
+    EXPECT_EQ(instructions->GetValue() - num_instructions, kNumInstructions);
+    EXPECT_EQ(cycles->GetValue() - num_cycles, kNumInstructions);
+  };
+  riscv_top_->EnableStatistics();
+  check_run("opcode statistics");
+  // Without statistics, the counters are not updated.
+  riscv_top_->DisableStatistics();
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x100c);
+  riscv_top_->EnableStatistics();
+  // A data watchpoint on memory that the program doesn't access.
+  EXPECT_OK(riscv_top_->SetDataWatchpoint(0x8000, 4, AccessType::kLoadStore));
+  check_run("data watchpoint");
+  EXPECT_OK(riscv_top_->ClearDataWatchpoint(0x8000, AccessType::kLoadStore));
+  // A breakpoint on the loop branch, which is cleared before resuming.
+  EXPECT_OK(riscv_top_->SetSwBreakpoint(0x1004));
+  EXPECT_OK(riscv_top_->WriteRegister("x5", 0));
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+            *HaltReason::kSoftwareBreakpoint);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 1);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1004);
+  EXPECT_OK(riscv_top_->ClearSwBreakpoint(0x1004));
+  check_run("breakpoint cleared");
+  // Branch trace.
+  EXPECT_OK(riscv_top_->ReadRegister("$branch_trace_head").status());
+  check_run("branch trace");
+  // Commit trace.
+  std::ostringstream os;
+  {
+    RiscVCommitTrace commit_trace(state_, memory_, &os);
+    riscv_top_->set_commit_trace(&commit_trace);
+    check_run("commit trace");
+    riscv_top_->set_commit_trace(nullptr);
+  }
+  std::string log = os.str();
+  EXPECT_EQ(std::count(log.begin(), log.end(), '\n'), kNumInstructions);
+}
+
+// The per-opcode counts accumulated by the run and step loops are exported to
+// the opcode counters when the core halts.
+TEST_F(RiscVTopTest, OpcodeCounts) {
+  SetupLoopProgram();
+  riscv_top_->EnableStatistics();
+  RunLoopProgram(10);
+  EXPECT_EQ(GetOpcodeCount("addi"), 10);
+  EXPECT_EQ(GetOpcodeCount("blt"), 10);
+  EXPECT_EQ(GetOpcodeCount("ebreak"), 1);
+  // Step through the first loop iteration and into the second.
+  EXPECT_OK(riscv_top_->WriteRegister("x5", 0));
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  EXPECT_EQ(riscv_top_->Step(3).value(), 3);
+  EXPECT_EQ(GetOpcodeCount("addi"), 12);
+  EXPECT_EQ(GetOpcodeCount("blt"), 11);
+  EXPECT_EQ(GetOpcodeCount("ebreak"), 1);
+  // Finish the loop with Run.
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  EXPECT_EQ(GetOpcodeCount("addi"), 20);
+  EXPECT_EQ(GetOpcodeCount("blt"), 20);
+  EXPECT_EQ(GetOpcodeCount("ebreak"), 2);
+  // Nothing is counted while statistics are disabled.
+  riscv_top_->DisableStatistics();
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  EXPECT_EQ(GetOpcodeCount("addi"), 20);
+  EXPECT_EQ(GetOpcodeCount("blt"), 20);
+  EXPECT_EQ(GetOpcodeCount("ebreak"), 2);
+}
+
+// A breakpoint that is cleared after it halted the simulation is not written
+// back to memory when the simulation resumes, and the pc may be changed before
+// resuming.
+TEST_F(RiscVTopTest, ResumeAfterClearingBreakpoint) {
+  SetupLoopProgram();
+  EXPECT_OK(riscv_top_->SetSwBreakpoint(0x1004));
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+            *HaltReason::kSoftwareBreakpoint);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 1);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1004);
+  EXPECT_OK(riscv_top_->ClearSwBreakpoint(0x1004));
+  EXPECT_OK(riscv_top_->Run());
+  EXPECT_OK(riscv_top_->Wait());
+  EXPECT_EQ(riscv_top_->GetLastHaltReason().value(),
+            *HaltReason::kUserRequest);
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 10);
+  uint32_t word = 0;
+  EXPECT_OK(riscv_top_->ReadMemory(0x1004, &word, sizeof(word)));
+  EXPECT_EQ(word, kBltX5X6);
+  // Halt at the breakpoint again, and restart the loop from the beginning.
+  EXPECT_OK(riscv_top_->SetSwBreakpoint(0x1004));
+  RunLoopProgram(10);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1004);
+  EXPECT_OK(riscv_top_->ClearSwBreakpoint(0x1004));
+  EXPECT_OK(riscv_top_->WriteRegister("x5", 0));
+  EXPECT_OK(riscv_top_->WriteRegister("pc", 0x1000));
+  EXPECT_OK(riscv_top_->Step(1).status());
+  EXPECT_EQ(riscv_top_->ReadRegister("x5").value(), 1);
+  EXPECT_EQ(riscv_top_->ReadRegister("pc").value(), 0x1004);
+  EXPECT_OK(riscv_top_->ReadMemory(0x1000, &word, sizeof(word)));
+  EXPECT_EQ(word, kAddiX5);
+}
+
 // This test will verify that the 64 bit version executes a program properly.
 // No need to test other aspects of the top.
 TEST_F(RiscVTopTest, RiscV64) {
@@ -42,7 +42,9 @@ using Instruction = ::mpact::sim::generic::Instruction;
 using ::mpact::sim::riscv::Vfredmax;
 using ::mpact::sim::riscv::Vfredmin;
 using ::mpact::sim::riscv::Vfredosum;
+using ::mpact::sim::riscv::Vfredusum;
 using ::mpact::sim::riscv::Vfwredosum;
+using ::mpact::sim::riscv::Vfwredusum;
 
 using ::absl::Span;
 using ::mpact::sim::riscv::FPRoundingMode;
@@ -52,6 +54,7 @@ using ::mpact::sim::riscv::ScopedFPStatus;
 using ::mpact::sim::riscv::test::FPCompare;
 using ::mpact::sim::riscv::test::FPTypeInfo;
 using ::mpact::sim::riscv::test::kA5Mask;
+using ::mpact::sim::riscv::test::kAllOnesMask;
 using ::mpact::sim::riscv::test::kLmul8Values;
 using ::mpact::sim::riscv::test::kLmulSettings;
 using ::mpact::sim::riscv::test::kSewSettingsByByteSize;
@@ -167,6 +170,63 @@ class RiscVFPReductionInstructionsTest
       }
     }
   }
+
+  // Helper function for the unordered sum reductions. All the elements are
+  // active, so that the elements may be summed in any order, and the values
+  // are small integers, so that the sum is exact in any order and rounding
+  // mode.
+  template <typename Vd, typename Vs2>
+  void UnorderedSumFPTestHelper(absl::string_view name, int sew,
+                                Instruction *inst) {
+    int byte_sew = sew / 8;
+    constexpr int vs2_size = kVectorLengthInBytes / sizeof(Vs2);
+    constexpr int vs1_size = kVectorLengthInBytes / sizeof(Vd);
+    Vs2 vs2_value[vs2_size * 8];
+    auto vs2_span = Span<Vs2>(vs2_value);
+    Vd vs1_value[vs1_size];
+    auto vs1_span = Span<Vd>(vs1_value);
+    AppendVectorRegisterOperands({kVs2, kVs1, kVmask}, {kVd});
+    SetVectorRegisterValues<uint8_t>(
+        {{kVmaskName, Span<const uint8_t>(kAllOnesMask)}});
+    for (auto &value : vs2_span) {
+      value = static_cast<Vs2>(absl::Uniform(bitgen_, -1000, 1000));
+    }
+    for (auto &value : vs1_span) {
+      value = static_cast<Vd>(absl::Uniform(bitgen_, -1000, 1000));
+    }
+    for (int i = 0; i < 8; i++) {
+      auto vs2_name = absl::StrCat("v", kVs2 + i);
+      SetVectorRegisterValues<Vs2>(
+          {{vs2_name, vs2_span.subspan(vs2_size * i, vs2_size)}});
+    }
+    SetVectorRegisterValues<Vd>({{absl::StrCat("v", kVs1), vs1_span}});
+    for (int lmul_index = 0; lmul_index < 7; lmul_index++) {
+      int lmul8_vd = kLmul8Values[lmul_index] * sizeof(Vd) / byte_sew;
+      if (lmul8_vd > 64) continue;
+      // Use vector lengths both below and above the number of partial sums.
+      for (int vlen : {1, 7, 9, 23, 1024}) {
+        uint32_t vtype =
+            (kSewSettingsByByteSize[byte_sew] << 3) | kLmulSettings[lmul_index];
+        ConfigureVectorUnit(vtype, vlen);
+        int num_values = rv_vector_->vector_length();
+        for (int rm : {0, 1, 2, 3, 4}) {
+          rv_fp_->SetRoundingMode(static_cast<FPRoundingMode>(rm));
+          ClearVectorRegisterGroup(kVd, 8);
+
+          inst->Execute();
+
+          EXPECT_FALSE(rv_vector_->vector_exception());
+          Vd accumulator = vs1_span[0];
+          for (int i = 0; i < num_values; i++) {
+            accumulator += static_cast<Vd>(vs2_span[i]);
+          }
+          EXPECT_EQ(accumulator, vreg_[kVd]->data_buffer()->Get<Vd>(0))
+              << name << " lmul8: " << kLmul8Values[lmul_index]
+              << " vl: " << num_values << " rm: " << rm;
+        }
+      }
+    }
+  }
 };
 
 // Test vector floating point sum reduction.
@@ -192,6 +252,24 @@ TEST_F(RiscVFPReductionInstructionsTest, Vfwredosum) {
       });
 }
 
+// Test vector floating point unordered sum reduction.
+TEST_F(RiscVFPReductionInstructionsTest, Vfredusum) {
+  SetSemanticFunction(&Vfredusum);
+  UnorderedSumFPTestHelper<float, float>("Vfredusum_32", /*sew*/ 32,
+                                         instruction_);
+  ResetInstruction();
+  SetSemanticFunction(&Vfredusum);
+  UnorderedSumFPTestHelper<double, double>("Vfredusum_64", /*sew*/ 64,
+                                           instruction_);
+}
+
+// Test vector floating point unordered widening sum reduction.
+TEST_F(RiscVFPReductionInstructionsTest, Vfwredusum) {
+  SetSemanticFunction(&Vfwredusum);
+  UnorderedSumFPTestHelper<double, float>("Vfwredusum_32", /*sew*/ 32,
+                                          instruction_);
+}
+
 template <typename T>
 T MaxMinHelper(T vs2, T vs1, std::function<T(T, T)> operation) {
   using UInt = typename FPTypeInfo<T>::IntType;
@@ -0,0 +1,118 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This microbenchmark measures the throughput of the vector host kernels in
+// riscv_vector_host_kernels.h for each operation, element width and lmul, for
+// each set of kernels supported by the host. The kernels are called once per
+// register of the group, as the vector semantic functions do.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riscv/riscv_vector_host_kernels.h"
+
+ABSL_FLAG(int64_t, iterations, 1'000'000,
+          "Number of times each vector instruction is executed");
+ABSL_FLAG(int, vlen, 512, "Vector register length in bits");
+
+namespace {
+
+using ::mpact::sim::riscv::GetSupportedVectorHostKernels;
+using ::mpact::sim::riscv::VectorHostKernels;
+using ::mpact::sim::riscv::VectorHostOp;
+
+constexpr const char *kOpNames[] = {"add",  "sub",  "rsub", "and",  "or",
+                                    "xor",  "sll",  "srl",  "sra",  "minu",
+                                    "min",  "maxu", "max"};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0]) ==
+              static_cast<int>(VectorHostOp::kPastMaxValue));
+
+constexpr int kMaxLmul = 8;
+
+class Benchmark {
+ public:
+  explicit Benchmark(int vlenb)
+      : vlenb_(vlenb),
+        vd_(vlenb * kMaxLmul),
+        vs2_(vlenb * kMaxLmul),
+        vs1_(vlenb * kMaxLmul) {
+    for (int i = 0; i < vlenb * kMaxLmul; i++) {
+      vs2_[i] = static_cast<uint8_t>(i * 7 + 3);
+      vs1_[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+  }
+
+  // Returns the average time in ns to execute a vector-vector instruction
+  // with the given kernel, with vl equal to vlmax.
+  double Run(const VectorHostKernels &kernels, int op_index, int width_index,
+             int lmul, int64_t iterations) {
+    auto kernel = kernels.vv[op_index][width_index];
+    int elements_per_vector = vlenb_ >> width_index;
+    absl::Time start = absl::Now();
+    for (int64_t i = 0; i < iterations; i++) {
+      for (int reg = 0; reg < lmul; reg++) {
+        int offset = reg * vlenb_;
+        kernel(&vd_[offset], &vs2_[offset], &vs1_[offset],
+               elements_per_vector);
+      }
+    }
+    absl::Duration duration = absl::Now() - start;
+    return absl::ToDoubleNanoseconds(duration) / iterations;
+  }
+
+ private:
+  int vlenb_;
+  std::vector<uint8_t> vd_;
+  std::vector<uint8_t> vs2_;
+  std::vector<uint8_t> vs1_;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  absl::ParseCommandLine(argc, argv);
+  int64_t iterations = absl::GetFlag(FLAGS_iterations);
+  int vlenb = absl::GetFlag(FLAGS_vlen) / 8;
+  Benchmark benchmark(vlenb);
+  auto supported = GetSupportedVectorHostKernels();
+  std::cout << absl::StrFormat("%-8s %4s %4s", "op", "sew", "lmul");
+  for (auto *kernels : supported) {
+    std::cout << absl::StrFormat(" %16s", kernels->name);
+  }
+  std::cout << "\n";
+  constexpr int kNumOps = static_cast<int>(VectorHostOp::kPastMaxValue);
+  for (int op_index = 0; op_index < kNumOps; op_index++) {
+    for (int width_index = 0;
+         width_index < VectorHostKernels::kNumElementWidths; width_index++) {
+      for (int lmul = 1; lmul <= kMaxLmul; lmul *= 2) {
+        std::cout << absl::StrFormat("%-8s %4d %4d", kOpNames[op_index],
+                                     8 << width_index, lmul);
+        for (auto *kernels : supported) {
+          double ns = benchmark.Run(*kernels, op_index, width_index, lmul,
+                                    iterations);
+          std::cout << absl::StrFormat(" %13.2f ns", ns);
+        }
+        std::cout << "\n";
+      }
+    }
+  }
+  return 0;
+}
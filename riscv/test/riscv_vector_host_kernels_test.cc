@@ -0,0 +1,253 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riscv/riscv_vector_host_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::riscv::GetSupportedVectorHostKernels;
+using ::mpact::sim::riscv::GetVectorHostKernels;
+using ::mpact::sim::riscv::VectorHostKernels;
+using ::mpact::sim::riscv::VectorHostOp;
+
+// Number of elements, chosen so that the kernels process both full host
+// vectors and a partial tail.
+constexpr int kNumElements = 75;
+constexpr int kNumOps = static_cast<int>(VectorHostOp::kPastMaxValue);
+
+// Reference implementation of the operations.
+template <typename T>
+T Reference(VectorHostOp op, T vs2, T vs1) {
+  using S = std::make_signed_t<T>;
+  int shift = vs1 & (sizeof(T) * 8 - 1);
+  switch (op) {
+    case VectorHostOp::kAdd:
+      return vs2 + vs1;
+    case VectorHostOp::kSub:
+      return vs2 - vs1;
+    case VectorHostOp::kRsub:
+      return vs1 - vs2;
+    case VectorHostOp::kAnd:
+      return vs2 & vs1;
+    case VectorHostOp::kOr:
+      return vs2 | vs1;
+    case VectorHostOp::kXor:
+      return vs2 ^ vs1;
+    case VectorHostOp::kSll:
+      return vs2 << shift;
+    case VectorHostOp::kSrl:
+      return vs2 >> shift;
+    case VectorHostOp::kSra:
+      return static_cast<S>(vs2) >> shift;
+    case VectorHostOp::kMinu:
+      return std::min(vs2, vs1);
+    case VectorHostOp::kMin:
+      return std::min(static_cast<S>(vs2), static_cast<S>(vs1));
+    case VectorHostOp::kMaxu:
+      return std::max(vs2, vs1);
+    case VectorHostOp::kMax:
+      return std::max(static_cast<S>(vs2), static_cast<S>(vs1));
+    default:
+      return 0;
+  }
+}
+
+class VectorHostKernelsTest : public testing::Test {
+ protected:
+  VectorHostKernelsTest() : random_(0x1234) {}
+
+  template <typename T>
+  std::vector<T> RandomVector() {
+    std::uniform_int_distribution<uint64_t> distribution;
+    std::vector<T> values(kNumElements);
+    for (auto &value : values) value = static_cast<T>(distribution(random_));
+    // Include equal values and small shift amounts.
+    values[0] = values[1];
+    values[2] = 3;
+    return values;
+  }
+
+  // Checks the vector-vector and vector-scalar kernels for element type T
+  // against the reference implementation.
+  template <typename T>
+  void CheckBinaryOps(const VectorHostKernels &kernels, int width_index) {
+    auto vs2 = RandomVector<T>();
+    auto vs1 = RandomVector<T>();
+    vs1[1] = vs2[1];
+    std::vector<T> vd(kNumElements);
+    for (int op_index = 0; op_index < kNumOps; op_index++) {
+      auto op = static_cast<VectorHostOp>(op_index);
+      kernels.vv[op_index][width_index](
+          reinterpret_cast<uint8_t *>(vd.data()),
+          reinterpret_cast<const uint8_t *>(vs2.data()),
+          reinterpret_cast<const uint8_t *>(vs1.data()), kNumElements);
+      for (int i = 0; i < kNumElements; i++) {
+        EXPECT_EQ(vd[i], Reference<T>(op, vs2[i], vs1[i]))
+            << kernels.name << " vv op: " << op_index
+            << " sew: " << sizeof(T) << " element: " << i;
+      }
+      // Use a scalar with bits above the element width set.
+      uint64_t rs1 = 0xffff'ffff'ffff'ff00ULL | 0x45;
+      kernels.vx[op_index][width_index](
+          reinterpret_cast<uint8_t *>(vd.data()),
+          reinterpret_cast<const uint8_t *>(vs2.data()), rs1, kNumElements);
+      for (int i = 0; i < kNumElements; i++) {
+        EXPECT_EQ(vd[i], Reference<T>(op, vs2[i], static_cast<T>(rs1)))
+            << kernels.name << " vx op: " << op_index
+            << " sew: " << sizeof(T) << " element: " << i;
+      }
+    }
+  }
+
+  // Checks the merge kernels for element type T, for mask bits that don't
+  // start on a byte boundary.
+  template <typename T>
+  void CheckMerge(const VectorHostKernels &kernels, int width_index) {
+    auto vs2 = RandomVector<T>();
+    auto vs1 = RandomVector<T>();
+    auto mask = RandomVector<uint8_t>();
+    std::vector<T> vd(kNumElements);
+    for (int offset : {0, 3, 8}) {
+      auto mask_value = [&mask, offset](int i) {
+        return ((mask[(offset + i) / 8] >> ((offset + i) % 8)) & 0b1) != 0;
+      };
+      kernels.merge_vv[width_index](
+          reinterpret_cast<uint8_t *>(vd.data()),
+          reinterpret_cast<const uint8_t *>(vs2.data()),
+          reinterpret_cast<const uint8_t *>(vs1.data()), mask.data(), offset,
+          kNumElements);
+      for (int i = 0; i < kNumElements; i++) {
+        EXPECT_EQ(vd[i], mask_value(i) ? vs1[i] : vs2[i])
+            << kernels.name << " merge_vv sew: " << sizeof(T)
+            << " offset: " << offset << " element: " << i;
+      }
+      uint64_t rs1 = 0x1234'5678'9abc'def0ULL;
+      kernels.merge_vx[width_index](
+          reinterpret_cast<uint8_t *>(vd.data()),
+          reinterpret_cast<const uint8_t *>(vs2.data()), rs1, mask.data(),
+          offset, kNumElements);
+      for (int i = 0; i < kNumElements; i++) {
+        EXPECT_EQ(vd[i], mask_value(i) ? static_cast<T>(rs1) : vs2[i])
+            << kernels.name << " merge_vx sew: " << sizeof(T)
+            << " offset: " << offset << " element: " << i;
+      }
+    }
+  }
+
+  // Checks the reduction kernels for element type T against a sequential
+  // reduction, for element counts that do and don't fill host vectors.
+  template <typename T>
+  void CheckReductions(const VectorHostKernels &kernels, int width_index) {
+    auto vs2 = RandomVector<T>();
+    // Use an accumulator with bits above the element width set.
+    uint64_t acc = 0xffff'ffff'ffff'ff00ULL | 0x45;
+    for (int num_elements : {0, 1, 16, kNumElements}) {
+      for (int op_index = 0; op_index < kNumOps; op_index++) {
+        auto op = static_cast<VectorHostOp>(op_index);
+        auto kernel = kernels.reduce[op_index][width_index];
+        if (kernel == nullptr) continue;
+        T expected = static_cast<T>(acc);
+        for (int i = 0; i < num_elements; i++) {
+          expected = Reference<T>(op, expected, vs2[i]);
+        }
+        T result = static_cast<T>(kernel(
+            acc, reinterpret_cast<const uint8_t *>(vs2.data()), num_elements));
+        EXPECT_EQ(result, expected)
+            << kernels.name << " reduce op: " << op_index
+            << " sew: " << sizeof(T) << " elements: " << num_elements;
+      }
+    }
+  }
+
+  // Checks the widening sum kernels for element type T.
+  template <typename T>
+  void CheckWideningSums(const VectorHostKernels &kernels, int width_index) {
+    using W = std::conditional_t<
+        sizeof(T) == 1, uint16_t,
+        std::conditional_t<sizeof(T) == 2, uint32_t, uint64_t>>;
+    using S = std::make_signed_t<T>;
+    auto vs2 = RandomVector<T>();
+    uint64_t acc = 0x1234'5678'9abc'def0ULL;
+    for (int num_elements : {0, 1, 16, kNumElements}) {
+      W unsigned_sum = static_cast<W>(acc);
+      W signed_sum = static_cast<W>(acc);
+      for (int i = 0; i < num_elements; i++) {
+        unsigned_sum += static_cast<W>(vs2[i]);
+        signed_sum += static_cast<W>(static_cast<S>(vs2[i]));
+      }
+      auto *data = reinterpret_cast<const uint8_t *>(vs2.data());
+      EXPECT_EQ(static_cast<W>(kernels.widening_sum[0][width_index](
+                    acc, data, num_elements)),
+                unsigned_sum)
+          << kernels.name << " sew: " << sizeof(T)
+          << " elements: " << num_elements;
+      EXPECT_EQ(static_cast<W>(kernels.widening_sum[1][width_index](
+                    acc, data, num_elements)),
+                signed_sum)
+          << kernels.name << " sew: " << sizeof(T)
+          << " elements: " << num_elements;
+    }
+  }
+
+  void CheckKernels(const VectorHostKernels &kernels) {
+    CheckBinaryOps<uint8_t>(kernels, 0);
+    CheckBinaryOps<uint16_t>(kernels, 1);
+    CheckBinaryOps<uint32_t>(kernels, 2);
+    CheckBinaryOps<uint64_t>(kernels, 3);
+    CheckMerge<uint8_t>(kernels, 0);
+    CheckMerge<uint16_t>(kernels, 1);
+    CheckMerge<uint32_t>(kernels, 2);
+    CheckMerge<uint64_t>(kernels, 3);
+    CheckReductions<uint8_t>(kernels, 0);
+    CheckReductions<uint16_t>(kernels, 1);
+    CheckReductions<uint32_t>(kernels, 2);
+    CheckReductions<uint64_t>(kernels, 3);
+    CheckWideningSums<uint8_t>(kernels, 0);
+    CheckWideningSums<uint16_t>(kernels, 1);
+    CheckWideningSums<uint32_t>(kernels, 2);
+  }
+
+  std::mt19937_64 random_;
+};
+
+// Checks all the kernels supported by the host this test runs on.
+TEST_F(VectorHostKernelsTest, Supported) {
+  auto supported = GetSupportedVectorHostKernels();
+  EXPECT_EQ(supported.front(), &GetVectorHostKernels());
+  EXPECT_STREQ(supported.back()->name, "scalar");
+  for (auto *kernels : supported) CheckKernels(*kernels);
+}
+
+// The destination may be the same as one of the sources.
+TEST_F(VectorHostKernelsTest, InPlace) {
+  auto &kernels = GetVectorHostKernels();
+  std::vector<uint16_t> vs2(kNumElements, 7);
+  std::vector<uint16_t> vs1(kNumElements, 5);
+  kernels.vv[static_cast<int>(VectorHostOp::kAdd)][1](
+      reinterpret_cast<uint8_t *>(vs2.data()),
+      reinterpret_cast<const uint8_t *>(vs2.data()),
+      reinterpret_cast<const uint8_t *>(vs1.data()), kNumElements);
+  for (int i = 0; i < kNumElements; i++) EXPECT_EQ(vs2[i], 12);
+}
+
+}  // namespace
@@ -43,6 +43,7 @@ using ::absl::Span;
 using ::mpact::sim::generic::ImmediateOperand;
 using ::mpact::sim::generic::Instruction;
 using ::mpact::sim::generic::RegisterBase;
+using ::mpact::sim::riscv::ExceptionCode;
 using ::mpact::sim::riscv::RiscVState;
 using ::mpact::sim::riscv::RiscVVectorState;
 using ::mpact::sim::riscv::RiscVXlen;
@@ -111,6 +112,16 @@ constexpr uint8_t kA5Mask[kVectorLengthInBytes] = {
     0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5, 0xa5,
 };
 
+// All elements active.
+constexpr uint8_t kAllOnesMask[kVectorLengthInBytes] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
 // Test fixture class. This class allows for more convenient manipulations
 // of instructions to test the semantic functions.
 class RV32VInstructionsTest : public testing::Test {
@@ -355,6 +366,61 @@ class RV32VInstructionsTest : public testing::Test {
     }
   }
 
+  // Unmasked unit stride loads take a fast path. Use a non-zero vstart and a
+  // vl that is less than vlmax to check that elements outside [vstart, vl)
+  // are left undisturbed.
+  template <typename T>
+  void VectorLoadUnitStridedUnmaskedHelper() {
+    constexpr int kStart = 3;
+    constexpr T kFill = static_cast<T>(0xa5a5'a5a5'a5a5'a5a5ULL);
+    // Set up instructions.
+    AppendRegisterOperands({kRs1Name, kRs2Name}, {});
+    AppendVectorRegisterOperands({kVmask}, {});
+    SetSemanticFunction(absl::bind_front(&VlStrided,
+                                         /*element_width*/ sizeof(T)));
+    // Add the child instruction that performs the register write-back.
+    SetChildInstruction();
+    SetChildSemanticFunction(&VlChild);
+    AppendVectorRegisterOperands(child_instruction_, {}, {kVd});
+    // Set up register values.
+    SetRegisterValues<uint32_t>({{kRs1Name, kDataLoadAddress}});
+    SetRegisterValues<int32_t>({{kRs2Name, sizeof(T)}});
+    SetVectorRegisterValues<uint8_t>(
+        {{kVmaskName, Span<const uint8_t>(kAllOnesMask)}});
+    // Iterate over different lmul values.
+    for (int lmul_index = 0; lmul_index < 7; lmul_index++) {
+      uint32_t vtype =
+          (kSewSettingsByByteSize[sizeof(T)] << 3) | kLmulSettings[lmul_index];
+      int lmul8 = kLmul8Values[lmul_index];
+      int num_values = kVectorLengthInBytes * lmul8 / (sizeof(T) * 8);
+      if (num_values <= kStart + 1) continue;
+      int vl = num_values - 1;
+      ConfigureVectorUnit(vtype, vl);
+      rv_vector_->set_vstart(kStart);
+      for (int reg = kVd; reg < kVd + 8; reg++) {
+        for (auto &value : vreg_[reg]->data_buffer()->Get<T>()) value = kFill;
+      }
+      // Execute instruction.
+      instruction_->Execute(nullptr);
+      EXPECT_EQ(rv_vector_->vstart(), 0);
+
+      // Check register values.
+      int count = 0;
+      for (int reg = kVd; reg < kVd + 8; reg++) {
+        auto span = vreg_[reg]->data_buffer()->Get<T>();
+        for (int i = 0; i < kVectorLengthInBytes / sizeof(T); i++) {
+          T expected = ((count >= kStart) && (count < vl))
+                           ? ComputeValue<T>(4096 + count * sizeof(T))
+                           : kFill;
+          EXPECT_EQ(expected, span[i])
+              << "element size " << sizeof(T) << " LMUL8 " << lmul8
+              << " Count " << count << " Reg " << reg << " value " << i;
+          count++;
+        }
+      }
+    }
+  }
+
   template <typename T>
   void VectorLoadStridedHelper() {
     const int strides[5] = {1, 4, 0, -1, -3};
@@ -498,13 +564,14 @@ class RV32VInstructionsTest : public testing::Test {
 
   // Helper function to test vector load segment strided instructions.
   template <typename T>
-  void VectorLoadSegmentHelper() {
+  void VectorLoadSegmentHelper(
+      Span<const uint8_t> mask_values = Span<const uint8_t>(kA5Mask)) {
     // Set up instructions.
     AppendRegisterOperands({kRs1Name}, {});
     AppendVectorRegisterOperands({kVmask}, {});
     AppendRegisterOperands({kRs3Name}, {});
     SetVectorRegisterValues<uint8_t>(
-        {{kVmaskName, Span<const uint8_t>(kA5Mask)}});
+        {{kVmaskName, mask_values}});
     SetSemanticFunction(absl::bind_front(&VlSegment,
                                          /*element_width*/ sizeof(T)));
     // Add the child instruction that performs the register write-back.
@@ -554,7 +621,7 @@ class RV32VInstructionsTest : public testing::Test {
             for (int i = 0; i < num_reg_elements; i++) {
               int mask_index = count / 8;
               int mask_offset = count % 8;
-              bool mask = (kA5Mask[mask_index] >> mask_offset) & 0x1;
+              bool mask = (mask_values[mask_index] >> mask_offset) & 0x1;
               if (mask && (count < num_values)) {
                 int address =
                     4096 + count * sizeof(T) * num_fields + field * sizeof(T);
@@ -576,6 +643,79 @@ class RV32VInstructionsTest : public testing::Test {
     }
   }
 
+  // Helper function to test vector load segment instructions with vl < VLMAX
+  // and vstart > 0. Each field still occupies a register group of EMUL
+  // registers, and elements outside [vstart, vl) are left undisturbed.
+  template <typename T>
+  void VectorLoadSegmentShortHelper(Span<const uint8_t> mask_values) {
+    constexpr int kStart = 1;
+    constexpr T kFill = static_cast<T>(0xa5a5'a5a5'a5a5'a5a5ULL);
+    // Set up instructions.
+    AppendRegisterOperands({kRs1Name}, {});
+    AppendVectorRegisterOperands({kVmask}, {});
+    AppendRegisterOperands({kRs3Name}, {});
+    SetVectorRegisterValues<uint8_t>({{kVmaskName, mask_values}});
+    SetSemanticFunction(absl::bind_front(&VlSegment,
+                                         /*element_width*/ sizeof(T)));
+    // Add the child instruction that performs the register write-back.
+    SetChildInstruction();
+    SetChildSemanticFunction(
+        absl::bind_front(&VlSegmentChild, /*element_width*/ sizeof(T)));
+    AppendRegisterOperands(child_instruction_, {kRs3Name}, {});
+    AppendVectorRegisterOperands(child_instruction_, {}, {kVd});
+    // Set up register values.
+    SetRegisterValues<uint32_t>({{kRs1Name, kDataLoadAddress}});
+    for (int nf = 1; nf < 8; nf++) {
+      int num_fields = nf + 1;
+      SetRegisterValues<int32_t>({{kRs3Name, nf}});
+      for (int lmul_index = 0; lmul_index < 7; lmul_index++) {
+        uint32_t vtype = (kSewSettingsByByteSize[sizeof(T)] << 3) |
+                         kLmulSettings[lmul_index];
+        int lmul8 = kLmul8Values[lmul_index];
+        if (lmul8 * num_fields > 64) continue;
+        int num_values = kVectorLengthInBytes * lmul8 / (sizeof(T) * 8);
+        if (num_values <= kStart + 1) continue;
+        int vl = num_values - 1;
+        ConfigureVectorUnit(vtype, vl);
+        rv_vector_->set_vstart(kStart);
+        for (int reg = kVd; reg < kVd + 8; reg++) {
+          for (auto &value : vreg_[reg]->data_buffer()->Get<T>()) {
+            value = kFill;
+          }
+        }
+        // Execute instruction.
+        instruction_->Execute(nullptr);
+        EXPECT_FALSE(rv_vector_->vector_exception());
+        EXPECT_EQ(rv_vector_->vstart(), 0);
+
+        // Check register values.
+        int regs_per_field = ::std::max(1, lmul8 / 8);
+        int elements_per_reg = kVectorLengthInBytes / sizeof(T);
+        for (int field = 0; field < num_fields; field++) {
+          int count = 0;
+          int start_reg = kVd + field * regs_per_field;
+          for (int reg = start_reg; reg < start_reg + regs_per_field; reg++) {
+            auto span = vreg_[reg]->data_buffer()->Get<T>();
+            for (int i = 0; i < elements_per_reg; i++) {
+              bool mask = (mask_values[count / 8] >> (count % 8)) & 0x1;
+              T expected = kFill;
+              if (mask && (count >= kStart) && (count < vl)) {
+                int address =
+                    4096 + count * sizeof(T) * num_fields + field * sizeof(T);
+                expected = ComputeValue<T>(address);
+              }
+              EXPECT_EQ(expected, span[i])
+                  << "element size " << sizeof(T) << " LMUL8 " << lmul8
+                  << " nf " << nf << " Count " << count << " Reg " << reg
+                  << " value " << i;
+              count++;
+            }
+          }
+        }
+      }
+    }
+  }
+
   // Helper function to test vector load segment strided instructions.
   template <typename T>
   void VectorLoadStridedSegmentHelper() {
@@ -853,6 +993,64 @@ class RV32VInstructionsTest : public testing::Test {
     }
   }
 
+  // Unmasked unit stride stores take a fast path. Use a non-zero vstart and a
+  // vl that is less than vlmax to check that only elements in [vstart, vl) are
+  // stored.
+  template <typename T>
+  void VectorStoreUnitStridedUnmaskedHelper() {
+    constexpr int kStart = 3;
+    // Set up instructions.
+    AppendVectorRegisterOperands({kVs1}, {});
+    AppendRegisterOperands({kRs1Name, kRs2Name}, {});
+    AppendVectorRegisterOperands({kVmask}, {});
+    SetSemanticFunction(absl::bind_front(&VsStrided,
+                                         /*element_width*/ sizeof(T)));
+    // Set up register values.
+    SetRegisterValues<uint32_t>({{kRs1Name, kDataStoreAddress}});
+    SetRegisterValues<int32_t>({{kRs2Name, sizeof(T)}});
+    SetVectorRegisterValues<uint8_t>(
+        {{kVmaskName, Span<const uint8_t>(kAllOnesMask)}});
+    // Set the store data register elements to be consecutive integers.
+    for (int reg = 0; reg < 8; reg++) {
+      auto reg_span = vreg_[reg + kVs1]->data_buffer()->Get<T>();
+      for (int i = 0; i < reg_span.size(); i++) {
+        reg_span[i] = static_cast<T>(reg * reg_span.size() + i + 1);
+      }
+    }
+    // Iterate over different lmul values.
+    for (int lmul_index = 0; lmul_index < 7; lmul_index++) {
+      uint32_t vtype =
+          (kSewSettingsByByteSize[sizeof(T)] << 3) | kLmulSettings[lmul_index];
+      int lmul8 = kLmul8Values[lmul_index];
+      int num_values = kVectorLengthInBytes * lmul8 / (sizeof(T) * 8);
+      if (num_values <= kStart + 1) continue;
+      int vl = num_values - 1;
+      ConfigureVectorUnit(vtype, vl);
+      rv_vector_->set_vstart(kStart);
+      // Execute instruction.
+      instruction_->Execute(nullptr);
+      EXPECT_EQ(rv_vector_->vstart(), 0);
+
+      // Check memory values.
+      auto *data_db = state_->db_factory()->Allocate<T>(1);
+      for (int i = 0; i < num_values; i++) {
+        data_db->template Set<T>(0, 0);
+        state_->LoadMemory(instruction_, kDataStoreAddress + i * sizeof(T),
+                           data_db, nullptr, nullptr);
+        T expected = ((i >= kStart) && (i < vl)) ? static_cast<T>(i + 1) : 0;
+        EXPECT_EQ(data_db->template Get<T>(0), expected)
+            << "index: " << i << " element_size: " << sizeof(T)
+            << " lmul8: " << lmul8;
+      }
+      data_db->DecRef();
+      // Clear memory.
+      data_db = state_->db_factory()->Allocate(0x4000);
+      memset(data_db->raw_ptr(), 0, 0x4000);
+      state_->StoreMemory(instruction_, kDataStoreAddress - 0x2000, data_db);
+      data_db->DecRef();
+    }
+  }
+
   template <typename IndexType, typename ValueType>
   void VectorStoreIndexedHelper() {
     // Set up instructions.
@@ -939,7 +1137,8 @@ class RV32VInstructionsTest : public testing::Test {
 
   // Helper function to test vector load segment strided instructions.
   template <typename T>
-  void VectorStoreSegmentHelper() {
+  void VectorStoreSegmentHelper(
+      Span<const uint8_t> mask_values = Span<const uint8_t>(kA5Mask)) {
     // Set up instructions.
     // Store data register.
     AppendVectorRegisterOperands({kVs1}, {});
@@ -965,7 +1164,7 @@ class RV32VInstructionsTest : public testing::Test {
     SetRegisterValues<uint32_t>({{kRs1Name, kDataStoreAddress}});
     // Initialize the mask.
     SetVectorRegisterValues<uint8_t>(
-        {{kVmaskName, Span<const uint8_t>(kA5Mask)}});
+        {{kVmaskName, mask_values}});
 
     int num_values_per_register = kVectorLengthInBytes / sizeof(T);
     // Can load all the data in one load, so set the data_db size accordingly.
@@ -1019,7 +1218,7 @@ class RV32VInstructionsTest : public testing::Test {
               // Get the mask value.
               int mask_index = segment_no >> 3;
               int mask_offset = segment_no & 0b111;
-              bool mask = (kA5Mask[mask_index] >> mask_offset) & 0x1;
+              bool mask = (mask_values[mask_index] >> mask_offset) & 0x1;
               T mem_value =
                   data_db->template Get<T>(segment_no * num_fields + field);
               if (mask && (segment_no < vlen)) {
@@ -1526,6 +1725,64 @@ TEST_F(RV32VInstructionsTest, Vle64) {
   VectorLoadUnitStridedHelper<uint64_t>();
 }
 
+TEST_F(RV32VInstructionsTest, Vle8Unmasked) {
+  VectorLoadUnitStridedUnmaskedHelper<uint8_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vle16Unmasked) {
+  VectorLoadUnitStridedUnmaskedHelper<uint16_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vle32Unmasked) {
+  VectorLoadUnitStridedUnmaskedHelper<uint32_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vle64Unmasked) {
+  VectorLoadUnitStridedUnmaskedHelper<uint64_t>();
+}
+
+// An unmasked unit stride load that extends beyond the maximum physical
+// address raises a load access fault, and leaves the destination registers
+// unchanged.
+TEST_F(RV32VInstructionsTest, Vle32UnmaskedFault) {
+  constexpr uint32_t kFill = 0xa5a5'a5a5;
+  int num_traps = 0;
+  uint64_t trap_code = 0;
+  state_->set_on_trap([&num_traps, &trap_code](
+                          bool is_interrupt, uint64_t trap_value,
+                          uint64_t exception_code, uint64_t epc,
+                          const Instruction *inst) -> bool {
+    num_traps++;
+    trap_code = exception_code;
+    return true;
+  });
+  AppendRegisterOperands({kRs1Name, kRs2Name}, {});
+  AppendVectorRegisterOperands({kVmask}, {});
+  SetSemanticFunction(absl::bind_front(&VlStrided,
+                                       /*element_width*/ sizeof(uint32_t)));
+  SetChildInstruction();
+  SetChildSemanticFunction(&VlChild);
+  AppendVectorRegisterOperands(child_instruction_, {}, {kVd});
+  SetRegisterValues<uint32_t>({{kRs1Name, kDataLoadAddress}});
+  SetRegisterValues<int32_t>({{kRs2Name, sizeof(uint32_t)}});
+  SetVectorRegisterValues<uint8_t>(
+      {{kVmaskName, Span<const uint8_t>(kAllOnesMask)}});
+  // LMUL = 1, vl = VLMAX.
+  ConfigureVectorUnit((kSewSettingsByByteSize[sizeof(uint32_t)] << 3) |
+                          kLmulSettings[3],
+                      /*vlen*/ 1024);
+  state_->set_max_physical_address(kDataLoadAddress + 8);
+  for (auto &value : vreg_[kVd]->data_buffer()->Get<uint32_t>()) {
+    value = kFill;
+  }
+  instruction_->Execute(nullptr);
+  EXPECT_EQ(num_traps, 1);
+  EXPECT_EQ(trap_code, static_cast<uint64_t>(ExceptionCode::kLoadAccessFault));
+  for (auto value : vreg_[kVd]->data_buffer()->Get<uint32_t>()) {
+    EXPECT_EQ(value, kFill);
+  }
+}
+
 TEST_F(RV32VInstructionsTest, Vlse8) { VectorLoadStridedHelper<uint8_t>(); }
 
 TEST_F(RV32VInstructionsTest, Vlse16) { VectorLoadStridedHelper<uint16_t>(); }
@@ -1653,6 +1910,107 @@ TEST_F(RV32VInstructionsTest, Vlsege32) { VectorLoadSegmentHelper<uint32_t>(); }
 
 TEST_F(RV32VInstructionsTest, Vlsege64) { VectorLoadSegmentHelper<uint64_t>(); }
 
+// Unmasked unit stride segment loads take a fast path.
+TEST_F(RV32VInstructionsTest, Vlsege8Unmasked) {
+  VectorLoadSegmentHelper<uint8_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege16Unmasked) {
+  VectorLoadSegmentHelper<uint16_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege32Unmasked) {
+  VectorLoadSegmentHelper<uint32_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege64Unmasked) {
+  VectorLoadSegmentHelper<uint64_t>(kAllOnesMask);
+}
+
+// Segment loads with vl < VLMAX and vstart > 0, through both the masked and
+// the unmasked (contiguous) paths.
+TEST_F(RV32VInstructionsTest, Vlsege8Short) {
+  VectorLoadSegmentShortHelper<uint8_t>(kA5Mask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege16Short) {
+  VectorLoadSegmentShortHelper<uint16_t>(kA5Mask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege32Short) {
+  VectorLoadSegmentShortHelper<uint32_t>(kA5Mask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege64Short) {
+  VectorLoadSegmentShortHelper<uint64_t>(kA5Mask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege8ShortUnmasked) {
+  VectorLoadSegmentShortHelper<uint8_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege16ShortUnmasked) {
+  VectorLoadSegmentShortHelper<uint16_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege32ShortUnmasked) {
+  VectorLoadSegmentShortHelper<uint32_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, Vlsege64ShortUnmasked) {
+  VectorLoadSegmentShortHelper<uint64_t>(kAllOnesMask);
+}
+
+// An unmasked unit stride segment load that extends beyond the maximum
+// physical address raises a load access fault, and leaves the destination
+// registers unchanged.
+TEST_F(RV32VInstructionsTest, Vlsege32UnmaskedFault) {
+  constexpr uint32_t kFill = 0xa5a5'a5a5;
+  constexpr int kNumFields = 2;
+  int num_traps = 0;
+  uint64_t trap_code = 0;
+  state_->set_on_trap([&num_traps, &trap_code](
+                          bool is_interrupt, uint64_t trap_value,
+                          uint64_t exception_code, uint64_t epc,
+                          const Instruction *inst) -> bool {
+    num_traps++;
+    trap_code = exception_code;
+    return true;
+  });
+  AppendRegisterOperands({kRs1Name}, {});
+  AppendVectorRegisterOperands({kVmask}, {});
+  AppendRegisterOperands({kRs3Name}, {});
+  SetSemanticFunction(absl::bind_front(&VlSegment,
+                                       /*element_width*/ sizeof(uint32_t)));
+  SetChildInstruction();
+  SetChildSemanticFunction(
+      absl::bind_front(&VlSegmentChild, /*element_width*/ sizeof(uint32_t)));
+  AppendRegisterOperands(child_instruction_, {kRs3Name}, {});
+  AppendVectorRegisterOperands(child_instruction_, {}, {kVd});
+  SetRegisterValues<uint32_t>({{kRs1Name, kDataLoadAddress}});
+  SetRegisterValues<int32_t>({{kRs3Name, kNumFields - 1}});
+  SetVectorRegisterValues<uint8_t>(
+      {{kVmaskName, Span<const uint8_t>(kAllOnesMask)}});
+  // LMUL = 1, vl = VLMAX.
+  ConfigureVectorUnit((kSewSettingsByByteSize[sizeof(uint32_t)] << 3) |
+                          kLmulSettings[3],
+                      /*vlen*/ 1024);
+  state_->set_max_physical_address(kDataLoadAddress + 8);
+  for (int reg = kVd; reg < kVd + kNumFields; reg++) {
+    for (auto &value : vreg_[reg]->data_buffer()->Get<uint32_t>()) {
+      value = kFill;
+    }
+  }
+  instruction_->Execute(nullptr);
+  EXPECT_EQ(num_traps, 1);
+  EXPECT_EQ(trap_code, static_cast<uint64_t>(ExceptionCode::kLoadAccessFault));
+  for (int reg = kVd; reg < kVd + kNumFields; reg++) {
+    for (auto value : vreg_[reg]->data_buffer()->Get<uint32_t>()) {
+      EXPECT_EQ(value, kFill);
+    }
+  }
+}
+
 // Test vector load segment, strided.
 TEST_F(RV32VInstructionsTest, Vlssege8) {
   VectorLoadStridedSegmentHelper<uint8_t>();
@@ -1745,6 +2103,22 @@ TEST_F(RV32VInstructionsTest, Vsse32) { VectorStoreStridedHelper<uint32_t>(); }
 
 TEST_F(RV32VInstructionsTest, Vsse64) { VectorStoreStridedHelper<uint64_t>(); }
 
+TEST_F(RV32VInstructionsTest, Vse8Unmasked) {
+  VectorStoreUnitStridedUnmaskedHelper<uint8_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vse16Unmasked) {
+  VectorStoreUnitStridedUnmaskedHelper<uint16_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vse32Unmasked) {
+  VectorStoreUnitStridedUnmaskedHelper<uint32_t>();
+}
+
+TEST_F(RV32VInstructionsTest, Vse64Unmasked) {
+  VectorStoreUnitStridedUnmaskedHelper<uint64_t>();
+}
+
 TEST_F(RV32VInstructionsTest, Vsm) {
   ConfigureVectorUnit(0b0'0'000'000, /*vlen*/ 1024);
   // Set up operands and register values.
@@ -1895,6 +2269,23 @@ TEST_F(RV32VInstructionsTest, VsSegment64) {
   VectorStoreSegmentHelper<uint64_t>();
 }
 
+// Unmasked unit stride segment stores take a fast path.
+TEST_F(RV32VInstructionsTest, VsSegment8Unmasked) {
+  VectorStoreSegmentHelper<uint8_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, VsSegment16Unmasked) {
+  VectorStoreSegmentHelper<uint16_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, VsSegment32Unmasked) {
+  VectorStoreSegmentHelper<uint32_t>(kAllOnesMask);
+}
+
+TEST_F(RV32VInstructionsTest, VsSegment64Unmasked) {
+  VectorStoreSegmentHelper<uint64_t>(kAllOnesMask);
+}
+
 // Test vector store segment strided.
 TEST_F(RV32VInstructionsTest, VsSegmentStrided8) {
   VectorStoreStridedSegmentHelper<uint8_t>();
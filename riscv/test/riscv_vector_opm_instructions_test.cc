@@ -22,6 +22,7 @@
 #include <optional>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "absl/base/casts.h"
@@ -104,36 +105,49 @@ class RiscVVectorOpmInstructionsTest : public RiscVVectorInstructionsTestBase {
     FillArrayWithRandomValues<uint8_t>(vs1_value);
     FillArrayWithRandomValues<uint8_t>(vd_value);
     AppendVectorRegisterOperands({kVs2, kVs1}, {kVd});
+    // The vector lengths are percentages of the elements from vstart. In
+    // addition, vstart and vl are set on and next to the 64 bit mask word
+    // boundaries.
+    std::vector<std::pair<int, int>> settings;
     for (int vstart : {0, 7, 32, 100, 250, 384}) {
       for (int vlen_pct : {10, 20, 50, 100}) {
         int vlen =
             (kVectorLengthInBytes * 8 - vstart) * vlen_pct / 100 + vstart;
         CHECK_LE(vlen, kVectorLengthInBytes * 8);
-        // Configure vector unit for different lmul settings.
-        uint32_t vtype = (kSewSettingsByByteSize[1] << 3) | kLmulSettings[6];
-        ConfigureVectorUnit(vtype, vlen);
-        vlen = rv_vector_->vector_length();
-        rv_vector_->set_vstart(vstart);
-        SetVectorRegisterValues<uint8_t>({{kVs2Name, vs2_value},
-                                          {kVs1Name, vs1_value},
-                                          {kVdName, vd_value}});
-        instruction_->Execute();
-        auto dst_span = vreg_[kVd]->data_buffer()->Get<uint8_t>();
-        for (int i = 0; i < kVectorLengthInBytes * 8; i++) {
-          int mask_index = i >> 3;
-          int mask_offset = i & 0b111;
-          bool result = (dst_span[mask_index] >> mask_offset) & 0b1;
-          if ((i < vstart) || (i >= vlen)) {
-            bool vd = (vd_value[mask_index] >> mask_offset) & 0b1;
-            EXPECT_EQ(result, vd) << "[" << i << "] " << std::hex
-                                  << "vd: " << (int)vd_value[mask_index]
-                                  << "  dst: " << (int)dst_span[mask_index];
-          } else {
-            bool vs2 = (vs2_value[mask_index] >> mask_offset) & 0b1;
-            bool vs1 = (vs1_value[mask_index] >> mask_offset) & 0b1;
-            EXPECT_EQ(result, op(vs2, vs1))
-                << "[" << i << "]: " << "op(" << vs2 << ", " << vs1 << ")";
-          }
+        settings.emplace_back(vstart, vlen);
+      }
+    }
+    for (int vstart : {1, 63, 64, 65}) {
+      for (int vlen : {65, 127, 128, 129, 511}) {
+        settings.emplace_back(vstart, vlen);
+      }
+    }
+    for (auto [vstart, vlen] : settings) {
+      // Configure vector unit for different lmul settings.
+      uint32_t vtype = (kSewSettingsByByteSize[1] << 3) | kLmulSettings[6];
+      ConfigureVectorUnit(vtype, vlen);
+      vlen = rv_vector_->vector_length();
+      rv_vector_->set_vstart(vstart);
+      SetVectorRegisterValues<uint8_t>({{kVs2Name, vs2_value},
+                                        {kVs1Name, vs1_value},
+                                        {kVdName, vd_value}});
+      instruction_->Execute();
+      EXPECT_EQ(rv_vector_->vstart(), 0) << name;
+      auto dst_span = vreg_[kVd]->data_buffer()->Get<uint8_t>();
+      for (int i = 0; i < kVectorLengthInBytes * 8; i++) {
+        int mask_index = i >> 3;
+        int mask_offset = i & 0b111;
+        bool result = (dst_span[mask_index] >> mask_offset) & 0b1;
+        if ((i < vstart) || (i >= vlen)) {
+          bool vd = (vd_value[mask_index] >> mask_offset) & 0b1;
+          EXPECT_EQ(result, vd) << "[" << i << "] " << std::hex
+                                << "vd: " << (int)vd_value[mask_index]
+                                << "  dst: " << (int)dst_span[mask_index];
+        } else {
+          bool vs2 = (vs2_value[mask_index] >> mask_offset) & 0b1;
+          bool vs1 = (vs1_value[mask_index] >> mask_offset) & 0b1;
+          EXPECT_EQ(result, op(vs2, vs1))
+              << "[" << i << "]: " << "op(" << vs2 << ", " << vs1 << ")";
         }
       }
     }
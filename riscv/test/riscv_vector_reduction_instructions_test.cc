@@ -49,6 +49,7 @@ using ::mpact::sim::riscv::Vwredsum;
 using ::mpact::sim::riscv::Vwredsumu;
 
 using ::mpact::sim::riscv::test::kA5Mask;
+using ::mpact::sim::riscv::test::kAllOnesMask;
 using ::mpact::sim::riscv::test::kLmul8Values;
 using ::mpact::sim::riscv::test::kLmulSettings;
 using ::mpact::sim::riscv::test::kSewSettingsByByteSize;
@@ -65,7 +66,9 @@ class RiscVVectorReductionInstructionsTest
  public:
   template <typename Vd, typename Vs2>
   void ReductionOpTestHelper(absl::string_view name, int sew, Instruction *inst,
-                             std::function<Vd(Vd, Vs2)> operation) {
+                             std::function<Vd(Vd, Vs2)> operation,
+                             Span<const uint8_t> mask_span =
+                                 Span<const uint8_t>(kA5Mask)) {
     int byte_sew = sew / 8;
     if (byte_sew != sizeof(Vd) && byte_sew != sizeof(Vs2)) {
       FAIL() << name << ": selected element width != any operand types"
@@ -84,7 +87,6 @@ class RiscVVectorReductionInstructionsTest
     // Initialize input values.
     FillArrayWithRandomValues<Vs2>(vs2_span);
     vs1_span[0] = RandomValue<Vs2>();
-    auto mask_span = Span<const uint8_t>(kA5Mask);
     SetVectorRegisterValues<uint8_t>({{kVmaskName, mask_span}});
     SetVectorRegisterValues<Vs2>({{kVs1Name, Span<const Vs2>(vs1_span)}});
     // Initialize the accumulator with the value from vs1[0].
@@ -424,4 +426,64 @@ TEST_F(RiscVVectorReductionInstructionsTest, Vwredsum32) {
       [](WT val0, T val1) -> WT { return val0 + static_cast<WT>(val1); });
 }
 
+// Unmasked reductions.
+TEST_F(RiscVVectorReductionInstructionsTest, Vredsum8Unmasked) {
+  using T = uint8_t;
+  SetSemanticFunction(&Vredsum);
+  ReductionOpTestHelper<T, T>(
+      "Vredsum", /*sew*/ sizeof(T) * 8, instruction_,
+      [](T val0, T val1) -> T { return val0 + val1; },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vredsum64Unmasked) {
+  using T = uint64_t;
+  SetSemanticFunction(&Vredsum);
+  ReductionOpTestHelper<T, T>(
+      "Vredsum", /*sew*/ sizeof(T) * 8, instruction_,
+      [](T val0, T val1) -> T { return val0 + val1; },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vredxor16Unmasked) {
+  using T = uint16_t;
+  SetSemanticFunction(&Vredxor);
+  ReductionOpTestHelper<T, T>(
+      "Vredxor", /*sew*/ sizeof(T) * 8, instruction_,
+      [](T val0, T val1) -> T { return val0 ^ val1; },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vredmin32Unmasked) {
+  using T = int32_t;
+  SetSemanticFunction(&Vredmin);
+  ReductionOpTestHelper<T, T>(
+      "Vredmin", /*sew*/ sizeof(T) * 8, instruction_,
+      [](T val0, T val1) -> T { return val0 < val1 ? val0 : val1; },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vredmaxu8Unmasked) {
+  using T = uint8_t;
+  SetSemanticFunction(&Vredmaxu);
+  ReductionOpTestHelper<T, T>(
+      "Vredmaxu", /*sew*/ sizeof(T) * 8, instruction_,
+      [](T val0, T val1) -> T { return val0 > val1 ? val0 : val1; },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vwredsumu16Unmasked) {
+  using T = uint16_t;
+  using WT = WideType<T>::type;
+  SetSemanticFunction(&Vwredsumu);
+  ReductionOpTestHelper<WT, T>(
+      "Vredsumu", /*sew*/ sizeof(T) * 8, instruction_,
+      [](WT val0, T val1) -> WT { return val0 + static_cast<WT>(val1); },
+      Span<const uint8_t>(kAllOnesMask));
+}
+TEST_F(RiscVVectorReductionInstructionsTest, Vwredsum8Unmasked) {
+  using T = int8_t;
+  using WT = WideType<T>::type;
+  SetSemanticFunction(&Vwredsum);
+  ReductionOpTestHelper<WT, T>(
+      "Vredsum", /*sew*/ sizeof(T) * 8, instruction_,
+      [](WT val0, T val1) -> WT { return val0 + static_cast<WT>(val1); },
+      Span<const uint8_t>(kAllOnesMask));
+}
+
 }  // namespace
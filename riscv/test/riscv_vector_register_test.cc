@@ -0,0 +1,160 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
+#include "riscv/riscv_register.h"
+#include "riscv/riscv_state.h"
+#include "riscv/riscv_vector_instruction_helpers.h"
+#include "riscv/riscv_vector_state.h"
+
+namespace {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::RegisterBase;
+using ::mpact::sim::riscv::GetContiguousRegisterGroup;
+using ::mpact::sim::riscv::RiscVState;
+using ::mpact::sim::riscv::RiscVVectorState;
+using ::mpact::sim::riscv::RiscVXlen;
+using ::mpact::sim::riscv::RV32VectorDestinationOperand;
+using ::mpact::sim::riscv::RV32VectorSourceOperand;
+using ::mpact::sim::riscv::RVVectorRegister;
+using ::mpact::sim::util::FlatDemandMemory;
+
+constexpr int kVLengthInBytes = 64;
+constexpr int kGroupSize = 4;
+
+class RV32VectorRegisterTest : public testing::Test {
+ protected:
+  RV32VectorRegisterTest() {
+    state_ = new RiscVState("test", RiscVXlen::RV64, &memory_);
+    vstate_ = new RiscVVectorState(state_, kVLengthInBytes);
+    // Fill the register group v8..v11 with the byte index within the group.
+    for (int i = 0; i < kGroupSize; i++) {
+      auto *reg =
+          state_->GetRegister<RVVectorRegister>(absl::StrCat("v", 8 + i)).first;
+      auto span = reg->data_buffer()->Get<uint8_t>();
+      for (int j = 0; j < kVLengthInBytes; j++) {
+        span[j] = static_cast<uint8_t>(i * kVLengthInBytes + j);
+      }
+      group_.push_back(reg);
+    }
+  }
+  ~RV32VectorRegisterTest() override {
+    delete state_;
+    delete vstate_;
+  }
+
+  FlatDemandMemory memory_;
+  RiscVState *state_;
+  RiscVVectorState *vstate_;
+  std::vector<RegisterBase *> group_;
+};
+
+// The register spans of a source operand hold the same elements as those
+// returned by the element accessors.
+TEST_F(RV32VectorRegisterTest, SourceSpans) {
+  RV32VectorSourceOperand op(absl::Span<RegisterBase *>(group_), "v8");
+  EXPECT_EQ(op.ElementsPerRegister<uint8_t>(), kVLengthInBytes);
+  EXPECT_EQ(op.ElementsPerRegister<uint32_t>(), kVLengthInBytes / 4);
+  int elements_per_register = op.ElementsPerRegister<uint16_t>();
+  for (int reg = 0; reg < op.size(); reg++) {
+    auto span = op.GetRegisterSpan<uint16_t>(reg);
+    ASSERT_EQ(span.size(), elements_per_register);
+    for (int i = 0; i < elements_per_register; i++) {
+      EXPECT_EQ(span[i], op.AsUint16(reg * elements_per_register + i))
+          << "register: " << reg << " element: " << i;
+    }
+  }
+}
+
+// The span returned with the copied data buffer of a destination operand holds
+// the prior register contents, and writes to it are visible once the data
+// buffer is submitted.
+TEST_F(RV32VectorRegisterTest, DestinationSpans) {
+  RV32VectorDestinationOperand op(absl::Span<RegisterBase *>(group_), 0, "v8");
+  EXPECT_EQ(op.ElementsPerRegister<uint64_t>(), kVLengthInBytes / 8);
+  absl::Span<uint32_t> span;
+  DataBuffer *db = op.CopyDataBuffer<uint32_t>(1, &span);
+  ASSERT_EQ(span.size(), kVLengthInBytes / 4);
+  auto prior = group_[1]->data_buffer()->Get<uint32_t>();
+  for (int i = 0; i < span.size(); i++) {
+    EXPECT_EQ(span[i], prior[i]);
+    span[i] = i;
+  }
+  db->Submit();
+  auto value = group_[1]->data_buffer()->Get<uint32_t>();
+  for (int i = 0; i < value.size(); i++) {
+    EXPECT_EQ(value[i], i);
+  }
+}
+
+// A data buffer for a partial write holds the prior register contents, while a
+// data buffer for a write of the whole register is a new buffer of the register
+// size. Either replaces the register contents when submitted.
+TEST_F(RV32VectorRegisterTest, WriteDataBuffer) {
+  RV32VectorDestinationOperand op(absl::Span<RegisterBase *>(group_), 0, "v8");
+  for (bool overwrite : {false, true}) {
+    DataBuffer *db = op.WriteDataBuffer(2, overwrite);
+    auto prior = group_[2]->data_buffer();
+    EXPECT_NE(db, prior);
+    auto span = db->Get<uint8_t>();
+    ASSERT_EQ(span.size(), kVLengthInBytes);
+    for (int i = 0; i < span.size(); i++) {
+      if (!overwrite) EXPECT_EQ(span[i], prior->Get<uint8_t>(i));
+      span[i] = static_cast<uint8_t>(i * 3 + overwrite);
+    }
+    db->Submit();
+    auto value = group_[2]->data_buffer()->Get<uint8_t>();
+    for (int i = 0; i < value.size(); i++) {
+      EXPECT_EQ(value[i], static_cast<uint8_t>(i * 3 + overwrite));
+    }
+  }
+}
+
+// A register group is returned as a contiguous, aligned copy of the registers,
+// while a single register is returned in place.
+TEST_F(RV32VectorRegisterTest, ContiguousRegisterGroup) {
+  auto *inst = new Instruction(state_);
+  auto *group_op =
+      new RV32VectorSourceOperand(absl::Span<RegisterBase *>(group_), "v8");
+  auto *single_op = new RV32VectorSourceOperand(
+      absl::Span<RegisterBase *>(group_).subspan(2, 1), "v10");
+  inst->AppendSource(group_op);
+  inst->AppendSource(single_op);
+  auto group = GetContiguousRegisterGroup<uint16_t>(vstate_, inst, 0, 0);
+  ASSERT_EQ(group.size(), kGroupSize * kVLengthInBytes / 2);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(group.data()) %
+                RiscVVectorState::kGroupBufferAlignment,
+            0);
+  for (int i = 0; i < group.size(); i++) {
+    EXPECT_EQ(group[i], group_op->AsUint16(i)) << "element: " << i;
+  }
+  auto single = GetContiguousRegisterGroup<uint32_t>(vstate_, inst, 1, 1);
+  EXPECT_EQ(single.data(), group_[2]->data_buffer()->Get<uint32_t>().data());
+  EXPECT_EQ(single.size(), kVLengthInBytes / 4);
+  inst->DecRef();
+}
+
+}  // namespace
@@ -16,10 +16,12 @@
 
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <ios>
 #include <vector>
 
 #include "absl/random/random.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "googlemock/include/gmock/gmock.h"
 #include "mpact/sim/generic/instruction.h"
@@ -60,6 +62,7 @@ using ::mpact::sim::riscv::test::kRs1;
 using ::mpact::sim::riscv::test::kRs1Name;
 using ::mpact::sim::riscv::test::kSewSettingsByByteSize;
 using ::mpact::sim::riscv::test::kVd;
+using ::mpact::sim::riscv::test::kVdName;
 using ::mpact::sim::riscv::test::kVectorLengthInBytes;
 using ::mpact::sim::riscv::test::kVmask;
 using ::mpact::sim::riscv::test::kVmaskName;
@@ -96,7 +99,83 @@ constexpr uint8_t kAllOnesMask[kVectorLengthInBytes] = {
 };
 
 class RiscVVectorUnaryInstructionsTest
-    : public RiscVVectorInstructionsTestBase {};
+    : public RiscVVectorInstructionsTestBase {
+ protected:
+  // Tests a vector mask set first instruction (vmsbf, vmsif, vmsof) with
+  // random source, mask, and destination registers for vector lengths that
+  // are not multiples of the 64 bit mask words. The expected value of the
+  // active elements in [0, vl) is computed by 'op' from the element index and
+  // the index of the first active set bit of the source (vl if there is none).
+  // Inactive and tail elements are left undisturbed.
+  void MaskSetFirstTestHelper(absl::string_view name,
+                              std::function<bool(int, int)> op) {
+    AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
+    uint8_t vs2_value[kVectorLengthInBytes];
+    uint8_t mask_value[kVectorLengthInBytes];
+    uint8_t vd_value[kVectorLengthInBytes];
+    // Set vtype to byte vector, and vector lmul to 8.
+    uint32_t vtype =
+        (kSewSettingsByByteSize[1] << 3) | kLmulSettingByLogSize[7];
+    for (int vlen : {1, 7, 63, 64, 65, 100, 129, 448, 511, 512}) {
+      for (int i = 0; i < 10; i++) {
+        FillArrayWithRandomValues<uint8_t>(vs2_value);
+        FillArrayWithRandomValues<uint8_t>(mask_value);
+        FillArrayWithRandomValues<uint8_t>(vd_value);
+        // Make the first set source bits sparse, so that the first active set
+        // bit is spread out over the vector length.
+        int first_byte = absl::Uniform(absl::IntervalClosedOpen, bitgen_, 0,
+                                       kVectorLengthInBytes);
+        for (int j = 0; j < first_byte; j++) vs2_value[j] = 0;
+        // Every other iteration the instruction is unmasked.
+        if (i & 1) std::memset(mask_value, 0xff, kVectorLengthInBytes);
+        ConfigureVectorUnit(vtype, vlen);
+        ASSERT_EQ(rv_vector_->vector_length(), vlen);
+        SetVectorRegisterValues<uint8_t>({{kVs2Name, vs2_value},
+                                          {kVmaskName, mask_value},
+                                          {kVdName, vd_value}});
+        instruction_->Execute();
+        EXPECT_FALSE(rv_vector_->vector_exception());
+        auto get_bit = [](const uint8_t *value, int index) -> bool {
+          return (value[index >> 3] >> (index & 0b111)) & 0b1;
+        };
+        int first = vlen;
+        for (int j = 0; j < vlen; j++) {
+          if (get_bit(vs2_value, j) && get_bit(mask_value, j)) {
+            first = j;
+            break;
+          }
+        }
+        auto dest_span = vreg_[kVd]->data_buffer()->Get<uint8_t>();
+        for (int j = 0; j < kVectorLengthInBytes * 8; j++) {
+          bool expected = get_bit(vd_value, j);
+          if ((j < vlen) && get_bit(mask_value, j)) expected = op(j, first);
+          EXPECT_EQ(get_bit(dest_span.data(), j), expected)
+              << name << " vl: " << vlen << " first: " << first
+              << " index: " << j;
+        }
+      }
+    }
+  }
+
+  // Tests that a vector mask set first instruction with a non-zero vstart
+  // raises an exception and leaves the destination register unchanged.
+  void MaskSetFirstVstartTestHelper(absl::string_view name) {
+    AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
+    uint32_t vtype =
+        (kSewSettingsByByteSize[1] << 3) | kLmulSettingByLogSize[7];
+    ConfigureVectorUnit(vtype, kVectorLengthInBytes * 8);
+    SetVectorRegisterValues<uint8_t>(
+        {{kVs2Name, kA5Mask}, {kVmaskName, kAllOnesMask}, {kVdName, k5AMask}});
+    rv_vector_->set_vstart(5);
+    instruction_->Execute();
+    EXPECT_TRUE(rv_vector_->vector_exception()) << name;
+    rv_vector_->clear_vector_exception();
+    auto dest_span = vreg_[kVd]->data_buffer()->Get<uint8_t>();
+    for (int i = 0; i < kVectorLengthInBytes; i++) {
+      EXPECT_EQ(dest_span[i], k5AMask[i]) << name << " index: " << i;
+    }
+  }
+};
 
 // Test move vector element 0 to scalar register.
 TEST_F(RiscVVectorUnaryInstructionsTest, VmvToScalar) {
@@ -420,6 +499,17 @@ TEST_F(RiscVVectorUnaryInstructionsTest, Vmsbf) {
   }
 }
 
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsbfMaskedTail) {
+  SetSemanticFunction(&Vmsbf);
+  MaskSetFirstTestHelper("Vmsbf",
+                         [](int index, int first) { return index < first; });
+}
+
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsbfVstart) {
+  SetSemanticFunction(&Vmsbf);
+  MaskSetFirstVstartTestHelper("Vmsbf");
+}
+
 TEST_F(RiscVVectorUnaryInstructionsTest, Vmsof) {
   SetSemanticFunction(&Vmsof);
   AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
@@ -479,6 +569,17 @@ TEST_F(RiscVVectorUnaryInstructionsTest, Vmsof) {
   }
 }
 
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsofMaskedTail) {
+  SetSemanticFunction(&Vmsof);
+  MaskSetFirstTestHelper("Vmsof",
+                         [](int index, int first) { return index == first; });
+}
+
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsofVstart) {
+  SetSemanticFunction(&Vmsof);
+  MaskSetFirstVstartTestHelper("Vmsof");
+}
+
 TEST_F(RiscVVectorUnaryInstructionsTest, Vmsif) {
   SetSemanticFunction(&Vmsif);
   AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
@@ -537,6 +638,17 @@ TEST_F(RiscVVectorUnaryInstructionsTest, Vmsif) {
   }
 }
 
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsifMaskedTail) {
+  SetSemanticFunction(&Vmsif);
+  MaskSetFirstTestHelper("Vmsif",
+                         [](int index, int first) { return index <= first; });
+}
+
+TEST_F(RiscVVectorUnaryInstructionsTest, VmsifVstart) {
+  SetSemanticFunction(&Vmsif);
+  MaskSetFirstVstartTestHelper("Vmsif");
+}
+
 // Helper function for testing Viota instructions.
 template <typename T>
 void TestViota(RiscVVectorUnaryInstructionsTest *tester, Instruction *inst) {